@@ -9,6 +9,7 @@
 #include <stdlib.h>
 #include <sys/socket.h>
 #include <fcntl.h>
+#include <errno.h>
 
 // Forward declaration
 void create_admin_panel(void);
@@ -25,6 +26,235 @@ static void on_room_ended_broadcast(int room_id) {
     g_idle_add(idle_refresh_admin_panel, NULL);
 }
 
+static gboolean idle_show_job_error(gpointer user_data) {
+    char *text = (char *)user_data;
+    show_error_dialog(text);
+    g_free(text);
+    return FALSE;
+}
+
+// Callback when JOB_DONE push received: successful cleanups stay silent,
+// a failed background job is reported since the admin has already moved on
+static void on_job_done_broadcast(int job_id, const char *type, const char *state, const char *message) {
+    if (strcmp(state, "failed") == 0) {
+        g_idle_add(idle_show_job_error,
+                   g_strdup_printf("Background job #%d (%s) failed:\n%s", job_id, type, message));
+    }
+}
+
+
+// Trạng thái một lần upload CSV chạy trong GTK main loop:
+// gửi file theo chunk (UPLOAD_CHUNK, chờ ACK từng chunk), sau UPLOAD_COMMIT thì
+// đọc IMPORT_PROGRESS/IMPORT_ROW_ERROR không chặn cho tới response cuối
+typedef struct {
+    NetUpload net;
+    int committed;
+    char pending[BUFFER_SIZE];   // phần response chưa đủ dòng
+    size_t pending_len;
+    int rows;
+    int errors;
+    GString *row_errors;         // các lỗi đầu tiên để hiển thị khi xong
+    int row_errors_shown;
+    gint64 last_activity;
+    int restart_listener;
+    char filename[256];
+    GtkWidget *window;
+    GtkWidget *progress_bar;
+    GtkWidget *status_label;
+} CsvUpload;
+
+#define CSV_UPLOAD_TICK_MS 30
+#define CSV_UPLOAD_TIMEOUT_US (60 * G_USEC_PER_SEC)
+#define CSV_UPLOAD_ERRORS_SHOWN 15
+#define CSV_UPLOAD_TICK_BUDGET_US (20 * 1000)
+
+static void csv_upload_finish(CsvUpload *up, const char *final_line) {
+    net_upload_close(&up->net);
+    gtk_widget_destroy(up->window);
+    if (up->restart_listener) {
+        broadcast_start_listener();
+    }
+
+    int imported = 0, skipped = 0;
+    GtkMessageType type = GTK_MESSAGE_INFO;
+    GString *msg = g_string_new(NULL);
+
+    if (final_line && sscanf(final_line, "IMPORT_OK|%d|%d", &imported, &skipped) >= 1) {
+        g_string_append_printf(msg, "Import successful!\n\nImported %d question(s) to this room.\n"
+                               "Rejected rows: %d\n\nFile: %s", imported, skipped, up->filename);
+        if (skipped > 0) type = GTK_MESSAGE_WARNING;
+    } else {
+        type = GTK_MESSAGE_ERROR;
+        g_string_append_printf(msg, "Import failed!\n\nServer error: %.200s",
+                               final_line ? final_line : "No response from server");
+    }
+    if (up->row_errors->len > 0) {
+        g_string_append_printf(msg, "\n\nRow errors:\n%s", up->row_errors->str);
+        if (up->errors > up->row_errors_shown) {
+            g_string_append_printf(msg, "... and %d more", up->errors - up->row_errors_shown);
+        }
+    }
+
+    GtkWidget *result_dialog = gtk_message_dialog_new(
+        GTK_WINDOW(main_window),
+        GTK_DIALOG_DESTROY_WITH_PARENT,
+        type,
+        GTK_BUTTONS_OK,
+        "%s", msg->str);
+    gtk_dialog_run(GTK_DIALOG(result_dialog));
+    gtk_widget_destroy(result_dialog);
+
+    g_string_free(msg, TRUE);
+    g_string_free(up->row_errors, TRUE);
+    g_free(up);
+}
+
+// Xử lý các dòng response hoàn chỉnh; trả về dòng kết quả cuối (đã cấp phát) nếu có
+static char *csv_upload_handle_lines(CsvUpload *up) {
+    up->pending[up->pending_len] = '\0';
+    up->pending_len = broadcast_extract_pushes(up->pending);
+
+    char *line = up->pending;
+    char *newline;
+    char *final_line = NULL;
+    while (!final_line && (newline = strchr(line, '\n')) != NULL) {
+        *newline = '\0';
+        if (newline > line && newline[-1] == '\r') newline[-1] = '\0';
+
+        int row = 0;
+        char reason[128];
+        if (sscanf(line, "IMPORT_PROGRESS|%d|%d", &up->rows, &up->errors) == 2) {
+            // cập nhật ở cuối tick
+        } else if (sscanf(line, "IMPORT_ROW_ERROR|%d|%127[^\n]", &row, reason) == 2) {
+            if (up->row_errors_shown < CSV_UPLOAD_ERRORS_SHOWN) {
+                g_string_append_printf(up->row_errors, "Line %d: %s\n", row, reason);
+                up->row_errors_shown++;
+            }
+        } else if (strncmp(line, "IMPORT_OK", 9) == 0 || strncmp(line, "ERROR", 5) == 0 ||
+                   strncmp(line, "UPLOAD_FAIL", 11) == 0) {
+            final_line = g_strdup(line);
+        }
+        line = newline + 1;
+    }
+
+    size_t rest = up->pending_len - (size_t)(line - up->pending);
+    memmove(up->pending, line, rest);
+    up->pending_len = rest;
+    return final_line;
+}
+
+static gboolean csv_upload_tick(gpointer user_data) {
+    CsvUpload *up = (CsvUpload *)user_data;
+    gint64 now = g_get_monotonic_time();
+
+    if (!up->committed) {
+        // Gửi các chunk tiếp theo, giới hạn thời gian mỗi tick để UI vẫn mượt
+        char error[128];
+        int rc;
+        while ((rc = net_upload_step(&up->net, error, sizeof(error))) == 0 &&
+               g_get_monotonic_time() - now < CSV_UPLOAD_TICK_BUDGET_US) {
+        }
+        if (rc < 0) {
+            char line[160];
+            snprintf(line, sizeof(line), "ERROR|%s", error);
+            csv_upload_finish(up, line);
+            return FALSE;
+        }
+        up->last_activity = now;
+        if (rc == 1) {
+            // Server đã có đủ file -> import, kèm frame tiến độ
+            char commit[64];
+            snprintf(commit, sizeof(commit), "UPLOAD_COMMIT|%d|1\n", up->net.upload_id);
+            send_message(commit);
+            up->committed = 1;
+        }
+    }
+
+    // Đọc các frame tiến độ server gửi về
+    while (up->committed) {
+        size_t space = sizeof(up->pending) - 1 - up->pending_len;
+        if (space == 0) {
+            up->pending_len = 0;  // dòng quá dài bất thường -> bỏ
+            continue;
+        }
+        ssize_t n = recv(client.socket_fd, up->pending + up->pending_len, space, MSG_DONTWAIT);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            csv_upload_finish(up, "Connection lost during import");
+            return FALSE;
+        }
+        if (n < 0) break;
+        up->pending_len += (size_t)n;
+        up->last_activity = now;
+
+        char *final_line = csv_upload_handle_lines(up);
+        if (final_line) {
+            csv_upload_finish(up, final_line);
+            g_free(final_line);
+            return FALSE;
+        }
+    }
+
+    if (now - up->last_activity > CSV_UPLOAD_TIMEOUT_US) {
+        csv_upload_finish(up, "Import timed out");
+        return FALSE;
+    }
+
+    char status[256];
+    if (!up->committed) {
+        gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(up->progress_bar),
+                                      (double)up->net.offset / (double)up->net.size);
+        snprintf(status, sizeof(status), "Uploading %ld / %ld bytes",
+                 up->net.offset, up->net.size);
+    } else {
+        gtk_progress_bar_pulse(GTK_PROGRESS_BAR(up->progress_bar));
+        snprintf(status, sizeof(status), "Saving questions...\nRows checked: %d  |  Errors: %d",
+                 up->rows, up->errors);
+    }
+    gtk_label_set_text(GTK_LABEL(up->status_label), status);
+    return TRUE;
+}
+
+// Mở phiên upload (UPLOAD_BEGIN) rồi chạy phần còn lại trong main loop; FALSE nếu server từ chối
+static gboolean csv_upload_start(int room_id, const char *filepath, const char *filename, long file_size,
+                                 char *error, size_t error_size) {
+    CsvUpload *up = g_new0(CsvUpload, 1);
+    if (net_upload_begin(&up->net, "exam_csv", room_id, filepath, filename, file_size,
+                         error, error_size) != 0) {
+        g_free(up);
+        return FALSE;
+    }
+    up->row_errors = g_string_new(NULL);
+    up->last_activity = g_get_monotonic_time();
+    snprintf(up->filename, sizeof(up->filename), "%s", filename);
+
+    // Listener đọc cả socket khi gặp push -> tạm dừng, push được tách trong csv_upload_tick
+    up->restart_listener = broadcast_is_listening();
+    if (up->restart_listener) {
+        broadcast_stop_listener();
+    }
+
+    up->window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+    gtk_window_set_title(GTK_WINDOW(up->window), "Importing CSV");
+    gtk_window_set_transient_for(GTK_WINDOW(up->window), GTK_WINDOW(main_window));
+    gtk_window_set_modal(GTK_WINDOW(up->window), TRUE);
+    gtk_window_set_deletable(GTK_WINDOW(up->window), FALSE);
+    gtk_window_set_default_size(GTK_WINDOW(up->window), 380, -1);
+
+    GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 10);
+    gtk_container_set_border_width(GTK_CONTAINER(box), 15);
+    char title[320];
+    snprintf(title, sizeof(title), "File: %s (%ld bytes)", filename, file_size);
+    gtk_box_pack_start(GTK_BOX(box), gtk_label_new(title), FALSE, FALSE, 0);
+    up->progress_bar = gtk_progress_bar_new();
+    gtk_box_pack_start(GTK_BOX(box), up->progress_bar, FALSE, FALSE, 0);
+    up->status_label = gtk_label_new("Starting upload...");
+    gtk_box_pack_start(GTK_BOX(box), up->status_label, FALSE, FALSE, 0);
+    gtk_container_add(GTK_CONTAINER(up->window), box);
+    gtk_widget_show_all(up->window);
+
+    g_timeout_add(CSV_UPLOAD_TICK_MS, csv_upload_tick, up);
+    return TRUE;
+}
 
 // Import questions from a CSV file into the currently selected room
 void on_import_csv_to_room(GtkWidget *widget, gpointer user_data)
@@ -81,33 +311,11 @@ void on_import_csv_to_room(GtkWidget *widget, gpointer user_data)
             // Get file size
             fseek(fp, 0, SEEK_END);
             long file_size = ftell(fp);
-            fseek(fp, 0, SEEK_SET);
-            
-            // Validate file size (max 5MB)
-            if (file_size <= 0 || file_size > 5 * 1024 * 1024) {
-                fclose(fp);
-                show_error_dialog("File too large or empty (max 5MB)!");
-                g_free(filepath);
-                gtk_widget_destroy(dialog);
-                return;
-            }
-            
-            // Read file into buffer
-            char *file_buffer = malloc(file_size);
-            if (!file_buffer) {
-                fclose(fp);
-                show_error_dialog("Memory allocation failed!");
-                g_free(filepath);
-                gtk_widget_destroy(dialog);
-                return;
-            }
-            
-            size_t read_bytes = fread(file_buffer, 1, file_size, fp);
             fclose(fp);
             
-            if (read_bytes != file_size) {
-                free(file_buffer);
-                show_error_dialog("Failed to read file!");
+            // Server parse CSV theo luồng nên không giới hạn kích thước
+            if (file_size <= 0) {
+                show_error_dialog("File is empty!");
                 g_free(filepath);
                 gtk_widget_destroy(dialog);
                 return;
@@ -119,114 +327,12 @@ void on_import_csv_to_room(GtkWidget *widget, gpointer user_data)
             if (!filename) filename = strrchr(filepath, '\\');
             filename = filename ? filename + 1 : filepath;
             
-            // Hiển thị loading message
-            GtkWidget *loading_dialog = gtk_message_dialog_new(
-                GTK_WINDOW(main_window),
-                GTK_DIALOG_DESTROY_WITH_PARENT,
-                GTK_MESSAGE_INFO,
-                GTK_BUTTONS_NONE,
-                "Uploading and importing CSV...\n\nFile: %s (%ld bytes)\nPlease wait...",
-                filename, file_size);
-            gtk_widget_show_all(loading_dialog);
-            
-            // Process events để hiển thị dialog
-            while (gtk_events_pending())
-                gtk_main_iteration();
-            
-            // Gửi header: IMPORT_CSV|room_id|filename|file_size
-            char header[512];
-            snprintf(header, sizeof(header), "IMPORT_CSV|%d|%s|%ld\n", 
-                     room_id, filename, file_size);
-            send_message(header);
-            
-            // Wait for ACK from server
-            char ack_buffer[64];
-            ssize_t ack_n = receive_message(ack_buffer, sizeof(ack_buffer));
-            if (ack_n <= 0 || strncmp(ack_buffer, "READY", 5) != 0) {
-                free(file_buffer);
-                gtk_widget_destroy(loading_dialog);
-                show_error_dialog("Server not ready to receive file!");
-                g_free(filepath);
-                gtk_widget_destroy(dialog);
-                return;
-            }
-            
-            // Gửi file content
-            ssize_t sent = send(client.socket_fd, file_buffer, file_size, 0);
-            free(file_buffer);
-            
-            if (sent != file_size) {
-                gtk_widget_destroy(loading_dialog);
-                show_error_dialog("Failed to upload file!");
-                g_free(filepath);
-                gtk_widget_destroy(dialog);
-                return;
-            }
-            
-            // Nhận response từ server
-            char buffer[BUFFER_SIZE];
-            ssize_t n = receive_message(buffer, sizeof(buffer));
-            
-            // Đóng loading dialog
-            gtk_widget_destroy(loading_dialog);
-
-            if (n > 0)
-            {
-                if (strstr(buffer, "IMPORT_OK"))
-                {
-                    // Parse số lượng câu hỏi đã import: IMPORT_OK|count
-                    int count = 0;
-                    if (sscanf(buffer, "IMPORT_OK|%d", &count) == 1)
-                    {
-                        char success_msg[256];
-                        snprintf(success_msg, sizeof(success_msg),
-                                "Import successful!\n\n"
-                                "Imported %d question(s) to this room.\n\n"
-                                "File: %s",
-                                count, filename);
-                        
-                        GtkWidget *success_dialog = gtk_message_dialog_new(
-                            GTK_WINDOW(main_window),
-                            GTK_DIALOG_DESTROY_WITH_PARENT,
-                            GTK_MESSAGE_INFO,
-                            GTK_BUTTONS_OK,
-                            "%s", success_msg);
-                        gtk_dialog_run(GTK_DIALOG(success_dialog));
-                        gtk_widget_destroy(success_dialog);
-                    }
-                }
-                else if (strstr(buffer, "ERROR"))
-                {
-                    char error_msg[512];
-                    snprintf(error_msg, sizeof(error_msg),
-                            "Import failed!\n\n"
-                            "Server error: %.200s\n\n"
-                            "Please check:\n"
-                            "• CSV format is correct\n"
-                            "• File is accessible by server\n"
-                            "• Database has required columns",
-                            buffer);
-                    
-                    GtkWidget *error_dialog = gtk_message_dialog_new(
-                        GTK_WINDOW(main_window),
-                        GTK_DIALOG_DESTROY_WITH_PARENT,
-                        GTK_MESSAGE_ERROR,
-                        GTK_BUTTONS_OK,
-                        "%s", error_msg);
-                    gtk_dialog_run(GTK_DIALOG(error_dialog));
-                    gtk_widget_destroy(error_dialog);
-                }
-            }
-            else
-            {
-                GtkWidget *error_dialog = gtk_message_dialog_new(
-                    GTK_WINDOW(main_window),
-                    GTK_DIALOG_DESTROY_WITH_PARENT,
-                    GTK_MESSAGE_ERROR,
-                    GTK_BUTTONS_OK,
-                    "No response from server!\n\nPlease check connection.");
-                gtk_dialog_run(GTK_DIALOG(error_dialog));
-                gtk_widget_destroy(error_dialog);
+            // Upload theo chunk + nhận tiến độ chạy nền trong main loop (xem csv_upload_tick)
+            char error[128];
+            if (!csv_upload_start(room_id, filepath, filename, file_size, error, sizeof(error))) {
+                char msg[192];
+                snprintf(msg, sizeof(msg), "Upload failed: %s", error);
+                show_error_dialog(msg);
             }
             
             g_free(filepath);
@@ -480,9 +586,11 @@ void on_delete_room_clicked(GtkWidget *widget, gpointer data) {
                                        GTK_MESSAGE_INFO,
                                        GTK_BUTTONS_OK,
                                        "Room deleted successfully!");
+        // DELETE_ROOM_OK|job_id: answers/results are removed by a background job
         gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(result_dialog),
                                                  "Room #%d has been permanently removed.\n"
-                                                 "All participants have been notified.",
+                                                 "All participants have been notified.\n"
+                                                 "Its data is being cleaned up in the background.",
                                                  room_id);
         gtk_dialog_run(GTK_DIALOG(result_dialog));
         gtk_widget_destroy(result_dialog);
@@ -562,10 +670,8 @@ void create_admin_panel()
     // Flush old socket data to prevent stale responses
     flush_socket_buffer(client.socket_fd);
     
-    // Request rooms từ server
-    send_message("LIST_MY_ROOMS\n");
-    char buffer[BUFFER_SIZE * 4];
-    ssize_t n = receive_message(buffer, sizeof(buffer));
+    // Request rooms từ server theo từng trang (LIST_MY_ROOMS|cursor), ghép thành một danh sách
+    char *buffer = net_request_list("LIST_MY_ROOMS", 0, "\n");
 
     // Tạo scrolled window chứa list rooms
     GtkWidget *scroll = gtk_scrolled_window_new(NULL, NULL);
@@ -579,17 +685,10 @@ void create_admin_panel()
     gtk_box_pack_start(GTK_BOX(vbox), scroll, TRUE, TRUE, 0);
 
     // Parse và hiển thị rooms
-    if (n > 0 && strncmp(buffer, "LIST_MY_ROOMS_OK|", 17) == 0) {
-        // Parse header: LIST_MY_ROOMS_OK|count
-        int room_count_expected = 0;
-        sscanf(buffer, "LIST_MY_ROOMS_OK|%d", &room_count_expected);
-        
+    if (buffer && strncmp(buffer, "LIST_MY_ROOMS_OK|", 17) == 0) {
+        // Parse: mỗi trang bắt đầu bằng LIST_MY_ROOMS_OK|count, theo sau là các dòng ROOM|
         char *saveptr1, *saveptr2;  // For strtok_r
-        char buffer_copy[BUFFER_SIZE * 4];
-        strncpy(buffer_copy, buffer, sizeof(buffer_copy) - 1);
-        buffer_copy[sizeof(buffer_copy) - 1] = '\0';
-        
-        char *line = strtok_r(buffer_copy, "\n", &saveptr1);
+        char *line = strtok_r(buffer, "\n", &saveptr1);
         line = strtok_r(NULL, "\n", &saveptr1); // Bỏ qua header line
 
         int room_count = 0;
@@ -708,6 +807,7 @@ void create_admin_panel()
         gtk_widget_set_margin_bottom(error_label, 50);
         gtk_container_add(GTK_CONTAINER(list_box), error_label);
     }
+    free(buffer);
 
     // Back button
     GtkWidget *button_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 10);
@@ -721,6 +821,7 @@ void create_admin_panel()
     
     // Start listening for ROOM_ENDED broadcasts to auto-refresh
     broadcast_on_room_ended(on_room_ended_broadcast);
+    broadcast_on_job_done(on_job_done_broadcast);
     broadcast_start_listener();
 }
 
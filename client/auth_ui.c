@@ -42,6 +42,11 @@ void on_login_clicked(GtkWidget *widget, gpointer data)
             token_start = strchr(token_start, '|');
             if (token_start) {
                 token_start++; // skip second '|'
+                size_t token_len = strcspn(token_start, "|\n");
+                if (token_len < sizeof(client.session_token)) {
+                    memcpy(client.session_token, token_start, token_len);
+                    client.session_token[token_len] = '\0';
+                }
                 
                 // Parse role (skip to third '|')
                 char *role_start = strchr(token_start, '|');
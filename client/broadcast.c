@@ -15,7 +15,10 @@ static RoomStartedCallback room_started_callback = NULL;
 static RoomCreatedCallback room_created_callback = NULL;
 static RoomDeletedCallback room_deleted_callback = NULL;
 static RoomEndedCallback room_ended_callback = NULL;
+static TimeUpdateCallback time_update_callback = NULL;
 static PracticeClosedCallback practice_closed_callback = NULL;
+static PracticeReadyCallback practice_ready_callback = NULL;
+static JobDoneCallback job_done_callback = NULL;
 
 // Listener state
 static guint timer_id = 0;
@@ -43,7 +46,15 @@ static int is_broadcast_message(const char *message) {
             strncmp(message, "ROOM_CREATED", 12) == 0 ||
             strncmp(message, "ROOM_DELETED", 12) == 0 ||
             strncmp(message, "ROOM_ENDED", 10) == 0 ||
-            strncmp(message, "PRACTICE_CLOSED", 15) == 0);
+            strncmp(message, "TIME_UPDATE", 11) == 0 ||
+            strncmp(message, "PRACTICE_CLOSED", 15) == 0 ||
+            strncmp(message, "PRACTICE_READY", 14) == 0 ||
+            strncmp(message, "LIVE_STATS", 10) == 0 ||
+            strncmp(message, "METRICS|", 8) == 0 ||
+            strncmp(message, "JOB_DONE|", 9) == 0 ||
+            // SUBSCRIBE/UNSUBSCRIBE gửi kiểu fire-and-forget, ack không thuộc response nào
+            strncmp(message, "SUBSCRIBE_", 10) == 0 ||
+            strncmp(message, "UNSUBSCRIBE_", 12) == 0);
 }
 
 // Parse and handle broadcast messages
@@ -83,6 +94,39 @@ static void handle_broadcast_message(const char *message) {
             practice_closed_callback(practice_id, room_name);
         }
     }
+    // Parse PRACTICE_READY|practice_id|room_name (cooldown đã hết)
+    else if (strncmp(message, "PRACTICE_READY", 14) == 0) {
+        char msg_copy[512];
+        strncpy(msg_copy, message, sizeof(msg_copy) - 1);
+        msg_copy[sizeof(msg_copy) - 1] = '\0';
+
+        char *ptr = msg_copy;
+        strtok(ptr, "|"); // Skip "PRACTICE_READY"
+        char *practice_id_str = strtok(NULL, "|");
+        char *room_name = strtok(NULL, "|");
+
+        if (practice_id_str && room_name && practice_ready_callback) {
+            int practice_id = atoi(practice_id_str);
+            practice_ready_callback(practice_id, room_name);
+        }
+    }
+    // Parse JOB_DONE|job_id|type|state|message (job nền của admin đã xong)
+    else if (strncmp(message, "JOB_DONE|", 9) == 0) {
+        char msg_copy[512];
+        strncpy(msg_copy, message, sizeof(msg_copy) - 1);
+        msg_copy[sizeof(msg_copy) - 1] = '\0';
+
+        char *ptr = msg_copy + 9;
+        char *job_id_str = strsep(&ptr, "|");
+        char *type = strsep(&ptr, "|");
+        char *state = strsep(&ptr, "|");
+        // message may itself contain '|' (e.g. IMPORT_OK|imported|skipped)
+        const char *text = ptr ? ptr : "";
+
+        if (job_id_str && type && state && job_done_callback) {
+            job_done_callback(atoi(job_id_str), type, state, text);
+        }
+    }
     // Parse ROOM_CREATED|room_id|room_name|duration
     else if (strncmp(message, "ROOM_CREATED", 12) == 0) {
         char msg_copy[512];
@@ -118,6 +162,13 @@ static void handle_broadcast_message(const char *message) {
             room_deleted_callback(room_id);
         }
     }
+    // Parse TIME_UPDATE|room_id|remaining_seconds
+    else if (strncmp(message, "TIME_UPDATE", 11) == 0) {
+        int room_id = 0, remaining = 0;
+        if (sscanf(message, "TIME_UPDATE|%d|%d", &room_id, &remaining) == 2 && time_update_callback) {
+            time_update_callback(room_id, remaining);
+        }
+    }
     // Parse ROOM_ENDED|room_id
     else if (strncmp(message, "ROOM_ENDED", 10) == 0) {
         char msg_copy[512];
@@ -136,6 +187,45 @@ static void handle_broadcast_message(const char *message) {
     }
 }
 
+// Idle callback: handle a push that was pulled out of a synchronous response
+static gboolean dispatch_deferred_push(gpointer user_data) {
+    char *message = (char *)user_data;
+    handle_broadcast_message(message);
+    g_free(message);
+    return FALSE;
+}
+
+// Remove complete push lines from a received buffer so request/response code only
+// sees its own reply. Pushes are handled from the main loop, never re-entrantly.
+size_t broadcast_extract_pushes(char *buffer) {
+    char *read_ptr = buffer;
+    char *write_ptr = buffer;
+
+    while (*read_ptr) {
+        char *newline = strchr(read_ptr, '\n');
+        if (!newline) {
+            // Incomplete trailing line - keep as is
+            size_t rest = strlen(read_ptr);
+            memmove(write_ptr, read_ptr, rest);
+            write_ptr += rest;
+            break;
+        }
+
+        size_t line_len = (size_t)(newline - read_ptr) + 1;
+        if (is_broadcast_message(read_ptr)) {
+            char *message = g_strndup(read_ptr, line_len - 1);
+            g_idle_add(dispatch_deferred_push, message);
+        } else {
+            memmove(write_ptr, read_ptr, line_len);
+            write_ptr += line_len;
+        }
+        read_ptr = newline + 1;
+    }
+
+    *write_ptr = '\0';
+    return (size_t)(write_ptr - buffer);
+}
+
 // GTK timeout callback - periodically polls the socket for broadcast messages using non-blocking I/O
 static gboolean poll_broadcasts(gpointer user_data) {
     if (!is_listening) {
@@ -172,15 +262,19 @@ static gboolean poll_broadcasts(gpointer user_data) {
             if (n > 0) {
                 buffer[n] = '\0';
                 
-                // Strip newline
-                len = strlen(buffer);
-                while (len > 0 && (buffer[len-1] == '\n' || buffer[len-1] == '\r')) {
-                    buffer[len-1] = '\0';
-                    len--;
+                // Several pushes may arrive in one read (e.g. TIME_UPDATE + ROOM_ENDED)
+                char *saveptr = NULL;
+                char *line = strtok_r(buffer, "\n", &saveptr);
+                while (line) {
+                    len = strlen(line);
+                    if (len > 0 && line[len-1] == '\r') {
+                        line[len-1] = '\0';
+                    }
+                    if (is_broadcast_message(line)) {
+                        handle_broadcast_message(line);
+                    }
+                    line = strtok_r(NULL, "\n", &saveptr);
                 }
-                
-                // Handle the broadcast
-                handle_broadcast_message(buffer);
             }
         }
         // If not a broadcast, leave it in buffer for request-response code
@@ -247,6 +341,18 @@ void broadcast_on_practice_closed(PracticeClosedCallback callback) {
     practice_closed_callback = callback;
 }
 
+void broadcast_on_practice_ready(PracticeReadyCallback callback) {
+    practice_ready_callback = callback;
+}
+
 void broadcast_on_room_ended(RoomEndedCallback callback) {
     room_ended_callback = callback;
 }
+
+void broadcast_on_time_update(TimeUpdateCallback callback) {
+    time_update_callback = callback;
+}
+
+void broadcast_on_job_done(JobDoneCallback callback) {
+    job_done_callback = callback;
+}
@@ -17,15 +17,27 @@ typedef void (*RoomStartedCallback)(int room_id, long start_time);
 typedef void (*RoomCreatedCallback)(int room_id, const char *room_name, int duration);
 typedef void (*RoomDeletedCallback)(int room_id);
 typedef void (*RoomEndedCallback)(int room_id);
+typedef void (*TimeUpdateCallback)(int room_id, int remaining_seconds);
 
 // Practice-specific broadcasts
 typedef void (*PracticeClosedCallback)(int practice_id, const char *room_name);
+typedef void (*PracticeReadyCallback)(int practice_id, const char *room_name);
+
+// Background admin jobs (room delete, async import): state is "done" or "failed"
+typedef void (*JobDoneCallback)(int job_id, const char *type, const char *state, const char *message);
 
 // Register callbacks
 void broadcast_on_room_started(RoomStartedCallback callback);
 void broadcast_on_room_created(RoomCreatedCallback callback);
 void broadcast_on_room_deleted(RoomDeletedCallback callback);
 void broadcast_on_room_ended(RoomEndedCallback callback);
+void broadcast_on_time_update(TimeUpdateCallback callback);
+
+// Remove push lines (ROOM_*, TIME_UPDATE, ...) mixed into a response buffer and
+// dispatch them later from the GTK main loop. Returns the remaining length.
+size_t broadcast_extract_pushes(char *buffer);
 void broadcast_on_practice_closed(PracticeClosedCallback callback);
+void broadcast_on_practice_ready(PracticeReadyCallback callback);
+void broadcast_on_job_done(JobDoneCallback callback);
 
 #endif // BROADCAST_H
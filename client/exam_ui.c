@@ -61,6 +61,16 @@ static void on_room_started_broadcast(int room_id, long start_time) {
     }
 }
 
+// Callback when TIME_UPDATE push received - đồng bộ đồng hồ đếm ngược theo server
+static void on_time_update_broadcast(int room_id, int remaining_seconds) {
+    if (exam_room_id != room_id || !exam_start_time || remaining_seconds <= 0) {
+        return;
+    }
+
+    // Giữ nguyên exam_duration, chỉ dời exam_start_time để remaining khớp với server
+    exam_start_time = time(NULL) - (exam_duration * 60 - remaining_seconds);
+}
+
 // Callback when ROOM_DELETED broadcast received
 static void on_room_deleted_broadcast(int room_id) {
     
@@ -649,6 +659,7 @@ static void start_exam_ui_from_response(int room_id, char *buffer) {
     
     // Register broadcast callback for ROOM_DELETED
     broadcast_on_room_deleted(on_room_deleted_broadcast);
+    broadcast_on_time_update(on_time_update_broadcast);
     
     // Start listening for broadcasts during exam
     if (!broadcast_is_listening()) {
@@ -1048,6 +1059,7 @@ void create_exam_page_from_resume(int room_id, char *resume_data) {
     
     // Register broadcast callbacks
     broadcast_on_room_deleted(on_room_deleted_broadcast);
+    broadcast_on_time_update(on_time_update_broadcast);
     
     // Start listening for broadcasts
     if (!broadcast_is_listening()) {
@@ -13,6 +13,7 @@ typedef struct {
     int user_id;
     char username[50];
     char role[20];  // "user" or "admin"
+    char session_token[64];  // token từ LOGIN_OK, dùng cho RESUME_SESSION khi mất kết nối
     int current_room;
     int current_question;
     int selected_answer;
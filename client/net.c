@@ -1,5 +1,6 @@
 #include "net.h"
 #include "ui_utils.h"
+#include "broadcast.h"
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <string.h>
@@ -7,6 +8,7 @@
 #include <sys/time.h>
 #include <stdio.h>
 #include <errno.h>
+#include <stdint.h>
 
 #include "include/client_common.h"
 
@@ -45,17 +47,55 @@ void flush_socket_buffer(int sockfd) {
     
 }
 
+// Topic đã SUBSCRIBE trên kết nối hiện tại (server gắn subscription với socket,
+// nên phải đăng ký lại sau khi RESUME_SESSION trên socket mới)
+static char subscribed_topics[NET_MAX_TOPICS][48];
+
+static void track_subscription(const char *msg) {
+    int subscribe = strncmp(msg, "SUBSCRIBE|", 10) == 0;
+    if (strncmp(msg, "LOGOUT", 6) == 0) {
+        memset(subscribed_topics, 0, sizeof(subscribed_topics));
+        return;
+    }
+    if (!subscribe && strncmp(msg, "UNSUBSCRIBE|", 12) != 0) return;
+
+    char topic[48];
+    snprintf(topic, sizeof(topic), "%s", strchr(msg, '|') + 1);
+    topic[strcspn(topic, "\r\n")] = '\0';
+
+    int free_slot = -1;
+    for (int i = 0; i < NET_MAX_TOPICS; i++) {
+        if (strcmp(subscribed_topics[i], topic) == 0) {
+            if (!subscribe) subscribed_topics[i][0] = '\0';
+            return;
+        }
+        if (free_slot < 0 && subscribed_topics[i][0] == '\0') free_slot = i;
+    }
+    if (subscribe && free_slot >= 0) {
+        snprintf(subscribed_topics[free_slot], sizeof(subscribed_topics[free_slot]), "%s", topic);
+    }
+}
+
+// Request gần nhất, gửi lại khi server trả BUSY|retry_ms
+static char last_request[BUFFER_SIZE];
+
 void send_message(const char *msg) {
-    // Check connection first
+    // Check connection first; mất kết nối thì thử gắn lại session cũ trước khi bỏ cuộc
     if (client.socket_fd <= 0 || !check_connection()) {
-        show_connection_lost_dialog();
-        return;
+        if (net_resume_session() != 0) {
+            show_connection_lost_dialog();
+            return;
+        }
     }
     
     // Log outgoing socket command with separator
     printf("\n===== CLIENT SEND =====\n%s\n", msg);
 
     ssize_t s = send(client.socket_fd, msg, strlen(msg), 0);
+    if (s > 0) {
+        track_subscription(msg);
+        snprintf(last_request, sizeof(last_request), "%s", msg);
+    }
     if (s < 0) {
         // Connection might be lost
         if (errno == EPIPE || errno == ECONNRESET) {
@@ -65,6 +105,139 @@ void send_message(const char *msg) {
     }
 }
 
+// CRC32 (IEEE, giống crc32_compute phía server) cho từng chunk upload
+static uint32_t upload_crc32(const unsigned char *data, size_t len) {
+    static uint32_t table[256];
+    static int table_ready = 0;
+    if (!table_ready) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320U ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+        table_ready = 1;
+    }
+    uint32_t crc = 0xFFFFFFFFU;
+    for (size_t i = 0; i < len; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFU;
+}
+
+static int send_all(const char *data, size_t len) {
+    size_t off = 0;
+    while (off < len) {
+        ssize_t s = send(client.socket_fd, data + off, len - off, MSG_NOSIGNAL);
+        if (s <= 0) {
+            if (s < 0 && errno == EINTR) continue;
+            return -1;
+        }
+        off += (size_t)s;
+    }
+    return 0;
+}
+
+// UPLOAD_BEGIN|purpose|target_id|filename|size -> UPLOAD_READY|id|offset|max_chunk
+int net_upload_begin(NetUpload *up, const char *purpose, int target_id,
+                     const char *path, const char *filename, long size,
+                     char *error, size_t error_size) {
+    memset(up, 0, sizeof(*up));
+    up->size = size;
+    up->fp = fopen(path, "rb");
+    if (!up->fp) {
+        snprintf(error, error_size, "Cannot read file");
+        return -1;
+    }
+
+    char msg[512];
+    snprintf(msg, sizeof(msg), "UPLOAD_BEGIN|%s|%d|%s|%ld\n", purpose, target_id, filename, size);
+    send_message(msg);
+
+    char buffer[256];
+    int max_chunk = 0;
+    if (receive_message(buffer, sizeof(buffer)) <= 0 ||
+        sscanf(buffer, "UPLOAD_READY|%d|%ld|%d", &up->upload_id, &up->offset, &max_chunk) != 3) {
+        char *reason = strrchr(buffer, '|');
+        snprintf(error, error_size, "%s", reason ? reason + 1 : "No response from server");
+        error[strcspn(error, "\r\n")] = '\0';
+        net_upload_close(up);
+        return -1;
+    }
+    up->chunk_size = max_chunk < UPLOAD_CHUNK_SIZE ? max_chunk : UPLOAD_CHUNK_SIZE;
+    return 0;
+}
+
+// Gửi chunk kế tiếp và chờ ACK; NACK (CRC sai, lệch offset) -> gửi lại từ offset server báo,
+// BUSY|retry_ms (bị giới hạn tốc độ) -> chờ rồi gửi lại đúng chunk đó.
+// Trả 1 khi đã gửi đủ file, 0 nếu còn chunk, -1 nếu lỗi.
+int net_upload_step(NetUpload *up, char *error, size_t error_size) {
+    if (up->offset >= up->size) return 1;
+
+    static char data[UPLOAD_CHUNK_SIZE];
+    long want = up->size - up->offset;
+    if (want > up->chunk_size) want = up->chunk_size;
+    if (fseek(up->fp, up->offset, SEEK_SET) != 0 || fread(data, 1, (size_t)want, up->fp) != (size_t)want) {
+        snprintf(error, error_size, "Cannot read file");
+        return -1;
+    }
+
+    char header[128];
+    int hlen = snprintf(header, sizeof(header), "UPLOAD_CHUNK|%d|%ld|%ld|%u\n",
+                        up->upload_id, up->offset, want, upload_crc32((unsigned char *)data, (size_t)want));
+    if (send_all(header, (size_t)hlen) != 0 || send_all(data, (size_t)want) != 0) {
+        snprintf(error, error_size, "Connection lost during upload");
+        return -1;
+    }
+
+    char buffer[256];
+    int id = 0;
+    long offset = -1;
+    int retry_ms = 0;
+    // Chunk không đi qua send_message: không để receive_message gửi lại request cũ khi BUSY
+    last_request[0] = '\0';
+    if (receive_message(buffer, sizeof(buffer)) <= 0) {
+        snprintf(error, error_size, "Connection lost during upload");
+        return -1;
+    }
+    if (sscanf(buffer, "UPLOAD_ACK|%d|%ld", &id, &offset) == 2) {
+        up->offset = offset;
+        up->retries = 0;
+    } else if (sscanf(buffer, "UPLOAD_NACK|%d|%ld", &id, &offset) == 2 && offset >= 0 &&
+               ++up->retries <= UPLOAD_MAX_RETRIES) {
+        up->offset = offset;
+    } else if (sscanf(buffer, "BUSY|%d", &retry_ms) == 1 && ++up->retries <= UPLOAD_MAX_RETRIES) {
+        if (retry_ms <= 0 || retry_ms > NET_BUSY_MAX_WAIT_MS) retry_ms = NET_BUSY_MAX_WAIT_MS;
+        usleep((useconds_t)retry_ms * 1000);
+    } else {
+        char *reason = strrchr(buffer, '|');
+        snprintf(error, error_size, "%s", reason ? reason + 1 : "Upload rejected");
+        error[strcspn(error, "\r\n")] = '\0';
+        return -1;
+    }
+    return up->offset >= up->size ? 1 : 0;
+}
+
+void net_upload_close(NetUpload *up) {
+    if (up->fp) fclose(up->fp);
+    up->fp = NULL;
+}
+
+// Upload cả file (chặn); trả upload_id để gửi UPLOAD_COMMIT, -1 nếu lỗi
+int net_upload_file(const char *purpose, int target_id, const char *path,
+                    const char *filename, long size, char *error, size_t error_size) {
+    NetUpload up;
+    if (net_upload_begin(&up, purpose, target_id, path, filename, size, error, error_size) != 0) {
+        return -1;
+    }
+    int rc;
+    while ((rc = net_upload_step(&up, error, error_size)) == 0) {
+    }
+    net_upload_close(&up);
+    return rc == 1 ? up.upload_id : -1;
+}
+
 ssize_t receive_message(char *buffer, size_t bufsz) {
     if (client.socket_fd <= 0) {
         show_connection_lost_dialog();
@@ -72,10 +245,31 @@ ssize_t receive_message(char *buffer, size_t bufsz) {
     }
     
     memset(buffer, 0, bufsz);
-    ssize_t n = recv(client.socket_fd, buffer, bufsz - 1, 0);
+    ssize_t n;
+    int busy_retries = 0;
+    while (1) {
+        n = recv(client.socket_fd, buffer, bufsz - 1, 0);
+        if (n <= 0) break;
+        buffer[n] = '\0';
+        // Server pushes (TIME_UPDATE, ROOM_*) có thể chen vào giữa request/response
+        n = (ssize_t)broadcast_extract_pushes(buffer);
+        if (n <= 0) continue;  // Chỉ toàn push -> đọc tiếp response thật
+
+        // Server tạm từ chối (hết token/quá tải): chờ retry_ms rồi gửi lại request
+        if (strncmp(buffer, "BUSY|", 5) != 0 || last_request[0] == '\0' ||
+            busy_retries >= NET_BUSY_RETRIES) break;
+        int retry_ms = atoi(buffer + 5);
+        if (retry_ms <= 0 || retry_ms > NET_BUSY_MAX_WAIT_MS) retry_ms = NET_BUSY_MAX_WAIT_MS;
+        busy_retries++;
+        printf("Server busy, retrying in %d ms\n", retry_ms);
+        usleep((useconds_t)retry_ms * 1000);
+        if (send_all(last_request, strlen(last_request)) != 0) {
+            n = -1;
+            break;
+        }
+    }
     
     if (n > 0) {
-        buffer[n] = '\0';
         // Log incoming socket message with separator
         printf("===== CLIENT RECV =====\n%s\n", buffer);
     } else if (n == 0) {
@@ -85,7 +279,10 @@ ssize_t receive_message(char *buffer, size_t bufsz) {
             close(client.socket_fd);
             client.socket_fd = -1;
         }
-        show_connection_lost_dialog();
+        // Response của request này đã mất (caller báo lỗi), nhưng session vẫn giữ được
+        if (net_resume_session() != 0) {
+            show_connection_lost_dialog();
+        }
     } else {
         // n < 0: lỗi
         // Check if connection was lost
@@ -124,6 +321,7 @@ ssize_t receive_complete_message(char *buffer, size_t bufsz, int max_attempts) {
         if (n > 0) {
             total_received += n;
             buffer[total_received] = '\0';
+            total_received = broadcast_extract_pushes(buffer);
             attempts = 0; // Reset on successful read
             
             // Check if we got a complete message (ends with newline)
@@ -164,6 +362,150 @@ ssize_t receive_complete_message(char *buffer, size_t bufsz, int max_attempts) {
     return total_received;
 }
 
+// Trang đã đủ: dòng cuối là "NEXT|<cursor>", hoặc response chỉ là một dòng lỗi/BUSY
+static int page_complete(const char *buf, size_t len) {
+    if (len == 0 || buf[len - 1] != '\n') return 0;
+    if (strncmp(buf, "BUSY|", 5) == 0 || strncmp(buf, "ERROR|", 6) == 0) return 1;
+    const char *first_nl = strchr(buf, '\n');
+    if ((size_t)(first_nl - buf) == len - 1) {
+        // Một dòng duy nhất: chỉ là trang khi đó chính là dòng NEXT, còn lại là lỗi *_FAIL
+        if (strncmp(buf, "NEXT|", 5) == 0) return 1;
+        const char *fail = strstr(buf, "_FAIL|");
+        return fail != NULL && fail < first_nl;
+    }
+    const char *last = buf + len - 1;
+    while (last > buf && last[-1] != '\n') last--;
+    return strncmp(last, "NEXT|", 5) == 0;
+}
+
+// Response một dòng đã đủ khi kết thúc bằng '\n'
+static int line_complete(const char *buf, size_t len) {
+    return len > 0 && buf[len - 1] == '\n';
+}
+
+// Đọc response vào buffer heap tự nới tới khi complete() (caller free);
+// BUSY|retry_ms -> chờ rồi gửi lại request
+static char *receive_alloc(int (*complete)(const char *, size_t), size_t *out_len) {
+    size_t cap = BUFFER_SIZE;
+    size_t len = 0;
+    int busy_retries = 0;
+    char *buf = malloc(cap);
+    if (!buf) return NULL;
+    buf[0] = '\0';
+
+    while (!complete(buf, len)) {
+        if (cap - len < BUFFER_SIZE) {
+            char *p = realloc(buf, cap * 2);
+            if (!p) break;
+            buf = p;
+            cap *= 2;
+        }
+        ssize_t n = recv(client.socket_fd, buf + len, cap - len - 1, 0);
+        if (n <= 0) break;
+        len += (size_t)n;
+        buf[len] = '\0';
+        len = broadcast_extract_pushes(buf);
+
+        if (complete(buf, len) && strncmp(buf, "BUSY|", 5) == 0 &&
+            busy_retries < NET_BUSY_RETRIES && last_request[0] != '\0') {
+            int retry_ms = atoi(buf + 5);
+            if (retry_ms <= 0 || retry_ms > NET_BUSY_MAX_WAIT_MS) retry_ms = NET_BUSY_MAX_WAIT_MS;
+            busy_retries++;
+            usleep((useconds_t)retry_ms * 1000);
+            if (send_all(last_request, strlen(last_request)) != 0) break;
+            len = 0;
+            buf[0] = '\0';
+        }
+    }
+
+    if (!complete(buf, len)) {
+        free(buf);
+        return NULL;
+    }
+    *out_len = len;
+    return buf;
+}
+
+// Response một dòng có thể rất dài (danh sách phòng, đề luyện tập): buffer heap vừa đủ, caller free
+char *net_receive_line(void) {
+    if (client.socket_fd <= 0) return NULL;
+    size_t len = 0;
+    char *buf = receive_alloc(line_complete, &len);
+    if (buf) printf("===== CLIENT RECV COMPLETE =====\n%s\n", buf);
+    return buf;
+}
+
+/*
+ * Lấy cả danh sách từ endpoint phân trang: gửi "<request>|<cursor>" và đi theo dòng
+ * NEXT|<cursor> cho tới NEXT|0. Các trang được ghép lại thành một response như trước:
+ * trang đầu giữ nguyên, các trang sau bỏ skip_fields trường header lặp lại rồi nối sau joiner.
+ * Trả buffer heap kết thúc bằng '\n' (caller free), response lỗi trả nguyên văn;
+ * NULL nếu mất kết nối giữa chừng (không trả danh sách thiếu như thể đã đủ).
+ */
+char *net_request_list(const char *request, int skip_fields, const char *joiner) {
+    char *result = NULL;
+    size_t result_len = 0;
+    int cursor = 0;
+
+    do {
+        char msg[BUFFER_SIZE];
+        snprintf(msg, sizeof(msg), "%s|%d\n", request, cursor);
+        send_message(msg);
+        if (client.socket_fd <= 0) break;
+
+        size_t len = 0;
+        char *page = receive_alloc(page_complete, &len);
+        if (!page) break;
+        printf("===== CLIENT RECV PAGE =====\n%s\n", page);
+
+        // Tách dòng NEXT cuối trang khỏi thân trang
+        char *next_line = page + len - 1;
+        while (next_line > page && next_line[-1] != '\n') next_line--;
+        if (strncmp(next_line, "NEXT|", 5) != 0) {
+            // Response lỗi: trả nguyên văn nếu là trang đầu
+            if (result == NULL) return page;
+            free(page);
+            break;
+        }
+        cursor = atoi(next_line + 5);
+        *next_line = '\0';
+        size_t body_len = (size_t)(next_line - page);
+        if (body_len > 0 && page[body_len - 1] == '\n') page[--body_len] = '\0';
+
+        const char *body = page;
+        if (result != NULL) {
+            for (int i = 0; i < skip_fields && body; i++) {
+                body = strchr(body, '|');
+                if (body) body++;
+            }
+            if (!body) body = "";
+        }
+
+        size_t add = strlen(body);
+        size_t join_len = (result != NULL && add > 0) ? strlen(joiner) : 0;
+        char *p = realloc(result, result_len + join_len + add + 2);
+        if (!p) {
+            free(page);
+            break;
+        }
+        result = p;
+        if (join_len > 0) memcpy(result + result_len, joiner, join_len);
+        memcpy(result + result_len + join_len, body, add);
+        result_len += join_len + add;
+        result[result_len] = '\0';
+        free(page);
+
+        if (cursor == 0) {
+            result[result_len++] = '\n';
+            result[result_len] = '\0';
+            return result;
+        }
+    } while (1);
+
+    free(result);
+    return NULL;
+}
+
 ssize_t receive_message_timeout(char *buffer, size_t bufsz, int timeout_sec) {
     if (client.socket_fd <= 0) return -1;
     
@@ -217,6 +559,65 @@ int reconnect_to_server(void) {
     return 0;
 }
 
+/*
+ * Nối lại server và gắn kết nối mới vào session cũ:
+ *   RESUME_SESSION|token -> RESUME_SESSION_OK|user_id|new_token|role|room_id
+ * Server giữ nguyên user in-memory và đáp án của phòng đang thi nên client chỉ cần
+ * đăng ký lại các topic. Trả 0 nếu thành công, -1 nếu không có token hoặc bị từ chối.
+ */
+int net_resume_session(void) {
+    if (client.session_token[0] == '\0') return -1;
+
+    for (int attempt = 0; attempt < NET_RESUME_ATTEMPTS; attempt++) {
+        if (attempt > 0) sleep(1);
+        if (reconnect_to_server() < 0) {
+            if (client.socket_fd > 0) close(client.socket_fd);
+            client.socket_fd = -1;
+            continue;
+        }
+        net_set_timeout(client.socket_fd);
+
+        char msg[128];
+        int len = snprintf(msg, sizeof(msg), "RESUME_SESSION|%s\n", client.session_token);
+        char buffer[256];
+        ssize_t n = -1;
+        if (send_all(msg, (size_t)len) == 0) {
+            n = recv(client.socket_fd, buffer, sizeof(buffer) - 1, 0);
+        }
+        if (n <= 0) {
+            close(client.socket_fd);
+            client.socket_fd = -1;
+            continue;
+        }
+        buffer[n] = '\0';
+
+        int user_id = 0;
+        int room_id = -1;
+        char token[64];
+        char role[20];
+        if (sscanf(buffer, "RESUME_SESSION_OK|%d|%63[^|]|%19[^|]|%d", &user_id, token, role, &room_id) != 4) {
+            // Token hết hạn / không hợp lệ: phải đăng nhập lại
+            printf("Resume session rejected: %s\n", buffer);
+            client.session_token[0] = '\0';
+            close(client.socket_fd);
+            client.socket_fd = -1;
+            return -1;
+        }
+
+        snprintf(client.session_token, sizeof(client.session_token), "%s", token);
+        snprintf(client.role, sizeof(client.role), "%s", role);
+        printf("Session resumed (user %d, room %d)\n", user_id, room_id);
+
+        for (int i = 0; i < NET_MAX_TOPICS; i++) {
+            if (subscribed_topics[i][0] == '\0') continue;
+            len = snprintf(msg, sizeof(msg), "SUBSCRIBE|%s\n", subscribed_topics[i]);
+            send_all(msg, (size_t)len);
+        }
+        return 0;
+    }
+    return -1;
+}
+
 // Check if connection is still alive
 int check_connection(void) {
     if (client.socket_fd <= 0) {
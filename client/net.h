@@ -1,15 +1,48 @@
 #ifndef NET_H
 #define NET_H
 #include<sys/types.h>
+#include <stdio.h>
 #include "include/client_common.h"
 
 void flush_socket_buffer(int sockfd);
 void send_message(const char *msg);
+
+// Upload file theo chunk có CRC (UPLOAD_BEGIN/UPLOAD_CHUNK, server ACK từng chunk)
+#define UPLOAD_CHUNK_SIZE (256 * 1024)
+#define UPLOAD_MAX_RETRIES 5
+typedef struct {
+    int upload_id;
+    FILE *fp;
+    long size;
+    long offset;        // byte đã được server ACK
+    long chunk_size;
+    int retries;        // số NACK liên tiếp
+} NetUpload;
+
+int net_upload_begin(NetUpload *up, const char *purpose, int target_id,
+                     const char *path, const char *filename, long size,
+                     char *error, size_t error_size);
+int net_upload_step(NetUpload *up, char *error, size_t error_size);
+void net_upload_close(NetUpload *up);
+int net_upload_file(const char *purpose, int target_id, const char *path,
+                    const char *filename, long size, char *error, size_t error_size);
+
 ssize_t receive_message(char *buffer, size_t bufsz);
 ssize_t receive_complete_message(char *buffer, size_t bufsz, int max_attempts);
+char *net_receive_line(void);
+char *net_request_list(const char *request, int skip_fields, const char *joiner);
 void net_set_timeout(int sockfd);
 ssize_t receive_message_timeout(char *buffer, size_t bufsz, int timeout_sec);
 int reconnect_to_server(void);
+
+// Mất kết nối: nối lại và RESUME_SESSION|token (không cần đăng nhập lại)
+#define NET_RESUME_ATTEMPTS 3
+#define NET_MAX_TOPICS 8
+
+// Server trả BUSY|retry_ms (rate limit/quá tải): tự gửi lại request tối đa chừng này lần
+#define NET_BUSY_RETRIES 3
+#define NET_BUSY_MAX_WAIT_MS 2000
+int net_resume_session(void);
 int check_connection(void);
 
 #endif // NET_H
@@ -139,14 +139,8 @@ void show_practice_list_screen(void) {
     // Send request to server
     send_message("LIST_PRACTICE\n");
     
-    char *recv_buf = malloc(BUFFER_SIZE * 128);  // 1MB for large question lists
+    char *recv_buf = net_receive_line();
     if (!recv_buf) {
-        show_error_dialog("Memory allocation error");
-        return;
-    }
-    ssize_t n = receive_complete_message(recv_buf, BUFFER_SIZE * 128, 100);
-    
-    if (n <= 0) {
         show_error_dialog("Failed to load practice rooms");
         return;
     }
@@ -154,6 +148,7 @@ void show_practice_list_screen(void) {
     // Parse response: PRACTICE_ROOMS_LIST|room_data
     if (strncmp(recv_buf, "PRACTICE_ROOMS_LIST|", 20) != 0) {
         show_error_dialog("Invalid server response");
+        free(recv_buf);
         return;
     }
     
@@ -326,15 +321,8 @@ void on_join_practice(GtkWidget *widget, gpointer data) {
     snprintf(msg, sizeof(msg), "JOIN_PRACTICE|%d\n", practice_id);
     send_message(msg);
     
-    char *recv_buf = malloc(BUFFER_SIZE * 128);  // 1MB for large question lists
+    char *recv_buf = net_receive_line();
     if (!recv_buf) {
-        show_error_dialog("Memory allocation error");
-        return;
-    }
-    ssize_t n = receive_complete_message(recv_buf, BUFFER_SIZE * 128, 100);
-    
-    if (n <= 0) {
-        free(recv_buf);
         show_error_dialog("Failed to join practice room");
         return;
     }
@@ -1311,14 +1299,14 @@ void on_view_participants_clicked(GtkWidget *widget, gpointer data) {
     int practice_id = GPOINTER_TO_INT(data);
     
     char msg[128];
-    snprintf(msg, sizeof(msg), "PRACTICE_PARTICIPANTS|%d\n", practice_id);
-    send_message(msg);
+    snprintf(msg, sizeof(msg), "PRACTICE_PARTICIPANTS|%d", practice_id);
     
-    char recv_buf[BUFFER_SIZE];
-    ssize_t n = receive_message(recv_buf, sizeof(recv_buf));
+    // Theo từng trang, ghép thành một dòng PRACTICE_PARTICIPANTS|id|u,name,s,a,t;...
+    char *recv_buf = net_request_list(msg, 2, "");
     
-    if (n <= 0 || strncmp(recv_buf, "PRACTICE_PARTICIPANTS|", 22) != 0) {
+    if (!recv_buf || strncmp(recv_buf, "PRACTICE_PARTICIPANTS|", 22) != 0) {
         show_error_dialog("Failed to load participants");
+        free(recv_buf);
         return;
     }
     
@@ -1346,18 +1334,21 @@ void on_view_participants_clicked(GtkWidget *widget, gpointer data) {
             int user_id, score, answered, total;
             char username[50];
             
-            sscanf(token, "%d,%49[^,],%d,%d,%d", &user_id, username, &score, &answered, &total);
-            
-            char line[256];
-            snprintf(line, sizeof(line), "%s | %d/%d | %d/%d\n",
-                    username, score, total, answered, total);
-            strcat(msg_text, line);
+            if (sscanf(token, "%d,%49[^,],%d,%d,%d", &user_id, username, &score, &answered, &total) == 5) {
+                char line[256];
+                snprintf(line, sizeof(line), "%s | %d/%d | %d/%d\n",
+                        username, score, total, answered, total);
+                // Danh sách ghép từ nhiều trang có thể dài hơn hộp thoại
+                if (strlen(msg_text) + strlen(line) >= sizeof(msg_text)) break;
+                strcat(msg_text, line);
+            }
             
             token = strtok(NULL, ";");
         }
     } else {
         strcat(msg_text, "No active participants");
     }
+    free(recv_buf);
     
     gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(dialog), "%s", msg_text);
     gtk_dialog_run(GTK_DIALOG(dialog));
@@ -1408,21 +1399,16 @@ void on_view_practice_results(GtkWidget *widget, gpointer data) {
     snprintf(msg, sizeof(msg), "VIEW_PRACTICE_RESULTS|%d\n", practice_id);
     send_message(msg);
 
-    // Dynamic allocation for large question lists
-    char *recv_buf = malloc(BUFFER_SIZE * 128);
-    if (!recv_buf) {
-        show_error_dialog("Memory allocation error");
-        return;
-    }
-    ssize_t n = receive_complete_message(recv_buf, BUFFER_SIZE * 128, 100);
+    // Buffer heap vừa đủ cho danh sách câu hỏi dài
+    char *recv_buf = net_receive_line();
     
-    if (n > 0 && strncmp(recv_buf, "PRACTICE_RESULTS_FAIL|", 21) == 0) {
+    if (recv_buf && strncmp(recv_buf, "PRACTICE_RESULTS_FAIL|", 21) == 0) {
         show_error_dialog(recv_buf + 21);
         free(recv_buf);
         return;
     }
 
-    if (n <= 0 || strncmp(recv_buf, "PRACTICE_RESULTS|", 17) != 0) {
+    if (!recv_buf || strncmp(recv_buf, "PRACTICE_RESULTS|", 17) != 0) {
         show_error_dialog("Failed to load practice results");
         free(recv_buf);
         return;
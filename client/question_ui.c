@@ -202,24 +202,13 @@ void show_exam_question_manager(GtkWidget *widget, gpointer data) {
     // Flush old socket data to prevent stale responses
     flush_socket_buffer(client.socket_fd);
     
-    // Request questions from server
-    char msg[64];
-    snprintf(msg, sizeof(msg), "GET_ROOM_QUESTIONS|%d\n", room_id);
-    send_message(msg);
-    
-    // Use larger buffer for question lists
-    char *buffer = malloc(BUFFER_SIZE * 16);
-    if (!buffer) {
-        show_error_dialog("Memory allocation failed!");
-        return;
-    }
-    
-    // Use complete message receiver to handle TCP fragmentation
-    ssize_t n = receive_complete_message(buffer, BUFFER_SIZE * 16, 50);
+    // Request questions from server theo từng trang, ghép thành một dòng ROOM_QUESTIONS_LIST
+    char request[64];
+    snprintf(request, sizeof(request), "GET_ROOM_QUESTIONS|%d", room_id);
+    char *buffer = net_request_list(request, 6, "|");
 
-    if (n <= 0) {
+    if (!buffer) {
         show_error_dialog("Failed to receive question list");
-        free(buffer);
         return;
     }
 
@@ -697,8 +686,8 @@ void show_import_exam_csv_dialog(GtkWidget *widget, gpointer data) {
         long file_size = ftell(fp);
         fclose(fp);
         
-        if (file_size <= 0 || file_size > 5 * 1024 * 1024) {
-            show_error_dialog("File size invalid (max 5MB)");
+        if (file_size <= 0) {
+            show_error_dialog("File is empty");
             g_free(filepath);
             gtk_widget_destroy(dialog);
             return;
@@ -712,63 +701,22 @@ void show_import_exam_csv_dialog(GtkWidget *widget, gpointer data) {
         // Flush old socket data before sending CSV command
         flush_socket_buffer(client.socket_fd);
         
-        // Send IMPORT_CSV command with file_size
-        char header[512];
-        snprintf(header, sizeof(header), "IMPORT_CSV|%d|%s|%ld\n", 
-                 current_room_id, filename, file_size);
-        send_message(header);
-
-        // Wait for READY
-        char ack_buffer[64];
-        ssize_t ack_n = receive_message(ack_buffer, sizeof(ack_buffer));
-        if (ack_n <= 0 || strncmp(ack_buffer, "READY", 5) != 0) {
-            show_error_dialog("Server not ready");
-            g_free(filepath);
-            gtk_widget_destroy(dialog);
-            return;
-        }
-        
-        // Read and send file content
-        fp = fopen(filepath, "rb");
-        if (!fp) {
-            show_error_dialog("Cannot read file");
-            g_free(filepath);
-            gtk_widget_destroy(dialog);
-            return;
-        }
-        
-        char *file_buffer = malloc(file_size);
-        if (!file_buffer) {
-            show_error_dialog("Memory allocation failed");
-            fclose(fp);
-            g_free(filepath);
-            gtk_widget_destroy(dialog);
-            return;
-        }
-        
-        size_t read_bytes = fread(file_buffer, 1, file_size, fp);
-        fclose(fp);
-        
-        if (read_bytes != (size_t)file_size) {
-            show_error_dialog("Failed to read file completely");
-            free(file_buffer);
-            g_free(filepath);
-            gtk_widget_destroy(dialog);
-            return;
-        }
-        
-        // Send file content
-        ssize_t sent = send(client.socket_fd, file_buffer, file_size, 0);
-        free(file_buffer);
-        
-        if (sent != file_size) {
-            show_error_dialog("Failed to upload file");
+        // Upload theo chunk có CRC (UPLOAD_BEGIN/UPLOAD_CHUNK) rồi UPLOAD_COMMIT để import
+        char error[128];
+        int upload_id = net_upload_file("exam_csv", current_room_id, filepath, filename,
+                                        file_size, error, sizeof(error));
+        if (upload_id < 0) {
+            char error_msg[192];
+            snprintf(error_msg, sizeof(error_msg), "Failed to upload file: %s", error);
+            show_error_dialog(error_msg);
             g_free(filepath);
             gtk_widget_destroy(dialog);
             return;
         }
 
         char buffer[512];
+        snprintf(buffer, sizeof(buffer), "UPLOAD_COMMIT|%d\n", upload_id);
+        send_message(buffer);
         ssize_t resp_n = receive_message(buffer, sizeof(buffer));
 
         if (resp_n > 0 && (strncmp(buffer, "IMPORT_CSV_OK", 13) == 0 || strncmp(buffer, "IMPORT_OK", 9) == 0)) {
@@ -1010,18 +958,14 @@ void show_practice_question_manager(GtkWidget *widget, gpointer data) {
     
     gtk_box_pack_start(GTK_BOX(vbox), button_box, FALSE, FALSE, 5);
 
-    // Request questions from server
-    char msg[64];
-    snprintf(msg, sizeof(msg), "GET_PRACTICE_QUESTIONS|%d\n", practice_id);
-    send_message(msg);
-    
-    // Use dynamic allocation for large question lists
-    char *buffer = malloc(BUFFER_SIZE * 64);  // 512KB for 100+ questions
+    // Request questions from server theo từng trang, ghép thành một dòng PRACTICE_QUESTIONS_LIST
+    char request[64];
+    snprintf(request, sizeof(request), "GET_PRACTICE_QUESTIONS|%d", practice_id);
+    char *buffer = net_request_list(request, 2, "|");
     if (!buffer) {
-        show_error_dialog("Memory allocation failed");
+        show_error_dialog("Failed to receive question list");
         return;
     }
-    receive_message(buffer, BUFFER_SIZE * 64);
 
     // Scrolled window for questions list
     GtkWidget *scroll = gtk_scrolled_window_new(NULL, NULL);
@@ -1255,13 +1199,35 @@ void show_import_practice_csv_dialog(GtkWidget *widget, gpointer data) {
     if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
         char *filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
         
-        // Send IMPORT_PRACTICE_CSV command
-        char msg[512];
-        snprintf(msg, sizeof(msg), "IMPORT_PRACTICE_CSV|%d|%s\n", current_practice_id, filename);
-        send_message(msg);
+        FILE *fp = fopen(filename, "rb");
+        long file_size = 0;
+        if (fp) {
+            fseek(fp, 0, SEEK_END);
+            file_size = ftell(fp);
+            fclose(fp);
+        }
+        if (file_size <= 0) {
+            show_error_dialog("Cannot read CSV file");
+            g_free(filename);
+            gtk_widget_destroy(dialog);
+            return;
+        }
+
+        const char *basename = strrchr(filename, '/');
+        basename = basename ? basename + 1 : filename;
 
+        // Upload theo chunk có CRC rồi UPLOAD_COMMIT -> IMPORT_PRACTICE_CSV_OK|n|skipped
         char buffer[256];
-        receive_message(buffer, sizeof(buffer));
+        char error[128];
+        int upload_id = net_upload_file("practice_csv", current_practice_id, filename, basename,
+                                        file_size, error, sizeof(error));
+        if (upload_id > 0) {
+            snprintf(buffer, sizeof(buffer), "UPLOAD_COMMIT|%d\n", upload_id);
+            send_message(buffer);
+            if (receive_message(buffer, sizeof(buffer)) <= 0) buffer[0] = '\0';
+        } else {
+            snprintf(buffer, sizeof(buffer), "IMPORT_PRACTICE_CSV_FAIL|%s", error);
+        }
 
         if (strncmp(buffer, "IMPORT_PRACTICE_CSV_OK", 22) == 0) {
             char *token = strtok(buffer, "|");
@@ -10,6 +10,10 @@
 #include <gdk/gdk.h>
 #include <fcntl.h>
 
+// Version danh mục phòng đã render vào rooms_list (0 = chưa có)
+static unsigned long rooms_catalog_version = 0;
+static GtkWidget *rooms_catalog_widget = NULL;
+
 // Idle callback for safe refresh
 static gboolean idle_refresh_rooms(gpointer user_data) {
     if (rooms_list != NULL && GTK_IS_LIST_BOX(rooms_list)) {
@@ -32,6 +36,14 @@ static void on_room_started_broadcast_list(int room_id, long start_time) {
     g_idle_add(idle_refresh_rooms, NULL);
 }
 
+// Rời màn hình danh sách phòng: thôi nhận ROOM_CREATED/ROOM_* của topic rooms.list
+static void on_test_mode_back_clicked(GtkWidget *button, gpointer data) {
+    if (client.socket_fd > 0) {
+        send_message("UNSUBSCRIBE|rooms.list\n");
+    }
+    create_main_menu();
+}
+
 void on_room_button_clicked(GtkWidget *button, gpointer data)
 {
     const char *room_id_str = g_object_get_data(G_OBJECT(button), "room_id");
@@ -70,6 +82,28 @@ void load_rooms_list()
                             "<span foreground='#e74c3c'>No room selected</span>");
     }
     
+    // Chỉ gửi version nếu danh sách hiện tại đúng là bản đã render cho version đó
+    unsigned long known_version = 0;
+    if (rooms_catalog_widget == rooms_list && rooms_list && GTK_IS_LIST_BOX(rooms_list)) {
+        known_version = rooms_catalog_version;
+    }
+
+    // Flush old responses before new request
+    flush_socket_buffer(client.socket_fd);
+    
+    // Gửi yêu cầu lấy danh sách phòng (kèm version để server trả NOT_MODIFIED nếu không đổi)
+    char request[64];
+    snprintf(request, sizeof(request), "LIST_ROOMS|%lu\n", known_version);
+    send_message(request);
+    char buffer[BUFFER_SIZE];
+    ssize_t n = receive_message(buffer, sizeof(buffer));
+
+    if (n > 0 && strncmp(buffer, "NOT_MODIFIED", 12) == 0)
+    {
+        // Danh sách đang hiển thị vẫn còn đúng
+        return;
+    }
+
     // Xóa hết các row cũ
     if (rooms_list && GTK_IS_LIST_BOX(rooms_list)) {
         GList *children, *iter;
@@ -78,17 +112,18 @@ void load_rooms_list()
             gtk_widget_destroy(GTK_WIDGET(iter->data));
         g_list_free(children);
     }
-
-    // Flush old responses before new request
-    flush_socket_buffer(client.socket_fd);
-    
-    // Gửi yêu cầu lấy danh sách phòng
-    send_message("LIST_ROOMS\n");
-    char buffer[BUFFER_SIZE];
-    ssize_t n = receive_message(buffer, sizeof(buffer));
+    rooms_catalog_version = 0;
+    rooms_catalog_widget = NULL;
 
     if (n > 0 && buffer[0] != '\0')
     {
+        // Header: LIST_ROOMS_OK|count|version
+        unsigned long version = 0;
+        if (sscanf(buffer, "LIST_ROOMS_OK|%*d|%lu", &version) == 1) {
+            rooms_catalog_version = version;
+            rooms_catalog_widget = rooms_list;
+        }
+
         char *line = strtok(buffer, "\n");
         int room_count = 0;
         
@@ -459,6 +494,11 @@ void create_test_mode_screen()
                                    GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
     gtk_box_pack_start(GTK_BOX(vbox), scroll, TRUE, TRUE, 0);
 
+    // Đăng ký topic rooms.list để nhận thay đổi danh sách phòng (ack được lọc như push)
+    if (client.socket_fd > 0) {
+        send_message("SUBSCRIBE|rooms.list\n");
+    }
+
     // Load danh sách phòng
     load_rooms_list();
 
@@ -468,7 +508,7 @@ void create_test_mode_screen()
     }
     g_signal_connect(join_btn, "clicked", G_CALLBACK(on_join_room_clicked), NULL);
     g_signal_connect(refresh_btn, "clicked", G_CALLBACK(load_rooms_list), NULL);
-    g_signal_connect(back_btn, "clicked", G_CALLBACK(create_main_menu), NULL);
+    g_signal_connect(back_btn, "clicked", G_CALLBACK(on_test_mode_back_clicked), NULL);
 
     // CRITICAL: Show UI FIRST before starting broadcast listener
     show_view(vbox);
@@ -388,16 +388,12 @@ void create_stats_screen()
     // Flush old responses before new request
     flush_socket_buffer(client.socket_fd);
     
-    // Request test history từ server
-    send_message("TEST_HISTORY\n");
-    char history_buffer[BUFFER_SIZE * 4];
-    ssize_t hn = receive_message(history_buffer, sizeof(history_buffer));
+    // Request test history từ server theo từng trang (TEST_HISTORY|cursor), ghép thành một dòng
+    char *history_buffer = net_request_list("TEST_HISTORY", 1, "");
 
-    if (hn > 0 && strncmp(history_buffer, "TEST_HISTORY", 12) == 0) {
+    if (history_buffer && strncmp(history_buffer, "TEST_HISTORY", 12) == 0) {
         // Parse response: TEST_HISTORY|result_id|room_name|score|total|time|date|result_id2|...
-        // Make a copy for safe parsing
-        char *buffer_copy = strdup(history_buffer);
-        char *data = buffer_copy;
+        char *data = history_buffer;
         
         // Skip "TEST_HISTORY|"
         char *token = strchr(data, '|');
@@ -407,7 +403,7 @@ void create_stats_screen()
         }
         
         int count = 0;
-        while (*data && count < 20) {
+        while (*data) {
             // Parse one record: result_id|room_name|score|total|time|date|
             char *record_end = data;
             int field_count = 0;
@@ -514,8 +510,6 @@ void create_stats_screen()
             data = record_end;
         }
         
-        free(buffer_copy);
-        
         if (count == 0) {
             GtkWidget *empty_label = gtk_label_new("No test history yet. Take your first test!");
             gtk_box_pack_start(GTK_BOX(history_box), empty_label, FALSE, FALSE, 20);
@@ -533,6 +527,7 @@ void create_stats_screen()
         GtkWidget *error_label = gtk_label_new("Failed to load test history");
         gtk_box_pack_start(GTK_BOX(history_box), error_label, FALSE, FALSE, 20);
     }
+    free(history_buffer);
 
     gtk_box_pack_start(GTK_BOX(vbox), scroll, TRUE, TRUE, 10);
 
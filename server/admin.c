@@ -1,5 +1,11 @@
 #include "admin.h"
 #include "db.h"
+#include "selection.h"
+#include "catalog.h"
+#include "leaderboard.h"
+#include "metrics.h"
+#include "credentials.h"
+#include "singleflight.h"
 #include <sys/socket.h>
 #include <time.h>
 
@@ -7,51 +13,44 @@ extern ServerData server_data;
 extern sqlite3 *db;
 
 /*
- * Tổng hợp số liệu tổng quan cho màn hình dashboard admin:
- *  - Tổng số user, số room, số câu hỏi, tổng lượt thi
- *  - Số user đang được load trong server_data.
+ * Kiểm tra user có role admin không (tra theo khoá chính).
  */
-void get_admin_dashboard(int socket_fd, int admin_id)
+int is_admin_user(int user_id)
 {
-  char query[500];
   sqlite3_stmt *stmt;
-
-  // Get total users, rooms, questions, and total tests
-  strcpy(query, "SELECT COUNT(*) FROM users;");
+  int is_admin = 0;
 
   pthread_mutex_lock(&server_data.lock);
-
-  if (sqlite3_prepare_v2(db, query, -1, &stmt, 0) == SQLITE_OK)
+  if (sqlite3_prepare_v2(db, "SELECT role FROM users WHERE id = ?;", -1, &stmt, 0) == SQLITE_OK)
   {
-    int total_users = 0;
+    sqlite3_bind_int(stmt, 1, user_id);
     if (sqlite3_step(stmt) == SQLITE_ROW)
     {
-      total_users = sqlite3_column_int(stmt, 0);
+      const char *role = (const char *)sqlite3_column_text(stmt, 0);
+      is_admin = role && strcmp(role, "admin") == 0;
     }
     sqlite3_finalize(stmt);
+  }
+  pthread_mutex_unlock(&server_data.lock);
 
-    // Get total tests completed
-    strcpy(query, "SELECT COUNT(*) FROM results;");
-    if (sqlite3_prepare_v2(db, query, -1, &stmt, 0) == SQLITE_OK)
-    {
-      int total_tests = 0;
-      if (sqlite3_step(stmt) == SQLITE_ROW)
-      {
-        total_tests = sqlite3_column_int(stmt, 0);
-      }
-      sqlite3_finalize(stmt);
+  return is_admin;
+}
 
-      // Build response
-      char response[500];
-      snprintf(response, sizeof(response),
-               "ADMIN_DASHBOARD|Users:%d|Rooms:%d|Questions:%d|TotalTests:%d|OnlineUsers:%d\n",
-               total_users, server_data.room_count, server_data.question_count,
-               total_tests, server_data.user_count);
-      send(socket_fd, response, strlen(response), 0);
-    }
+/*
+ * Tổng hợp số liệu tổng quan cho màn hình dashboard admin:
+ *  - Tổng số user, số phòng đang mở, số câu hỏi, tổng lượt thi, số user online
+ *  - Đọc từ registry bộ đếm (xem metrics.c), không truy vấn DB.
+ */
+void get_admin_dashboard(int socket_fd, int admin_id)
+{
+  if (!is_admin_user(admin_id))
+  {
+    char response[] = "ADMIN_DASHBOARD_FAIL|Permission denied\n";
+    send(socket_fd, response, strlen(response), 0);
+    return;
   }
 
-  pthread_mutex_unlock(&server_data.lock);
+  metrics_send_dashboard(socket_fd);
 }
 
 /*
@@ -60,6 +59,7 @@ void get_admin_dashboard(int socket_fd, int admin_id)
  */
 void manage_users(int socket_fd, int admin_id)
 {
+  (void)admin_id;
   pthread_mutex_lock(&server_data.lock);
 
   char response[4096];
@@ -87,6 +87,7 @@ void manage_users(int socket_fd, int admin_id)
  */
 void manage_questions(int socket_fd, int admin_id)
 {
+  (void)admin_id;
   pthread_mutex_lock(&server_data.lock);
 
   char response[8192];
@@ -115,6 +116,7 @@ void manage_questions(int socket_fd, int admin_id)
  */
 void get_system_stats(int socket_fd, int admin_id)
 {
+  (void)admin_id;
   char query[800];
   sqlite3_stmt *stmt;
 
@@ -171,11 +173,16 @@ void ban_user(int socket_fd, int admin_id, int target_user_id)
   char *err_msg = 0;
   if (sqlite3_exec(db, query, 0, 0, &err_msg) == SQLITE_OK)
   {
+    if (sqlite3_changes(db) > 0)
+      metrics_add(METRIC_REGISTERED_USERS, -1);
+
     // Remove from in-memory
     for (int i = 0; i < server_data.user_count; i++)
     {
       if (server_data.users[i].user_id == target_user_id)
       {
+        if (server_data.users[i].is_online == 1)
+          metrics_add(METRIC_ONLINE_USERS, -1);
         // Shift array
         for (int j = i; j < server_data.user_count - 1; j++)
         {
@@ -186,6 +193,11 @@ void ban_user(int socket_fd, int admin_id, int target_user_id)
       }
     }
 
+    // Phòng của user bị xoá không còn host -> danh mục phòng đổi
+    room_catalog_invalidate();
+    leaderboard_remove_user(target_user_id);
+    credentials_remove(target_user_id);
+
     char response[] = "BAN_USER_OK\n";
     send(socket_fd, response, strlen(response), 0);
     log_activity(admin_id, "BAN_USER", "Banned user");
@@ -215,6 +227,9 @@ void delete_question(int socket_fd, int admin_id, int question_id)
   char *err_msg = 0;
   if (sqlite3_exec(db, query, 0, 0, &err_msg) == SQLITE_OK)
   {
+    if (sqlite3_changes(db) > 0)
+      metrics_add(METRIC_QUESTIONS, -1);
+
     // Remove from in-memory
     for (int i = 0; i < server_data.question_count; i++)
     {
@@ -229,6 +244,11 @@ void delete_question(int socket_fd, int admin_id, int question_id)
       }
     }
 
+    // Không biết room của câu hỏi -> huỷ toàn bộ cache ngân hàng câu hỏi
+    question_bank_invalidate(-1);
+    singleflight_room_changed(0);
+    room_catalog_invalidate();
+
     char response[] = "DELETE_QUESTION_OK\n";
     send(socket_fd, response, strlen(response), 0);
     log_activity(admin_id, "DELETE_QUESTION", "Deleted question");
@@ -3,6 +3,7 @@
 
 #include "include/common.h"
 
+int is_admin_user(int user_id);
 void get_admin_dashboard(int socket_fd, int admin_id);   // Tổng quan dashboard admin
 void manage_users(int socket_fd, int admin_id);          // Danh sách user và trạng thái online
 void manage_questions(int socket_fd, int admin_id);      // Danh sách câu hỏi đang cache
@@ -0,0 +1,189 @@
+#include "admission.h"
+#include "metrics.h"
+#include <limits.h>
+
+/*
+ * Admission control cho các lệnh client trước khi vào chuỗi dispatch:
+ *  - Token bucket theo kết nối và theo user: client spam LEADERBOARD/LIST_ROOMS
+ *    chỉ tiêu hết token của chính nó, nhận BUSY|retry_ms (thời gian tới token kế tiếp)
+ *  - Governor toàn cục: thời gian xử lý lệnh (gồm chờ server_data.lock) là độ trễ hàng
+ *    đợi của server. Nếu độ trễ NHỎ NHẤT trong một chu kỳ ADMIT_INTERVAL_MS vẫn vượt
+ *    ADMIT_TARGET_MS (hàng đợi đứng, không phải một lệnh chậm lẻ), hoặc số lệnh đang
+ *    xử lý vượt ADMIT_MAX_INFLIGHT, thì lệnh ưu tiên thấp bị từ chối bằng BUSY|retry_ms
+ *  - SAVE_ANSWER, SUBMIT_TEST và các lệnh giải phóng tài nguyên luôn được nhận
+ *  - Số lệnh bị từ chối được đếm trong registry metrics (Shed/RateLimited).
+ * admission_lock là lock lá.
+ */
+
+typedef struct {
+  const char *cmd;
+  AdmitClass admit_class;
+  int measured;
+} AdmitRule;
+
+// Lệnh không có trong bảng: ADMIT_NORMAL, có đo độ trễ
+static const AdmitRule rules[] = {
+  {"SAVE_ANSWER", ADMIT_CRITICAL, 1},
+  {"SUBMIT_TEST", ADMIT_CRITICAL, 1},
+  {"SUBMIT_PRACTICE_ANSWER", ADMIT_CRITICAL, 1},
+  {"FINISH_PRACTICE", ADMIT_CRITICAL, 1},
+  {"LOGOUT", ADMIT_CRITICAL, 1},
+  {"RESUME_SESSION", ADMIT_CRITICAL, 1},
+  {"RESUME_EXAM", ADMIT_CRITICAL, 1},
+  // Gửi kiểu fire-and-forget từ client: BUSY sẽ lẫn vào response của lệnh khác
+  {"SUBSCRIBE", ADMIT_CRITICAL, 1},
+  {"UNSUBSCRIBE", ADMIT_CRITICAL, 1},
+  {"LIVE_UNSUBSCRIBE", ADMIT_CRITICAL, 1},
+  {"ADMIN_METRICS_UNSUBSCRIBE", ADMIT_CRITICAL, 1},
+  {"LIST_ROOMS", ADMIT_LOW, 1},
+  {"LIST_MY_ROOMS", ADMIT_LOW, 1},
+  {"LIST_PRACTICE", ADMIT_LOW, 1},
+  {"GET_ROOM_MEMBERS", ADMIT_LOW, 1},
+  {"GET_EXAM_STUDENTS", ADMIT_LOW, 1},
+  {"PRACTICE_PARTICIPANTS", ADMIT_LOW, 1},
+  {"VIEW_PRACTICE_RESULTS", ADMIT_LOW, 1},
+  {"LEADERBOARD", ADMIT_LOW, 1},
+  {"MY_RANK", ADMIT_LOW, 1},
+  {"USER_STATS", ADMIT_LOW, 1},
+  {"TEST_HISTORY", ADMIT_LOW, 1},
+  {"CATEGORY_STATS", ADMIT_LOW, 1},
+  {"DIFFICULTY_STATS", ADMIT_LOW, 1},
+  {"ITEM_STATS", ADMIT_LOW, 1},
+  {"ADMIN_DASHBOARD", ADMIT_LOW, 1},
+  {"JOB_STATUS", ADMIT_LOW, 1},
+  {"EXPORT_QUESTIONS", ADMIT_LOW, 0},
+  {"EXPORT_RESULTS", ADMIT_LOW, 0},
+  // Nhận dữ liệu từ client trong lúc xử lý -> thời gian không phản ánh tải server
+  {"IMPORT_PRACTICE_CSV", ADMIT_NORMAL, 0},
+  {"UPLOAD_CHUNK", ADMIT_NORMAL, 0},
+  {"UPLOAD_COMMIT", ADMIT_NORMAL, 0},
+};
+
+typedef struct {
+  int user_id;          // 0 = slot trống
+  TokenBucket bucket;
+} UserBucket;
+
+static UserBucket user_buckets[ADMIT_USER_SLOTS];
+static pthread_mutex_t admission_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int inflight = 0;
+static long interval_start_ms = 0;
+static long interval_min_ms = LONG_MAX;
+static int overloaded = 0;
+
+static long now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+static const AdmitRule *find_rule(const char *cmd) {
+  for (size_t i = 0; i < sizeof(rules) / sizeof(rules[0]); i++) {
+    if (strcmp(rules[i].cmd, cmd) == 0) return &rules[i];
+  }
+  return NULL;
+}
+
+static void bucket_refill(TokenBucket *b, int rate, int burst, long now) {
+  if (now > b->last_ms) {
+    b->tokens += (double)(now - b->last_ms) * rate / 1000.0;
+    if (b->tokens > burst) b->tokens = burst;
+    b->last_ms = now;
+  }
+}
+
+// Thời gian (ms) tới khi bucket có đủ một token
+static int bucket_wait_ms(const TokenBucket *b, int rate) {
+  int wait = (int)((1.0 - b->tokens) * 1000.0 / rate) + 1;
+  return wait < 1 ? 1 : wait;
+}
+
+// Gọi khi đang giữ admission_lock
+static TokenBucket *user_bucket(int user_id, long now) {
+  unsigned int start = (unsigned int)user_id % ADMIT_USER_SLOTS;
+  UserBucket *victim = NULL;
+  for (int i = 0; i < ADMIT_USER_PROBE; i++) {
+    UserBucket *slot = &user_buckets[(start + i) % ADMIT_USER_SLOTS];
+    if (slot->user_id == user_id) return &slot->bucket;
+    // Ưu tiên slot trống, sau đó slot lâu không dùng nhất
+    if (!victim || (victim->user_id != 0 &&
+                    (slot->user_id == 0 || slot->bucket.last_ms < victim->bucket.last_ms)))
+      victim = slot;
+  }
+  victim->user_id = user_id;
+  victim->bucket.tokens = ADMIT_USER_BURST;
+  victim->bucket.last_ms = now;
+  return &victim->bucket;
+}
+
+// Cập nhật trạng thái quá tải khi hết chu kỳ. Gọi khi đang giữ admission_lock.
+static void governor_roll(long now) {
+  if (now - interval_start_ms < ADMIT_INTERVAL_MS) return;
+  // Cả chu kỳ không có mẫu nào (LONG_MAX) nghĩa là không có lệnh chờ -> hết quá tải
+  overloaded = interval_min_ms != LONG_MAX && interval_min_ms > ADMIT_TARGET_MS;
+  interval_start_ms = now;
+  interval_min_ms = LONG_MAX;
+}
+
+void admission_conn_init(TokenBucket *conn) {
+  conn->tokens = ADMIT_CONN_BURST;
+  conn->last_ms = now_ms();
+}
+
+/*
+ * Quyết định nhận lệnh cmd. Trả 0 và điền ticket nếu được nhận (caller phải gọi
+ * admission_release sau khi xử lý xong), ngược lại trả retry_ms > 0 cho BUSY|retry_ms.
+ */
+int admission_acquire(TokenBucket *conn, int user_id, const char *cmd, AdmitTicket *ticket) {
+  const AdmitRule *rule = find_rule(cmd);
+  AdmitClass admit_class = rule ? rule->admit_class : ADMIT_NORMAL;
+  long now = now_ms();
+  int retry_ms = 0;
+
+  pthread_mutex_lock(&admission_lock);
+  governor_roll(now);
+
+  if (admit_class == ADMIT_LOW && (overloaded || inflight >= ADMIT_MAX_INFLIGHT)) {
+    retry_ms = ADMIT_SHED_RETRY_MS + (int)(now % ADMIT_SHED_RETRY_MS);
+    metrics_add(METRIC_SHED, 1);
+  } else if (admit_class != ADMIT_CRITICAL) {
+    bucket_refill(conn, ADMIT_CONN_RATE, ADMIT_CONN_BURST, now);
+    TokenBucket *user = user_id > 0 ? user_bucket(user_id, now) : NULL;
+    if (user) bucket_refill(user, ADMIT_USER_RATE, ADMIT_USER_BURST, now);
+
+    if (conn->tokens < 1.0) {
+      retry_ms = bucket_wait_ms(conn, ADMIT_CONN_RATE);
+    } else if (user && user->tokens < 1.0) {
+      retry_ms = bucket_wait_ms(user, ADMIT_USER_RATE);
+    } else {
+      conn->tokens -= 1.0;
+      if (user) user->tokens -= 1.0;
+    }
+    if (retry_ms > 0) metrics_add(METRIC_RATE_LIMITED, 1);
+  }
+
+  if (retry_ms == 0) {
+    inflight++;
+    ticket->started_ms = now;
+    ticket->measured = rule ? rule->measured : 1;
+  }
+  pthread_mutex_unlock(&admission_lock);
+  return retry_ms;
+}
+
+/*
+ * Kết thúc lệnh đã nhận: ghi mẫu độ trễ cho governor.
+ */
+void admission_release(const AdmitTicket *ticket) {
+  long now = now_ms();
+
+  pthread_mutex_lock(&admission_lock);
+  inflight--;
+  if (ticket->measured) {
+    governor_roll(now);
+    long elapsed = now - ticket->started_ms;
+    if (elapsed < interval_min_ms) interval_min_ms = elapsed;
+  }
+  pthread_mutex_unlock(&admission_lock);
+}
@@ -0,0 +1,44 @@
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include "common.h"
+
+// Token bucket theo kết nối: số lệnh/giây và số lệnh dồn tối đa
+#define ADMIT_CONN_RATE 20
+#define ADMIT_CONN_BURST 40
+// Token bucket theo user (giữ nguyên qua các lần kết nối lại)
+#define ADMIT_USER_RATE 30
+#define ADMIT_USER_BURST 60
+// Số slot bucket theo user (dò tuyến tính ADMIT_USER_PROBE slot, đầy thì thay slot cũ nhất)
+#define ADMIT_USER_SLOTS 512
+#define ADMIT_USER_PROBE 8
+// Governor: độ trễ xử lý lệnh nhỏ nhất trong một chu kỳ vượt target -> quá tải
+#define ADMIT_TARGET_MS 50
+#define ADMIT_INTERVAL_MS 200
+// Số lệnh đang xử lý đồng thời tối đa trước khi bỏ lệnh ưu tiên thấp
+#define ADMIT_MAX_INFLIGHT 64
+// retry_ms gợi ý khi bị governor từ chối (cộng thêm jitter tới cùng giá trị)
+#define ADMIT_SHED_RETRY_MS 250
+
+typedef enum {
+  ADMIT_CRITICAL = 0,   // luôn nhận (SAVE_ANSWER, SUBMIT_TEST, LOGOUT...)
+  ADMIT_NORMAL,         // qua token bucket
+  ADMIT_LOW             // qua token bucket, bị bỏ khi quá tải (thống kê, danh sách)
+} AdmitClass;
+
+typedef struct {
+  double tokens;
+  long last_ms;
+} TokenBucket;
+
+// Trạng thái admission của một lệnh đã được nhận
+typedef struct {
+  long started_ms;
+  int measured;         // tính vào độ trễ của governor (lệnh streaming/import thì không)
+} AdmitTicket;
+
+void admission_conn_init(TokenBucket *conn);
+int admission_acquire(TokenBucket *conn, int user_id, const char *cmd, AdmitTicket *ticket);
+void admission_release(const AdmitTicket *ticket);
+
+#endif
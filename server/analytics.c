@@ -0,0 +1,465 @@
+#include "analytics.h"
+#include "db.h"
+#include "network.h"
+#include "selection.h"
+#include <math.h>
+#include <stdint.h>
+
+extern ServerData server_data;
+
+/*
+ * Thống kê theo category/độ khó và thống kê từng câu hỏi:
+ *  - Worker thread (connection riêng) đọc đáp án của mỗi bài vừa nộp, cộng dồn vào:
+ *      + bộ đếm đúng/số câu theo (user, category) và (user, độ khó)
+ *      + thống kê câu hỏi lưu dạng cột (mảng song song theo slot câu hỏi):
+ *        số lượt làm, số lượt đúng, tổng điểm bài thi (tỉ lệ) của người làm
+ *  - p-value = tỉ lệ trả lời đúng; độ phân biệt = tương quan point-biserial
+ *    giữa "đúng câu này" và tỉ lệ điểm cả bài, tính được từ các tổng cộng dồn
+ *  - Khi khởi động (hoặc xoá phòng) dựng lại toàn bộ từ results/exam_answers
+ *  - CATEGORY_STATS / DIFFICULTY_STATS / ITEM_STATS chỉ đọc bộ nhớ.
+ */
+
+static const char *difficulty_names[3] = {"Easy", "Medium", "Hard"};
+
+typedef struct {
+  int user_id;   // 0 = slot trống
+  uint32_t cat_correct[ANALYTICS_MAX_CATEGORIES];
+  uint32_t cat_attempts[ANALYTICS_MAX_CATEGORIES];
+  uint32_t diff_correct[3];
+  uint32_t diff_attempts[3];
+} UserAnalytics;
+
+// Toàn bộ bộ đếm; dựng lại toàn bộ thì dựng bản mới rồi tráo vào trong analytics_lock
+typedef struct {
+  // Bảng băm địa chỉ mở user_id -> bộ đếm
+  UserAnalytics *users_table;
+  int users_capacity;
+  int users_count;
+
+  char category_names[ANALYTICS_MAX_CATEGORIES][50];
+  int category_count;
+
+  // Thống kê câu hỏi dạng cột, chỉ số = slot câu hỏi
+  int item_count;
+  int item_capacity;
+  int *item_qid;
+  int *item_room;
+  uint32_t *item_attempts;
+  uint32_t *item_correct;
+  double *item_sum_y;     // tổng tỉ lệ điểm bài thi của người làm
+  double *item_sum_yy;
+  double *item_sum_xy;    // tổng tỉ lệ điểm của người làm đúng
+  // question_id -> slot + 1 (0 = chưa có)
+  int *slot_by_qid;
+  int slot_by_qid_size;
+} AnalyticsTables;
+
+static AnalyticsTables tables;
+// results.id lớn nhất đã nằm trong lần dựng lại gần nhất: bài nộp có id <= mốc này
+// đã được tính, job của nó (xếp hàng trước khi dựng lại xong) bị bỏ qua
+static sqlite3_int64 rebuilt_up_to = 0;
+static pthread_mutex_t analytics_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Hàng đợi việc cho worker: room_id > 0 là một bài nộp, room_id = 0 là dựng lại toàn bộ
+typedef struct {
+  int room_id;
+  int user_id;
+} AnalyticsJob;
+
+static AnalyticsJob job_queue[ANALYTICS_QUEUE_SIZE];
+static int job_head = 0;
+static int job_count = 0;
+static int rebuild_pending = 0;
+static pthread_mutex_t job_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t job_cond = PTHREAD_COND_INITIALIZER;
+
+// ===== BỘ NHỚ THỐNG KÊ (t là bảng đang dùng thì caller giữ analytics_lock) =====
+
+static int category_index(AnalyticsTables *t, const char *name) {
+  if (!name || !*name) name = "General";
+  for (int i = 0; i < t->category_count; i++) {
+    if (strcmp(t->category_names[i], name) == 0) return i;
+  }
+  if (t->category_count < ANALYTICS_MAX_CATEGORIES - 1) {
+    strncpy(t->category_names[t->category_count], name, sizeof(t->category_names[0]) - 1);
+    return t->category_count++;
+  }
+  // Hết chỗ: gộp vào category cuối
+  if (t->category_count == ANALYTICS_MAX_CATEGORIES - 1) {
+    strcpy(t->category_names[t->category_count], "Other");
+    t->category_count++;
+  }
+  return ANALYTICS_MAX_CATEGORIES - 1;
+}
+
+static UserAnalytics *find_user(AnalyticsTables *t, int user_id, int create) {
+  if (t->users_capacity > 0) {
+    unsigned int mask = (unsigned int)(t->users_capacity - 1);
+    unsigned int i = ((unsigned int)user_id * 2654435761u) & mask;
+    while (t->users_table[i].user_id != 0) {
+      if (t->users_table[i].user_id == user_id) return &t->users_table[i];
+      i = (i + 1) & mask;
+    }
+  }
+  if (!create) return NULL;
+
+  // Giữ hệ số tải <= 1/2
+  if ((t->users_count + 1) * 2 > t->users_capacity) {
+    int new_capacity = t->users_capacity ? t->users_capacity * 2 : 64;
+    UserAnalytics *table = calloc(new_capacity, sizeof(UserAnalytics));
+    if (!table) return NULL;
+    for (int k = 0; k < t->users_capacity; k++) {
+      if (t->users_table[k].user_id == 0) continue;
+      unsigned int j = ((unsigned int)t->users_table[k].user_id * 2654435761u) & (unsigned int)(new_capacity - 1);
+      while (table[j].user_id != 0) j = (j + 1) & (unsigned int)(new_capacity - 1);
+      table[j] = t->users_table[k];
+    }
+    free(t->users_table);
+    t->users_table = table;
+    t->users_capacity = new_capacity;
+  }
+
+  unsigned int mask = (unsigned int)(t->users_capacity - 1);
+  unsigned int i = ((unsigned int)user_id * 2654435761u) & mask;
+  while (t->users_table[i].user_id != 0) i = (i + 1) & mask;
+  t->users_table[i].user_id = user_id;
+  t->users_count++;
+  return &t->users_table[i];
+}
+
+static int grow_items(AnalyticsTables *t) {
+  int new_capacity = t->item_capacity ? t->item_capacity * 2 : 256;
+#define GROW(arr) do { \
+    void *p = realloc(arr, sizeof(*(arr)) * new_capacity); \
+    if (!p) return -1; \
+    arr = p; \
+  } while (0)
+  GROW(t->item_qid);
+  GROW(t->item_room);
+  GROW(t->item_attempts);
+  GROW(t->item_correct);
+  GROW(t->item_sum_y);
+  GROW(t->item_sum_yy);
+  GROW(t->item_sum_xy);
+#undef GROW
+  t->item_capacity = new_capacity;
+  return 0;
+}
+
+static int item_slot(AnalyticsTables *t, int question_id, int room_id) {
+  if (question_id <= 0) return -1;
+  if (question_id < t->slot_by_qid_size && t->slot_by_qid[question_id] > 0) {
+    return t->slot_by_qid[question_id] - 1;
+  }
+
+  if (question_id >= t->slot_by_qid_size) {
+    int new_size = t->slot_by_qid_size ? t->slot_by_qid_size : 1024;
+    while (new_size <= question_id) new_size *= 2;
+    int *p = realloc(t->slot_by_qid, sizeof(int) * new_size);
+    if (!p) return -1;
+    memset(p + t->slot_by_qid_size, 0, sizeof(int) * (new_size - t->slot_by_qid_size));
+    t->slot_by_qid = p;
+    t->slot_by_qid_size = new_size;
+  }
+  if (t->item_count == t->item_capacity && grow_items(t) != 0) return -1;
+
+  int slot = t->item_count++;
+  t->item_qid[slot] = question_id;
+  t->item_room[slot] = room_id;
+  t->item_attempts[slot] = 0;
+  t->item_correct[slot] = 0;
+  t->item_sum_y[slot] = 0;
+  t->item_sum_yy[slot] = 0;
+  t->item_sum_xy[slot] = 0;
+  t->slot_by_qid[question_id] = slot + 1;
+  return slot;
+}
+
+static void free_tables(AnalyticsTables *t) {
+  free(t->users_table);
+  free(t->item_qid);
+  free(t->item_room);
+  free(t->item_attempts);
+  free(t->item_correct);
+  free(t->item_sum_y);
+  free(t->item_sum_yy);
+  free(t->item_sum_xy);
+  free(t->slot_by_qid);
+  memset(t, 0, sizeof(*t));
+}
+
+// ===== WORKER =====
+
+// Mỗi dòng = một câu đã chọn của phòng, kèm đúng/sai (câu bỏ trống tính sai)
+#define ACCUMULATE_SELECT \
+  "SELECT r.user_id, q.room_id, q.id, q.category, q.difficulty, " \
+  "  CASE WHEN a.selected_answer = q.correct_answer THEN 1 ELSE 0 END, " \
+  "  CASE WHEN r.total_questions > 0 THEN CAST(r.score AS REAL) / r.total_questions ELSE 0 END " \
+  "FROM results r " \
+  "JOIN exam_questions q ON q.room_id = r.room_id AND q.is_selected = 1 " \
+  "LEFT JOIN exam_answers a ON a.user_id = r.user_id AND a.room_id = r.room_id AND a.question_id = q.id "
+
+// Cộng các dòng của stmt vào t
+static void accumulate_rows(AnalyticsTables *t, sqlite3_stmt *stmt) {
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    int row_user = sqlite3_column_int(stmt, 0);
+    int row_room = sqlite3_column_int(stmt, 1);
+    int question_id = sqlite3_column_int(stmt, 2);
+    int cat = category_index(t, (const char *)sqlite3_column_text(stmt, 3));
+    int level = normalize_difficulty((const char *)sqlite3_column_text(stmt, 4));
+    int correct = sqlite3_column_int(stmt, 5);
+    double ratio = sqlite3_column_double(stmt, 6);
+
+    UserAnalytics *ua = find_user(t, row_user, 1);
+    if (ua) {
+      ua->cat_attempts[cat]++;
+      ua->cat_correct[cat] += correct;
+      if (level >= 0) {
+        ua->diff_attempts[level]++;
+        ua->diff_correct[level] += correct;
+      }
+    }
+
+    int slot = item_slot(t, question_id, row_room);
+    if (slot >= 0) {
+      t->item_attempts[slot]++;
+      t->item_correct[slot] += correct;
+      t->item_sum_y[slot] += ratio;
+      t->item_sum_yy[slot] += ratio * ratio;
+      if (correct) t->item_sum_xy[slot] += ratio;
+    }
+  }
+}
+
+/*
+ * Cộng dồn bài nộp (user_id, room_id) vào bảng đang dùng. Dùng index của results
+ * theo room_id; bài đã có trong lần dựng lại gần nhất (id <= rebuilt_up_to) bị bỏ qua.
+ */
+static void accumulate_submission(sqlite3 *conn, int room_id, int user_id) {
+  const char *sql = ACCUMULATE_SELECT
+    "WHERE r.room_id = ? AND r.user_id = ? AND r.id > ?;";
+
+  sqlite3_stmt *stmt;
+  if (sqlite3_prepare_v2(conn, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    fprintf(stderr, "[ANALYTICS] Query failed: %s\n", sqlite3_errmsg(conn));
+    return;
+  }
+  sqlite3_bind_int(stmt, 1, room_id);
+  sqlite3_bind_int(stmt, 2, user_id);
+
+  pthread_mutex_lock(&analytics_lock);
+  sqlite3_bind_int64(stmt, 3, rebuilt_up_to);
+  accumulate_rows(&tables, stmt);
+  pthread_mutex_unlock(&analytics_lock);
+  sqlite3_finalize(stmt);
+}
+
+/*
+ * Dựng lại toàn bộ từ results vào bảng mới (không giữ analytics_lock khi quét),
+ * rồi tráo vào. Mốc results.id đọc trong cùng transaction với lần quét.
+ */
+static void rebuild_all(sqlite3 *conn) {
+  AnalyticsTables fresh;
+  memset(&fresh, 0, sizeof(fresh));
+  sqlite3_int64 up_to = 0;
+  sqlite3_stmt *stmt;
+
+  sqlite3_exec(conn, "BEGIN", NULL, NULL, NULL);
+  if (sqlite3_prepare_v2(conn, "SELECT COALESCE(MAX(id), 0) FROM results;", -1, &stmt, NULL) == SQLITE_OK) {
+    if (sqlite3_step(stmt) == SQLITE_ROW) up_to = sqlite3_column_int64(stmt, 0);
+    sqlite3_finalize(stmt);
+  }
+  int ok = sqlite3_prepare_v2(conn, ACCUMULATE_SELECT ";", -1, &stmt, NULL) == SQLITE_OK;
+  if (ok) {
+    accumulate_rows(&fresh, stmt);
+    sqlite3_finalize(stmt);
+  } else {
+    fprintf(stderr, "[ANALYTICS] Query failed: %s\n", sqlite3_errmsg(conn));
+  }
+  sqlite3_exec(conn, "COMMIT", NULL, NULL, NULL);
+
+  if (!ok) {
+    free_tables(&fresh);
+    return;
+  }
+
+  pthread_mutex_lock(&analytics_lock);
+  AnalyticsTables old = tables;
+  tables = fresh;
+  rebuilt_up_to = up_to;
+  pthread_mutex_unlock(&analytics_lock);
+  free_tables(&old);
+}
+
+static void *analytics_worker_thread(void *arg) {
+  (void)arg;
+  sqlite3 *conn = db_open_worker_connection();
+  if (!conn) {
+    fprintf(stderr, "[ANALYTICS] Worker disabled, category/difficulty stats unavailable\n");
+    return NULL;
+  }
+
+  while (1) {
+    pthread_mutex_lock(&job_lock);
+    while (job_count == 0 && !rebuild_pending) {
+      pthread_cond_wait(&job_cond, &job_lock);
+    }
+    AnalyticsJob job = {0, 0};
+    if (rebuild_pending) {
+      // Dựng lại toàn bộ đã bao gồm các bài nộp đang chờ
+      rebuild_pending = 0;
+      job_count = 0;
+    } else {
+      job = job_queue[job_head];
+      job_head = (job_head + 1) % ANALYTICS_QUEUE_SIZE;
+      job_count--;
+    }
+    pthread_mutex_unlock(&job_lock);
+
+    if (job.room_id == 0)
+      rebuild_all(conn);
+    else
+      accumulate_submission(conn, job.room_id, job.user_id);
+  }
+  return NULL;
+}
+
+/*
+ * Một bài vừa được lưu vào results (sau COMMIT): đưa vào hàng đợi của worker.
+ * Hàng đợi đầy thì dựng lại toàn bộ để không mất số liệu.
+ */
+void analytics_record_submission(int room_id, int user_id) {
+  pthread_mutex_lock(&job_lock);
+  if (job_count < ANALYTICS_QUEUE_SIZE) {
+    job_queue[(job_head + job_count) % ANALYTICS_QUEUE_SIZE] = (AnalyticsJob){room_id, user_id};
+    job_count++;
+  } else {
+    rebuild_pending = 1;
+  }
+  pthread_cond_signal(&job_cond);
+  pthread_mutex_unlock(&job_lock);
+}
+
+/*
+ * Kết quả bị xoá (xoá phòng): dựng lại toàn bộ thống kê từ DB.
+ */
+void analytics_rebuild(void) {
+  pthread_mutex_lock(&job_lock);
+  rebuild_pending = 1;
+  pthread_cond_signal(&job_cond);
+  pthread_mutex_unlock(&job_lock);
+}
+
+/*
+ * Khởi động worker và dựng thống kê từ lịch sử. Gọi sau init_database().
+ */
+void analytics_start(void) {
+  analytics_rebuild();
+  pthread_t tid;
+  if (pthread_create(&tid, NULL, analytics_worker_thread, NULL) != 0) {
+    perror("Failed to create analytics worker thread");
+    return;
+  }
+  pthread_detach(tid);
+}
+
+// ===== TRUY VẤN =====
+
+/*
+ * CATEGORY_STATS|<category>:<đúng>/<số câu>|... theo các câu user đã làm.
+ */
+void analytics_send_category_stats(int socket_fd, int user_id) {
+  char response[4096];
+  size_t len = snprintf(response, sizeof(response), "CATEGORY_STATS|");
+
+  pthread_mutex_lock(&analytics_lock);
+  UserAnalytics *ua = find_user(&tables, user_id, 0);
+  for (int i = 0; ua && i < tables.category_count && len < sizeof(response) - 1; i++) {
+    if (ua->cat_attempts[i] == 0) continue;
+    len += snprintf(response + len, sizeof(response) - len, "%s:%u/%u|",
+                    tables.category_names[i], ua->cat_correct[i], ua->cat_attempts[i]);
+  }
+  pthread_mutex_unlock(&analytics_lock);
+
+  if (len >= sizeof(response) - 1) len = sizeof(response) - 2;
+  response[len++] = '\n';
+  response[len] = '\0';
+  server_send(socket_fd, response);
+}
+
+/*
+ * DIFFICULTY_STATS|<độ khó>:<số câu>:<tỉ lệ đúng>%|... cho Easy/Medium/Hard.
+ */
+void analytics_send_difficulty_stats(int socket_fd, int user_id) {
+  char response[512];
+  size_t len = snprintf(response, sizeof(response), "DIFFICULTY_STATS|");
+
+  pthread_mutex_lock(&analytics_lock);
+  UserAnalytics *ua = find_user(&tables, user_id, 0);
+  for (int i = 0; i < 3; i++) {
+    uint32_t attempts = ua ? ua->diff_attempts[i] : 0;
+    uint32_t correct = ua ? ua->diff_correct[i] : 0;
+    len += snprintf(response + len, sizeof(response) - len, "%s:%u:%.1f%%|",
+                    difficulty_names[i], attempts,
+                    attempts > 0 ? 100.0 * correct / attempts : 0.0);
+  }
+  pthread_mutex_unlock(&analytics_lock);
+
+  snprintf(response + len, sizeof(response) - len, "\n");
+  server_send(socket_fd, response);
+}
+
+// Tương quan point-biserial giữa đúng/sai câu hỏi và tỉ lệ điểm cả bài
+static double discrimination(int slot) {
+  double n = tables.item_attempts[slot];
+  double sx = tables.item_correct[slot];
+  double sy = tables.item_sum_y[slot];
+  double var_x = n * sx - sx * sx;
+  double var_y = n * tables.item_sum_yy[slot] - sy * sy;
+  if (n < 2 || var_x <= 0 || var_y <= 1e-12) return 0.0;
+  return (n * tables.item_sum_xy[slot] - sx * sy) / sqrt(var_x * var_y);
+}
+
+/*
+ * ITEM_STATS|room_id|qid:lượt làm:p-value:độ phân biệt|... (chỉ chủ phòng).
+ */
+void analytics_send_item_stats(int socket_fd, int user_id, int room_id) {
+  pthread_mutex_lock(&server_data.lock);
+  int found = 0, is_host = 0;
+  for (int i = 0; i < server_data.room_count; i++) {
+    if (server_data.rooms[i].room_id == room_id) {
+      found = 1;
+      is_host = server_data.rooms[i].creator_id == user_id;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&server_data.lock);
+
+  if (!found) {
+    server_send(socket_fd, "ITEM_STATS_FAIL|Room not found\n");
+    return;
+  }
+  if (!is_host) {
+    server_send(socket_fd, "ITEM_STATS_FAIL|Permission denied\n");
+    return;
+  }
+
+  char response[8192];
+  size_t len = snprintf(response, sizeof(response), "ITEM_STATS|%d|", room_id);
+  int items = 0;
+
+  pthread_mutex_lock(&analytics_lock);
+  for (int i = 0; i < tables.item_count && items < ANALYTICS_MAX_ITEMS && len < sizeof(response) - 1; i++) {
+    if (tables.item_room[i] != room_id || tables.item_attempts[i] == 0) continue;
+    len += snprintf(response + len, sizeof(response) - len, "%d:%u:%.2f:%.2f|",
+                    tables.item_qid[i], tables.item_attempts[i],
+                    (double)tables.item_correct[i] / tables.item_attempts[i], discrimination(i));
+    items++;
+  }
+  pthread_mutex_unlock(&analytics_lock);
+
+  if (len >= sizeof(response) - 1) len = sizeof(response) - 2;
+  response[len++] = '\n';
+  response[len] = '\0';
+  server_send(socket_fd, response);
+}
@@ -0,0 +1,20 @@
+#ifndef ANALYTICS_H
+#define ANALYTICS_H
+
+#include "common.h"
+
+// Số category phân biệt được thống kê riêng; category mới hơn gộp vào category cuối
+#define ANALYTICS_MAX_CATEGORIES 64
+// Số bài nộp chờ worker xử lý tối đa
+#define ANALYTICS_QUEUE_SIZE 1024
+// Số câu hỏi tối đa trả về trong một ITEM_STATS
+#define ANALYTICS_MAX_ITEMS 200
+
+void analytics_start(void);
+void analytics_record_submission(int room_id, int user_id);
+void analytics_rebuild(void);
+void analytics_send_category_stats(int socket_fd, int user_id);
+void analytics_send_difficulty_stats(int socket_fd, int user_id);
+void analytics_send_item_stats(int socket_fd, int user_id, int room_id);
+
+#endif
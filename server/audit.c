@@ -0,0 +1,258 @@
+#include "audit.h"
+#include "db.h"
+#include "scheduler.h"
+#include <errno.h>
+
+extern sqlite3 *db;
+
+/*
+ * Pipeline ghi log audit (activity_log, practice_logs):
+ *  - Request thread chỉ đẩy sự kiện vào hàng đợi trong RAM (không chạm SQLite)
+ *  - Một writer thread gom sự kiện và ghi theo lô trong một transaction
+ *    với prepared statement trên connection riêng
+ *  - Định kỳ gộp log cũ thành thống kê theo ngày (activity_daily, practice_daily)
+ *    và xoá log chi tiết để DB không phình vô hạn.
+ */
+
+typedef enum {
+  AUDIT_ACTIVITY = 0,
+  AUDIT_PRACTICE
+} AuditKind;
+
+typedef struct {
+  int kind;
+  int user_id;
+  time_t timestamp;
+  char action[32];
+  char details[256];
+  int practice_id;
+  int question_id;
+  int answer;
+  int is_correct;
+} AuditEvent;
+
+static AuditEvent queue[AUDIT_QUEUE_SIZE];
+static int queue_head = 0;   // vị trí đọc
+static int queue_count = 0;
+static long dropped_events = 0;
+static int maintenance_requested = 0;
+static pthread_mutex_t audit_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t audit_cond = PTHREAD_COND_INITIALIZER;
+
+static void enqueue(const AuditEvent *ev) {
+  pthread_mutex_lock(&audit_lock);
+  if (queue_count == AUDIT_QUEUE_SIZE) {
+    dropped_events++;
+    pthread_cond_signal(&audit_cond);
+    pthread_mutex_unlock(&audit_lock);
+    return;
+  }
+  queue[(queue_head + queue_count) % AUDIT_QUEUE_SIZE] = *ev;
+  queue_count++;
+  if (queue_count >= AUDIT_BATCH_SIZE) {
+    pthread_cond_signal(&audit_cond);
+  }
+  pthread_mutex_unlock(&audit_lock);
+}
+
+/*
+ * Ghi nhận một hoạt động của user (LOGIN, SUBMIT_TEST, ...) vào hàng đợi.
+ */
+void audit_log_activity(int user_id, const char *action, const char *details) {
+  AuditEvent ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.kind = AUDIT_ACTIVITY;
+  ev.user_id = user_id;
+  ev.timestamp = time(NULL);
+  strncpy(ev.action, action ? action : "", sizeof(ev.action) - 1);
+  strncpy(ev.details, details ? details : "", sizeof(ev.details) - 1);
+  enqueue(&ev);
+}
+
+/*
+ * Ghi nhận một lần trả lời câu hỏi luyện tập vào hàng đợi.
+ */
+void audit_log_practice(int user_id, int practice_id, int question_id, int answer, int is_correct) {
+  AuditEvent ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.kind = AUDIT_PRACTICE;
+  ev.user_id = user_id;
+  ev.timestamp = time(NULL);
+  ev.practice_id = practice_id;
+  ev.question_id = question_id;
+  ev.answer = answer;
+  ev.is_correct = is_correct;
+  enqueue(&ev);
+}
+
+// Ghi một lô sự kiện trong một transaction
+static void write_batch(sqlite3 *conn, const AuditEvent *batch, int count) {
+  sqlite3_stmt *activity_stmt = NULL;
+  sqlite3_stmt *practice_stmt = NULL;
+
+  sqlite3_prepare_v2(conn,
+    "INSERT INTO activity_log (user_id, action, details, timestamp) "
+    "VALUES (?, ?, ?, datetime(?, 'unixepoch'));", -1, &activity_stmt, NULL);
+  sqlite3_prepare_v2(conn,
+    "INSERT INTO practice_logs (user_id, practice_id, question_id, answer, is_correct, attempt_time) "
+    "VALUES (?, ?, ?, ?, ?, ?);", -1, &practice_stmt, NULL);
+
+  sqlite3_exec(conn, "BEGIN", NULL, NULL, NULL);
+  for (int i = 0; i < count; i++) {
+    const AuditEvent *ev = &batch[i];
+    sqlite3_stmt *stmt = ev->kind == AUDIT_ACTIVITY ? activity_stmt : practice_stmt;
+    if (!stmt) continue;
+
+    if (ev->kind == AUDIT_ACTIVITY) {
+      sqlite3_bind_int(stmt, 1, ev->user_id);
+      sqlite3_bind_text(stmt, 2, ev->action, -1, SQLITE_STATIC);
+      sqlite3_bind_text(stmt, 3, ev->details, -1, SQLITE_STATIC);
+      sqlite3_bind_int64(stmt, 4, ev->timestamp);
+    } else {
+      sqlite3_bind_int(stmt, 1, ev->user_id);
+      sqlite3_bind_int(stmt, 2, ev->practice_id);
+      sqlite3_bind_int(stmt, 3, ev->question_id);
+      sqlite3_bind_int(stmt, 4, ev->answer);
+      sqlite3_bind_int(stmt, 5, ev->is_correct);
+      sqlite3_bind_int64(stmt, 6, ev->timestamp);
+    }
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+      fprintf(stderr, "[AUDIT] Insert failed: %s\n", sqlite3_errmsg(conn));
+    }
+    sqlite3_reset(stmt);
+  }
+  sqlite3_exec(conn, "COMMIT", NULL, NULL, NULL);
+
+  sqlite3_finalize(activity_stmt);
+  sqlite3_finalize(practice_stmt);
+}
+
+/*
+ * Gộp log cũ hơn AUDIT_RETENTION_DAYS vào bảng tổng hợp theo ngày và xoá log chi tiết.
+ */
+static void run_maintenance(sqlite3 *conn) {
+  char sql[1024];
+  char *err_msg = NULL;
+
+  snprintf(sql, sizeof(sql),
+    "BEGIN;"
+    "INSERT INTO activity_daily (day, user_id, action, event_count) "
+    "  SELECT date(timestamp), user_id, action, COUNT(*) FROM activity_log "
+    "  WHERE timestamp < datetime('now', '-%d days') GROUP BY 1, 2, 3 "
+    "  ON CONFLICT(day, user_id, action) DO UPDATE SET event_count = event_count + excluded.event_count;"
+    "DELETE FROM activity_log WHERE timestamp < datetime('now', '-%d days');"
+    "INSERT INTO practice_daily (day, user_id, practice_id, attempts, correct) "
+    "  SELECT date(attempt_time, 'unixepoch'), user_id, practice_id, COUNT(*), SUM(is_correct = 1) "
+    "  FROM practice_logs WHERE attempt_time < strftime('%%s', 'now', '-%d days') GROUP BY 1, 2, 3 "
+    "  ON CONFLICT(day, user_id, practice_id) DO UPDATE SET "
+    "  attempts = attempts + excluded.attempts, correct = correct + excluded.correct;"
+    "DELETE FROM practice_logs WHERE attempt_time < strftime('%%s', 'now', '-%d days');"
+    "COMMIT;",
+    AUDIT_RETENTION_DAYS, AUDIT_RETENTION_DAYS, AUDIT_RETENTION_DAYS, AUDIT_RETENTION_DAYS);
+
+  if (sqlite3_exec(conn, sql, NULL, NULL, &err_msg) != SQLITE_OK) {
+    fprintf(stderr, "[AUDIT] Maintenance failed: %s\n", err_msg ? err_msg : "");
+    sqlite3_free(err_msg);
+    sqlite3_exec(conn, "ROLLBACK", NULL, NULL, NULL);
+  } else {
+    printf("[AUDIT] Retention/rollup done (keep %d days)\n", AUDIT_RETENTION_DAYS);
+  }
+}
+
+// Writer thread: chờ đủ lô hoặc hết AUDIT_FLUSH_INTERVAL rồi ghi
+static void *audit_writer_thread(void *arg) {
+  (void)arg;
+  sqlite3 *conn = db_open_worker_connection();
+  if (!conn) conn = db;
+
+  AuditEvent *batch = malloc(sizeof(AuditEvent) * AUDIT_BATCH_SIZE);
+  if (!batch) return NULL;
+
+  while (1) {
+    pthread_mutex_lock(&audit_lock);
+    if (queue_count < AUDIT_BATCH_SIZE && !maintenance_requested) {
+      struct timespec deadline;
+      clock_gettime(CLOCK_REALTIME, &deadline);
+      deadline.tv_sec += AUDIT_FLUSH_INTERVAL;
+      pthread_cond_timedwait(&audit_cond, &audit_lock, &deadline);
+    }
+
+    int count = queue_count < AUDIT_BATCH_SIZE ? queue_count : AUDIT_BATCH_SIZE;
+    for (int i = 0; i < count; i++) {
+      batch[i] = queue[(queue_head + i) % AUDIT_QUEUE_SIZE];
+    }
+    queue_head = (queue_head + count) % AUDIT_QUEUE_SIZE;
+    queue_count -= count;
+
+    long dropped = dropped_events;
+    dropped_events = 0;
+    int do_maintenance = maintenance_requested;
+    maintenance_requested = 0;
+    pthread_mutex_unlock(&audit_lock);
+
+    if (dropped > 0) {
+      fprintf(stderr, "[AUDIT] Queue full, dropped %ld event(s)\n", dropped);
+    }
+    if (count > 0) {
+      write_batch(conn, batch, count);
+    }
+    if (do_maintenance) {
+      run_maintenance(conn);
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Handler của scheduler: yêu cầu writer thread chạy retention/rollup
+ * (không chạy trực tiếp để không làm trễ các deadline phòng thi), rồi hẹn lần kế tiếp.
+ */
+void on_audit_maintenance(int unused, int unused2) {
+  (void)unused;
+  (void)unused2;
+  pthread_mutex_lock(&audit_lock);
+  maintenance_requested = 1;
+  pthread_cond_signal(&audit_cond);
+  pthread_mutex_unlock(&audit_lock);
+
+  scheduler_add(SCHED_AUDIT_MAINTENANCE, 0, 0, time(NULL) + AUDIT_MAINTENANCE_INTERVAL);
+}
+
+/*
+ * Tạo bảng tổng hợp theo ngày, khởi động writer thread và hẹn lần bảo trì đầu tiên.
+ * Gọi sau init_database().
+ */
+void audit_start(void) {
+  const char *sql_rollups =
+    "CREATE TABLE IF NOT EXISTS activity_daily("
+    "day TEXT NOT NULL,"
+    "user_id INTEGER,"
+    "action TEXT NOT NULL,"
+    "event_count INTEGER DEFAULT 0,"
+    "PRIMARY KEY(day, user_id, action));"
+    "CREATE TABLE IF NOT EXISTS practice_daily("
+    "day TEXT NOT NULL,"
+    "user_id INTEGER,"
+    "practice_id INTEGER,"
+    "attempts INTEGER DEFAULT 0,"
+    "correct INTEGER DEFAULT 0,"
+    "PRIMARY KEY(day, user_id, practice_id));"
+    "CREATE INDEX IF NOT EXISTS idx_activity_log_timestamp ON activity_log(timestamp);"
+    "CREATE INDEX IF NOT EXISTS idx_practice_logs_time ON practice_logs(attempt_time);";
+
+  char *err_msg = NULL;
+  if (sqlite3_exec(db, sql_rollups, NULL, NULL, &err_msg) != SQLITE_OK) {
+    fprintf(stderr, "[AUDIT] Failed to create rollup tables: %s\n", err_msg ? err_msg : "");
+    sqlite3_free(err_msg);
+  }
+
+  pthread_t tid;
+  if (pthread_create(&tid, NULL, audit_writer_thread, NULL) != 0) {
+    perror("Failed to create audit writer thread");
+    return;
+  }
+  pthread_detach(tid);
+
+  // Lần bảo trì đầu tiên ngay sau khi khởi động ổn định
+  scheduler_add(SCHED_AUDIT_MAINTENANCE, 0, 0, time(NULL) + 60);
+}
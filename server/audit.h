@@ -0,0 +1,20 @@
+#ifndef AUDIT_H
+#define AUDIT_H
+
+#include "common.h"
+
+// Số sự kiện tối đa chờ ghi trong bộ nhớ
+#define AUDIT_QUEUE_SIZE 8192
+// Ghi xuống DB khi đủ số sự kiện này hoặc sau AUDIT_FLUSH_INTERVAL giây
+#define AUDIT_BATCH_SIZE 256
+#define AUDIT_FLUSH_INTERVAL 1
+// Log chi tiết cũ hơn số ngày này được gộp vào bảng tổng hợp theo ngày rồi xoá
+#define AUDIT_RETENTION_DAYS 30
+#define AUDIT_MAINTENANCE_INTERVAL (24 * 60 * 60)
+
+void audit_start(void);
+void audit_log_activity(int user_id, const char *action, const char *details);
+void audit_log_practice(int user_id, int practice_id, int question_id, int answer, int is_correct);
+void on_audit_maintenance(int unused, int unused2);
+
+#endif
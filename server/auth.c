@@ -1,28 +1,112 @@
 #include "auth.h"
 #include "db.h"
+#include "scheduler.h"
+#include "leaderboard.h"
+#include "metrics.h"
+#include "credentials.h"
+#include "roster.h"
 #include <sys/socket.h>
 #include <stdio.h>
 #include <time.h>
 #include <openssl/sha.h>
+#include <openssl/rand.h>
+#include <openssl/crypto.h>
 
 extern ServerData server_data;
 extern sqlite3 *db;
 
 /*
- * Sinh token phiên đăng nhập ngẫu nhiên cho user,
- * dùng để xác thực các request sau khi LOGIN thành công.
+ * Sinh token phiên đăng nhập ngẫu nhiên cho user (CSPRNG của OpenSSL),
+ * dùng cho RESUME_SESSION sau khi mất kết nối.
+ * Byte >= 248 bị bỏ để mỗi ký tự trong 62 ký tự có xác suất như nhau.
  */
 void generate_session_token(char *token, size_t len)
 {
   static const char charset[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
-  srand(time(NULL) + rand());
-  for (size_t i = 0; i < len - 1; i++)
+  unsigned char random[64];
+  size_t filled = 0;
+  while (filled < len - 1)
   {
-    token[i] = charset[rand() % (sizeof(charset) - 1)];
+    if (RAND_bytes(random, sizeof(random)) != 1)
+    {
+      // Không có entropy: trả token rỗng (không bao giờ khớp) thay vì token đoán được
+      fprintf(stderr, "[AUTH] RAND_bytes failed, session token not issued\n");
+      token[0] = '\0';
+      return;
+    }
+    for (size_t i = 0; i < sizeof(random) && filled < len - 1; i++)
+    {
+      if (random[i] < 248)
+        token[filled++] = charset[random[i] % (sizeof(charset) - 1)];
+    }
   }
   token[len - 1] = '\0';
 }
 
+/*
+ * Chỉ mục session token -> vị trí trong server_data.users (bảng băm móc xích theo slot),
+ * để RESUME_SESSION tìm user trong O(1). Mọi thao tác gọi khi giữ server_data.lock.
+ * Giá trị trong bucket/next là slot + 1 (0 = hết chuỗi).
+ */
+static int token_buckets[SESSION_TOKEN_BUCKETS];
+static int token_next[MAX_CLIENTS];
+
+static unsigned int token_hash(const char *token)
+{
+  unsigned int h = 5381;
+  while (*token)
+    h = h * 33 + (unsigned char)*token++;
+  return h % SESSION_TOKEN_BUCKETS;
+}
+
+static void token_index_remove(int slot)
+{
+  const char *token = server_data.users[slot].session_token;
+  if (token[0] == '\0')
+    return;
+  int *link = &token_buckets[token_hash(token)];
+  while (*link)
+  {
+    if (*link - 1 == slot)
+    {
+      *link = token_next[slot];
+      token_next[slot] = 0;
+      return;
+    }
+    link = &token_next[*link - 1];
+  }
+}
+
+// Gán token mới cho slot (NULL = xoá token) và cập nhật chỉ mục
+static void set_session_token(int slot, const char *token)
+{
+  User *user = &server_data.users[slot];
+  token_index_remove(slot);
+  memset(user->session_token, 0, sizeof(user->session_token));
+  if (token && token[0])
+  {
+    strncpy(user->session_token, token, sizeof(user->session_token) - 1);
+    unsigned int b = token_hash(user->session_token);
+    token_next[slot] = token_buckets[b];
+    token_buckets[b] = slot + 1;
+  }
+}
+
+// Tìm slot theo token (so sánh hằng thời gian), -1 nếu không có
+static int find_session_slot(const char *token)
+{
+  char key[sizeof(((User *)0)->session_token)] = {0};
+  if (!token || !token[0] || strlen(token) >= sizeof(key))
+    return -1;
+  strcpy(key, token);
+  for (int link = token_buckets[token_hash(key)]; link; link = token_next[link - 1])
+  {
+    if (CRYPTO_memcmp(server_data.users[link - 1].session_token, key, sizeof(key)) == 0)
+      return link - 1;
+  }
+  return -1;
+}
+
 /*
  * Băm mật khẩu bằng SHA-256 và lưu dưới dạng hex string 64 ký tự.
  * Mọi mật khẩu lưu trong DB đều phải đi qua hàm này.
@@ -39,182 +123,150 @@ void hash_password(const char *password, char *hashed_output) {
 
 /*
  * Xử lý đăng ký tài khoản mới:
- *  - Băm mật khẩu
- *  - Lưu user vào bảng users
- *  - Cập nhật cấu trúc in-memory server_data.users
+ *  - Băm mật khẩu và lưu user vào bảng users trên auth worker (credentials.c)
+ *  - Chỉ bước cuối cập nhật server_data.users dưới server_data.lock
  * Trả về REGISTER_OK/REGISTER_FAIL cho client.
  */
 void register_user(int socket_fd, char *username, char *password)
 {
   char response[200];
-  char hashed_password[65];
 
-  hash_password(password, hashed_password);
-  if (!username || !password)
+  if (!username || !password || !*username || !*password)
   {
     snprintf(response, sizeof(response), "REGISTER_FAIL|Missing username or password\n");
     server_send(socket_fd, response);
     return;
   }
 
-  char query[300];
-  char *err_msg = 0;
-
-  snprintf(query, sizeof(query),
-           "INSERT INTO users (username, password) VALUES ('%s', '%s');",
-           username, hashed_password);
+  int new_user_id = 0;
+  AuthResult rc = auth_register(username, password, &new_user_id);
+  if (rc != AUTH_OK)
+  {
+    snprintf(response, sizeof(response), "REGISTER_FAIL|%s\n",
+             rc == AUTH_EXISTS ? "Username already exists" : "Database error");
+    server_send(socket_fd, response);
+    return;
+  }
 
   pthread_mutex_lock(&server_data.lock);
 
-  if (sqlite3_exec(db, query, 0, 0, &err_msg) != SQLITE_OK)
-  {
-    snprintf(response, sizeof(response), "REGISTER_FAIL|Username already exists\n");
-    fprintf(stderr, "SQL error: %s\n", err_msg);
-    sqlite3_free(err_msg);
-  }
-  else
+  // Mảng in-memory đầy: user vẫn đăng nhập được, sẽ được thêm khi có chỗ (xem login_user)
+  if (server_data.user_count < MAX_CLIENTS)
   {
-    snprintf(response, sizeof(response), "REGISTER_OK|Account created successfully\n");
-
     int idx = server_data.user_count;
-    server_data.users[idx].user_id = (int)sqlite3_last_insert_rowid(db);
+    memset(&server_data.users[idx], 0, sizeof(server_data.users[idx]));
+    server_data.users[idx].user_id = new_user_id;
     strncpy(server_data.users[idx].username, username, sizeof(server_data.users[idx].username) - 1);
-    strncpy(server_data.users[idx].password, password, sizeof(server_data.users[idx].password) - 1);
     server_data.users[idx].is_online = 0;
     server_data.users[idx].socket_fd = -1;
+    server_data.users[idx].active_room_id = -1;
     server_data.user_count++;
   }
 
+  leaderboard_add_user(new_user_id, username);
+  metrics_add(METRIC_REGISTERED_USERS, 1);
+
   pthread_mutex_unlock(&server_data.lock);
+
+  snprintf(response, sizeof(response), "REGISTER_OK|Account created successfully\n");
   server_send(socket_fd, response);
 }
 
 /*
  * Xử lý đăng nhập:
- *  - Kiểm tra username/password (đã băm) trong DB
- *  - Sinh session token, set trạng thái is_online, socket_fd
+ *  - Kiểm tra username/password trên auth worker (chỉ mục in-memory, không SQL)
+ *  - Sinh session token, set trạng thái is_online, socket_fd dưới server_data.lock
  *  - Lưu role của user (user/admin) để phía client phân quyền
- *  - Đồng bộ cờ is_online vào DB và log hoạt động.
+ *  - Đồng bộ cờ is_online vào DB (ngoài lock) và log hoạt động.
  */
 void login_user(int socket_fd, char *username, char *password, int *user_id)
 {
-  char query[300];
-  sqlite3_stmt *stmt;
   char response[300];
-  char hashed_password[65];
   char user_role[20] = "user";
-  hash_password(password, hashed_password);
-
-  snprintf(query, sizeof(query),
-           "SELECT id, password, role FROM users WHERE username='%s';", username);
-
-  pthread_mutex_lock(&server_data.lock);
+  int verified_id = 0;
 
-  if (sqlite3_prepare_v2(db, query, -1, &stmt, 0) == SQLITE_OK)
+  if (!username || !password)
   {
-    if (sqlite3_step(stmt) == SQLITE_ROW)
-    {
-      const char *db_password = (const char *)sqlite3_column_text(stmt, 1);
-      
-      if (strcmp(db_password, hashed_password) != 0)
-      {
-        snprintf(response, sizeof(response), "LOGIN_FAIL|WRONG_PASSWORD\n");
-        sqlite3_finalize(stmt);
-        pthread_mutex_unlock(&server_data.lock);
-        server_send(socket_fd, response);
-        return;
-      }
-
-      *user_id = sqlite3_column_int(stmt, 0);
-      
-      // Get role (column 2)
-      const char *role = (const char *)sqlite3_column_text(stmt, 2);
-      if (role) {
-        strncpy(user_role, role, sizeof(user_role) - 1);
-      }
-
-      // Kiểm tra user đã online chưa (chống đăng nhập đồng thời)
-      int already_online = 0;
-      int duplicate_count = 0;
-      for (int i = 0; i < server_data.user_count; i++)
-      {
-        if (server_data.users[i].user_id == *user_id)
-        {
-          duplicate_count++;
-          
-          if (server_data.users[i].is_online == 1)
-          {
-            already_online = 1;
-          }
-        }
-      }
-
-      if (duplicate_count > 1) {
-      }
+    server_send(socket_fd, "LOGIN_FAIL|Missing username or password\n");
+    return;
+  }
 
-      if (already_online)
-      {
-        snprintf(response, sizeof(response), "LOGIN_FAIL|User is already logged in from another device\n");
-        sqlite3_finalize(stmt);
-        pthread_mutex_unlock(&server_data.lock);
-        server_send(socket_fd, response);
-        return;
-      }
+  AuthResult rc = auth_check_login(username, password, &verified_id, user_role, sizeof(user_role));
+  if (rc != AUTH_OK)
+  {
+    snprintf(response, sizeof(response), "LOGIN_FAIL|%s\n",
+             rc == AUTH_WRONG_PASSWORD ? "WRONG_PASSWORD" : "USER_NOT_FOUND");
+    server_send(socket_fd, response);
+    return;
+  }
 
-      // Generate session token
-      char token[64];
-      generate_session_token(token, sizeof(token));
+  // Generate session token (CSPRNG, ngoài lock)
+  char token[64];
+  generate_session_token(token, sizeof(token));
+  time_t now = time(NULL);
 
-      // Update user data with token and last activity
-      // QUAN TRỌNG: Update TẤT CẢ instances của user (nếu có duplicate)
-      int user_found = 0;
-      for (int i = 0; i < server_data.user_count; i++)
-      {
-        if (server_data.users[i].user_id == *user_id)
-        {
-          strncpy(server_data.users[i].session_token, token, sizeof(server_data.users[i].session_token) - 1);
-          server_data.users[i].last_activity = time(NULL);
-          server_data.users[i].is_online = 1;
-          server_data.users[i].socket_fd = socket_fd;
-          user_found = 1;
-          // KHÔNG BREAK - tiếp tục update tất cả instances
-        }
-      }
+  pthread_mutex_lock(&server_data.lock);
 
-      // Nếu user chưa có trong in-memory, thêm vào
-      if (!user_found && server_data.user_count < MAX_CLIENTS)
-      {
-        int idx = server_data.user_count;
-        server_data.users[idx].user_id = *user_id;
-        strncpy(server_data.users[idx].username, username, sizeof(server_data.users[idx].username) - 1);
-        strncpy(server_data.users[idx].session_token, token, sizeof(server_data.users[idx].session_token) - 1);
-        server_data.users[idx].last_activity = time(NULL);
-        server_data.users[idx].is_online = 1;
-        server_data.users[idx].socket_fd = socket_fd;
-        server_data.user_count++;
-      }
+  // Kiểm tra user đã online chưa (chống đăng nhập đồng thời)
+  int already_online = 0;
+  for (int i = 0; i < server_data.user_count; i++)
+  {
+    if (server_data.users[i].user_id == verified_id && server_data.users[i].is_online == 1)
+    {
+      already_online = 1;
+      break;
+    }
+  }
 
-      // Đồng bộ trạng thái online vào database
-      char update_query[200];
-      char *err_msg = 0;
-      snprintf(update_query, sizeof(update_query),
-               "UPDATE users SET is_online = 1 WHERE id = %d;", *user_id);
-      sqlite3_exec(db, update_query, 0, 0, &err_msg);
-      if (err_msg) {
-        sqlite3_free(err_msg);
-      }
+  if (already_online)
+  {
+    pthread_mutex_unlock(&server_data.lock);
+    server_send(socket_fd, "LOGIN_FAIL|User is already logged in from another device\n");
+    return;
+  }
 
-      snprintf(response, sizeof(response), "LOGIN_OK|%d|%s|%s\n", *user_id, token, user_role);
-      log_activity(*user_id, "LOGIN", "User logged in");
-    }
-    else
+  // Update user data with token and last activity
+  // QUAN TRỌNG: Update TẤT CẢ instances của user (nếu có duplicate)
+  int user_found = 0;
+  for (int i = 0; i < server_data.user_count; i++)
+  {
+    if (server_data.users[i].user_id == verified_id)
     {
-      snprintf(response, sizeof(response), "LOGIN_FAIL|USER_NOT_FOUND\n");
+      set_session_token(i, token);
+      server_data.users[i].token_expires = now + SESSION_TOKEN_TTL;
+      strncpy(server_data.users[i].role, user_role, sizeof(server_data.users[i].role) - 1);
+      server_data.users[i].active_room_id = -1;
+      server_data.users[i].is_online = 1;
+      server_data.users[i].socket_fd = socket_fd;
+      user_found = 1;
+      // KHÔNG BREAK - tiếp tục update tất cả instances
     }
   }
 
-  sqlite3_finalize(stmt);
+  // Nếu user chưa có trong in-memory, thêm vào
+  if (!user_found && server_data.user_count < MAX_CLIENTS)
+  {
+    int idx = server_data.user_count;
+    server_data.users[idx].user_id = verified_id;
+    strncpy(server_data.users[idx].username, username, sizeof(server_data.users[idx].username) - 1);
+    set_session_token(idx, token);
+    server_data.users[idx].token_expires = now + SESSION_TOKEN_TTL;
+    strncpy(server_data.users[idx].role, user_role, sizeof(server_data.users[idx].role) - 1);
+    server_data.users[idx].active_room_id = -1;
+    server_data.users[idx].is_online = 1;
+    server_data.users[idx].socket_fd = socket_fd;
+    server_data.user_count++;
+  }
+
   pthread_mutex_unlock(&server_data.lock);
+
+  *user_id = verified_id;
+  auth_set_online(verified_id, 1);
+  metrics_add(METRIC_ONLINE_USERS, 1);
+  log_activity(verified_id, "LOGIN", "User logged in");
+  scheduler_add(SCHED_SESSION_IDLE, 0, verified_id, now + SESSION_IDLE_TIMEOUT);
+
+  snprintf(response, sizeof(response), "LOGIN_OK|%d|%s|%s\n", verified_id, token, user_role);
   server_send(socket_fd, response);
 }
 
@@ -230,6 +282,7 @@ void logout_user(int user_id, int socket_fd)
 
   int logged_out_user_id = user_id;
   int user_found = 0;
+  int was_online = 0;
 
   // Cập nhật trạng thái user trong in-memory structure
   // QUAN TRỌNG: Không break để đảm bảo logout TẤT CẢ instances (tránh duplicate)
@@ -238,9 +291,15 @@ void logout_user(int user_id, int socket_fd)
     if (server_data.users[i].user_id == user_id || 
         (user_id == -1 && server_data.users[i].socket_fd == socket_fd))
     {
+      if (server_data.users[i].is_online == 1) was_online = 1;
+      // LOGOUT giữa giờ thi: host thấy thí sinh rời phòng
+      if (server_data.users[i].active_room_id > 0)
+        roster_update(server_data.users[i].active_room_id, server_data.users[i].user_id,
+                      PARTICIPANT_DISCONNECTED);
       server_data.users[i].is_online = 0;
       server_data.users[i].socket_fd = -1;
-      memset(server_data.users[i].session_token, 0, sizeof(server_data.users[i].session_token));
+      server_data.users[i].active_room_id = -1;
+      set_session_token(i, NULL);
       
       logged_out_user_id = server_data.users[i].user_id;
       user_found = 1;
@@ -249,37 +308,237 @@ void logout_user(int user_id, int socket_fd)
     }
   }
 
+  if (was_online) {
+    metrics_add(METRIC_ONLINE_USERS, -1);
+  }
+
+  pthread_mutex_unlock(&server_data.lock);
+
   // Log activity và đồng bộ DB (chỉ 1 lần sau khi logout tất cả instances)
   if (user_found && logged_out_user_id > 0) {
     log_activity(logged_out_user_id, "LOGOUT", "User logged out");
-    
-    // Đồng bộ trạng thái offline vào database
-    char update_query[200];
-    char *err_msg = 0;
-    snprintf(update_query, sizeof(update_query),
-             "UPDATE users SET is_online = 0 WHERE id = %d;", logged_out_user_id);
-    sqlite3_exec(db, update_query, 0, 0, &err_msg);
-    if (err_msg) {
-      sqlite3_free(err_msg);
+    auth_set_online(logged_out_user_id, 0);
+    scheduler_cancel(SCHED_SESSION_IDLE, 0, logged_out_user_id);
+  }
+}
+
+/*
+ * Mất kết nối (không LOGOUT): giữ session để RESUME_SESSION trên kết nối mới.
+ *  - Chỉ tác động khi user vẫn gắn với socket này (nếu đã RESUME sang socket khác
+ *    thì thread của socket cũ thoát mà không đụng tới session)
+ *  - Token chỉ còn hiệu lực thêm SESSION_RESUME_GRACE giây; hết hạn thì
+ *    on_session_idle đóng hẳn session như LOGOUT
+ *  - Đáp án/phòng đang thi giữ nguyên trong bộ nhớ.
+ */
+void detach_session(int user_id, int socket_fd)
+{
+  pthread_mutex_lock(&server_data.lock);
+
+  time_t now = time(NULL);
+  time_t expires = 0;
+  for (int i = 0; i < server_data.user_count; i++)
+  {
+    User *user = &server_data.users[i];
+    if (user->user_id != user_id || user->socket_fd != socket_fd || user->is_online != 1)
+      continue;
+    if (user->active_room_id > 0)
+      roster_update(user->active_room_id, user_id, PARTICIPANT_DISCONNECTED);
+    user->is_online = 0;
+    user->socket_fd = -1;
+    if (user->token_expires > now + SESSION_RESUME_GRACE)
+      user->token_expires = now + SESSION_RESUME_GRACE;
+    expires = user->token_expires;
+  }
+
+  pthread_mutex_unlock(&server_data.lock);
+
+  if (expires == 0)
+    return;
+  metrics_add(METRIC_ONLINE_USERS, -1);
+  log_activity(user_id, "DISCONNECT", "Connection lost, session kept for resume");
+  // Dùng chung sự kiện SESSION_IDLE: handler đóng session khi token hết hạn
+  scheduler_add(SCHED_SESSION_IDLE, 0, user_id, expires);
+}
+
+/*
+ * RESUME_SESSION|token -> RESUME_SESSION_OK|user_id|new_token|role|room_id
+ *                      hoặc RESUME_SESSION_FAIL|reason
+ *  - Gắn socket mới vào user in-memory sẵn có: không băm mật khẩu, không truy vấn DB,
+ *    đáp án của phòng đang thi (room_id, -1 nếu không) vẫn còn trong bộ nhớ
+ *  - Nếu socket cũ chưa bị phát hiện là chết (mất Wi-Fi), đóng nó và chiếm session
+ *  - Token được cấp mới mỗi lần resume (token cũ hết hiệu lực).
+ */
+void resume_session(int socket_fd, const char *token, int *user_id, int *room_id)
+{
+  char response[160];
+
+  if (*user_id > 0)
+  {
+    server_send(socket_fd, "RESUME_SESSION_FAIL|Already logged in\n");
+    return;
+  }
+
+  pthread_mutex_lock(&server_data.lock);
+
+  time_t now = time(NULL);
+  int slot = find_session_slot(token);
+  if (slot < 0 || server_data.users[slot].token_expires <= now)
+  {
+    pthread_mutex_unlock(&server_data.lock);
+    server_send(socket_fd, "RESUME_SESSION_FAIL|Invalid or expired session\n");
+    return;
+  }
+
+  User *found = &server_data.users[slot];
+  int resumed_user = found->user_id;
+  int was_online = found->is_online == 1;
+  int old_fd = was_online ? found->socket_fd : -1;
+
+  char new_token[64];
+  generate_session_token(new_token, sizeof(new_token));
+
+  for (int i = 0; i < server_data.user_count; i++)
+  {
+    User *user = &server_data.users[i];
+    if (user->user_id != resumed_user)
+      continue;
+    set_session_token(i, new_token);
+    user->token_expires = now + SESSION_TOKEN_TTL;
+    user->is_online = 1;
+    user->socket_fd = socket_fd;
+  }
+
+  *user_id = resumed_user;
+  *room_id = found->active_room_id;
+  if (found->active_room_id > 0)
+    roster_update(found->active_room_id, resumed_user, PARTICIPANT_STARTED);  // ACTIVE nếu đã có đáp án
+  snprintf(response, sizeof(response), "RESUME_SESSION_OK|%d|%s|%s|%d\n",
+           resumed_user, new_token, found->role[0] ? found->role : "user", found->active_room_id);
+
+  // Socket cũ còn treo: đóng để thread của nó thoát (không còn gắn với user)
+  if (old_fd > 0 && old_fd != socket_fd)
+  {
+    shutdown(old_fd, SHUT_RDWR);
+  }
+
+  pthread_mutex_unlock(&server_data.lock);
+
+  if (!was_online)
+    metrics_add(METRIC_ONLINE_USERS, 1);
+  log_activity(resumed_user, "RESUME_SESSION", "Session resumed on new connection");
+  scheduler_add(SCHED_SESSION_IDLE, 0, resumed_user, now + SESSION_IDLE_TIMEOUT);
+  server_send(socket_fd, response);
+}
+
+/*
+ * Ghi nhớ phòng user đang thi để RESUME_SESSION trả về (-1 = không thi).
+ */
+void session_set_room(int user_id, int room_id)
+{
+  pthread_mutex_lock(&server_data.lock);
+  for (int i = 0; i < server_data.user_count; i++)
+  {
+    if (server_data.users[i].user_id == user_id)
+      server_data.users[i].active_room_id = room_id;
+  }
+  pthread_mutex_unlock(&server_data.lock);
+}
+
+// Thời điểm nhận command cuối theo socket fd: luồng client ghi, on_session_idle đọc,
+// không qua server_data.lock
+static time_t connection_activity[SESSION_ACTIVITY_SLOTS];
+
+/*
+ * Ghi nhận hoạt động trên kết nối (gọi mỗi khi nhận command, kể cả trước LOGIN/RESUME
+ * nên fd được dùng lại không mang thời điểm của kết nối cũ).
+ */
+void session_touch(int socket_fd)
+{
+  if (socket_fd >= 0 && socket_fd < SESSION_ACTIVITY_SLOTS)
+    __atomic_store_n(&connection_activity[socket_fd], time(NULL), __ATOMIC_RELAXED);
+}
+
+static time_t session_last_activity(int socket_fd, time_t now)
+{
+  if (socket_fd < 0 || socket_fd >= SESSION_ACTIVITY_SLOTS)
+    return now;  // ngoài bảng: coi như vẫn hoạt động
+  return __atomic_load_n(&connection_activity[socket_fd], __ATOMIC_RELAXED);
+}
+
+/*
+ * Handler của scheduler cho session idle timeout:
+ *  - Nếu kết nối của user vẫn hoạt động gần đây thì lên lịch lại theo lần hoạt động cuối
+ *  - Nếu đã im lặng quá SESSION_IDLE_TIMEOUT thì shutdown socket,
+ *    luồng handle_client sẽ nhận recv() = 0 và dọn dẹp như disconnect bình thường.
+ *  - Session đã mất kết nối (detach_session) mà token hết hạn: đóng hẳn như LOGOUT.
+ */
+void on_session_idle(int unused, int user_id)
+{
+  (void)unused;
+  pthread_mutex_lock(&server_data.lock);
+
+  time_t now = time(NULL);
+  time_t next_deadline = 0;
+  int expired = 0;
+  for (int i = 0; i < server_data.user_count; i++)
+  {
+    User *user = &server_data.users[i];
+    if (user->user_id != user_id)
+      continue;
+    if (user->is_online != 1)
+    {
+      if (user->session_token[0] == '\0')
+        continue;
+      if (user->token_expires <= now)
+      {
+        set_session_token(i, NULL);
+        user->active_room_id = -1;
+        expired = 1;
+      }
+      else
+      {
+        next_deadline = user->token_expires;
+      }
+      continue;
+    }
+
+    time_t last_activity = session_last_activity(user->socket_fd, now);
+    if (now - last_activity >= SESSION_IDLE_TIMEOUT)
+    {
+      printf("[SCHED] Closing idle session user=%d fd=%d\n", user_id, user->socket_fd);
+      shutdown(user->socket_fd, SHUT_RDWR);
+    }
+    else
+    {
+      next_deadline = last_activity + SESSION_IDLE_TIMEOUT;
     }
+    break;
   }
 
-  if (!user_found) {
+  if (next_deadline > 0)
+  {
+    scheduler_add(SCHED_SESSION_IDLE, 0, user_id, next_deadline);
   }
 
   pthread_mutex_unlock(&server_data.lock);
+
+  if (expired)
+  {
+    // Không resume kịp: đồng bộ trạng thái offline như LOGOUT (ghi DB ngoài lock)
+    auth_set_online(user_id, 0);
+    log_activity(user_id, "LOGOUT", "Session expired after disconnect");
+  }
 }
 
 /*
  * Đổi mật khẩu:
  *  - Kiểm tra tham số, độ dài mật khẩu mới
- *  - Xác thực mật khẩu cũ trong DB
- *  - Cập nhật mật khẩu mới (đã băm) vào DB và log hoạt động.
+ *  - Xác thực mật khẩu cũ và ghi mật khẩu mới (đã băm) trên auth worker
+ *  - Log hoạt động.
  */
 void change_password(int socket_fd, int user_id, char *old_password, char *new_password)
 {
   char response[256];
-  char old_hashed[65], new_hashed[65];
   
   if (!old_password || !new_password || user_id <= 0) {
     snprintf(response, sizeof(response), "CHANGE_PASSWORD_FAIL|Invalid parameters\n");
@@ -294,43 +553,15 @@ void change_password(int socket_fd, int user_id, char *old_password, char *new_p
     return;
   }
   
-  hash_password(old_password, old_hashed);
-  hash_password(new_password, new_hashed);
-  
-  pthread_mutex_lock(&server_data.lock);
-  
-  // Verify old password
-  char query[512];
-  sqlite3_stmt *stmt;
-  snprintf(query, sizeof(query),
-           "SELECT id FROM users WHERE id=%d AND password='%s';", user_id, old_hashed);
-  
-  if (sqlite3_prepare_v2(db, query, -1, &stmt, 0) == SQLITE_OK) {
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-      // Old password correct, update to new password
-      sqlite3_finalize(stmt);
-      
-      char update_query[512];
-      char *err_msg = 0;
-      snprintf(update_query, sizeof(update_query),
-               "UPDATE users SET password='%s' WHERE id=%d;", new_hashed, user_id);
-      
-      if (sqlite3_exec(db, update_query, 0, 0, &err_msg) == SQLITE_OK) {
-        snprintf(response, sizeof(response), "CHANGE_PASSWORD_OK|Password changed successfully\n");
-        log_activity(user_id, "CHANGE_PASSWORD", "Password changed successfully");
-      } else {
-        snprintf(response, sizeof(response), "CHANGE_PASSWORD_FAIL|Database error\n");
-        sqlite3_free(err_msg);
-      }
-    } else {
-      // Old password incorrect
-      sqlite3_finalize(stmt);
-      snprintf(response, sizeof(response), "CHANGE_PASSWORD_FAIL|Old password incorrect\n");
-    }
+  AuthResult rc = auth_change_password(user_id, old_password, new_password);
+  if (rc == AUTH_OK) {
+    snprintf(response, sizeof(response), "CHANGE_PASSWORD_OK|Password changed successfully\n");
+    log_activity(user_id, "CHANGE_PASSWORD", "Password changed successfully");
+  } else if (rc == AUTH_WRONG_PASSWORD) {
+    snprintf(response, sizeof(response), "CHANGE_PASSWORD_FAIL|Old password incorrect\n");
   } else {
-    snprintf(response, sizeof(response), "CHANGE_PASSWORD_FAIL|Database query error\n");
+    snprintf(response, sizeof(response), "CHANGE_PASSWORD_FAIL|Database error\n");
   }
   
-  pthread_mutex_unlock(&server_data.lock);
   server_send(socket_fd, response);
 }
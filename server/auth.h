@@ -3,11 +3,25 @@
 
 #include "common.h"
 
+// Thời gian sống của session token (giây), cấp lại mỗi lần LOGIN/RESUME_SESSION
+#define SESSION_TOKEN_TTL (8 * 60 * 60)
+// Sau khi mất kết nối, token còn dùng được cho RESUME_SESSION trong khoảng này (giây)
+#define SESSION_RESUME_GRACE (10 * 60)
+// Số bucket của chỉ mục session token -> user
+#define SESSION_TOKEN_BUCKETS 256
+// Kích thước bảng thời điểm hoạt động theo socket fd (fd lớn hơn không bị đóng vì idle)
+#define SESSION_ACTIVITY_SLOTS 65536
+
 void register_user(int socket_fd, char *username, char *password);
 void login_user(int socket_fd, char *username, char *password, int *user_id);
 void logout_user(int user_id, int socket_fd);
+void detach_session(int user_id, int socket_fd);
+void resume_session(int socket_fd, const char *token, int *user_id, int *room_id);
+void session_set_room(int user_id, int room_id);
 void generate_session_token(char *token, size_t len);
 void change_password(int socket_fd, int user_id, char *old_password, char *new_password);
 void hash_password(const char *password, char *hashed_output);
+void session_touch(int socket_fd);
+void on_session_idle(int unused, int user_id);
 
 #endif
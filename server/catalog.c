@@ -0,0 +1,178 @@
+#include "catalog.h"
+#include "network.h"
+
+extern ServerData server_data;
+extern sqlite3 *db;
+
+/*
+ * Danh mục phòng thi (LIST_ROOMS) được materialize trong bộ nhớ:
+ *  - Các entry (id, tên, thời lượng, host, số câu hỏi) được dựng lại bằng MỘT truy vấn
+ *    khi danh mục bị đánh dấu thay đổi (tạo/xoá/đóng/start/kết thúc phòng, sửa câu hỏi)
+ *  - Payload LIST_ROOMS_OK được render sẵn và dùng lại cho mọi client (chỉ giữ payload,
+ *    mảng entry chỉ sống trong lúc dựng lại)
+ *  - Mỗi thay đổi tăng version; client gửi LIST_ROOMS|version đang có,
+ *    nếu chưa đổi thì chỉ nhận NOT_MODIFIED|version.
+ */
+
+typedef struct {
+  int room_id;
+  char name[100];
+  int duration;
+  char host[50];
+  int question_count;
+} RoomCatalogEntry;
+
+static char *payload = NULL;
+static unsigned long catalog_version = 0;
+static int catalog_dirty = 1;
+static pthread_mutex_t catalog_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Version khởi đầu theo thời điểm chạy để client giữ version cũ sau restart không nhận nhầm NOT_MODIFIED
+static void ensure_version(void) {
+  if (catalog_version == 0) {
+    catalog_version = ((unsigned long)time(NULL)) << 16;
+  }
+}
+
+/*
+ * Đánh dấu danh mục phòng đã thay đổi. Có thể gọi khi đang giữ server_data.lock.
+ */
+void room_catalog_invalidate(void) {
+  pthread_mutex_lock(&catalog_lock);
+  ensure_version();
+  catalog_version++;
+  catalog_dirty = 1;
+  pthread_mutex_unlock(&catalog_lock);
+}
+
+// Đọc danh mục từ DB vào mảng tạm (caller giữ server_data.lock)
+static int load_entries(RoomCatalogEntry **out) {
+  const char *sql =
+    "SELECT r.id, r.name, r.duration, u.username, "
+    "  (SELECT COUNT(*) FROM exam_questions q WHERE q.room_id = r.id) "
+    "FROM rooms r "
+    "JOIN users u ON r.host_id = u.id "
+    "WHERE r.is_active = 1 "
+    "ORDER BY r.created_at DESC;";
+
+  sqlite3_stmt *stmt;
+  if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    return -1;
+  }
+
+  int capacity = 32, count = 0;
+  RoomCatalogEntry *list = malloc(sizeof(RoomCatalogEntry) * capacity);
+  if (!list) {
+    sqlite3_finalize(stmt);
+    return -1;
+  }
+
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    if (count == capacity) {
+      RoomCatalogEntry *grown = realloc(list, sizeof(RoomCatalogEntry) * capacity * 2);
+      if (!grown) break;
+      list = grown;
+      capacity *= 2;
+    }
+    RoomCatalogEntry *e = &list[count++];
+    memset(e, 0, sizeof(*e));
+    e->room_id = sqlite3_column_int(stmt, 0);
+    const char *name = (const char *)sqlite3_column_text(stmt, 1);
+    const char *host = (const char *)sqlite3_column_text(stmt, 3);
+    strncpy(e->name, name ? name : "", sizeof(e->name) - 1);
+    strncpy(e->host, host ? host : "", sizeof(e->host) - 1);
+    e->duration = sqlite3_column_int(stmt, 2);
+    e->question_count = sqlite3_column_int(stmt, 4);
+  }
+  sqlite3_finalize(stmt);
+
+  *out = list;
+  return count;
+}
+
+// Render payload LIST_ROOMS_OK từ các entry (không giới hạn kích thước cố định)
+static char *render_payload(const RoomCatalogEntry *list, int count, unsigned long version) {
+  size_t size = 64 + (size_t)count * (sizeof(RoomCatalogEntry) + 64);
+  char *out = malloc(size);
+  if (!out) return NULL;
+
+  size_t offset = snprintf(out, size, "LIST_ROOMS_OK|%d|%lu\n", count, version);
+  for (int i = 0; i < count; i++) {
+    const RoomCatalogEntry *e = &list[i];
+    const char *status_str = "Open";
+
+    char question_info[50];
+    if (e->question_count == 0) {
+      strcpy(question_info, "Chưa có question");
+    } else {
+      snprintf(question_info, sizeof(question_info), "%d questions", e->question_count);
+    }
+
+    offset += snprintf(out + offset, size - offset, "ROOM|%d|%s|%d|%s|%s|%s\n",
+                       e->room_id, e->name, e->duration, status_str, question_info, e->host);
+  }
+  return out;
+}
+
+/*
+ * Trả danh sách phòng đang mở:
+ *  - known_version = version client đang giữ (0 nếu chưa có)
+ *  - Không đổi -> NOT_MODIFIED|version; ngược lại gửi payload đã cache (dựng lại nếu cần).
+ */
+void room_catalog_list(int socket_fd, unsigned long known_version) {
+  char *response = NULL;
+
+  pthread_mutex_lock(&catalog_lock);
+  ensure_version();
+  if (!catalog_dirty && payload) {
+    if (known_version == catalog_version) {
+      char not_modified[64];
+      snprintf(not_modified, sizeof(not_modified), "NOT_MODIFIED|%lu\n", catalog_version);
+      pthread_mutex_unlock(&catalog_lock);
+      server_send(socket_fd, not_modified);
+      return;
+    }
+    response = strdup(payload);
+  }
+  pthread_mutex_unlock(&catalog_lock);
+
+  if (!response) {
+    // Dựng lại danh mục (thứ tự lock: server_data.lock -> catalog_lock)
+    pthread_mutex_lock(&server_data.lock);
+
+    pthread_mutex_lock(&catalog_lock);
+    unsigned long build_version = catalog_version;
+    pthread_mutex_unlock(&catalog_lock);
+
+    RoomCatalogEntry *list = NULL;
+    int count = load_entries(&list);
+    if (count < 0) {
+      pthread_mutex_unlock(&server_data.lock);
+      server_send(socket_fd, "LIST_ROOMS_FAIL|Database error\n");
+      return;
+    }
+    char *rendered = render_payload(list, count, build_version);
+    free(list);
+
+    pthread_mutex_lock(&catalog_lock);
+    if (rendered && build_version == catalog_version) {
+      // Không có thay đổi mới trong lúc dựng -> cache lại
+      free(payload);
+      payload = rendered;
+      catalog_dirty = 0;
+      response = strdup(payload);
+    } else {
+      response = rendered;
+    }
+    pthread_mutex_unlock(&catalog_lock);
+    pthread_mutex_unlock(&server_data.lock);
+
+    if (!response) {
+      server_send(socket_fd, "LIST_ROOMS_FAIL|Out of memory\n");
+      return;
+    }
+  }
+
+  server_send(socket_fd, response);
+  free(response);
+}
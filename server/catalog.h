@@ -0,0 +1,9 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include "common.h"
+
+void room_catalog_invalidate(void);
+void room_catalog_list(int socket_fd, unsigned long known_version);
+
+#endif
@@ -0,0 +1,354 @@
+#include "credentials.h"
+#include "auth.h"
+#include "db.h"
+#include <unistd.h>
+#include <openssl/crypto.h>
+
+extern sqlite3 *db;
+
+/*
+ * Xác thực ngoài server_data.lock:
+ *  - Chỉ mục in-memory username -> (user_id, hash mật khẩu, role) nạp từ bảng users
+ *    lúc khởi động, cập nhật khi REGISTER / CHANGE_PASSWORD / BAN_USER
+ *  - Pool AUTH_MAX_WORKERS thread băm SHA-256, so khớp với chỉ mục và ghi DB
+ *    (INSERT user, đổi mật khẩu, cờ is_online) trên connection SQLite riêng
+ *  - Thread client đẩy yêu cầu vào hàng đợi rồi chờ kết quả; số phép băm/ghi DB
+ *    chạy đồng thời bị giới hạn bởi số worker chứ không bởi số người đăng nhập
+ *  - login_user/register_user chỉ giữ server_data.lock ở bước cuối (đánh dấu online,
+ *    thêm user vào server_data.users).
+ * cred_lock (rwlock) và auth_lock là lock lá.
+ */
+
+typedef struct CredEntry {
+  int user_id;
+  char hash[65];
+  char role[20];
+  struct CredEntry *next;
+  char username[];
+} CredEntry;
+
+static CredEntry *cred_buckets[CRED_BUCKETS];
+static pthread_rwlock_t cred_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+typedef enum {
+  AUTH_REQ_LOGIN = 0,
+  AUTH_REQ_REGISTER,
+  AUTH_REQ_CHANGE_PASSWORD,
+  AUTH_REQ_SET_ONLINE
+} AuthRequestKind;
+
+typedef struct {
+  AuthRequestKind kind;
+  const char *username;
+  const char *password;
+  const char *new_password;
+  int user_id;                // vào: CHANGE_PASSWORD/SET_ONLINE, ra: LOGIN/REGISTER
+  int online;
+  char role[20];
+  AuthResult result;
+  int done;
+  pthread_cond_t done_cond;
+} AuthRequest;
+
+static AuthRequest *queue[AUTH_QUEUE_SIZE];
+static int queue_head = 0;
+static int queue_count = 0;
+static int worker_count = 0;
+static pthread_mutex_t auth_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t space_cond = PTHREAD_COND_INITIALIZER;
+
+static unsigned int cred_hash(const char *username) {
+  unsigned int h = 5381;
+  while (*username) h = h * 33 + (unsigned char)*username++;
+  return h % CRED_BUCKETS;
+}
+
+// Gọi khi đang giữ cred_lock
+static CredEntry *find_by_username(const char *username) {
+  for (CredEntry *e = cred_buckets[cred_hash(username)]; e; e = e->next) {
+    if (strcmp(e->username, username) == 0) return e;
+  }
+  return NULL;
+}
+
+// Gọi khi đang giữ cred_lock (CHANGE_PASSWORD/BAN_USER hiếm -> quét toàn bảng)
+static CredEntry *find_by_id(int user_id) {
+  for (int b = 0; b < CRED_BUCKETS; b++) {
+    for (CredEntry *e = cred_buckets[b]; e; e = e->next) {
+      if (e->user_id == user_id) return e;
+    }
+  }
+  return NULL;
+}
+
+// Gọi khi đang giữ cred_lock ghi
+static int cred_insert(int user_id, const char *username, const char *hash, const char *role) {
+  size_t len = strlen(username);
+  CredEntry *e = calloc(1, sizeof(CredEntry) + len + 1);
+  if (!e) return -1;
+  e->user_id = user_id;
+  memcpy(e->username, username, len + 1);
+  snprintf(e->hash, sizeof(e->hash), "%s", hash ? hash : "");
+  snprintf(e->role, sizeof(e->role), "%s", role ? role : "user");
+  unsigned int b = cred_hash(username);
+  e->next = cred_buckets[b];
+  cred_buckets[b] = e;
+  return 0;
+}
+
+/*
+ * Nạp chỉ mục từ bảng users (gọi một lần sau init_database).
+ * Trả về số user đã nạp, -1 nếu lỗi.
+ */
+int credentials_load(void) {
+  sqlite3_stmt *stmt;
+  int loaded = 0;
+
+  if (sqlite3_prepare_v2(db, "SELECT id, username, password, role FROM users;", -1, &stmt, NULL) != SQLITE_OK) {
+    fprintf(stderr, "[AUTH] Cannot load credentials: %s\n", sqlite3_errmsg(db));
+    return -1;
+  }
+
+  pthread_rwlock_wrlock(&cred_lock);
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    const char *username = (const char *)sqlite3_column_text(stmt, 1);
+    if (!username) continue;
+    if (cred_insert(sqlite3_column_int(stmt, 0), username,
+                    (const char *)sqlite3_column_text(stmt, 2),
+                    (const char *)sqlite3_column_text(stmt, 3)) == 0)
+      loaded++;
+  }
+  pthread_rwlock_unlock(&cred_lock);
+  sqlite3_finalize(stmt);
+
+  printf("[AUTH] Loaded %d credentials\n", loaded);
+  return loaded;
+}
+
+/*
+ * Gỡ user khỏi chỉ mục (BAN_USER). Session đang mở không bị ảnh hưởng.
+ */
+void credentials_remove(int user_id) {
+  pthread_rwlock_wrlock(&cred_lock);
+  for (int b = 0; b < CRED_BUCKETS; b++) {
+    for (CredEntry **link = &cred_buckets[b]; *link; link = &(*link)->next) {
+      if ((*link)->user_id == user_id) {
+        CredEntry *e = *link;
+        *link = e->next;
+        free(e);
+        pthread_rwlock_unlock(&cred_lock);
+        return;
+      }
+    }
+  }
+  pthread_rwlock_unlock(&cred_lock);
+}
+
+static AuthResult process_login(AuthRequest *req) {
+  char hashed[65];
+  hash_password(req->password, hashed);
+
+  pthread_rwlock_rdlock(&cred_lock);
+  CredEntry *e = find_by_username(req->username);
+  AuthResult rc = AUTH_NOT_FOUND;
+  if (e) {
+    if (CRYPTO_memcmp(e->hash, hashed, sizeof(hashed)) == 0) {
+      req->user_id = e->user_id;
+      snprintf(req->role, sizeof(req->role), "%s", e->role);
+      rc = AUTH_OK;
+    } else {
+      rc = AUTH_WRONG_PASSWORD;
+    }
+  }
+  pthread_rwlock_unlock(&cred_lock);
+  return rc;
+}
+
+static AuthResult process_register(AuthRequest *req, sqlite3 *conn) {
+  pthread_rwlock_rdlock(&cred_lock);
+  int exists = find_by_username(req->username) != NULL;
+  pthread_rwlock_unlock(&cred_lock);
+  if (exists) return AUTH_EXISTS;
+
+  char hashed[65];
+  hash_password(req->password, hashed);
+
+  sqlite3_stmt *stmt;
+  if (sqlite3_prepare_v2(conn, "INSERT INTO users (username, password) VALUES (?, ?);", -1, &stmt, NULL) != SQLITE_OK)
+    return AUTH_ERROR;
+  sqlite3_bind_text(stmt, 1, req->username, -1, SQLITE_STATIC);
+  sqlite3_bind_text(stmt, 2, hashed, -1, SQLITE_STATIC);
+  int rc = sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+  if (rc == SQLITE_CONSTRAINT) return AUTH_EXISTS;
+  if (rc != SQLITE_DONE) {
+    fprintf(stderr, "[AUTH] Register failed: %s\n", sqlite3_errmsg(conn));
+    return AUTH_ERROR;
+  }
+  req->user_id = (int)sqlite3_last_insert_rowid(conn);
+
+  pthread_rwlock_wrlock(&cred_lock);
+  if (cred_insert(req->user_id, req->username, hashed, "user") != 0)
+    fprintf(stderr, "[AUTH] Out of memory indexing user %d\n", req->user_id);
+  pthread_rwlock_unlock(&cred_lock);
+  return AUTH_OK;
+}
+
+static AuthResult process_change_password(AuthRequest *req, sqlite3 *conn) {
+  char old_hashed[65], new_hashed[65];
+  hash_password(req->password, old_hashed);
+  hash_password(req->new_password, new_hashed);
+
+  pthread_rwlock_rdlock(&cred_lock);
+  CredEntry *e = find_by_id(req->user_id);
+  int matches = e && CRYPTO_memcmp(e->hash, old_hashed, sizeof(old_hashed)) == 0;
+  pthread_rwlock_unlock(&cred_lock);
+  if (!matches) return AUTH_WRONG_PASSWORD;
+
+  sqlite3_stmt *stmt;
+  if (sqlite3_prepare_v2(conn, "UPDATE users SET password = ? WHERE id = ?;", -1, &stmt, NULL) != SQLITE_OK)
+    return AUTH_ERROR;
+  sqlite3_bind_text(stmt, 1, new_hashed, -1, SQLITE_STATIC);
+  sqlite3_bind_int(stmt, 2, req->user_id);
+  int rc = sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+  if (rc != SQLITE_DONE) return AUTH_ERROR;
+
+  pthread_rwlock_wrlock(&cred_lock);
+  e = find_by_id(req->user_id);
+  if (e) memcpy(e->hash, new_hashed, sizeof(new_hashed));
+  pthread_rwlock_unlock(&cred_lock);
+  return AUTH_OK;
+}
+
+static AuthResult process_set_online(AuthRequest *req, sqlite3 *conn) {
+  sqlite3_stmt *stmt;
+  if (sqlite3_prepare_v2(conn, "UPDATE users SET is_online = ? WHERE id = ?;", -1, &stmt, NULL) != SQLITE_OK)
+    return AUTH_ERROR;
+  sqlite3_bind_int(stmt, 1, req->online);
+  sqlite3_bind_int(stmt, 2, req->user_id);
+  int rc = sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+  return rc == SQLITE_DONE ? AUTH_OK : AUTH_ERROR;
+}
+
+static AuthResult process_request(AuthRequest *req, sqlite3 *conn) {
+  switch (req->kind) {
+  case AUTH_REQ_LOGIN:
+    return process_login(req);
+  case AUTH_REQ_REGISTER:
+    return conn ? process_register(req, conn) : AUTH_ERROR;
+  case AUTH_REQ_CHANGE_PASSWORD:
+    return conn ? process_change_password(req, conn) : AUTH_ERROR;
+  case AUTH_REQ_SET_ONLINE:
+    return conn ? process_set_online(req, conn) : AUTH_ERROR;
+  }
+  return AUTH_ERROR;
+}
+
+static void *auth_worker(void *arg) {
+  (void)arg;
+  sqlite3 *conn = db_open_worker_connection();
+  if (!conn) fprintf(stderr, "[AUTH] Worker has no DB connection, writes will fail\n");
+
+  for (;;) {
+    pthread_mutex_lock(&auth_lock);
+    while (queue_count == 0) pthread_cond_wait(&work_cond, &auth_lock);
+    AuthRequest *req = queue[queue_head];
+    queue_head = (queue_head + 1) % AUTH_QUEUE_SIZE;
+    queue_count--;
+    pthread_cond_signal(&space_cond);
+    pthread_mutex_unlock(&auth_lock);
+
+    AuthResult rc = process_request(req, conn);
+
+    pthread_mutex_lock(&auth_lock);
+    req->result = rc;
+    req->done = 1;
+    pthread_cond_signal(&req->done_cond);
+    pthread_mutex_unlock(&auth_lock);
+  }
+  return NULL;
+}
+
+int auth_pool_start(void) {
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  int wanted = cpus < 1 ? 1 : cpus > AUTH_MAX_WORKERS ? AUTH_MAX_WORKERS : (int)cpus;
+
+  for (int i = 0; i < wanted; i++) {
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, auth_worker, NULL) != 0) break;
+    pthread_detach(tid);
+    pthread_mutex_lock(&auth_lock);
+    worker_count++;
+    pthread_mutex_unlock(&auth_lock);
+  }
+  printf("[AUTH] Started %d auth workers\n", worker_count);
+  return worker_count > 0 ? 0 : -1;
+}
+
+/*
+ * Giao yêu cầu cho pool và chờ kết quả. Pool không chạy được thì xử lý ngay
+ * trên thread gọi với connection tạm.
+ */
+static AuthResult auth_submit(AuthRequest *req) {
+  pthread_mutex_lock(&auth_lock);
+  if (worker_count == 0) {
+    pthread_mutex_unlock(&auth_lock);
+    sqlite3 *conn = req->kind == AUTH_REQ_LOGIN ? NULL : db_open_worker_connection();
+    AuthResult rc = process_request(req, conn);
+    if (conn) sqlite3_close(conn);
+    return rc;
+  }
+
+  pthread_cond_init(&req->done_cond, NULL);
+  req->done = 0;
+  while (queue_count == AUTH_QUEUE_SIZE) pthread_cond_wait(&space_cond, &auth_lock);
+  queue[(queue_head + queue_count) % AUTH_QUEUE_SIZE] = req;
+  queue_count++;
+  pthread_cond_signal(&work_cond);
+  while (!req->done) pthread_cond_wait(&req->done_cond, &auth_lock);
+  pthread_mutex_unlock(&auth_lock);
+  pthread_cond_destroy(&req->done_cond);
+  return req->result;
+}
+
+/*
+ * Kiểm tra username/password. AUTH_OK: điền user_id và role.
+ */
+AuthResult auth_check_login(const char *username, const char *password,
+                            int *user_id, char *role, size_t role_size) {
+  AuthRequest req = {.kind = AUTH_REQ_LOGIN, .username = username, .password = password};
+  AuthResult rc = auth_submit(&req);
+  if (rc == AUTH_OK) {
+    *user_id = req.user_id;
+    snprintf(role, role_size, "%s", req.role);
+  }
+  return rc;
+}
+
+/*
+ * Tạo tài khoản (role user). AUTH_OK: điền user_id mới.
+ */
+AuthResult auth_register(const char *username, const char *password, int *user_id) {
+  AuthRequest req = {.kind = AUTH_REQ_REGISTER, .username = username, .password = password};
+  AuthResult rc = auth_submit(&req);
+  if (rc == AUTH_OK) *user_id = req.user_id;
+  return rc;
+}
+
+AuthResult auth_change_password(int user_id, const char *old_password, const char *new_password) {
+  AuthRequest req = {.kind = AUTH_REQ_CHANGE_PASSWORD, .user_id = user_id,
+                     .password = old_password, .new_password = new_password};
+  return auth_submit(&req);
+}
+
+/*
+ * Đồng bộ cờ users.is_online (chỉ để tra cứu ngoài server, bộ nhớ là nguồn chính).
+ * Ghi trên connection của worker để không giữ server_data.lock khi commit.
+ */
+void auth_set_online(int user_id, int online) {
+  AuthRequest req = {.kind = AUTH_REQ_SET_ONLINE, .user_id = user_id, .online = online};
+  auth_submit(&req);
+}
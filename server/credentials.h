@@ -0,0 +1,31 @@
+#ifndef CREDENTIALS_H
+#define CREDENTIALS_H
+
+#include "common.h"
+
+// Số bucket của chỉ mục username -> (id, hash, role)
+#define CRED_BUCKETS 1024
+// Số worker xác thực tối đa (giới hạn thêm bởi số CPU)
+#define AUTH_MAX_WORKERS 4
+// Số yêu cầu chờ tối đa; đầy thì thread client chờ chỗ trống
+#define AUTH_QUEUE_SIZE 256
+
+typedef enum {
+  AUTH_OK = 0,
+  AUTH_NOT_FOUND,
+  AUTH_WRONG_PASSWORD,
+  AUTH_EXISTS,
+  AUTH_ERROR
+} AuthResult;
+
+int credentials_load(void);
+void credentials_remove(int user_id);
+
+int auth_pool_start(void);
+AuthResult auth_check_login(const char *username, const char *password,
+                            int *user_id, char *role, size_t role_size);
+AuthResult auth_register(const char *username, const char *password, int *user_id);
+AuthResult auth_change_password(int user_id, const char *old_password, const char *new_password);
+void auth_set_online(int user_id, int online);
+
+#endif
@@ -0,0 +1,918 @@
+#include "csv_import.h"
+#include "db.h"
+#include "selection.h"
+#include <sys/socket.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+
+/*
+ * Import câu hỏi từ CSV dùng chung cho phòng thi (upload exam_csv) và phòng luyện tập
+ * (IMPORT_PRACTICE_CSV):
+ *  - Parser RFC 4180 dạng máy trạng thái: field trong ngoặc kép được chứa dấu phẩy,
+ *    xuống dòng và "" (ngoặc kép escape); chấp nhận CRLF/LF và BOM UTF-8 đầu file
+ *  - Dữ liệu đọc từ socket/file theo chunk CSV_CHUNK_SIZE, được cắt thành block
+ *    ~CSV_BLOCK_SIZE tại ranh giới record (newline ngoài ngoặc kép); các worker
+ *    parse + kiểm tra (đáp án 0-3, chuẩn hoá difficulty, độ dài field) song song
+ *    và dựng sẵn batch chèn. Không ghi file tạm, không giới hạn kích thước upload
+ *  - Luồng nhận gửi IMPORT_PROGRESS|rows|errors và IMPORT_ROW_ERROR|line|reason
+ *    theo thứ tự block khi được yêu cầu
+ *  - Luồng nhận chèn từng batch đã kiểm tra theo thứ tự ngay khi batch xong, mỗi batch
+ *    một transaction ngắn trên connection riêng, rồi giải phóng batch -> bộ nhớ chỉ
+ *    giới hạn bởi số block đang xử lý, không giữ server_data.lock hay khoá ghi SQLite
+ *    trong lúc còn chờ dữ liệu từ client
+ *  - Import lỗi giữa chừng (mất kết nối, hết bộ nhớ, lỗi ghi) -> xoá các câu đã chèn
+ *    để lần import vẫn là tất cả hoặc không gì.
+ */
+
+enum {
+  CSV_FIELD_START = 0,
+  CSV_UNQUOTED,
+  CSV_QUOTED,
+  CSV_QUOTE_END      // vừa gặp " trong field ngoặc kép: "" hoặc kết thúc field
+};
+
+static const unsigned char utf8_bom[3] = { 0xEF, 0xBB, 0xBF };
+
+void csv_parser_init(CsvParser *p, CsvRecordHandler handler, void *ctx) {
+  memset(p, 0, sizeof(*p));
+  p->state = CSV_FIELD_START;
+  p->line = 1;
+  p->record_line = 1;
+  p->handler = handler;
+  p->ctx = ctx;
+}
+
+// Bắt đầu parse một đoạn giữa file: không có BOM, đánh số dòng từ first_line
+void csv_parser_set_origin(CsvParser *p, int first_line, int at_file_start) {
+  p->line = first_line;
+  p->record_line = first_line;
+  if (!at_file_start) p->bom_matched = -1;
+}
+
+void csv_parser_free(CsvParser *p) {
+  free(p->buf);
+  p->buf = NULL;
+  p->len = p->cap = 0;
+}
+
+static int append_char(CsvParser *p, char c) {
+  if (p->overflow) return 0;
+  if (p->len + 1 >= CSV_MAX_RECORD) {
+    p->overflow = 1;
+    return 0;
+  }
+  if (p->len + 1 >= p->cap) {
+    size_t cap = p->cap ? p->cap * 2 : 1024;
+    char *grown = realloc(p->buf, cap);
+    if (!grown) return -1;
+    p->buf = grown;
+    p->cap = cap;
+  }
+  p->buf[p->len++] = c;
+  return 0;
+}
+
+static int end_field(CsvParser *p) {
+  if (append_char(p, '\0') < 0) return -1;
+  if (p->field_count < CSV_MAX_FIELDS) p->starts[p->field_count] = p->field_start;
+  p->field_count++;
+  p->field_start = p->len;
+  return 0;
+}
+
+static int end_record(CsvParser *p) {
+  int rc = 0;
+
+  if (p->overflow) {
+    p->malformed++;
+    if (p->error_handler) p->error_handler(p->ctx, p->record_line, "Record too long");
+  } else if (p->handler) {
+    char *fields[CSV_MAX_FIELDS];
+    int n = p->field_count < CSV_MAX_FIELDS ? p->field_count : CSV_MAX_FIELDS;
+    for (int i = 0; i < n; i++) fields[i] = p->buf + p->starts[i];
+    rc = p->handler(p->ctx, fields, p->field_count, p->record_line);
+  }
+
+  p->len = 0;
+  p->field_start = 0;
+  p->field_count = 0;
+  p->overflow = 0;
+  p->record_started = 0;
+  p->record_line = p->line;
+  return rc;
+}
+
+static int step(CsvParser *p, char c) {
+  if (c == '\n') p->line++;
+
+  switch (p->state) {
+  case CSV_FIELD_START:
+  case CSV_UNQUOTED:
+    if (c == '\r') return 0;  // CR của CRLF
+    if (c == '\n') {
+      if (!p->record_started && p->state == CSV_FIELD_START) {
+        p->record_line = p->line;  // dòng trống
+        return 0;
+      }
+      p->state = CSV_FIELD_START;
+      if (end_field(p) < 0) return -1;
+      return end_record(p);
+    }
+    p->record_started = 1;
+    if (c == ',') {
+      p->state = CSV_FIELD_START;
+      return end_field(p);
+    }
+    if (c == '"' && p->state == CSV_FIELD_START) {
+      p->state = CSV_QUOTED;
+      return 0;
+    }
+    p->state = CSV_UNQUOTED;
+    return append_char(p, c);
+
+  case CSV_QUOTED:
+    if (c == '"') {
+      p->state = CSV_QUOTE_END;
+      return 0;
+    }
+    return append_char(p, c);
+
+  case CSV_QUOTE_END:
+    if (c == '"') {
+      p->state = CSV_QUOTED;
+      return append_char(p, '"');
+    }
+    if (c == '\r') return 0;
+    if (c == ',') {
+      p->state = CSV_FIELD_START;
+      return end_field(p);
+    }
+    if (c == '\n') {
+      p->state = CSV_FIELD_START;
+      if (end_field(p) < 0) return -1;
+      return end_record(p);
+    }
+    // Ký tự sau ngoặc đóng (không chuẩn): giữ lại như field thường
+    p->state = CSV_UNQUOTED;
+    return append_char(p, c);
+  }
+  return 0;
+}
+
+/*
+ * Parse thêm một chunk. Trả < 0 nếu hết bộ nhớ hoặc handler yêu cầu dừng.
+ */
+int csv_parser_feed(CsvParser *p, const char *data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    char c = data[i];
+
+    if (p->bom_matched >= 0) {
+      if ((unsigned char)c == utf8_bom[p->bom_matched]) {
+        if (++p->bom_matched == 3) p->bom_matched = -1;
+        continue;
+      }
+      // Không phải BOM: trả lại các byte đã khớp một phần
+      int matched = p->bom_matched;
+      p->bom_matched = -1;
+      for (int k = 0; k < matched; k++) {
+        if (step(p, (char)utf8_bom[k]) < 0) return -1;
+      }
+    }
+
+    if (step(p, c) < 0) return -1;
+  }
+  return 0;
+}
+
+/*
+ * Kết thúc input: đẩy record cuối nếu file không có xuống dòng ở cuối.
+ */
+int csv_parser_finish(CsvParser *p) {
+  if (p->state == CSV_QUOTED) {
+    // Thiếu ngoặc kép đóng -> record cuối không hợp lệ
+    p->malformed++;
+    if (p->error_handler) p->error_handler(p->ctx, p->record_line, "Unterminated quoted field");
+    p->len = 0;
+    p->field_start = 0;
+    p->field_count = 0;
+    p->record_started = 0;
+    p->state = CSV_FIELD_START;
+    return 0;
+  }
+  if (!p->record_started && p->state == CSV_FIELD_START) return 0;
+  p->state = CSV_FIELD_START;
+  if (end_field(p) < 0) return -1;
+  return end_record(p);
+}
+
+/* ===== Batch câu hỏi đã kiểm tra của một block ===== */
+
+// Mỗi câu giữ 7 chuỗi nối tiếp: text, A, B, C, D, difficulty, category
+#define SPOOL_STRINGS 7
+
+typedef struct {
+  int line;
+  const char *reason;       // chuỗi hằng
+} CsvRowError;
+
+typedef struct {
+  char *data;
+  size_t len;
+  size_t cap;
+  size_t *offsets;
+  int *correct;
+  int count;
+  int capacity;
+  int header_checked;
+  int rows;                 // record dữ liệu đã xử lý (không tính header/chú thích)
+  int error_count;
+  CsvRowError errors[CSV_MAX_REPORTED_ERRORS];   // chỉ giữ các lỗi đầu tiên
+  int out_of_memory;
+  int done;
+} CsvBatch;
+
+static int batch_append_string(CsvBatch *b, const char *str) {
+  size_t n = strlen(str) + 1;
+  if (b->len + n > b->cap) {
+    size_t cap = b->cap ? b->cap : 64 * 1024;
+    while (cap < b->len + n) cap *= 2;
+    char *grown = realloc(b->data, cap);
+    if (!grown) return -1;
+    b->data = grown;
+    b->cap = cap;
+  }
+  memcpy(b->data + b->len, str, n);
+  b->len += n;
+  return 0;
+}
+
+static void batch_error(void *ctx, int line, const char *reason) {
+  CsvBatch *b = ctx;
+  if (b->error_count < CSV_MAX_REPORTED_ERRORS) {
+    b->errors[b->error_count].line = line;
+    b->errors[b->error_count].reason = reason;
+  }
+  b->error_count++;
+  b->rows++;
+}
+
+// "0".."3" -> 0..3, còn lại -1
+static int parse_correct(const char *str) {
+  while (*str == ' ') str++;
+  if (*str < '0' || *str > '3') return -1;
+  const char *end = str + 1;
+  while (*end == ' ') end++;
+  return *end == '\0' ? str[0] - '0' : -1;
+}
+
+// Kiểm tra một câu hỏi; trả NULL nếu hợp lệ, ngược lại là lý do lỗi
+static const char *validate_question(char **fields, int field_count, int *correct, int *level) {
+  if (field_count < CSV_QUESTION_FIELDS) return "Missing fields";
+  if (fields[0][0] == '\0') return "Empty question";
+  if (strlen(fields[0]) > CSV_MAX_QUESTION_LEN) return "Question too long";
+  for (int k = 1; k <= 4; k++) {
+    if (fields[k][0] == '\0') return "Empty option";
+    if (strlen(fields[k]) > CSV_MAX_OPTION_LEN) return "Option too long";
+  }
+  *correct = parse_correct(fields[5]);
+  if (*correct < 0) return "Correct answer must be 0-3";
+  *level = normalize_difficulty(fields[6]);
+  if (*level < 0) return "Difficulty must be easy/medium/hard";
+  if (strlen(fields[7]) > CSV_MAX_CATEGORY_LEN) return "Category too long";
+  return NULL;
+}
+
+static int batch_record(void *ctx, char **fields, int field_count, int line) {
+  CsvBatch *b = ctx;
+  static const char *difficulty_names[] = { "Easy", "Medium", "Hard" };
+
+  // Dòng chú thích
+  if (field_count == 1 && fields[0][0] == '#') return 0;
+
+  // Dòng đầu file là header nếu cột đáp án không phải số
+  if (!b->header_checked) {
+    b->header_checked = 1;
+    if (field_count < CSV_QUESTION_FIELDS || parse_correct(fields[5]) < 0) return 0;
+  }
+
+  int correct = -1, level = -1;
+  const char *reason = validate_question(fields, field_count, &correct, &level);
+  if (reason) {
+    batch_error(b, line, reason);
+    return 0;
+  }
+
+  if (b->count == b->capacity) {
+    int capacity = b->capacity ? b->capacity * 2 : 256;
+    size_t *offsets = realloc(b->offsets, capacity * sizeof(size_t));
+    if (!offsets) return -1;
+    b->offsets = offsets;
+    int *corrects = realloc(b->correct, capacity * sizeof(int));
+    if (!corrects) return -1;
+    b->correct = corrects;
+    b->capacity = capacity;
+  }
+
+  size_t offset = b->len;
+  const char *values[SPOOL_STRINGS] = {
+    fields[0], fields[1], fields[2], fields[3], fields[4], difficulty_names[level], fields[7]
+  };
+  for (int i = 0; i < SPOOL_STRINGS; i++) {
+    if (batch_append_string(b, values[i]) < 0) return -1;
+  }
+  b->offsets[b->count] = offset;
+  b->correct[b->count] = correct;
+  b->count++;
+  b->rows++;
+  return 0;
+}
+
+static void batch_free(CsvBatch *b) {
+  if (!b) return;
+  free(b->data);
+  free(b->offsets);
+  free(b->correct);
+  free(b);
+}
+
+/* ===== Pipeline: cắt block -> worker parse/kiểm tra song song ===== */
+
+typedef struct {
+  char *data;
+  size_t len;
+  int first_line;
+  int at_file_start;
+  CsvBatch *batch;
+} CsvBlock;
+
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  CsvBlock queue[CSV_MAX_PENDING_BLOCKS];
+  int queue_head;
+  int queue_count;
+  int in_flight;            // block đang chờ hoặc đang được parse
+  int closed;
+  pthread_t workers[CSV_IMPORT_MAX_WORKERS];
+  int worker_count;
+  int max_workers;
+
+  CsvBatch **batches;       // theo thứ tự block
+  int batch_count;
+  int batch_capacity;
+
+  // Trạng thái cắt block của luồng nhận
+  char *pending;
+  size_t pending_len;
+  size_t pending_cap;
+  size_t last_boundary;     // vị trí ngay sau newline kết thúc record cuối cùng
+  int split_state;          // trạng thái CSV_* của parser tại cuối pending
+  int bom_matched;          // số byte BOM đã khớp ở đầu input, -1 = đã qua
+  int next_line;
+
+  // Writer (luồng nhận): chèn batch theo thứ tự, mỗi batch một transaction
+  CsvTarget target;
+  int target_id;
+  int order_base;
+  sqlite3 *conn;
+  sqlite3_stmt *insert;
+  sqlite3_stmt *mapping;
+  int *ids;                 // id đã chèn (đã commit) theo thứ tự
+  int inserted;
+  int ids_capacity;
+  const char *write_error;
+
+  // Báo tiến độ (luồng nhận)
+  int progress_fd;          // -1 = không báo
+  int reported;             // số batch đã cộng dồn
+  int rows;
+  int errors;
+  int errors_sent;
+  long last_progress_ms;
+  int out_of_memory;
+} CsvPipeline;
+
+static long now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void *csv_worker(void *arg) {
+  CsvPipeline *pl = arg;
+
+  for (;;) {
+    pthread_mutex_lock(&pl->lock);
+    while (pl->queue_count == 0 && !pl->closed) pthread_cond_wait(&pl->cond, &pl->lock);
+    if (pl->queue_count == 0) {
+      pthread_mutex_unlock(&pl->lock);
+      return NULL;
+    }
+    CsvBlock block = pl->queue[pl->queue_head];
+    pl->queue_head = (pl->queue_head + 1) % CSV_MAX_PENDING_BLOCKS;
+    pl->queue_count--;
+    pthread_mutex_unlock(&pl->lock);
+
+    CsvBatch *b = block.batch;
+    b->header_checked = !block.at_file_start;
+    CsvParser parser;
+    csv_parser_init(&parser, batch_record, b);
+    parser.error_handler = batch_error;
+    csv_parser_set_origin(&parser, block.first_line, block.at_file_start);
+    if (csv_parser_feed(&parser, block.data, block.len) < 0 || csv_parser_finish(&parser) < 0) {
+      b->out_of_memory = 1;
+    }
+    csv_parser_free(&parser);
+    free(block.data);
+
+    pthread_mutex_lock(&pl->lock);
+    b->done = 1;
+    pl->in_flight--;
+    pthread_cond_broadcast(&pl->cond);
+    pthread_mutex_unlock(&pl->lock);
+  }
+}
+
+static void pipeline_init(CsvPipeline *pl, int progress_fd, CsvTarget target, int target_id,
+                          int order_base) {
+  memset(pl, 0, sizeof(*pl));
+  pthread_mutex_init(&pl->lock, NULL);
+  pthread_cond_init(&pl->cond, NULL);
+  pl->progress_fd = progress_fd;
+  pl->next_line = 1;
+  pl->split_state = CSV_FIELD_START;
+  pl->target = target;
+  pl->target_id = target_id;
+  pl->order_base = order_base;
+
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  pl->max_workers = cpus < 1 ? 1 : cpus > CSV_IMPORT_MAX_WORKERS ? CSV_IMPORT_MAX_WORKERS : (int)cpus;
+}
+
+/*
+ * Writer: chèn một batch trong transaction riêng trên connection của pipeline.
+ * Lỗi -> rollback batch đó, ghi write_error; các batch trước đó vẫn nằm trong ids.
+ */
+static int pipeline_write_batch(CsvPipeline *pl, CsvBatch *b) {
+  if (b->count == 0) return 0;
+
+  if (!pl->conn) {
+    pl->conn = db_open_worker_connection();
+    if (!pl->conn) {
+      pl->write_error = "Database unavailable";
+      return -1;
+    }
+    const char *insert_sql = pl->target == CSV_TARGET_EXAM_ROOM
+      ? "INSERT INTO exam_questions (room_id, question_text, option_a, option_b, option_c, option_d, correct_answer, difficulty, category) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?);"
+      : "INSERT INTO practice_questions (practice_id, question_text, option_a, option_b, option_c, option_d, correct_answer, difficulty, category) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?);";
+    int ok = sqlite3_prepare_v2(pl->conn, insert_sql, -1, &pl->insert, NULL) == SQLITE_OK;
+    if (ok && pl->target == CSV_TARGET_PRACTICE) {
+      ok = sqlite3_prepare_v2(pl->conn,
+          "INSERT INTO practice_room_questions (practice_id, question_id, question_order) VALUES (?, ?, ?);",
+          -1, &pl->mapping, NULL) == SQLITE_OK;
+    }
+    if (!ok) {
+      fprintf(stderr, "[CSV_IMPORT] prepare failed: %s\n", sqlite3_errmsg(pl->conn));
+      pl->write_error = "Import failed";
+      return -1;
+    }
+  }
+
+  if (pl->inserted + b->count > pl->ids_capacity) {
+    int capacity = pl->ids_capacity ? pl->ids_capacity : 1024;
+    while (capacity < pl->inserted + b->count) capacity *= 2;
+    int *grown = realloc(pl->ids, capacity * sizeof(int));
+    if (!grown) {
+      pl->out_of_memory = 1;
+      return -1;
+    }
+    pl->ids = grown;
+    pl->ids_capacity = capacity;
+  }
+
+  int committed = pl->inserted;
+  int ok = sqlite3_exec(pl->conn, "BEGIN IMMEDIATE;", NULL, NULL, NULL) == SQLITE_OK;
+  int in_transaction = ok;
+
+  for (int i = 0; ok && i < b->count; i++) {
+    const char *str = b->data + b->offsets[i];
+    const char *values[SPOOL_STRINGS];
+    for (int k = 0; k < SPOOL_STRINGS; k++) {
+      values[k] = str;
+      str += strlen(str) + 1;
+    }
+
+    sqlite3_bind_int(pl->insert, 1, pl->target_id);
+    for (int k = 0; k < 5; k++) sqlite3_bind_text(pl->insert, 2 + k, values[k], -1, SQLITE_STATIC);
+    sqlite3_bind_int(pl->insert, 7, b->correct[i]);
+    sqlite3_bind_text(pl->insert, 8, values[5], -1, SQLITE_STATIC);
+    sqlite3_bind_text(pl->insert, 9, values[6], -1, SQLITE_STATIC);
+    ok = sqlite3_step(pl->insert) == SQLITE_DONE;
+    sqlite3_reset(pl->insert);
+    if (!ok) break;
+
+    pl->ids[pl->inserted] = (int)sqlite3_last_insert_rowid(pl->conn);
+    if (pl->mapping) {
+      sqlite3_bind_int(pl->mapping, 1, pl->target_id);
+      sqlite3_bind_int(pl->mapping, 2, pl->ids[pl->inserted]);
+      sqlite3_bind_int(pl->mapping, 3, pl->order_base + pl->inserted);
+      ok = sqlite3_step(pl->mapping) == SQLITE_DONE;
+      sqlite3_reset(pl->mapping);
+    }
+    pl->inserted++;
+  }
+
+  if (ok) ok = sqlite3_exec(pl->conn, "COMMIT;", NULL, NULL, NULL) == SQLITE_OK;
+  if (!ok) {
+    fprintf(stderr, "[CSV_IMPORT] insert failed: %s\n", sqlite3_errmsg(pl->conn));
+    if (in_transaction) sqlite3_exec(pl->conn, "ROLLBACK;", NULL, NULL, NULL);
+    pl->inserted = committed;
+    pl->write_error = "Import failed";
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * Import thất bại sau khi đã commit vài batch -> xoá các câu đã chèn (và thứ tự
+ * trong practice_room_questions) trong một transaction.
+ */
+static void pipeline_undo(CsvPipeline *pl) {
+  if (!pl->conn || pl->inserted == 0) return;
+
+  sqlite3_stmt *unmap = NULL;
+  sqlite3_stmt *del = NULL;
+  int ok = sqlite3_exec(pl->conn, "BEGIN IMMEDIATE;", NULL, NULL, NULL) == SQLITE_OK;
+  int in_transaction = ok;
+
+  if (ok) {
+    ok = sqlite3_prepare_v2(pl->conn, pl->target == CSV_TARGET_EXAM_ROOM
+        ? "DELETE FROM exam_questions WHERE id = ?;"
+        : "DELETE FROM practice_questions WHERE id = ?;", -1, &del, NULL) == SQLITE_OK;
+  }
+  if (ok && pl->target == CSV_TARGET_PRACTICE) {
+    ok = sqlite3_prepare_v2(pl->conn,
+        "DELETE FROM practice_room_questions WHERE practice_id = ? AND question_id = ?;",
+        -1, &unmap, NULL) == SQLITE_OK;
+  }
+
+  for (int i = 0; ok && i < pl->inserted; i++) {
+    if (unmap) {
+      sqlite3_bind_int(unmap, 1, pl->target_id);
+      sqlite3_bind_int(unmap, 2, pl->ids[i]);
+      ok = sqlite3_step(unmap) == SQLITE_DONE;
+      sqlite3_reset(unmap);
+    }
+    if (ok) {
+      sqlite3_bind_int(del, 1, pl->ids[i]);
+      ok = sqlite3_step(del) == SQLITE_DONE;
+      sqlite3_reset(del);
+    }
+  }
+
+  sqlite3_finalize(unmap);
+  sqlite3_finalize(del);
+
+  if (ok) ok = sqlite3_exec(pl->conn, "COMMIT;", NULL, NULL, NULL) == SQLITE_OK;
+  if (!ok) {
+    fprintf(stderr, "[CSV_IMPORT] undo of %d rows failed: %s\n", pl->inserted, sqlite3_errmsg(pl->conn));
+    if (in_transaction) sqlite3_exec(pl->conn, "ROLLBACK;", NULL, NULL, NULL);
+  }
+  pl->inserted = 0;
+}
+
+/*
+ * Cộng dồn các batch đã xong theo thứ tự, gửi IMPORT_ROW_ERROR / IMPORT_PROGRESS
+ * và chèn batch vào DB.
+ * force = 1: gửi frame tiến độ kể cả khi chưa đến chu kỳ.
+ */
+static void pipeline_report(CsvPipeline *pl, int force) {
+  int advanced = 0;
+
+  for (;;) {
+    pthread_mutex_lock(&pl->lock);
+    CsvBatch *b = pl->reported < pl->batch_count ? pl->batches[pl->reported] : NULL;
+    int done = b && b->done;
+    pthread_mutex_unlock(&pl->lock);
+    if (!done) break;
+
+    // Batch đã xong không còn bị worker sửa -> đọc ngoài lock
+    pl->rows += b->rows;
+    pl->errors += b->error_count;
+    if (b->out_of_memory) pl->out_of_memory = 1;
+    advanced = 1;
+
+    int stored = b->error_count < CSV_MAX_REPORTED_ERRORS ? b->error_count : CSV_MAX_REPORTED_ERRORS;
+    for (int i = 0; i < stored && pl->progress_fd >= 0 && pl->errors_sent < CSV_MAX_REPORTED_ERRORS; i++) {
+      char frame[128];
+      snprintf(frame, sizeof(frame), "IMPORT_ROW_ERROR|%d|%s\n", b->errors[i].line, b->errors[i].reason);
+      send(pl->progress_fd, frame, strlen(frame), MSG_NOSIGNAL);
+      pl->errors_sent++;
+    }
+
+    // Ghi ngay rồi bỏ batch: sau lỗi đầu tiên chỉ còn đếm, phần đã chèn sẽ được xoá
+    if (!pl->out_of_memory && !pl->write_error) pipeline_write_batch(pl, b);
+    batch_free(b);
+    pthread_mutex_lock(&pl->lock);
+    pl->batches[pl->reported++] = NULL;
+    pthread_mutex_unlock(&pl->lock);
+  }
+
+  if (pl->progress_fd < 0 || (!advanced && !force)) return;
+  long now = now_ms();
+  if (!force && now - pl->last_progress_ms < CSV_PROGRESS_INTERVAL_MS) return;
+  pl->last_progress_ms = now;
+
+  char frame[64];
+  snprintf(frame, sizeof(frame), "IMPORT_PROGRESS|%d|%d\n", pl->rows, pl->errors);
+  send(pl->progress_fd, frame, strlen(frame), MSG_NOSIGNAL);
+}
+
+// Giao một block cho worker (chờ nếu đã đủ CSV_MAX_PENDING_BLOCKS block đang xử lý)
+static int pipeline_submit(CsvPipeline *pl, size_t len) {
+  CsvBlock block;
+  block.data = malloc(len);
+  block.batch = calloc(1, sizeof(CsvBatch));
+  if (!block.data || !block.batch) {
+    free(block.data);
+    free(block.batch);
+    return -1;
+  }
+  memcpy(block.data, pl->pending, len);
+  block.len = len;
+  block.first_line = pl->next_line;
+  block.at_file_start = pl->batch_count == 0;
+  for (size_t i = 0; i < len; i++) {
+    if (pl->pending[i] == '\n') pl->next_line++;
+  }
+
+  pthread_mutex_lock(&pl->lock);
+  if (pl->batch_count == pl->batch_capacity) {
+    int capacity = pl->batch_capacity ? pl->batch_capacity * 2 : 16;
+    CsvBatch **grown = realloc(pl->batches, capacity * sizeof(CsvBatch *));
+    if (!grown) {
+      pthread_mutex_unlock(&pl->lock);
+      free(block.data);
+      free(block.batch);
+      return -1;
+    }
+    pl->batches = grown;
+    pl->batch_capacity = capacity;
+  }
+  pl->batches[pl->batch_count++] = block.batch;
+
+  while (pl->in_flight >= CSV_MAX_PENDING_BLOCKS) {
+    // Chờ worker, đồng thời báo tiến độ các batch vừa xong
+    pthread_mutex_unlock(&pl->lock);
+    pipeline_report(pl, 0);
+    pthread_mutex_lock(&pl->lock);
+    if (pl->in_flight >= CSV_MAX_PENDING_BLOCKS) pthread_cond_wait(&pl->cond, &pl->lock);
+  }
+
+  int tail = (pl->queue_head + pl->queue_count) % CSV_MAX_PENDING_BLOCKS;
+  pl->queue[tail] = block;
+  pl->queue_count++;
+  pl->in_flight++;
+  if (pl->worker_count < pl->max_workers && pl->worker_count < pl->in_flight) {
+    if (pthread_create(&pl->workers[pl->worker_count], NULL, csv_worker, pl) == 0) {
+      pl->worker_count++;
+    }
+  }
+  pthread_cond_broadcast(&pl->cond);
+  pthread_mutex_unlock(&pl->lock);
+
+  // Không tạo được worker nào -> tự parse ở luồng hiện tại
+  if (pl->worker_count == 0) {
+    pthread_mutex_lock(&pl->lock);
+    pl->closed = 1;
+    pthread_mutex_unlock(&pl->lock);
+    csv_worker(pl);
+    pthread_mutex_lock(&pl->lock);
+    pl->closed = 0;
+    pthread_mutex_unlock(&pl->lock);
+  }
+  return 0;
+}
+
+/*
+ * Trạng thái của step() rút gọn cho việc cắt block: chỉ newline kết thúc record
+ * (ngoài field ngoặc kép) là ranh giới; " giữa field thường như ab"c không mở ngoặc.
+ */
+static int split_step(int state, char c, int *boundary) {
+  switch (state) {
+  case CSV_FIELD_START:
+  case CSV_UNQUOTED:
+    if (c == '\r') return state;
+    if (c == '\n') {
+      *boundary = 1;
+      return CSV_FIELD_START;
+    }
+    if (c == ',') return CSV_FIELD_START;
+    if (c == '"' && state == CSV_FIELD_START) return CSV_QUOTED;
+    return CSV_UNQUOTED;
+
+  case CSV_QUOTED:
+    return c == '"' ? CSV_QUOTE_END : CSV_QUOTED;
+
+  case CSV_QUOTE_END:
+    if (c == '"') return CSV_QUOTED;
+    if (c == '\r') return CSV_QUOTE_END;
+    if (c == ',') return CSV_FIELD_START;
+    if (c == '\n') {
+      *boundary = 1;
+      return CSV_FIELD_START;
+    }
+    return CSV_UNQUOTED;
+  }
+  return state;
+}
+
+/*
+ * Nạp thêm dữ liệu thô; cắt block tại ranh giới record cuối cùng khi đủ CSV_BLOCK_SIZE.
+ */
+static int pipeline_feed(CsvPipeline *pl, const char *data, size_t len) {
+  if (pl->pending_len + len > pl->pending_cap) {
+    size_t cap = pl->pending_cap ? pl->pending_cap : CSV_BLOCK_SIZE + CSV_CHUNK_SIZE;
+    while (cap < pl->pending_len + len) cap *= 2;
+    char *grown = realloc(pl->pending, cap);
+    if (!grown) return -1;
+    pl->pending = grown;
+    pl->pending_cap = cap;
+  }
+
+  size_t start = pl->pending_len;
+  memcpy(pl->pending + start, data, len);
+  pl->pending_len += len;
+
+  for (size_t i = start; i < pl->pending_len; i++) {
+    char c = pl->pending[i];
+    if (pl->bom_matched >= 0) {
+      // BOM đầu file không thuộc field nào: " ngay sau nó vẫn mở ngoặc kép
+      if ((unsigned char)c == utf8_bom[pl->bom_matched]) {
+        if (++pl->bom_matched == 3) pl->bom_matched = -1;
+        continue;
+      }
+      if (pl->bom_matched > 0) pl->split_state = CSV_UNQUOTED;
+      pl->bom_matched = -1;
+    }
+    int boundary = 0;
+    pl->split_state = split_step(pl->split_state, c, &boundary);
+    if (boundary) pl->last_boundary = i + 1;
+  }
+
+  if (pl->pending_len < CSV_BLOCK_SIZE) return 0;
+
+  // Input lỗi (ngoặc kép không đóng) -> không có ranh giới: cắt cưỡng bức để giới hạn bộ nhớ
+  size_t cut = pl->last_boundary;
+  if (cut == 0) {
+    if (pl->pending_len < (size_t)CSV_BLOCK_SIZE * 4) return 0;
+    cut = pl->pending_len;
+    pl->split_state = CSV_FIELD_START;
+  }
+
+  if (pipeline_submit(pl, cut) < 0) return -1;
+  memmove(pl->pending, pl->pending + cut, pl->pending_len - cut);
+  pl->pending_len -= cut;
+  pl->last_boundary = 0;
+  pipeline_report(pl, 0);
+  return 0;
+}
+
+// Giao phần còn lại, chờ mọi worker xong và báo tiến độ cuối cùng
+static int pipeline_finish(CsvPipeline *pl, int submit_rest) {
+  int rc = 0;
+  if (submit_rest && pl->pending_len > 0) rc = pipeline_submit(pl, pl->pending_len);
+
+  pthread_mutex_lock(&pl->lock);
+  pl->closed = 1;
+  pthread_cond_broadcast(&pl->cond);
+  pthread_mutex_unlock(&pl->lock);
+  for (int i = 0; i < pl->worker_count; i++) pthread_join(pl->workers[i], NULL);
+
+  if (submit_rest) pipeline_report(pl, 1);
+  return rc;
+}
+
+static void pipeline_free(CsvPipeline *pl) {
+  for (int i = 0; i < pl->batch_count; i++) batch_free(pl->batches[i]);
+  free(pl->batches);
+  free(pl->pending);
+  free(pl->ids);
+  sqlite3_finalize(pl->insert);
+  sqlite3_finalize(pl->mapping);
+  if (pl->conn) sqlite3_close(pl->conn);
+  pthread_mutex_destroy(&pl->lock);
+  pthread_cond_destroy(&pl->cond);
+}
+
+static int finish_import(CsvPipeline *pl, int feed_rc, CsvImportResult *result) {
+  if (pipeline_finish(pl, feed_rc == 0 && result->error == NULL) < 0) feed_rc = -1;
+  if ((feed_rc < 0 || pl->out_of_memory) && result->error == NULL) {
+    result->error = "Memory allocation failed";
+  }
+  if (pl->write_error && result->error == NULL) result->error = pl->write_error;
+
+  int rc = -1;
+  if (result->error == NULL) {
+    result->skipped = pl->errors;
+    result->imported = pl->inserted;
+    if (pl->inserted > 0) {
+      result->question_ids = pl->ids;
+      pl->ids = NULL;
+    }
+    rc = 0;
+  } else {
+    pipeline_undo(pl);
+  }
+
+  pipeline_free(pl);
+  return rc;
+}
+
+/*
+ * Nhận đúng `size` byte CSV từ socket (sau khi đã gửi READY) và import.
+ * Luôn đọc hết `size` byte để giữ đồng bộ protocol, kể cả khi parse lỗi.
+ * report_progress: gửi IMPORT_PROGRESS/IMPORT_ROW_ERROR trong lúc nhận.
+ * Trả 0 nếu thành công (result->imported/skipped), -1 nếu lỗi (result->error).
+ */
+int csv_import_from_socket(int socket_fd, long size, CsvTarget target, int target_id,
+                           int order_base, int report_progress, CsvImportResult *result) {
+  memset(result, 0, sizeof(*result));
+
+  char *chunk = malloc(CSV_CHUNK_SIZE);
+  if (!chunk) {
+    result->error = "Memory allocation failed";
+    return -1;
+  }
+
+  CsvPipeline pl;
+  pipeline_init(&pl, report_progress ? socket_fd : -1, target, target_id, order_base);
+
+  long remaining = size;
+  int feed_rc = 0;
+
+  while (remaining > 0) {
+    // Chờ bằng poll thay vì recv + usleep lặp lại: client ngừng gửi -> hết hạn một lần
+    struct pollfd pfd = { .fd = socket_fd, .events = POLLIN };
+    int ready = poll(&pfd, 1, CSV_RECV_TIMEOUT_MS);
+    if (ready < 0 && errno == EINTR) continue;
+    if (ready == 0) {
+      result->error = "Upload timeout";
+      break;
+    }
+    size_t want = remaining < CSV_CHUNK_SIZE ? (size_t)remaining : CSV_CHUNK_SIZE;
+    ssize_t n = ready > 0 ? recv(socket_fd, chunk, want, 0) : -1;
+    if (n > 0) {
+      remaining -= n;
+      if (feed_rc == 0) feed_rc = pipeline_feed(&pl, chunk, (size_t)n);
+    } else if (n == 0) {
+      result->error = "Connection closed";
+      break;
+    } else if (errno != EINTR) {
+      result->error = "File upload failed";
+      break;
+    }
+  }
+
+  free(chunk);
+  return finish_import(&pl, feed_rc, result);
+}
+
+/*
+ * Import từ file trên máy server (file staging của UPLOAD_COMMIT).
+ * progress_fd >= 0: gửi IMPORT_PROGRESS/IMPORT_ROW_ERROR cho socket đó trong lúc parse.
+ */
+int csv_import_from_file(const char *path, CsvTarget target, int target_id,
+                         int order_base, int progress_fd, CsvImportResult *result) {
+  memset(result, 0, sizeof(*result));
+
+  FILE *fp = path ? fopen(path, "rb") : NULL;
+  if (!fp) {
+    result->error = "Cannot open file";
+    return -1;
+  }
+
+  char *chunk = malloc(CSV_CHUNK_SIZE);
+  if (!chunk) {
+    fclose(fp);
+    result->error = "Memory allocation failed";
+    return -1;
+  }
+
+  CsvPipeline pl;
+  pipeline_init(&pl, progress_fd, target, target_id, order_base);
+
+  int feed_rc = 0;
+  size_t n;
+  while (feed_rc == 0 && (n = fread(chunk, 1, CSV_CHUNK_SIZE, fp)) > 0) {
+    feed_rc = pipeline_feed(&pl, chunk, n);
+  }
+  if (ferror(fp)) result->error = "Cannot read file";
+
+  fclose(fp);
+  free(chunk);
+  return finish_import(&pl, feed_rc, result);
+}
@@ -0,0 +1,80 @@
+#ifndef CSV_IMPORT_H
+#define CSV_IMPORT_H
+
+#include "common.h"
+
+// Số field tối đa giữ lại mỗi dòng (field dư bị bỏ qua)
+#define CSV_MAX_FIELDS 16
+// Độ dài tối đa một record (kể cả field nhiều dòng trong ngoặc kép)
+#define CSV_MAX_RECORD (64 * 1024)
+// Kích thước mỗi lần đọc từ socket/file
+#define CSV_CHUNK_SIZE (64 * 1024)
+// Kích thước block giao cho một worker (cắt tại ranh giới record)
+#define CSV_BLOCK_SIZE (256 * 1024)
+// Số worker parse/kiểm tra tối đa của một lần import (giới hạn thêm bởi số CPU)
+#define CSV_IMPORT_MAX_WORKERS 8
+// Số block đang chờ/đang parse tối đa (giới hạn bộ nhớ khi client gửi nhanh)
+#define CSV_MAX_PENDING_BLOCKS 16
+// Số lỗi theo dòng được gửi về client (tổng số lỗi vẫn được đếm đủ)
+#define CSV_MAX_REPORTED_ERRORS 100
+// Thời gian chờ dữ liệu tối đa khi nhận CSV trực tiếp từ socket (ms)
+#define CSV_RECV_TIMEOUT_MS 30000
+// Chu kỳ tối thiểu giữa hai frame IMPORT_PROGRESS (ms)
+#define CSV_PROGRESS_INTERVAL_MS 200
+// Giới hạn độ dài field của câu hỏi
+#define CSV_MAX_QUESTION_LEN 2000
+#define CSV_MAX_OPTION_LEN 500
+#define CSV_MAX_CATEGORY_LEN 100
+// Số field của một câu hỏi: question,optA,optB,optC,optD,correct(0-3),difficulty,category
+#define CSV_QUESTION_FIELDS 8
+
+// Callback cho mỗi record hoàn chỉnh; trả < 0 để dừng parse
+typedef int (*CsvRecordHandler)(void *ctx, char **fields, int field_count, int line);
+// Callback cho record hỏng (quá dài, thiếu ngoặc kép đóng)
+typedef void (*CsvErrorHandler)(void *ctx, int line, const char *reason);
+
+// Parser RFC 4180 dạng máy trạng thái, nhận dữ liệu theo từng chunk
+typedef struct {
+  int state;
+  int bom_matched;          // số byte BOM UTF-8 đã khớp, -1 = đã qua đầu file
+  int line;                 // dòng vật lý hiện tại (bắt đầu từ 1)
+  int record_line;          // dòng bắt đầu record đang parse
+  int record_started;
+  int overflow;             // record vượt CSV_MAX_RECORD -> bỏ cả record
+  int malformed;            // số record lỗi (quá dài, thiếu ngoặc đóng)
+  char *buf;
+  size_t len;
+  size_t cap;
+  size_t field_start;       // vị trí bắt đầu field đang parse trong buf
+  size_t starts[CSV_MAX_FIELDS];
+  int field_count;
+  CsvRecordHandler handler;
+  CsvErrorHandler error_handler;   // tuỳ chọn
+  void *ctx;
+} CsvParser;
+
+void csv_parser_init(CsvParser *p, CsvRecordHandler handler, void *ctx);
+void csv_parser_set_origin(CsvParser *p, int first_line, int at_file_start);
+int csv_parser_feed(CsvParser *p, const char *data, size_t len);
+int csv_parser_finish(CsvParser *p);
+void csv_parser_free(CsvParser *p);
+
+// Đích của một lần import câu hỏi
+typedef enum {
+  CSV_TARGET_EXAM_ROOM = 0,   // exam_questions.room_id
+  CSV_TARGET_PRACTICE         // practice_questions + practice_room_questions
+} CsvTarget;
+
+typedef struct {
+  int imported;
+  int skipped;                // dòng bị từ chối khi kiểm tra (xem IMPORT_ROW_ERROR)
+  int *question_ids;          // id đã chèn theo thứ tự (caller free)
+  const char *error;          // NULL nếu thành công
+} CsvImportResult;
+
+int csv_import_from_socket(int socket_fd, long size, CsvTarget target, int target_id,
+                           int order_base, int report_progress, CsvImportResult *result);
+int csv_import_from_file(const char *path, CsvTarget target, int target_id,
+                         int order_base, int progress_fd, CsvImportResult *result);
+
+#endif
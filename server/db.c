@@ -1,5 +1,6 @@
 #include "db.h"
 #include "practice.h"
+#include "audit.h"
 
 extern sqlite3 *db;
 extern ServerData server_data;
@@ -20,6 +21,11 @@ void init_database() {
     return;
   }
 
+  // WAL + busy timeout: cho phép các connection phụ (worker/scheduler) ghi song song
+  // mà không làm các lệnh trên connection chính thất bại với SQLITE_BUSY
+  sqlite3_busy_timeout(db, DB_BUSY_TIMEOUT_MS);
+  sqlite3_exec(db, "PRAGMA journal_mode=WAL;", NULL, NULL, NULL);
+
   const char *sql_users = "CREATE TABLE IF NOT EXISTS users("
                     "id INTEGER PRIMARY KEY,"
                     "username TEXT UNIQUE,"
@@ -216,6 +222,33 @@ void init_database() {
     err_msg = NULL;
   }
 
+  // Index theo room để nạp ngân hàng câu hỏi / reset is_selected không quét toàn bảng
+  const char *sql_index_exam_questions =
+    "CREATE INDEX IF NOT EXISTS idx_exam_questions_room ON exam_questions(room_id, is_selected);";
+  sqlite3_exec(db, sql_index_exam_questions, 0, 0, &err_msg);
+  if (err_msg) {
+    sqlite3_free(err_msg);
+    err_msg = NULL;
+  }
+
+  // Index theo room để EXPORT_RESULTS đọc kết quả một phòng theo thứ tự id
+  const char *sql_index_results_room =
+    "CREATE INDEX IF NOT EXISTS idx_results_room ON results(room_id, id);";
+  sqlite3_exec(db, sql_index_results_room, 0, 0, &err_msg);
+  if (err_msg) {
+    sqlite3_free(err_msg);
+    err_msg = NULL;
+  }
+
+  // Index theo room để job xoá phòng xoá exam_answers theo lô không quét toàn bảng
+  const char *sql_index_exam_answers_room =
+    "CREATE INDEX IF NOT EXISTS idx_exam_answers_room ON exam_answers(room_id);";
+  sqlite3_exec(db, sql_index_exam_answers_room, 0, 0, &err_msg);
+  if (err_msg) {
+    sqlite3_free(err_msg);
+    err_msg = NULL;
+  }
+
   // Thêm cột has_taken_exam vào participants
   const char *sql_alter_participants = 
     "ALTER TABLE participants ADD COLUMN has_taken_exam INTEGER DEFAULT 0;";
@@ -277,19 +310,55 @@ void init_database() {
 /*
  * Ghi log hoạt động người dùng vào bảng activity_log
  * để phục vụ audit và thống kê sau này.
+ * Chỉ đẩy vào hàng đợi audit; writer thread ghi xuống DB theo lô (xem audit.c).
  */
 void log_activity(int user_id, const char *action, const char *details) {
-  char query[500];
-  char *err_msg = 0;
+  audit_log_activity(user_id, action, details);
+}
 
-  snprintf(query, sizeof(query),
-           "INSERT INTO activity_log (user_id, action, details) VALUES (%d, '%s', '%s');",
-           user_id, action, details);
+/*
+ * Mở một connection SQLite riêng cho thread nền (scheduler, worker...):
+ *  - Dùng transaction riêng, không trộn với các lệnh trên connection chính
+ *  - Trả về NULL nếu lỗi.
+ */
+sqlite3 *db_open_worker_connection(void) {
+  sqlite3 *conn = NULL;
+  if (sqlite3_open("quiz_app.db", &conn) != SQLITE_OK) {
+    fprintf(stderr, "Cannot open worker connection: %s\n", sqlite3_errmsg(conn));
+    sqlite3_close(conn);
+    return NULL;
+  }
+  sqlite3_busy_timeout(conn, DB_BUSY_TIMEOUT_MS);
+  return conn;
+}
 
-  if (sqlite3_exec(db, query, 0, 0, &err_msg) != SQLITE_OK) {
-    fprintf(stderr, "SQL error: %s\n", err_msg);
-    sqlite3_free(err_msg);
+/*
+ * Connection chỉ đọc dùng lại trong suốt thread client (một thread mỗi kết nối):
+ *  - Mở lần đầu khi thread cần, đóng tự động khi thread kết thúc
+ *  - Caller KHÔNG sqlite3_close; trả về NULL nếu không mở được.
+ */
+static pthread_key_t read_conn_key;
+static pthread_once_t read_conn_once = PTHREAD_ONCE_INIT;
+
+static void close_read_connection(void *conn) {
+  sqlite3_close((sqlite3 *)conn);
+}
+
+static void create_read_conn_key(void) {
+  pthread_key_create(&read_conn_key, close_read_connection);
+}
+
+sqlite3 *db_thread_read_connection(void) {
+  pthread_once(&read_conn_once, create_read_conn_key);
+  sqlite3 *conn = pthread_getspecific(read_conn_key);
+  if (conn) return conn;
+
+  conn = db_open_worker_connection();
+  if (conn && pthread_setspecific(read_conn_key, conn) != 0) {
+    sqlite3_close(conn);
+    return NULL;
   }
+  return conn;
 }
 
 /*
@@ -320,7 +389,6 @@ void load_users_from_db(void) {
       server_data.users[idx].is_online = 0;
       server_data.users[idx].socket_fd = -1;
       memset(server_data.users[idx].session_token, 0, sizeof(server_data.users[idx].session_token));
-      server_data.users[idx].last_activity = 0;
       
       server_data.user_count++;
     }
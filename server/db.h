@@ -3,8 +3,12 @@
 
 #include "common.h"
 
+#define DB_BUSY_TIMEOUT_MS 5000
+
 void init_database(void);
 void load_users_from_db(void);
 void log_activity(int user_id, const char *action, const char *details);
+sqlite3 *db_open_worker_connection(void);
+sqlite3 *db_thread_read_connection(void);
 
 #endif
@@ -0,0 +1,218 @@
+#include "export.h"
+#include "admin.h"
+#include "db.h"
+#include <sys/socket.h>
+
+/*
+ * Xuất dữ liệu hàng loạt dạng CSV (RFC 4180), stream thẳng từ cursor SQLite:
+ *   EXPORT_BEGIN|kind|room_id|csv
+ *   EXPORT_CHUNK|<n>\n<n byte CSV>      (lặp lại, n <= EXPORT_CHUNK_SIZE)
+ *   EXPORT_END|<rows>                   hoặc EXPORT_FAIL|reason nếu lỗi giữa chừng
+ * Field CSV có thể chứa xuống dòng nên dữ liệu được đóng khung theo độ dài,
+ * client chỉ cần nối các chunk lại. Mỗi lần export chỉ giữ một buffer chunk
+ * và một dòng của cursor, đọc trên connection riêng (snapshot WAL) nên không
+ * chặn các thao tác ghi khác.
+ * File câu hỏi dùng đúng định dạng của IMPORT_CSV để có thể import lại.
+ */
+
+typedef struct {
+  int socket_fd;
+  int error;
+  size_t len;
+  size_t total;
+  char buf[EXPORT_CHUNK_SIZE];
+} ExportStream;
+
+static int send_all(int socket_fd, const char *data, size_t len) {
+  size_t off = 0;
+  while (off < len) {
+    ssize_t n = send(socket_fd, data + off, len - off, MSG_NOSIGNAL);
+    if (n <= 0) return -1;
+    off += (size_t)n;
+  }
+  return 0;
+}
+
+static void export_flush(ExportStream *es) {
+  if (es->error || es->len == 0) return;
+  char header[32];
+  int hlen = snprintf(header, sizeof(header), "EXPORT_CHUNK|%zu\n", es->len);
+  if (send_all(es->socket_fd, header, (size_t)hlen) != 0 ||
+      send_all(es->socket_fd, es->buf, es->len) != 0) {
+    es->error = 1;
+  }
+  es->total += es->len;
+  es->len = 0;
+}
+
+static void export_putc(ExportStream *es, char c) {
+  if (es->len == sizeof(es->buf)) export_flush(es);
+  es->buf[es->len++] = c;
+}
+
+static void export_write(ExportStream *es, const char *s) {
+  while (*s) export_putc(es, *s++);
+}
+
+// Ghi một field, thêm ngoặc kép khi chứa dấu phẩy, ngoặc kép hoặc xuống dòng
+static void export_field(ExportStream *es, const char *value, int first) {
+  if (!first) export_putc(es, ',');
+  if (!value) return;
+  if (!strpbrk(value, ",\"\r\n")) {
+    export_write(es, value);
+    return;
+  }
+  export_putc(es, '"');
+  for (const char *p = value; *p; p++) {
+    if (*p == '"') export_putc(es, '"');
+    export_putc(es, *p);
+  }
+  export_putc(es, '"');
+}
+
+static void export_int(ExportStream *es, int value, int first) {
+  char num[16];
+  snprintf(num, sizeof(num), "%d", value);
+  export_field(es, num, first);
+}
+
+/*
+ * Kiểm tra quyền: chủ phòng (rooms.host_id) hoặc admin; room_id = 0 (mọi phòng) chỉ admin.
+ * Trả NULL nếu được phép, ngược lại là lý do từ chối.
+ */
+static const char *check_export_access(sqlite3 *conn, int user_id, int room_id) {
+  if (room_id < 0) return "Invalid room";
+  int is_admin = is_admin_user(user_id);
+  if (room_id == 0) return is_admin ? NULL : "Permission denied";
+
+  sqlite3_stmt *stmt;
+  int host_id = -1;
+  if (sqlite3_prepare_v2(conn, "SELECT host_id FROM rooms WHERE id = ?", -1, &stmt, NULL) != SQLITE_OK)
+    return "Database error";
+  sqlite3_bind_int(stmt, 1, room_id);
+  if (sqlite3_step(stmt) == SQLITE_ROW) host_id = sqlite3_column_int(stmt, 0);
+  sqlite3_finalize(stmt);
+
+  if (host_id < 0) return "Room not found";
+  if (host_id != user_id && !is_admin) return "Permission denied";
+  return NULL;
+}
+
+typedef void (*ExportRowWriter)(ExportStream *es, sqlite3_stmt *stmt);
+
+static void write_question_row(ExportStream *es, sqlite3_stmt *stmt) {
+  for (int col = 0; col < 5; col++)
+    export_field(es, (const char *)sqlite3_column_text(stmt, col), col == 0);
+  export_int(es, sqlite3_column_int(stmt, 5), 0);
+  export_field(es, (const char *)sqlite3_column_text(stmt, 6), 0);
+  export_field(es, (const char *)sqlite3_column_text(stmt, 7), 0);
+}
+
+static void write_result_row(ExportStream *es, sqlite3_stmt *stmt) {
+  export_int(es, sqlite3_column_int(stmt, 0), 1);
+  export_int(es, sqlite3_column_int(stmt, 1), 0);
+  export_field(es, (const char *)sqlite3_column_text(stmt, 2), 0);
+  export_int(es, sqlite3_column_int(stmt, 3), 0);
+  export_field(es, (const char *)sqlite3_column_text(stmt, 4), 0);
+  export_int(es, sqlite3_column_int(stmt, 5), 0);
+  export_int(es, sqlite3_column_int(stmt, 6), 0);
+  export_int(es, sqlite3_column_int(stmt, 7), 0);
+  export_field(es, (const char *)sqlite3_column_text(stmt, 8), 0);
+}
+
+static void run_export(int socket_fd, int user_id, int room_id, const char *kind,
+                       const char *header, const char *sql_room, const char *sql_all,
+                       ExportRowWriter write_row) {
+  char response[160];
+  sqlite3 *conn = db_open_worker_connection();
+  if (!conn) {
+    server_send(socket_fd, "EXPORT_FAIL|Database error\n");
+    return;
+  }
+
+  const char *error = check_export_access(conn, user_id, room_id);
+  sqlite3_stmt *stmt = NULL;
+  // Hai câu SQL riêng để lọc theo phòng vẫn dùng được index room_id
+  if (!error && sqlite3_prepare_v2(conn, room_id ? sql_room : sql_all, -1, &stmt, NULL) != SQLITE_OK)
+    error = "Database error";
+  if (error) {
+    snprintf(response, sizeof(response), "EXPORT_FAIL|%s\n", error);
+    server_send(socket_fd, response);
+    sqlite3_close(conn);
+    return;
+  }
+  if (room_id) sqlite3_bind_int(stmt, 1, room_id);
+
+  snprintf(response, sizeof(response), "EXPORT_BEGIN|%s|%d|csv\n", kind, room_id);
+  server_send(socket_fd, response);
+
+  ExportStream *es = malloc(sizeof(ExportStream));
+  if (!es) {
+    server_send(socket_fd, "EXPORT_FAIL|Out of memory\n");
+    sqlite3_finalize(stmt);
+    sqlite3_close(conn);
+    return;
+  }
+  es->socket_fd = socket_fd;
+  es->error = 0;
+  es->len = 0;
+  es->total = 0;
+
+  export_write(es, header);
+  int rows = 0;
+  int rc;
+  while (!es->error && (rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+    write_row(es, stmt);
+    export_write(es, "\r\n");
+    rows++;
+  }
+  export_flush(es);
+
+  if (!es->error) {
+    if (rc == SQLITE_DONE)
+      snprintf(response, sizeof(response), "EXPORT_END|%d\n", rows);
+    else
+      snprintf(response, sizeof(response), "EXPORT_FAIL|Database error\n");
+    server_send(socket_fd, response);
+  }
+  printf("[EXPORT] %s room=%d user=%d: %d rows, %zu bytes%s\n", kind, room_id, user_id,
+         rows, es->total, es->error ? " (client disconnected)" : "");
+
+  free(es);
+  sqlite3_finalize(stmt);
+  sqlite3_close(conn);
+}
+
+/*
+ * EXPORT_QUESTIONS|room_id -> ngân hàng câu hỏi của phòng, cùng định dạng với IMPORT_CSV.
+ * room_id = 0: câu hỏi của mọi phòng (chỉ admin).
+ */
+#define QUESTION_EXPORT_SELECT \
+  "SELECT question_text, option_a, option_b, option_c, option_d, correct_answer, " \
+  "difficulty, category FROM exam_questions "
+
+void handle_export_questions(int socket_fd, int user_id, int room_id) {
+  run_export(socket_fd, user_id, room_id, "questions",
+             "question,option_a,option_b,option_c,option_d,correct_answer,difficulty,category\r\n",
+             QUESTION_EXPORT_SELECT "WHERE room_id = ? ORDER BY id",
+             QUESTION_EXPORT_SELECT "ORDER BY room_id, id",
+             write_question_row);
+}
+
+/*
+ * EXPORT_RESULTS|room_id -> toàn bộ bài đã nộp của phòng.
+ * room_id = 0: kết quả của mọi phòng (chỉ admin), dùng cho báo cáo cả học kỳ.
+ */
+#define RESULT_EXPORT_SELECT \
+  "SELECT r.id, r.room_id, COALESCE(rm.name, ''), r.user_id, COALESCE(u.username, ''), " \
+  "r.score, r.total_questions, r.time_taken, r.completed_at FROM results r " \
+  "LEFT JOIN rooms rm ON rm.id = r.room_id " \
+  "LEFT JOIN users u ON u.id = r.user_id "
+
+void handle_export_results(int socket_fd, int user_id, int room_id) {
+  run_export(socket_fd, user_id, room_id, "results",
+             "result_id,room_id,room_name,user_id,username,score,total_questions,time_taken,completed_at\r\n",
+             RESULT_EXPORT_SELECT "WHERE r.room_id = ? ORDER BY r.id",
+             RESULT_EXPORT_SELECT "ORDER BY r.room_id, r.id",
+             write_result_row);
+}
@@ -0,0 +1,12 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include "common.h"
+
+// Kích thước dữ liệu CSV tối đa của một frame EXPORT_CHUNK (bộ nhớ cố định mỗi lần export)
+#define EXPORT_CHUNK_SIZE (32 * 1024)
+
+void handle_export_questions(int socket_fd, int user_id, int room_id);
+void handle_export_results(int socket_fd, int user_id, int room_id);
+
+#endif
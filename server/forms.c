@@ -0,0 +1,316 @@
+#include "forms.h"
+#include "db.h"
+
+/*
+ * Đề thi riêng cho từng thí sinh:
+ *  - Thứ tự câu hỏi và hoán vị đáp án A-D được sinh tất định từ seed (room, user)
+ *    nên có thể tính lại bất cứ lúc nào (sau restart, thí sinh vào muộn...)
+ *  - Khi phòng bắt đầu, worker thread sinh sẵn đề cho mọi thí sinh trên connection riêng,
+ *    START_ROOM không phải chờ
+ *  - Mỗi đề lưu gọn: 2 byte/câu cho thứ tự + 1 byte/câu cho hoán vị đáp án
+ *    (4 chỉ số 2 bit: options[i] >> (2*d) & 3 = đáp án gốc hiển thị ở vị trí d)
+ *  - Đáp án lưu trong RAM/DB luôn theo thứ tự gốc; chỉ map khi serialize và khi nhận SAVE_ANSWER.
+ */
+
+typedef struct {
+  int user_id;
+  uint16_t *order;     // order[k] = vị trí gốc (theo id tăng dần) của câu hiển thị thứ k
+  uint8_t *options;    // hoán vị đáp án theo vị trí gốc
+} ParticipantForm;
+
+typedef struct {
+  int room_id;
+  int valid;
+  time_t last_used;
+  int n;
+  int *question_ids;   // id câu hỏi đã chọn, tăng dần
+  int form_count;
+  ParticipantForm forms[MAX_CLIENTS];
+} RoomForms;
+
+static RoomForms rooms_forms[FORMS_MAX_ROOMS];
+static pthread_mutex_t forms_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int job_queue[FORMS_QUEUE_SIZE];
+static int job_head = 0;
+static int job_count = 0;
+static pthread_mutex_t job_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t job_cond = PTHREAD_COND_INITIALIZER;
+
+// ===== SINH ĐỀ TẤT ĐỊNH =====
+
+static uint64_t splitmix64(uint64_t *state) {
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+static uint64_t form_seed(int room_id, int user_id) {
+  return ((uint64_t)(uint32_t)room_id << 32) | (uint32_t)user_id;
+}
+
+// Hoán vị đáp án của một câu chỉ phụ thuộc (room, user, question_id)
+static uint8_t option_permutation(int room_id, int user_id, int question_id) {
+  uint64_t state = form_seed(room_id, user_id) ^ ((uint64_t)(uint32_t)question_id * 0xD6E8FEB86659FD93ULL);
+  uint8_t perm[4] = {0, 1, 2, 3};
+  for (int i = 3; i > 0; i--) {
+    int j = (int)(splitmix64(&state) % (uint64_t)(i + 1));
+    uint8_t tmp = perm[i];
+    perm[i] = perm[j];
+    perm[j] = tmp;
+  }
+  return (uint8_t)(perm[0] | (perm[1] << 2) | (perm[2] << 4) | (perm[3] << 6));
+}
+
+static void generate_form(int room_id, int user_id, const int *question_ids, int n,
+                          uint16_t *order, uint8_t *options) {
+  uint64_t state = form_seed(room_id, user_id);
+  for (int i = 0; i < n; i++) {
+    order[i] = (uint16_t)i;
+    options[i] = option_permutation(room_id, user_id, question_ids[i]);
+  }
+  // Fisher-Yates cho thứ tự câu hỏi
+  for (int i = n - 1; i > 0; i--) {
+    int j = (int)(splitmix64(&state) % (uint64_t)(i + 1));
+    uint16_t tmp = order[i];
+    order[i] = order[j];
+    order[j] = tmp;
+  }
+}
+
+// ===== CACHE ĐỀ THEO PHÒNG (caller giữ forms_lock) =====
+
+static void room_forms_clear(RoomForms *rf) {
+  for (int i = 0; i < rf->form_count; i++) {
+    free(rf->forms[i].order);
+    free(rf->forms[i].options);
+  }
+  free(rf->question_ids);
+  memset(rf, 0, sizeof(*rf));
+}
+
+static int same_questions(const RoomForms *rf, const int *question_ids, int n) {
+  return rf->n == n && memcmp(rf->question_ids, question_ids, sizeof(int) * n) == 0;
+}
+
+// Tìm slot của phòng; nếu bộ câu hỏi đã đổi (phòng start lại) thì dựng lại slot
+static RoomForms *room_forms_get(int room_id, const int *question_ids, int n) {
+  RoomForms *slot = NULL;
+  for (int i = 0; i < FORMS_MAX_ROOMS; i++) {
+    RoomForms *rf = &rooms_forms[i];
+    if (rf->valid && rf->room_id == room_id) {
+      slot = rf;
+      break;
+    }
+    if (!slot || (slot->valid && (!rf->valid || rf->last_used < slot->last_used))) {
+      slot = rf;
+    }
+  }
+
+  if (!slot->valid || slot->room_id != room_id || !same_questions(slot, question_ids, n)) {
+    room_forms_clear(slot);
+    slot->question_ids = malloc(sizeof(int) * (n > 0 ? n : 1));
+    if (!slot->question_ids) return NULL;
+    memcpy(slot->question_ids, question_ids, sizeof(int) * n);
+    slot->room_id = room_id;
+    slot->n = n;
+    slot->valid = 1;
+  }
+  slot->last_used = time(NULL);
+  return slot;
+}
+
+static ParticipantForm *find_form(RoomForms *rf, int user_id) {
+  for (int i = 0; i < rf->form_count; i++) {
+    if (rf->forms[i].user_id == user_id) return &rf->forms[i];
+  }
+  return NULL;
+}
+
+// Đưa đề đã sinh vào cache (nhận quyền sở hữu order/options)
+static void install_form(RoomForms *rf, int user_id, uint16_t *order, uint8_t *options) {
+  if (find_form(rf, user_id) || rf->form_count >= MAX_CLIENTS) {
+    free(order);
+    free(options);
+    return;
+  }
+  ParticipantForm *f = &rf->forms[rf->form_count++];
+  f->user_id = user_id;
+  f->order = order;
+  f->options = options;
+}
+
+/*
+ * Lấy đề của thí sinh cho danh sách câu hỏi đã chọn (question_ids tăng dần):
+ *  - Dùng bản sinh sẵn nếu có, ngược lại sinh ngay (kết quả giống hệt) và lưu lại
+ *  - order/options do caller cấp phát, đủ n phần tử.
+ */
+void forms_get(int room_id, int user_id, const int *question_ids, int n,
+               uint16_t *order, uint8_t *options) {
+  pthread_mutex_lock(&forms_lock);
+  RoomForms *rf = room_forms_get(room_id, question_ids, n);
+  ParticipantForm *f = rf ? find_form(rf, user_id) : NULL;
+  if (f) {
+    memcpy(order, f->order, sizeof(uint16_t) * n);
+    memcpy(options, f->options, n);
+    pthread_mutex_unlock(&forms_lock);
+    return;
+  }
+
+  generate_form(room_id, user_id, question_ids, n, order, options);
+  if (rf) {
+    uint16_t *order_copy = malloc(sizeof(uint16_t) * (n > 0 ? n : 1));
+    uint8_t *options_copy = malloc(n > 0 ? n : 1);
+    if (order_copy && options_copy) {
+      memcpy(order_copy, order, sizeof(uint16_t) * n);
+      memcpy(options_copy, options, n);
+      install_form(rf, user_id, order_copy, options_copy);
+    } else {
+      free(order_copy);
+      free(options_copy);
+    }
+  }
+  pthread_mutex_unlock(&forms_lock);
+}
+
+/*
+ * Đổi đáp án thí sinh chọn (vị trí hiển thị 0-3) về đáp án gốc của câu hỏi.
+ */
+int forms_unmap_answer(int room_id, int user_id, int question_id, int displayed) {
+  if (displayed < 0 || displayed > 3) return displayed;
+  uint8_t perm = option_permutation(room_id, user_id, question_id);
+  return (perm >> (2 * displayed)) & 3;
+}
+
+/*
+ * Đổi đáp án gốc (đã lưu) sang vị trí hiển thị trong đề của thí sinh (dùng khi resume).
+ */
+int forms_map_answer(int room_id, int user_id, int question_id, int original) {
+  if (original < 0 || original > 3) return original;
+  uint8_t perm = option_permutation(room_id, user_id, question_id);
+  for (int d = 0; d < 4; d++) {
+    if (((perm >> (2 * d)) & 3) == original) return d;
+  }
+  return original;
+}
+
+// ===== WORKER SINH ĐỀ NỀN =====
+
+static int load_ids(sqlite3_stmt *stmt, int room_id, int **out) {
+  int capacity = 64, count = 0;
+  int *ids = malloc(sizeof(int) * capacity);
+  if (!ids) return -1;
+
+  sqlite3_bind_int(stmt, 1, room_id);
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    if (count == capacity) {
+      int *grown = realloc(ids, sizeof(int) * capacity * 2);
+      if (!grown) break;
+      ids = grown;
+      capacity *= 2;
+    }
+    ids[count++] = sqlite3_column_int(stmt, 0);
+  }
+  sqlite3_reset(stmt);
+  *out = ids;
+  return count;
+}
+
+static void prepare_room_forms(sqlite3 *conn, int room_id) {
+  sqlite3_stmt *q_stmt = NULL, *p_stmt = NULL;
+  int *question_ids = NULL, *user_ids = NULL;
+  int n = 0, users = 0, generated = 0;
+
+  if (sqlite3_prepare_v2(conn, "SELECT id FROM exam_questions WHERE room_id = ? AND is_selected = 1 ORDER BY id",
+                         -1, &q_stmt, NULL) != SQLITE_OK ||
+      sqlite3_prepare_v2(conn, "SELECT DISTINCT user_id FROM participants WHERE room_id = ?",
+                         -1, &p_stmt, NULL) != SQLITE_OK) {
+    fprintf(stderr, "[FORMS] Prepare failed: %s\n", sqlite3_errmsg(conn));
+    goto done;
+  }
+
+  n = load_ids(q_stmt, room_id, &question_ids);
+  users = load_ids(p_stmt, room_id, &user_ids);
+  if (n <= 0 || users < 0) goto done;
+
+  // Sinh đề ngoài lock, chỉ giữ forms_lock lúc đưa vào cache
+  for (int u = 0; u < users; u++) {
+    uint16_t *order = malloc(sizeof(uint16_t) * n);
+    uint8_t *options = malloc(n);
+    if (!order || !options) {
+      free(order);
+      free(options);
+      break;
+    }
+    generate_form(room_id, user_ids[u], question_ids, n, order, options);
+
+    pthread_mutex_lock(&forms_lock);
+    RoomForms *rf = room_forms_get(room_id, question_ids, n);
+    if (rf) {
+      install_form(rf, user_ids[u], order, options);
+    } else {
+      free(order);
+      free(options);
+    }
+    pthread_mutex_unlock(&forms_lock);
+    generated++;
+  }
+
+  printf("[FORMS] Prepared %d form(s) for room %d (%d questions)\n", generated, room_id, n);
+
+done:
+  free(question_ids);
+  free(user_ids);
+  sqlite3_finalize(q_stmt);
+  sqlite3_finalize(p_stmt);
+}
+
+static void *forms_worker_thread(void *arg) {
+  (void)arg;
+  sqlite3 *conn = db_open_worker_connection();
+  if (!conn) {
+    fprintf(stderr, "[FORMS] Worker disabled, forms are generated on demand\n");
+    return NULL;
+  }
+
+  while (1) {
+    pthread_mutex_lock(&job_lock);
+    while (job_count == 0) {
+      pthread_cond_wait(&job_cond, &job_lock);
+    }
+    int room_id = job_queue[job_head];
+    job_head = (job_head + 1) % FORMS_QUEUE_SIZE;
+    job_count--;
+    pthread_mutex_unlock(&job_lock);
+
+    prepare_room_forms(conn, room_id);
+  }
+  return NULL;
+}
+
+/*
+ * Yêu cầu sinh sẵn đề cho mọi thí sinh của phòng (gọi khi phòng bắt đầu, sau khi đã chốt câu hỏi).
+ * Không chặn: nếu hàng đợi đầy, đề sẽ được sinh khi thí sinh vào thi.
+ */
+void forms_prepare(int room_id) {
+  pthread_mutex_lock(&job_lock);
+  if (job_count < FORMS_QUEUE_SIZE) {
+    job_queue[(job_head + job_count) % FORMS_QUEUE_SIZE] = room_id;
+    job_count++;
+    pthread_cond_signal(&job_cond);
+  }
+  pthread_mutex_unlock(&job_lock);
+}
+
+/*
+ * Khởi động worker sinh đề. Gọi sau init_database().
+ */
+void forms_start(void) {
+  pthread_t tid;
+  if (pthread_create(&tid, NULL, forms_worker_thread, NULL) != 0) {
+    perror("Failed to create forms worker thread");
+    return;
+  }
+  pthread_detach(tid);
+}
@@ -0,0 +1,19 @@
+#ifndef FORMS_H
+#define FORMS_H
+
+#include "common.h"
+#include <stdint.h>
+
+// Số phòng đang thi có đề riêng được giữ trong bộ nhớ
+#define FORMS_MAX_ROOMS MAX_ROOMS
+// Số phòng chờ sinh đề tối đa trong hàng đợi của worker
+#define FORMS_QUEUE_SIZE 64
+
+void forms_start(void);
+void forms_prepare(int room_id);
+void forms_get(int room_id, int user_id, const int *question_ids, int n,
+               uint16_t *order, uint8_t *options);
+int forms_unmap_answer(int room_id, int user_id, int question_id, int displayed);
+int forms_map_answer(int room_id, int user_id, int question_id, int original);
+
+#endif
@@ -32,6 +32,25 @@ typedef struct
   time_t submit_time;
 } UserAnswer;
 
+// Trạng thái của một thí sinh trong phòng thi (màn hình giám sát của host)
+typedef enum
+{
+  PARTICIPANT_JOINED = 0,     // đã vào phòng, chưa bắt đầu làm bài
+  PARTICIPANT_STARTED,        // đã BEGIN_EXAM, chưa trả lời câu nào
+  PARTICIPANT_ACTIVE,         // đang làm bài (đã lưu ít nhất một đáp án)
+  PARTICIPANT_DISCONNECTED,   // mất kết nối giữa giờ thi, có thể RESUME
+  PARTICIPANT_SUBMITTED,      // đã nộp bài
+  PARTICIPANT_AUTO_SUBMITTED  // server tự nộp khi hết giờ
+} ParticipantState;
+
+typedef struct
+{
+  ParticipantState state;
+  int answered;               // số câu đã trả lời
+  time_t last_seen;           // thời điểm của sự kiện gần nhất
+  char username[50];
+} ParticipantStatus;
+
 typedef struct
 {
   int room_id;
@@ -45,6 +64,7 @@ typedef struct
   time_t end_time;
   int participants[MAX_CLIENTS];
   int participant_count;
+  ParticipantStatus status[MAX_CLIENTS];  // song song với participants[]
   UserAnswer answers[MAX_CLIENTS][MAX_QUESTIONS];
   int scores[MAX_CLIENTS];
 } TestRoom;
@@ -59,7 +79,9 @@ typedef struct
   char difficulty_filter[20];
   char category_filter[50];
   char session_token[64];
-  time_t last_activity;
+  time_t token_expires;     // hết hạn -> RESUME_SESSION bị từ chối
+  char role[20];            // role lúc LOGIN (trả lại khi RESUME_SESSION)
+  int active_room_id;       // phòng đang thi (BEGIN_EXAM/RESUME_EXAM), -1 nếu không
   int total_tests_completed;
   int total_correct_answers;
 } User;
@@ -112,5 +134,7 @@ extern sqlite3 *db;
 
 // Helper to send a text response and log it
 ssize_t server_send(int socket_fd, const char *msg);
+// Non-blocking push of a whole line; -1 if the line was dropped for this socket
+int server_push(int socket_fd, const char *msg, size_t len);
 
 #endif
@@ -0,0 +1,276 @@
+#include "jobs.h"
+#include "admin.h"
+#include "db.h"
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+extern ServerData server_data;
+
+/*
+ * Hàng đợi job nền cho các thao tác quản trị nặng (xoá phòng, import):
+ *  - Handler kiểm tra quyền, cập nhật in-memory rồi job_submit() và trả job_id ngay
+ *  - Một worker ưu tiên thấp (nice JOB_NICE) chạy lần lượt từng job trên connection
+ *    SQLite riêng; xoá dữ liệu theo lô JOB_BATCH_ROWS dòng mỗi transaction và nghỉ
+ *    JOB_YIELD_MS giữa các lô để ghi của phòng thi đang chạy không phải chờ lâu
+ *  - Client hỏi JOB_STATUS|job_id hoặc nhận push JOB_DONE|job_id|type|state|message
+ *    khi job kết thúc (gửi tới socket hiện tại của user nếu đang online).
+ * jobs_lock là lock lá, handler của job chạy ngoài lock.
+ */
+
+typedef struct {
+  int job_id;               // 0 = slot trống
+  JobType type;
+  JobState state;
+  int user_id;
+  int target_id;
+  long done;
+  long total;
+  char message[128];
+  time_t created;
+  time_t finished;
+} Job;
+
+static const char *job_type_names[JOB_TYPES] = {"delete_room", "delete_practice", "import"};
+static const char *job_state_names[] = {"queued", "running", "done", "failed"};
+
+static Job jobs[JOB_HISTORY];
+static int pending[JOB_HISTORY];        // hàng đợi FIFO chỉ số slot
+static int pending_head = 0;
+static int pending_count = 0;
+static int next_job_id = 1;
+static JobHandler handlers[JOB_TYPES];
+static pthread_mutex_t jobs_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobs_cond = PTHREAD_COND_INITIALIZER;
+
+void jobs_register(JobType type, JobHandler handler) {
+  if (type >= 0 && type < JOB_TYPES) handlers[type] = handler;
+}
+
+// Gọi khi đang giữ jobs_lock
+static Job *find_job(int job_id) {
+  if (job_id <= 0) return NULL;
+  for (int i = 0; i < JOB_HISTORY; i++) {
+    if (jobs[i].job_id == job_id) return &jobs[i];
+  }
+  return NULL;
+}
+
+/*
+ * Đưa job vào hàng đợi. Dùng slot trống hoặc ghi đè job đã xong lâu nhất.
+ * Trả job_id, -1 nếu mọi slot đều đang chờ/chạy.
+ */
+int job_submit(JobType type, int user_id, int target_id) {
+  pthread_mutex_lock(&jobs_lock);
+  int slot = -1;
+  for (int i = 0; i < JOB_HISTORY; i++) {
+    if (jobs[i].job_id == 0) {
+      slot = i;
+      break;
+    }
+    if ((jobs[i].state == JOB_DONE || jobs[i].state == JOB_FAILED) &&
+        (slot < 0 || jobs[i].finished < jobs[slot].finished)) {
+      slot = i;
+    }
+  }
+  if (slot < 0) {
+    pthread_mutex_unlock(&jobs_lock);
+    return -1;
+  }
+
+  Job *job = &jobs[slot];
+  memset(job, 0, sizeof(*job));
+  job->job_id = next_job_id++;
+  job->type = type;
+  job->state = JOB_QUEUED;
+  job->user_id = user_id;
+  job->target_id = target_id;
+  job->created = time(NULL);
+  pending[(pending_head + pending_count) % JOB_HISTORY] = slot;
+  pending_count++;
+  int job_id = job->job_id;
+  pthread_cond_signal(&jobs_cond);
+  pthread_mutex_unlock(&jobs_lock);
+
+  printf("[JOBS] Queued job %d (%s, target=%d, user=%d)\n", job_id, job_type_names[type], target_id, user_id);
+  return job_id;
+}
+
+/*
+ * Chạy handler ngay trên thread gọi với connection riêng (không có job_id,
+ * không push JOB_DONE). Dùng khi job_submit trả -1 mà thao tác đã không thể huỷ.
+ */
+int job_run_inline(JobType type, int user_id, int target_id) {
+  if (type < 0 || type >= JOB_TYPES || !handlers[type]) return -1;
+  sqlite3 *conn = db_open_worker_connection();
+  if (!conn) return -1;
+  char message[128] = "";
+  int rc = handlers[type](0, target_id, user_id, conn, message, sizeof(message));
+  sqlite3_close(conn);
+  printf("[JOBS] Ran %s inline (queue full): %s\n", job_type_names[type], message);
+  return rc;
+}
+
+void job_progress(int job_id, long done, long total) {
+  pthread_mutex_lock(&jobs_lock);
+  Job *job = find_job(job_id);
+  if (job) {
+    job->done = done;
+    job->total = total;
+  }
+  pthread_mutex_unlock(&jobs_lock);
+}
+
+void job_advance(int job_id, long rows) {
+  pthread_mutex_lock(&jobs_lock);
+  Job *job = find_job(job_id);
+  if (job) job->done += rows;
+  pthread_mutex_unlock(&jobs_lock);
+}
+
+/*
+ * Đếm số dòng thoả "<where>" (where có đúng một tham số ?), dùng làm tổng tiến độ.
+ */
+long job_count_rows(sqlite3 *conn, const char *table, const char *where, int id) {
+  char sql[256];
+  snprintf(sql, sizeof(sql), "SELECT COUNT(*) FROM %s WHERE %s", table, where);
+  sqlite3_stmt *stmt;
+  long count = 0;
+  if (sqlite3_prepare_v2(conn, sql, -1, &stmt, NULL) != SQLITE_OK) return 0;
+  sqlite3_bind_int(stmt, 1, id);
+  if (sqlite3_step(stmt) == SQLITE_ROW) count = sqlite3_column_int64(stmt, 0);
+  sqlite3_finalize(stmt);
+  return count;
+}
+
+/*
+ * Xoá các dòng thoả "<where>" theo lô JOB_BATCH_ROWS, mỗi lô một transaction
+ * (autocommit), nghỉ JOB_YIELD_MS giữa các lô. Trả số dòng đã xoá, -1 nếu lỗi.
+ */
+long job_delete_batched(int job_id, sqlite3 *conn, const char *table, const char *where, int id) {
+  char sql[384];
+  snprintf(sql, sizeof(sql), "DELETE FROM %s WHERE rowid IN (SELECT rowid FROM %s WHERE %s LIMIT %d)",
+           table, table, where, JOB_BATCH_ROWS);
+  sqlite3_stmt *stmt;
+  if (sqlite3_prepare_v2(conn, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    fprintf(stderr, "[JOBS] Prepare failed (%s): %s\n", table, sqlite3_errmsg(conn));
+    return -1;
+  }
+
+  long deleted = 0;
+  while (1) {
+    sqlite3_bind_int(stmt, 1, id);
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (rc != SQLITE_DONE) {
+      fprintf(stderr, "[JOBS] Delete failed (%s): %s\n", table, sqlite3_errmsg(conn));
+      deleted = -1;
+      break;
+    }
+    int changes = sqlite3_changes(conn);
+    deleted += changes;
+    job_advance(job_id, changes);
+    if (changes < JOB_BATCH_ROWS) break;
+    usleep(JOB_YIELD_MS * 1000);
+  }
+  sqlite3_finalize(stmt);
+  return deleted;
+}
+
+// Push JOB_DONE tới socket hiện tại của user (nếu đang online)
+static void notify_owner(int user_id, const char *message) {
+  int socket_fd = -1;
+  pthread_mutex_lock(&server_data.lock);
+  for (int i = 0; i < server_data.user_count; i++) {
+    if (server_data.users[i].user_id == user_id && server_data.users[i].is_online) {
+      socket_fd = server_data.users[i].socket_fd;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&server_data.lock);
+  if (socket_fd > 0) server_push(socket_fd, message, strlen(message));
+}
+
+static void *jobs_worker_thread(void *arg) {
+  (void)arg;
+  // Linux: nice áp dụng cho riêng thread này
+  setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), JOB_NICE);
+
+  sqlite3 *conn = db_open_worker_connection();
+  if (!conn) {
+    fprintf(stderr, "[JOBS] Worker has no database connection, jobs will fail\n");
+  }
+
+  while (1) {
+    pthread_mutex_lock(&jobs_lock);
+    while (pending_count == 0) {
+      pthread_cond_wait(&jobs_cond, &jobs_lock);
+    }
+    Job *job = &jobs[pending[pending_head]];
+    pending_head = (pending_head + 1) % JOB_HISTORY;
+    pending_count--;
+    job->state = JOB_RUNNING;
+    int job_id = job->job_id;
+    JobType type = job->type;
+    int user_id = job->user_id;
+    int target_id = job->target_id;
+    pthread_mutex_unlock(&jobs_lock);
+
+    char message[128] = "";
+    int rc = -1;
+    if (!conn)
+      snprintf(message, sizeof(message), "Database unavailable");
+    else if (!handlers[type])
+      snprintf(message, sizeof(message), "No handler");
+    else
+      rc = handlers[type](job_id, target_id, user_id, conn, message, sizeof(message));
+
+    pthread_mutex_lock(&jobs_lock);
+    // Slot không bị tái sử dụng khi job chưa xong nên con trỏ vẫn hợp lệ
+    job->state = rc == 0 ? JOB_DONE : JOB_FAILED;
+    snprintf(job->message, sizeof(job->message), "%s", message);
+    job->finished = time(NULL);
+    pthread_mutex_unlock(&jobs_lock);
+
+    printf("[JOBS] Job %d (%s) %s: %s\n", job_id, job_type_names[type],
+           job_state_names[rc == 0 ? JOB_DONE : JOB_FAILED], message);
+
+    char push[256];
+    snprintf(push, sizeof(push), "JOB_DONE|%d|%s|%s|%s\n", job_id, job_type_names[type],
+             job_state_names[rc == 0 ? JOB_DONE : JOB_FAILED], message);
+    notify_owner(user_id, push);
+  }
+  return NULL;
+}
+
+int jobs_start(void) {
+  pthread_t tid;
+  if (pthread_create(&tid, NULL, jobs_worker_thread, NULL) != 0) {
+    perror("Failed to create job worker thread");
+    return -1;
+  }
+  pthread_detach(tid);
+  return 0;
+}
+
+/*
+ * JOB_STATUS|job_id -> JOB_STATUS|id|type|state|done|total|message
+ * Chỉ người tạo job hoặc admin được xem.
+ */
+void handle_job_status(int socket_fd, int user_id, int job_id) {
+  char response[256];
+  pthread_mutex_lock(&jobs_lock);
+  Job *job = find_job(job_id);
+  Job copy;
+  if (job) copy = *job;
+  pthread_mutex_unlock(&jobs_lock);
+
+  if (!job || (copy.user_id != user_id && !is_admin_user(user_id))) {
+    server_send(socket_fd, "JOB_STATUS_FAIL|Job not found\n");
+    return;
+  }
+  snprintf(response, sizeof(response), "JOB_STATUS|%d|%s|%s|%ld|%ld|%s\n", copy.job_id,
+           job_type_names[copy.type], job_state_names[copy.state], copy.done, copy.total, copy.message);
+  server_send(socket_fd, response);
+}
@@ -0,0 +1,45 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include "common.h"
+
+// Số job được theo dõi (đang chờ, đang chạy và đã xong gần đây)
+#define JOB_HISTORY 128
+// Số dòng xoá trong một transaction và thời gian nghỉ giữa hai lô (ms)
+#define JOB_BATCH_ROWS 2000
+#define JOB_YIELD_MS 10
+// Mức nice của worker (ưu tiên thấp hơn các thread phục vụ client)
+#define JOB_NICE 10
+
+typedef enum {
+  JOB_DELETE_ROOM = 0,        // target = room_id: dữ liệu con của phòng thi đã xoá
+  JOB_DELETE_PRACTICE,        // target = practice_id: dữ liệu con của phòng luyện tập đã xoá
+  JOB_IMPORT_UPLOAD,          // target = upload_id: import file đã upload (UPLOAD_COMMIT async)
+  JOB_TYPES
+} JobType;
+
+typedef enum {
+  JOB_QUEUED = 0,
+  JOB_RUNNING,
+  JOB_DONE,
+  JOB_FAILED
+} JobState;
+
+// Handler chạy trên worker (không giữ lock nào); conn là connection riêng của worker.
+// Ghi kết quả ngắn vào message, trả 0 nếu thành công, -1 nếu lỗi.
+typedef int (*JobHandler)(int job_id, int target_id, int user_id, sqlite3 *conn,
+                          char *message, size_t message_size);
+
+void jobs_register(JobType type, JobHandler handler);
+int jobs_start(void);
+int job_submit(JobType type, int user_id, int target_id);
+int job_run_inline(JobType type, int user_id, int target_id);
+void job_progress(int job_id, long done, long total);
+void job_advance(int job_id, long rows);
+
+long job_count_rows(sqlite3 *conn, const char *table, const char *where, int id);
+long job_delete_batched(int job_id, sqlite3 *conn, const char *table, const char *where, int id);
+
+void handle_job_status(int socket_fd, int user_id, int job_id);
+
+#endif
@@ -0,0 +1,527 @@
+#include "journal.h"
+#include "db.h"
+#include "rooms.h"
+#include "roster.h"
+#include "timer.h"
+#include "scheduler.h"
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+extern ServerData server_data;
+
+/*
+ * Journal đáp án thi (crash-safe):
+ *  - Mỗi SAVE_ANSWER được append một bản ghi cố định có CRC vào JOURNAL_FILE (O_APPEND)
+ *  - Journal thread fdatasync theo lô (group commit): client chỉ nhận SAVE_ANSWER_OK
+ *    khi bản ghi đã nằm trên đĩa, nhưng nhiều đáp án dùng chung một lần fsync
+ *  - Sau fsync, các bản ghi được ghi xuống exam_answers bất đồng bộ trong một transaction
+ *    trên connection riêng của journal thread; lô chỉ rời pending (và journal chỉ được
+ *    cắt) sau khi COMMIT thành công, lỗi thì rollback và thử lại
+ *  - Khởi động lại: replay journal vào SQLite rồi khôi phục phòng đang thi từ checkpoint mmap.
+ *
+ * Checkpoint có hai slot: mỗi lần chụp ghi vào slot không active (kèm generation và CRC),
+ * msync(MS_SYNC) rồi mới lật header. Crash giữa chừng chỉ làm hỏng slot đang ghi,
+ * khi khôi phục chọn slot có CRC hợp lệ và generation mới nhất.
+ */
+
+#define JOURNAL_MAGIC 0x4A524E4CU   /* "JRNL" */
+#define CHECKPOINT_MAGIC 0x434B5054U /* "CKPT" */
+
+typedef struct {
+  uint32_t magic;
+  int32_t user_id;
+  int32_t room_id;
+  int32_t question_id;
+  int32_t answer;
+  int32_t reserved;
+  int64_t timestamp;
+  uint32_t crc;      // CRC32 của toàn bộ các trường phía trước
+  uint32_t padding;
+} JournalRecord;
+
+// Trạng thái rút gọn của một phòng đang thi (đáp án đã nằm trong journal/SQLite)
+typedef struct {
+  int32_t room_id;
+  int32_t room_status;
+  int64_t exam_start_time;
+  int32_t time_limit;
+  int32_t num_questions;
+  int32_t participant_count;
+  int32_t participants[MAX_CLIENTS];
+} RoomCheckpoint;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t crc;          // CRC32 từ generation đến hết slot
+  uint64_t generation;
+  uint32_t room_count;
+  uint32_t reserved;
+  int64_t saved_at;
+  RoomCheckpoint rooms[MAX_ROOMS];
+} CheckpointSlot;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t active;       // slot chứa checkpoint mới nhất đã xuống đĩa
+  uint64_t generation;
+  CheckpointSlot slots[2];
+} CheckpointFile;
+
+static int journal_fd = -1;
+static JournalRecord pending[JOURNAL_MAX_PENDING];
+static int pending_count = 0;          // đã write() nhưng chưa ghi vào SQLite
+static uint64_t written_seq = 0;       // số bản ghi đã write()
+static uint64_t synced_seq = 0;        // số bản ghi đã fdatasync
+static uint64_t applied_seq = 0;       // số bản ghi đã COMMIT xuống SQLite
+static pthread_mutex_t journal_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t journal_cond = PTHREAD_COND_INITIALIZER;   // có bản ghi mới / có chỗ trống
+static pthread_cond_t durable_cond = PTHREAD_COND_INITIALIZER;   // synced_seq tăng
+
+static CheckpointFile *checkpoint = NULL;
+
+/*
+ * CRC32 (IEEE 802.3) dùng chung cho journal và các dữ liệu cần kiểm tra toàn vẹn.
+ */
+uint32_t crc32_compute(const void *data, size_t len) {
+  static uint32_t table[256];
+  static int table_ready = 0;
+  if (!table_ready) {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++) {
+        c = (c & 1) ? 0xEDB88320U ^ (c >> 1) : c >> 1;
+      }
+      table[i] = c;
+    }
+    table_ready = 1;
+  }
+
+  const unsigned char *p = data;
+  uint32_t crc = 0xFFFFFFFFU;
+  for (size_t i = 0; i < len; i++) {
+    crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return crc ^ 0xFFFFFFFFU;
+}
+
+static uint32_t record_crc(const JournalRecord *rec) {
+  return crc32_compute(rec, offsetof(JournalRecord, crc));
+}
+
+static void sleep_ms(int ms) {
+  struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+  nanosleep(&ts, NULL);
+}
+
+/*
+ * Ghi một lô bản ghi vào exam_answers (question_id thật nên không cần map index).
+ * Trả 0 khi đã COMMIT; -1 nếu có lỗi (đã rollback, không bản ghi nào được ghi).
+ */
+static int apply_records(sqlite3 *conn, const JournalRecord *records, int count) {
+  if (count == 0) return 0;
+
+  sqlite3_stmt *stmt;
+  const char *sql =
+    "INSERT OR REPLACE INTO exam_answers (user_id, room_id, question_id, selected_answer, answered_at) "
+    "VALUES (?, ?, ?, ?, ?)";
+  if (sqlite3_prepare_v2(conn, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    fprintf(stderr, "[JOURNAL] Prepare failed: %s\n", sqlite3_errmsg(conn));
+    return -1;
+  }
+
+  int ok = sqlite3_exec(conn, "BEGIN IMMEDIATE", NULL, NULL, NULL) == SQLITE_OK;
+  int in_transaction = ok;
+  for (int i = 0; ok && i < count; i++) {
+    sqlite3_bind_int(stmt, 1, records[i].user_id);
+    sqlite3_bind_int(stmt, 2, records[i].room_id);
+    sqlite3_bind_int(stmt, 3, records[i].question_id);
+    sqlite3_bind_int(stmt, 4, records[i].answer);
+    sqlite3_bind_int64(stmt, 5, records[i].timestamp);
+    ok = sqlite3_step(stmt) == SQLITE_DONE;
+    sqlite3_reset(stmt);
+  }
+  sqlite3_finalize(stmt);
+
+  if (ok) ok = sqlite3_exec(conn, "COMMIT", NULL, NULL, NULL) == SQLITE_OK;
+  if (!ok) {
+    fprintf(stderr, "[JOURNAL] Applying %d record(s) failed: %s\n", count, sqlite3_errmsg(conn));
+    if (in_transaction) sqlite3_exec(conn, "ROLLBACK", NULL, NULL, NULL);
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * Replay journal còn sót lại từ lần chạy trước vào SQLite (chạy lúc khởi động, đơn luồng).
+ * Chỉ cắt journal khi replay đã COMMIT; trả -1 nếu không replay được.
+ */
+static int replay_journal(sqlite3 *conn) {
+  struct stat st;
+  if (fstat(journal_fd, &st) < 0) return -1;
+  if (st.st_size == 0) return 0;
+
+  JournalRecord *records = malloc(st.st_size);
+  if (!records) return -1;
+
+  ssize_t n = pread(journal_fd, records, st.st_size, 0);
+  int total = n > 0 ? (int)(n / sizeof(JournalRecord)) : 0;
+  int valid = 0;
+  while (valid < total &&
+         records[valid].magic == JOURNAL_MAGIC &&
+         records[valid].crc == record_crc(&records[valid])) {
+    valid++;
+  }
+
+  int rc = -1;
+  for (int attempt = 0, delay = JOURNAL_RETRY_MIN_MS; attempt < JOURNAL_START_ATTEMPTS; attempt++, delay *= 2) {
+    if (attempt > 0) sleep_ms(delay);
+    if ((rc = apply_records(conn, records, valid)) == 0) break;
+  }
+  free(records);
+  if (rc < 0) return -1;
+  printf("[JOURNAL] Replayed %d answer(s)%s\n", valid, valid < total ? " (torn tail discarded)" : "");
+
+  // Mọi bản ghi hợp lệ đã vào SQLite -> bắt đầu journal mới
+  if (ftruncate(journal_fd, 0) < 0) {
+    perror("[JOURNAL] ftruncate");
+  }
+  fsync(journal_fd);
+  return 0;
+}
+
+/*
+ * Ghi một đáp án vào journal (chưa fsync). Trả về số thứ tự để chờ bằng journal_wait_durable(),
+ * hoặc 0 nếu journal không hoạt động. write() chỉ vào page cache nên có thể gọi trong server_data.lock.
+ */
+uint64_t journal_append(int user_id, int room_id, int question_id, int answer, time_t ts) {
+  if (journal_fd < 0) return 0;  // journal không hoạt động -> caller tự flush như cũ
+
+  JournalRecord rec;
+  memset(&rec, 0, sizeof(rec));
+  rec.magic = JOURNAL_MAGIC;
+  rec.user_id = user_id;
+  rec.room_id = room_id;
+  rec.question_id = question_id;
+  rec.answer = answer;
+  rec.timestamp = ts;
+  rec.crc = record_crc(&rec);
+
+  pthread_mutex_lock(&journal_lock);
+  // SQLite đang chậm -> chờ journal thread giải phóng bớt
+  while (pending_count == JOURNAL_MAX_PENDING) {
+    pthread_cond_wait(&durable_cond, &journal_lock);
+  }
+
+  if (write(journal_fd, &rec, sizeof(rec)) != (ssize_t)sizeof(rec)) {
+    perror("[JOURNAL] write");
+  }
+  pending[pending_count++] = rec;
+  uint64_t seq = ++written_seq;
+  pthread_cond_signal(&journal_cond);
+  pthread_mutex_unlock(&journal_lock);
+  return seq;
+}
+
+/*
+ * Chờ mọi bản ghi đã append tới lúc gọi được COMMIT vào exam_answers (dùng trước khi
+ * chấm điểm từ DB). Không giữ server_data.lock khi gọi.
+ * Trả -1 nếu journal không hoạt động: caller tự flush đáp án in-memory.
+ */
+int journal_wait_applied(void) {
+  pthread_mutex_lock(&journal_lock);
+  if (journal_fd < 0) {
+    pthread_mutex_unlock(&journal_lock);
+    return -1;
+  }
+  uint64_t seq = written_seq;
+  while (applied_seq < seq) {
+    pthread_cond_wait(&durable_cond, &journal_lock);
+  }
+  pthread_mutex_unlock(&journal_lock);
+  return 0;
+}
+
+/*
+ * Chờ tới khi bản ghi seq đã được fdatasync xuống đĩa.
+ */
+void journal_wait_durable(uint64_t seq) {
+  pthread_mutex_lock(&journal_lock);
+  while (synced_seq < seq && journal_fd >= 0) {
+    pthread_cond_wait(&durable_cond, &journal_lock);
+  }
+  pthread_mutex_unlock(&journal_lock);
+}
+
+/*
+ * Journal thread: group commit fdatasync, rồi ghi các bản ghi đã bền vững xuống SQLite
+ * trên connection riêng (arg). Lô ghi lỗi vẫn nằm đầu pending và được thử lại.
+ */
+static void *journal_thread(void *arg) {
+  sqlite3 *conn = arg;
+  JournalRecord *batch = malloc(sizeof(JournalRecord) * JOURNAL_MAX_PENDING);
+  if (!batch) return NULL;
+  int retry_ms = 0;
+
+  while (1) {
+    pthread_mutex_lock(&journal_lock);
+    while (synced_seq == written_seq && pending_count == 0) {
+      pthread_cond_wait(&journal_cond, &journal_lock);
+    }
+    uint64_t target = written_seq;
+    int need_sync = synced_seq != target;
+    pthread_mutex_unlock(&journal_lock);
+
+    // fdatasync ngoài lock: appender vẫn ghi tiếp được, lần sync sau sẽ gom chúng
+    if (need_sync && fdatasync(journal_fd) < 0) {
+      perror("[JOURNAL] fdatasync");
+    }
+
+    pthread_mutex_lock(&journal_lock);
+    synced_seq = target;
+    // Chỉ các bản ghi đã bền vững mới được đưa xuống SQLite
+    int count = pending_count - (int)(written_seq - target);
+    memcpy(batch, pending, sizeof(JournalRecord) * count);
+    pthread_cond_broadcast(&durable_cond);
+    pthread_mutex_unlock(&journal_lock);
+
+    if (apply_records(conn, batch, count) < 0) {
+      // Giữ lô trong pending (vẫn có trong journal) và thử lại sau
+      retry_ms = retry_ms ? retry_ms * 2 : JOURNAL_RETRY_MIN_MS;
+      if (retry_ms > JOURNAL_RETRY_MAX_MS) retry_ms = JOURNAL_RETRY_MAX_MS;
+      sleep_ms(retry_ms);
+      continue;
+    }
+    retry_ms = 0;
+
+    pthread_mutex_lock(&journal_lock);
+    memmove(pending, pending + count, sizeof(JournalRecord) * (pending_count - count));
+    pending_count -= count;
+    applied_seq = written_seq - pending_count;
+
+    // Mọi bản ghi đã vào SQLite -> có thể cắt journal (appender đang bị chặn bởi lock)
+    struct stat st;
+    if (pending_count == 0 && fstat(journal_fd, &st) == 0 && st.st_size > JOURNAL_COMPACT_BYTES) {
+      if (ftruncate(journal_fd, 0) < 0) {
+        perror("[JOURNAL] ftruncate");
+      }
+    }
+    pthread_cond_broadcast(&durable_cond);
+    pthread_mutex_unlock(&journal_lock);
+  }
+  return NULL;
+}
+
+/*
+ * Mở journal, replay phần còn sót từ lần chạy trước vào SQLite và khởi động journal thread.
+ * Gọi sau init_database() và trước khi nhận kết nối.
+ * Journal cần connection riêng (transaction của nó không được xen với connection chính):
+ * không mở được hoặc replay lỗi -> tắt journal, giữ nguyên file cho lần khởi động sau,
+ * SAVE_ANSWER quay về flush trực tiếp.
+ */
+void journal_start(void) {
+  journal_fd = open(JOURNAL_FILE, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+  if (journal_fd < 0) {
+    perror("[JOURNAL] open");
+    return;
+  }
+
+  sqlite3 *conn = NULL;
+  for (int attempt = 0, delay = JOURNAL_RETRY_MIN_MS; !conn && attempt < JOURNAL_START_ATTEMPTS; attempt++, delay *= 2) {
+    if (attempt > 0) sleep_ms(delay);
+    conn = db_open_worker_connection();
+  }
+  if (!conn || replay_journal(conn) < 0) {
+    fprintf(stderr, "[JOURNAL] %s, journal disabled\n",
+            conn ? "Replay failed" : "Cannot open journal connection");
+    if (conn) sqlite3_close(conn);
+    close(journal_fd);
+    journal_fd = -1;
+    return;
+  }
+
+  pthread_t tid;
+  if (pthread_create(&tid, NULL, journal_thread, conn) != 0) {
+    perror("Failed to create journal thread");
+    sqlite3_close(conn);
+    close(journal_fd);
+    journal_fd = -1;
+    return;
+  }
+  pthread_detach(tid);
+}
+
+static uint32_t checkpoint_slot_crc(const CheckpointSlot *slot) {
+  size_t start = offsetof(CheckpointSlot, generation);
+  return crc32_compute((const char *)slot + start, sizeof(CheckpointSlot) - start);
+}
+
+// Slot hợp lệ có generation lớn nhất, NULL nếu cả hai đều hỏng/trống
+static const CheckpointSlot *latest_checkpoint_slot(const CheckpointFile *file) {
+  const CheckpointSlot *best = NULL;
+  for (int s = 0; s < 2; s++) {
+    const CheckpointSlot *slot = &file->slots[s];
+    if (slot->magic != CHECKPOINT_MAGIC || slot->crc != checkpoint_slot_crc(slot)) continue;
+    if (!best || slot->generation > best->generation) best = slot;
+  }
+  return best;
+}
+
+// Map file checkpoint (tạo mới nếu chưa có)
+static CheckpointFile *map_checkpoint(void) {
+  int fd = open(CHECKPOINT_FILE, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    perror("[CHECKPOINT] open");
+    return NULL;
+  }
+  if (ftruncate(fd, sizeof(CheckpointFile)) < 0) {
+    perror("[CHECKPOINT] ftruncate");
+    close(fd);
+    return NULL;
+  }
+  void *addr = mmap(NULL, sizeof(CheckpointFile), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    perror("[CHECKPOINT] mmap");
+    return NULL;
+  }
+  return (CheckpointFile *)addr;
+}
+
+/*
+ * Khôi phục các phòng đang STARTED từ checkpoint của lần chạy trước:
+ *  - Trạng thái, thời điểm bắt đầu và danh sách participant
+ *  - Đáp án được nạp lại từ SQLite (journal đã replay xong), trạng thái thí sinh
+ *    cho màn hình giám sát dựng lại từ đó (roster_restore)
+ *  - Lên lịch lại deadline; phòng đã quá hạn sẽ được kết thúc ngay khi scheduler chạy.
+ * Gọi sau load_rooms_from_db() và journal_start().
+ */
+void checkpoint_restore(void) {
+  checkpoint = map_checkpoint();
+  if (!checkpoint) return;
+  const CheckpointSlot *latest = latest_checkpoint_slot(checkpoint);
+
+  // Header lấy theo slot thật sự hợp lệ; lần chụp kế tiếp ghi đè slot còn lại
+  checkpoint->magic = CHECKPOINT_MAGIC;
+  checkpoint->active = latest ? (uint32_t)(latest - checkpoint->slots) : 0;
+  checkpoint->generation = latest ? latest->generation : 0;
+  if (!latest) return;
+
+  int restored_ids[MAX_ROOMS];
+  int restored_count = 0;
+
+  pthread_mutex_lock(&server_data.lock);
+  for (uint32_t c = 0; c < latest->room_count && c < MAX_ROOMS; c++) {
+    const RoomCheckpoint *saved = &latest->rooms[c];
+    if (saved->room_status != 1) continue;
+
+    for (int i = 0; i < server_data.room_count; i++) {
+      TestRoom *room = &server_data.rooms[i];
+      if (room->room_id != saved->room_id) continue;
+
+      room->room_status = 1;
+      room->exam_start_time = saved->exam_start_time;
+      room->time_limit = saved->time_limit;
+      room->num_questions = saved->num_questions;
+      room->participant_count = saved->participant_count < MAX_CLIENTS ? saved->participant_count : MAX_CLIENTS;
+      memcpy(room->participants, saved->participants, sizeof(int) * room->participant_count);
+      restored_ids[restored_count++] = room->room_id;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&server_data.lock);
+
+  for (int r = 0; r < restored_count; r++) {
+    int room_id = restored_ids[r];
+    int participants[MAX_CLIENTS];
+    int count = 0;
+    time_t start_time = 0;
+    int time_limit = 0;
+
+    pthread_mutex_lock(&server_data.lock);
+    for (int i = 0; i < server_data.room_count; i++) {
+      TestRoom *room = &server_data.rooms[i];
+      if (room->room_id == room_id) {
+        count = room->participant_count;
+        memcpy(participants, room->participants, sizeof(int) * count);
+        start_time = room->exam_start_time;
+        time_limit = room->time_limit;
+        break;
+      }
+    }
+    pthread_mutex_unlock(&server_data.lock);
+
+    for (int p = 0; p < count; p++) {
+      load_room_answers(room_id, participants[p]);
+    }
+
+    pthread_mutex_lock(&server_data.lock);
+    for (int i = 0; i < server_data.room_count; i++) {
+      if (server_data.rooms[i].room_id == room_id) {
+        roster_restore(&server_data.rooms[i]);
+        break;
+      }
+    }
+    pthread_mutex_unlock(&server_data.lock);
+    timer_schedule_room(room_id, start_time, time_limit);
+    timer_schedule_room_ticks(room_id);
+    printf("[CHECKPOINT] Restored running room %d (%d participants)\n", room_id, count);
+  }
+}
+
+/*
+ * Yêu cầu chụp checkpoint ngay (ví dụ vừa START_ROOM) thay vì chờ chu kỳ kế tiếp.
+ */
+void checkpoint_request(void) {
+  scheduler_add(SCHED_CHECKPOINT, 0, 0, time(NULL));
+}
+
+/*
+ * Handler của scheduler: chụp trạng thái phòng thi vào slot không active của checkpoint mmap,
+ * đồng bộ xuống đĩa rồi mới lật header; sau đó hẹn lần kế tiếp.
+ */
+void on_checkpoint(int unused, int unused2) {
+  (void)unused;
+  (void)unused2;
+
+  if (checkpoint) {
+    CheckpointSlot *slot = &checkpoint->slots[checkpoint->active ^ 1];
+    pthread_mutex_lock(&server_data.lock);
+    uint32_t count = 0;
+    for (int i = 0; i < server_data.room_count && count < MAX_ROOMS; i++) {
+      TestRoom *room = &server_data.rooms[i];
+      if (room->room_status != 1) continue;
+
+      RoomCheckpoint *saved = &slot->rooms[count++];
+      saved->room_id = room->room_id;
+      saved->room_status = room->room_status;
+      saved->exam_start_time = room->exam_start_time;
+      saved->time_limit = room->time_limit;
+      saved->num_questions = room->num_questions;
+      saved->participant_count = room->participant_count;
+      memcpy(saved->participants, room->participants, sizeof(int) * room->participant_count);
+    }
+    pthread_mutex_unlock(&server_data.lock);
+    memset(&slot->rooms[count], 0, sizeof(RoomCheckpoint) * (MAX_ROOMS - count));
+    slot->room_count = count;
+    slot->reserved = 0;
+    slot->saved_at = time(NULL);
+    slot->generation = checkpoint->generation + 1;
+    slot->magic = CHECKPOINT_MAGIC;
+    slot->crc = checkpoint_slot_crc(slot);
+
+    if (msync(checkpoint, sizeof(CheckpointFile), MS_SYNC) < 0) {
+      perror("[CHECKPOINT] msync");
+    } else {
+      checkpoint->magic = CHECKPOINT_MAGIC;
+      checkpoint->generation = slot->generation;
+      checkpoint->active ^= 1;
+      msync(checkpoint, offsetof(CheckpointFile, slots), MS_ASYNC);
+    }
+  }
+
+  scheduler_add(SCHED_CHECKPOINT, 0, 0, time(NULL) + CHECKPOINT_INTERVAL);
+}
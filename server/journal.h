@@ -0,0 +1,33 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "common.h"
+#include <stdint.h>
+
+#define JOURNAL_FILE "answers.journal"
+#define CHECKPOINT_FILE "rooms.ckpt"
+// Số bản ghi tối đa đã fsync nhưng chưa ghi xuống SQLite
+#define JOURNAL_MAX_PENDING 16384
+// Chỉ truncate journal khi đã lớn hơn ngưỡng này và mọi bản ghi đã vào SQLite
+#define JOURNAL_COMPACT_BYTES (1024 * 1024)
+// Ghi lô xuống SQLite thất bại (BUSY, lỗi COMMIT) -> giữ lô trong pending và thử lại sau
+// khoảng chờ tăng dần từ JOURNAL_RETRY_MIN_MS tới JOURNAL_RETRY_MAX_MS
+#define JOURNAL_RETRY_MIN_MS 50
+#define JOURNAL_RETRY_MAX_MS 2000
+// Số lần thử mở connection riêng / replay lúc khởi động trước khi tắt journal
+#define JOURNAL_START_ATTEMPTS 5
+// Chu kỳ chụp checkpoint trạng thái phòng thi vào file mmap (giây)
+#define CHECKPOINT_INTERVAL 5
+
+uint32_t crc32_compute(const void *data, size_t len);
+
+void journal_start(void);
+uint64_t journal_append(int user_id, int room_id, int question_id, int answer, time_t ts);
+void journal_wait_durable(uint64_t seq);
+int journal_wait_applied(void);
+
+void checkpoint_restore(void);
+void checkpoint_request(void);
+void on_checkpoint(int unused, int unused2);
+
+#endif
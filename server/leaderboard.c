@@ -0,0 +1,303 @@
+#include "leaderboard.h"
+
+extern sqlite3 *db;
+
+/*
+ * Bảng xếp hạng theo tổng điểm, duy trì tăng dần trong bộ nhớ:
+ *  - Skiplist có "span" ở mỗi con trỏ (số node bị nhảy qua) -> tra hạng/lấy theo hạng O(log n)
+ *  - Sắp theo total_score giảm dần, hoà điểm thì user_id tăng dần
+ *  - Nạp một lần lúc khởi động, cập nhật ở mỗi lần SUBMIT_TEST/auto-submit,
+ *    đăng ký user mới và ban user; truy vấn không chạm SQLite.
+ */
+
+typedef struct LbNode {
+  int user_id;
+  char username[50];
+  int total_score;
+  int tests_completed;
+  int level;
+  struct LbNode *next[LEADERBOARD_MAX_LEVEL];
+  int span[LEADERBOARD_MAX_LEVEL];
+} LbNode;
+
+static LbNode head;
+static int list_level = 1;
+static int list_length = 0;
+
+// user_id -> node (user_id là rowid SQLite nên dùng mảng mở rộng dần)
+static LbNode **by_user = NULL;
+static int by_user_capacity = 0;
+
+static pthread_mutex_t leaderboard_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// a đứng trước b trong bảng xếp hạng?
+static int ranks_before(const LbNode *a, const LbNode *b) {
+  if (a->total_score != b->total_score) return a->total_score > b->total_score;
+  return a->user_id < b->user_id;
+}
+
+static int random_level(void) {
+  int level = 1;
+  while (level < LEADERBOARD_MAX_LEVEL && (rand() & 3) == 0) {
+    level++;
+  }
+  return level;
+}
+
+static void list_insert(LbNode *node) {
+  LbNode *update[LEADERBOARD_MAX_LEVEL];
+  int rank[LEADERBOARD_MAX_LEVEL];
+  LbNode *x = &head;
+
+  for (int i = list_level - 1; i >= 0; i--) {
+    rank[i] = (i == list_level - 1) ? 0 : rank[i + 1];
+    while (x->next[i] && ranks_before(x->next[i], node)) {
+      rank[i] += x->span[i];
+      x = x->next[i];
+    }
+    update[i] = x;
+  }
+
+  int level = random_level();
+  if (level > list_level) {
+    for (int i = list_level; i < level; i++) {
+      rank[i] = 0;
+      update[i] = &head;
+      head.span[i] = list_length;
+    }
+    list_level = level;
+  }
+
+  node->level = level;
+  for (int i = 0; i < level; i++) {
+    node->next[i] = update[i]->next[i];
+    update[i]->next[i] = node;
+    node->span[i] = update[i]->span[i] - (rank[0] - rank[i]);
+    update[i]->span[i] = (rank[0] - rank[i]) + 1;
+  }
+  for (int i = level; i < list_level; i++) {
+    update[i]->span[i]++;
+  }
+  list_length++;
+}
+
+static void list_remove(LbNode *node) {
+  LbNode *update[LEADERBOARD_MAX_LEVEL];
+  LbNode *x = &head;
+
+  for (int i = list_level - 1; i >= 0; i--) {
+    while (x->next[i] && ranks_before(x->next[i], node)) {
+      x = x->next[i];
+    }
+    update[i] = x;
+  }
+
+  for (int i = 0; i < list_level; i++) {
+    if (update[i]->next[i] == node) {
+      update[i]->span[i] += node->span[i] - 1;
+      update[i]->next[i] = node->next[i];
+    } else {
+      update[i]->span[i]--;
+    }
+  }
+  while (list_level > 1 && head.next[list_level - 1] == NULL) {
+    list_level--;
+  }
+  list_length--;
+}
+
+// Hạng (1-based) của node đang nằm trong list
+static int list_rank_of(const LbNode *node) {
+  int rank = 0;
+  LbNode *x = &head;
+  for (int i = list_level - 1; i >= 0; i--) {
+    while (x->next[i] && (x->next[i] == node || ranks_before(x->next[i], node))) {
+      rank += x->span[i];
+      x = x->next[i];
+    }
+    if (x == node) return rank;
+  }
+  return 0;
+}
+
+// Node ở hạng rank (1-based), NULL nếu vượt quá
+static LbNode *list_at_rank(int rank) {
+  int traversed = 0;
+  LbNode *x = &head;
+  for (int i = list_level - 1; i >= 0; i--) {
+    while (x->next[i] && traversed + x->span[i] <= rank) {
+      traversed += x->span[i];
+      x = x->next[i];
+    }
+    if (traversed == rank) return x == &head ? NULL : x;
+  }
+  return NULL;
+}
+
+static LbNode *lookup_user(int user_id) {
+  if (user_id <= 0 || user_id >= by_user_capacity) return NULL;
+  return by_user[user_id];
+}
+
+static int index_user(int user_id, LbNode *node) {
+  if (user_id <= 0) return -1;
+  if (user_id >= by_user_capacity) {
+    int capacity = by_user_capacity ? by_user_capacity : 256;
+    while (capacity <= user_id) capacity *= 2;
+    LbNode **grown = realloc(by_user, sizeof(LbNode *) * capacity);
+    if (!grown) return -1;
+    memset(grown + by_user_capacity, 0, sizeof(LbNode *) * (capacity - by_user_capacity));
+    by_user = grown;
+    by_user_capacity = capacity;
+  }
+  by_user[user_id] = node;
+  return 0;
+}
+
+// Thêm user vào bảng xếp hạng (caller giữ leaderboard_lock)
+static void add_user_locked(int user_id, const char *username, int total_score, int tests_completed) {
+  if (lookup_user(user_id)) return;
+
+  LbNode *node = calloc(1, sizeof(LbNode));
+  if (!node) return;
+  node->user_id = user_id;
+  strncpy(node->username, username ? username : "", sizeof(node->username) - 1);
+  node->total_score = total_score;
+  node->tests_completed = tests_completed;
+
+  if (index_user(user_id, node) != 0) {
+    free(node);
+    return;
+  }
+  list_insert(node);
+}
+
+/*
+ * Nạp bảng xếp hạng từ DB (một lần lúc khởi động, sau init_database()).
+ */
+void leaderboard_seed(void) {
+  const char *sql =
+    "SELECT u.id, u.username, COALESCE(SUM(r.score), 0), COUNT(r.id) "
+    "FROM users u LEFT JOIN results r ON u.id = r.user_id "
+    "WHERE u.role != 'admin' "
+    "GROUP BY u.id;";
+
+  sqlite3_stmt *stmt;
+  if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    fprintf(stderr, "[LEADERBOARD] Seed failed: %s\n", sqlite3_errmsg(db));
+    return;
+  }
+
+  pthread_mutex_lock(&leaderboard_lock);
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    add_user_locked(sqlite3_column_int(stmt, 0),
+                    (const char *)sqlite3_column_text(stmt, 1),
+                    sqlite3_column_int(stmt, 2),
+                    sqlite3_column_int(stmt, 3));
+  }
+  int total = list_length;
+  pthread_mutex_unlock(&leaderboard_lock);
+  sqlite3_finalize(stmt);
+
+  printf("[LEADERBOARD] Loaded %d player(s)\n", total);
+}
+
+/*
+ * User mới đăng ký: vào bảng xếp hạng với 0 điểm.
+ */
+void leaderboard_add_user(int user_id, const char *username) {
+  pthread_mutex_lock(&leaderboard_lock);
+  add_user_locked(user_id, username, 0, 0);
+  pthread_mutex_unlock(&leaderboard_lock);
+}
+
+/*
+ * User bị xoá/ban: gỡ khỏi bảng xếp hạng.
+ */
+void leaderboard_remove_user(int user_id) {
+  pthread_mutex_lock(&leaderboard_lock);
+  LbNode *node = lookup_user(user_id);
+  if (node) {
+    list_remove(node);
+    by_user[user_id] = NULL;
+    free(node);
+  }
+  pthread_mutex_unlock(&leaderboard_lock);
+}
+
+/*
+ * Ghi nhận một bài thi vừa được lưu vào results (cộng điểm, +1 lượt thi, đổi vị trí).
+ */
+void leaderboard_record_result(int user_id, int score) {
+  pthread_mutex_lock(&leaderboard_lock);
+  LbNode *node = lookup_user(user_id);
+  if (node) {
+    list_remove(node);
+    node->total_score += score;
+    node->tests_completed++;
+    list_insert(node);
+  }
+  pthread_mutex_unlock(&leaderboard_lock);
+}
+
+/*
+ * Một kết quả bị xoá khỏi results (xoá phòng): trừ điểm, -1 lượt thi, đổi vị trí.
+ */
+void leaderboard_remove_result(int user_id, int score) {
+  pthread_mutex_lock(&leaderboard_lock);
+  LbNode *node = lookup_user(user_id);
+  if (node) {
+    list_remove(node);
+    node->total_score -= score;
+    if (node->tests_completed > 0) node->tests_completed--;
+    list_insert(node);
+  }
+  pthread_mutex_unlock(&leaderboard_lock);
+}
+
+static void fill_row(LeaderboardRow *row, const LbNode *node, int rank) {
+  row->rank = rank;
+  row->user_id = node->user_id;
+  strncpy(row->username, node->username, sizeof(row->username) - 1);
+  row->username[sizeof(row->username) - 1] = '\0';
+  row->total_score = node->total_score;
+  row->tests_completed = node->tests_completed;
+}
+
+/*
+ * Lấy tối đa count dòng bắt đầu từ vị trí offset (0-based) của bảng xếp hạng.
+ * Trả về số dòng đã ghi vào rows; *total = tổng số người chơi.
+ */
+int leaderboard_window(int offset, int count, LeaderboardRow *rows, int *total) {
+  if (offset < 0) offset = 0;
+
+  pthread_mutex_lock(&leaderboard_lock);
+  if (total) *total = list_length;
+
+  int filled = 0;
+  LbNode *x = list_at_rank(offset + 1);
+  while (x && filled < count) {
+    fill_row(&rows[filled], x, offset + filled + 1);
+    filled++;
+    x = x->next[0];
+  }
+  pthread_mutex_unlock(&leaderboard_lock);
+  return filled;
+}
+
+/*
+ * Hạng hiện tại của user. Trả về 0 nếu user không có trong bảng xếp hạng.
+ */
+int leaderboard_rank(int user_id, LeaderboardRow *row, int *total) {
+  pthread_mutex_lock(&leaderboard_lock);
+  if (total) *total = list_length;
+
+  int rank = 0;
+  LbNode *node = lookup_user(user_id);
+  if (node) {
+    rank = list_rank_of(node);
+    if (row) fill_row(row, node, rank);
+  }
+  pthread_mutex_unlock(&leaderboard_lock);
+  return rank;
+}
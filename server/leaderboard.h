@@ -0,0 +1,27 @@
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+#include "common.h"
+
+// Số tầng tối đa của skiplist (đủ cho ~2^16 user với p = 1/4)
+#define LEADERBOARD_MAX_LEVEL 16
+// Số dòng tối đa trả về trong một trang LEADERBOARD
+#define LEADERBOARD_MAX_PAGE 100
+
+typedef struct {
+  int rank;
+  int user_id;
+  char username[50];
+  int total_score;
+  int tests_completed;
+} LeaderboardRow;
+
+void leaderboard_seed(void);
+void leaderboard_add_user(int user_id, const char *username);
+void leaderboard_remove_user(int user_id);
+void leaderboard_record_result(int user_id, int score);
+void leaderboard_remove_result(int user_id, int score);
+int leaderboard_window(int offset, int count, LeaderboardRow *rows, int *total);
+int leaderboard_rank(int user_id, LeaderboardRow *row, int *total);
+
+#endif
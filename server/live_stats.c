@@ -0,0 +1,429 @@
+#include "live_stats.h"
+#include "network.h"
+#include "scheduler.h"
+#include <sys/socket.h>
+
+extern ServerData server_data;
+extern sqlite3 *db;
+
+/*
+ * Thống kê trực tiếp của phòng đang thi cho host:
+ *  - Mỗi phòng giữ đáp án đúng của các câu đã chọn (nạp một lần) và các bộ đếm:
+ *    số lượt trả lời / trả lời đúng theo từng câu, điểm hiện tại của từng thí sinh,
+ *    histogram điểm -> cập nhật O(1) ở mỗi SAVE_ANSWER, không chạy lại JOIN chấm điểm
+ *  - Host đăng ký bằng LIVE_SUBSCRIBE, nhận ngay snapshot đầy đủ; sau đó scheduler
+ *    đẩy LIVE_STATS tối đa mỗi LIVE_STATS_PUSH_INTERVAL giây và chỉ khi có thay đổi,
+ *    chỉ gồm các câu có bộ đếm đổi (delta). Payload render một lần cho mọi host.
+ *
+ * Format: LIVE_STATS|room_id|seq|participants:P|answered:A|hist:h0,...,h10
+ *         |top:user_id:username:score:answered,...|q:idx:question_id:answered:correct;...
+ */
+
+typedef struct {
+  int user_id;
+  char username[50];
+  int score;       // số câu đúng hiện tại
+  int answered;    // số câu đã trả lời
+} LiveParticipant;
+
+typedef struct {
+  int room_id;
+  int in_use;
+  int key_loaded;
+  int n;
+  int *question_ids;
+  int *answer_key;
+  int *answered;
+  int *correct;
+  unsigned char *changed;   // câu có thay đổi từ lần đẩy trước
+  int participant_count;
+  LiveParticipant participants[MAX_CLIENTS];
+  int histogram[LIVE_STATS_BUCKETS];
+  int dirty;
+  int push_scheduled;
+  unsigned long seq;
+  int watchers[LIVE_STATS_MAX_WATCHERS];
+  int watcher_count;
+} LiveRoom;
+
+static LiveRoom live_rooms[MAX_ROOMS];
+static pthread_mutex_t live_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int bucket_of(int score, int n) {
+  if (n <= 0) return 0;
+  int bucket = score * 10 / n;
+  return bucket < 0 ? 0 : (bucket >= LIVE_STATS_BUCKETS ? LIVE_STATS_BUCKETS - 1 : bucket);
+}
+
+static void free_key(LiveRoom *lr) {
+  free(lr->question_ids);
+  free(lr->answer_key);
+  free(lr->answered);
+  free(lr->correct);
+  free(lr->changed);
+  lr->question_ids = NULL;
+  lr->answer_key = NULL;
+  lr->answered = NULL;
+  lr->correct = NULL;
+  lr->changed = NULL;
+  lr->key_loaded = 0;
+  lr->n = 0;
+}
+
+// Xoá bộ đếm, giữ lại danh sách host đang theo dõi
+static void clear_counters(LiveRoom *lr) {
+  free_key(lr);
+  lr->participant_count = 0;
+  memset(lr->histogram, 0, sizeof(lr->histogram));
+  lr->dirty = 1;
+}
+
+static LiveRoom *find_room(int room_id) {
+  for (int i = 0; i < MAX_ROOMS; i++) {
+    if (live_rooms[i].in_use && live_rooms[i].room_id == room_id) return &live_rooms[i];
+  }
+  return NULL;
+}
+
+static LiveParticipant *find_participant(LiveRoom *lr, int user_id, int create) {
+  for (int i = 0; i < lr->participant_count; i++) {
+    if (lr->participants[i].user_id == user_id) return &lr->participants[i];
+  }
+  if (!create || lr->participant_count >= MAX_CLIENTS) return NULL;
+
+  LiveParticipant *p = &lr->participants[lr->participant_count++];
+  memset(p, 0, sizeof(*p));
+  p->user_id = user_id;
+  for (int j = 0; j < server_data.user_count; j++) {
+    if (server_data.users[j].user_id == user_id) {
+      strncpy(p->username, server_data.users[j].username, sizeof(p->username) - 1);
+      break;
+    }
+  }
+  lr->histogram[bucket_of(0, lr->n)]++;
+  return p;
+}
+
+// Áp một thay đổi đáp án vào bộ đếm (caller giữ live_lock, key đã nạp)
+static void apply_answer(LiveRoom *lr, int user_id, int q, int old_answer, int new_answer) {
+  if (q < 0 || q >= lr->n) return;
+  LiveParticipant *p = find_participant(lr, user_id, 1);
+  if (!p) return;
+
+  int key = lr->answer_key[q];
+  int was_answered = old_answer >= 0 && old_answer <= 3;
+  int is_answered = new_answer >= 0 && new_answer <= 3;
+  int was_correct = was_answered && old_answer == key;
+  int is_correct = is_answered && new_answer == key;
+
+  if (was_answered == is_answered && was_correct == is_correct) return;
+
+  lr->answered[q] += is_answered - was_answered;
+  lr->correct[q] += is_correct - was_correct;
+  p->answered += is_answered - was_answered;
+
+  int old_bucket = bucket_of(p->score, lr->n);
+  p->score += is_correct - was_correct;
+  int new_bucket = bucket_of(p->score, lr->n);
+  if (old_bucket != new_bucket) {
+    lr->histogram[old_bucket]--;
+    lr->histogram[new_bucket]++;
+  }
+
+  lr->changed[q] = 1;
+  lr->dirty = 1;
+}
+
+/*
+ * Nạp đáp án đúng của các câu đã chọn (thứ tự theo id = index đáp án in-memory)
+ * và dựng lại bộ đếm từ đáp án đang có trong RAM. Caller giữ server_data.lock và live_lock.
+ */
+static int ensure_key(LiveRoom *lr) {
+  if (lr->key_loaded) return 0;
+
+  sqlite3_stmt *stmt;
+  if (sqlite3_prepare_v2(db, "SELECT id, correct_answer FROM exam_questions "
+                             "WHERE room_id = ? AND is_selected = 1 ORDER BY id",
+                         -1, &stmt, NULL) != SQLITE_OK) {
+    return -1;
+  }
+  sqlite3_bind_int(stmt, 1, lr->room_id);
+
+  int capacity = 64, n = 0;
+  int *ids = malloc(sizeof(int) * capacity);
+  int *key = malloc(sizeof(int) * capacity);
+  while (ids && key && sqlite3_step(stmt) == SQLITE_ROW && n < MAX_QUESTIONS) {
+    if (n == capacity) {
+      capacity *= 2;
+      int *grown_ids = realloc(ids, sizeof(int) * capacity);
+      if (grown_ids) ids = grown_ids;
+      int *grown_key = realloc(key, sizeof(int) * capacity);
+      if (grown_key) key = grown_key;
+      if (!grown_ids || !grown_key) break;
+    }
+    ids[n] = sqlite3_column_int(stmt, 0);
+    key[n] = sqlite3_column_int(stmt, 1);
+    n++;
+  }
+  sqlite3_finalize(stmt);
+
+  lr->question_ids = ids;
+  lr->answer_key = key;
+  lr->answered = calloc(n > 0 ? n : 1, sizeof(int));
+  lr->correct = calloc(n > 0 ? n : 1, sizeof(int));
+  lr->changed = calloc(n > 0 ? n : 1, 1);
+  lr->n = n;
+  if (!ids || !key || !lr->answered || !lr->correct || !lr->changed) {
+    free_key(lr);
+    return -1;
+  }
+  lr->key_loaded = 1;
+  lr->participant_count = 0;
+  memset(lr->histogram, 0, sizeof(lr->histogram));
+
+  // Đáp án đã có trong RAM (vd sau khi khôi phục checkpoint)
+  for (int r = 0; r < server_data.room_count; r++) {
+    TestRoom *room = &server_data.rooms[r];
+    if (room->room_id != lr->room_id) continue;
+    for (int u = 0; u < room->participant_count; u++) {
+      for (int q = 0; q < n; q++) {
+        int answer = room->answers[u][q].answer;
+        if (answer >= 0 && answer <= 3) {
+          apply_answer(lr, room->participants[u], q, -1, answer);
+        }
+      }
+    }
+    break;
+  }
+  return 0;
+}
+
+// Lấy (hoặc cấp) slot của phòng; ưu tiên slot trống, rồi slot không có host theo dõi
+static LiveRoom *get_room(int room_id) {
+  LiveRoom *lr = find_room(room_id);
+  if (lr) return lr;
+
+  for (int pass = 0; pass < 2 && !lr; pass++) {
+    for (int i = 0; i < MAX_ROOMS; i++) {
+      if ((pass == 0 && !live_rooms[i].in_use) ||
+          (pass == 1 && live_rooms[i].watcher_count == 0 && !live_rooms[i].push_scheduled)) {
+        lr = &live_rooms[i];
+        break;
+      }
+    }
+  }
+  if (!lr) return NULL;
+
+  free_key(lr);
+  memset(lr, 0, sizeof(*lr));
+  lr->room_id = room_id;
+  lr->in_use = 1;
+  lr->dirty = 1;
+  return lr;
+}
+
+/*
+ * Ghi nhận thí sinh đổi đáp án câu question_idx từ old_answer sang new_answer
+ * (đáp án gốc, -1 = chưa trả lời). Gọi từ save_answer khi đang giữ server_data.lock,
+ * TRƯỚC khi ghi đáp án mới vào RAM (lần đầu bộ đếm được dựng từ đáp án trong RAM).
+ */
+void live_stats_record_answer(int room_id, int user_id, int question_idx, int old_answer, int new_answer) {
+  pthread_mutex_lock(&live_lock);
+  LiveRoom *lr = get_room(room_id);
+  if (lr && ensure_key(lr) == 0) {
+    apply_answer(lr, user_id, question_idx, old_answer, new_answer);
+  }
+  pthread_mutex_unlock(&live_lock);
+}
+
+/*
+ * Phòng bắt đầu lại (bộ câu hỏi mới) hoặc bị xoá: bỏ bộ đếm cũ.
+ */
+void live_stats_reset(int room_id) {
+  pthread_mutex_lock(&live_lock);
+  LiveRoom *lr = find_room(room_id);
+  if (lr) {
+    clear_counters(lr);
+  }
+  pthread_mutex_unlock(&live_lock);
+}
+
+// Render LIVE_STATS (full = tất cả câu, ngược lại chỉ câu đã đổi). Caller giữ live_lock.
+static char *render_stats(LiveRoom *lr, int full) {
+  size_t size = 512 + (size_t)LIVE_STATS_TOP_K * 80 + (size_t)lr->n * 48;
+  char *out = malloc(size);
+  if (!out) return NULL;
+
+  int answered_total = 0;
+  for (int i = 0; i < lr->participant_count; i++) {
+    answered_total += lr->participants[i].answered;
+  }
+
+  size_t len = snprintf(out, size, "LIVE_STATS|%d|%lu|participants:%d|answered:%d|hist:",
+                        lr->room_id, lr->seq, lr->participant_count, answered_total);
+  for (int b = 0; b < LIVE_STATS_BUCKETS; b++) {
+    len += snprintf(out + len, size - len, "%s%d", b ? "," : "", lr->histogram[b]);
+  }
+
+  // Top-k: chọn trực tiếp trên danh sách thí sinh (<= MAX_CLIENTS)
+  int picked[LIVE_STATS_TOP_K];
+  int picked_count = 0;
+  len += snprintf(out + len, size - len, "|top:");
+  while (picked_count < LIVE_STATS_TOP_K) {
+    int best = -1;
+    for (int i = 0; i < lr->participant_count; i++) {
+      int taken = 0;
+      for (int k = 0; k < picked_count; k++) {
+        if (picked[k] == i) taken = 1;
+      }
+      if (taken) continue;
+      LiveParticipant *p = &lr->participants[i];
+      if (best < 0 || p->score > lr->participants[best].score ||
+          (p->score == lr->participants[best].score && p->answered < lr->participants[best].answered)) {
+        best = i;
+      }
+    }
+    if (best < 0) break;
+    LiveParticipant *p = &lr->participants[best];
+    len += snprintf(out + len, size - len, "%s%d:%s:%d:%d", picked_count ? "," : "",
+                    p->user_id, p->username, p->score, p->answered);
+    picked[picked_count++] = best;
+  }
+
+  len += snprintf(out + len, size - len, "|q:");
+  int first = 1;
+  for (int q = 0; q < lr->n; q++) {
+    if (!full && !lr->changed[q]) continue;
+    len += snprintf(out + len, size - len, "%s%d:%d:%d:%d", first ? "" : ";",
+                    q, lr->question_ids[q], lr->answered[q], lr->correct[q]);
+    first = 0;
+  }
+  snprintf(out + len, size - len, "\n");
+  return out;
+}
+
+// Host không nhận trọn một delta thì số liệu của nó đã lệch: gỡ khỏi phòng, LIVE_SUBSCRIBE lại
+// để lấy snapshot mới
+static void send_to_watchers(int room_id, const int *fds, int count, const char *msg) {
+  size_t len = strlen(msg);
+  for (int i = 0; i < count; i++) {
+    if (server_push(fds[i], msg, len) != 0) live_stats_unsubscribe(fds[i], room_id);
+  }
+}
+
+/*
+ * LIVE_SUBSCRIBE|room_id: host theo dõi phòng của mình.
+ * Trả LIVE_SUBSCRIBE_OK|room_id rồi ngay một snapshot LIVE_STATS đầy đủ.
+ */
+void live_stats_subscribe(int socket_fd, int user_id, int room_id) {
+  pthread_mutex_lock(&server_data.lock);
+
+  TestRoom *room = NULL;
+  for (int i = 0; i < server_data.room_count; i++) {
+    if (server_data.rooms[i].room_id == room_id) {
+      room = &server_data.rooms[i];
+      break;
+    }
+  }
+  if (!room) {
+    pthread_mutex_unlock(&server_data.lock);
+    server_send(socket_fd, "LIVE_SUBSCRIBE_FAIL|Room not found\n");
+    return;
+  }
+  if (room->creator_id != user_id) {
+    pthread_mutex_unlock(&server_data.lock);
+    server_send(socket_fd, "LIVE_SUBSCRIBE_FAIL|Permission denied\n");
+    return;
+  }
+
+  pthread_mutex_lock(&live_lock);
+  LiveRoom *lr = get_room(room_id);
+  char *snapshot = NULL;
+  const char *error = NULL;
+  if (!lr) {
+    error = "LIVE_SUBSCRIBE_FAIL|Too many rooms\n";
+  } else {
+    int already = 0;
+    for (int i = 0; i < lr->watcher_count; i++) {
+      if (lr->watchers[i] == socket_fd) already = 1;
+    }
+    if (!already && lr->watcher_count >= LIVE_STATS_MAX_WATCHERS) {
+      error = "LIVE_SUBSCRIBE_FAIL|Too many watchers\n";
+    } else {
+      if (!already) lr->watchers[lr->watcher_count++] = socket_fd;
+      ensure_key(lr);
+      snapshot = render_stats(lr, 1);
+      if (!lr->push_scheduled) {
+        lr->push_scheduled = 1;
+        scheduler_add(SCHED_LIVE_STATS, room_id, 0, time(NULL) + LIVE_STATS_PUSH_INTERVAL);
+      }
+    }
+  }
+  pthread_mutex_unlock(&live_lock);
+  pthread_mutex_unlock(&server_data.lock);
+
+  if (error) {
+    server_send(socket_fd, error);
+    return;
+  }
+  char response[64];
+  snprintf(response, sizeof(response), "LIVE_SUBSCRIBE_OK|%d\n", room_id);
+  server_send(socket_fd, response);
+  if (snapshot) {
+    send_to_watchers(room_id, &socket_fd, 1, snapshot);
+    free(snapshot);
+  }
+}
+
+/*
+ * Bỏ theo dõi phòng (room_id <= 0: mọi phòng, dùng khi socket đóng).
+ */
+void live_stats_unsubscribe(int socket_fd, int room_id) {
+  pthread_mutex_lock(&live_lock);
+  for (int r = 0; r < MAX_ROOMS; r++) {
+    LiveRoom *lr = &live_rooms[r];
+    if (!lr->in_use || (room_id > 0 && lr->room_id != room_id)) continue;
+    for (int i = 0; i < lr->watcher_count; i++) {
+      if (lr->watchers[i] == socket_fd) {
+        lr->watchers[i] = lr->watchers[--lr->watcher_count];
+        break;
+      }
+    }
+  }
+  pthread_mutex_unlock(&live_lock);
+}
+
+/*
+ * Handler của scheduler: đẩy delta cho các host đang theo dõi phòng nếu có thay đổi,
+ * rồi hẹn lần kế tiếp. Không còn host theo dõi thì dừng.
+ */
+void on_live_stats_push(int room_id, int unused) {
+  (void)unused;
+  int fds[LIVE_STATS_MAX_WATCHERS];
+  int fd_count = 0;
+  char *delta = NULL;
+
+  pthread_mutex_lock(&live_lock);
+  LiveRoom *lr = find_room(room_id);
+  if (!lr || lr->watcher_count == 0) {
+    if (lr) lr->push_scheduled = 0;
+    pthread_mutex_unlock(&live_lock);
+    return;
+  }
+
+  if (lr->dirty) {
+    lr->seq++;
+    delta = render_stats(lr, 0);
+    if (lr->changed) memset(lr->changed, 0, lr->n);
+    lr->dirty = 0;
+  }
+  memcpy(fds, lr->watchers, sizeof(int) * lr->watcher_count);
+  fd_count = lr->watcher_count;
+  scheduler_add(SCHED_LIVE_STATS, room_id, 0, time(NULL) + LIVE_STATS_PUSH_INTERVAL);
+  pthread_mutex_unlock(&live_lock);
+
+  if (delta) {
+    send_to_watchers(room_id, fds, fd_count, delta);
+    free(delta);
+  }
+}
@@ -0,0 +1,21 @@
+#ifndef LIVE_STATS_H
+#define LIVE_STATS_H
+
+#include "common.h"
+
+// Chu kỳ tối thiểu giữa hai lần đẩy LIVE_STATS cho host (giây)
+#define LIVE_STATS_PUSH_INTERVAL 2
+// Số thí sinh dẫn đầu gửi kèm mỗi lần đẩy
+#define LIVE_STATS_TOP_K 5
+// Histogram điểm theo dải 10%: bucket 0..9 = [0%,10%)..[90%,100%), bucket 10 = 100%
+#define LIVE_STATS_BUCKETS 11
+// Số host/socket theo dõi tối đa mỗi phòng
+#define LIVE_STATS_MAX_WATCHERS 8
+
+void live_stats_record_answer(int room_id, int user_id, int question_idx, int old_answer, int new_answer);
+void live_stats_reset(int room_id);
+void live_stats_subscribe(int socket_fd, int user_id, int room_id);
+void live_stats_unsubscribe(int socket_fd, int room_id);
+void on_live_stats_push(int room_id, int unused);
+
+#endif
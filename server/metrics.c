@@ -0,0 +1,205 @@
+#include "metrics.h"
+#include "scheduler.h"
+#include "pubsub.h"
+#include <sys/socket.h>
+
+extern ServerData server_data;
+extern sqlite3 *db;
+
+/*
+ * Registry số liệu vận hành cho dashboard admin:
+ *  - Mỗi bộ đếm là một biến atomic, được cộng/trừ ngay tại nơi phát sinh sự kiện
+ *    (đăng ký, đăng nhập/đăng xuất, tạo/bắt đầu/kết thúc/xoá phòng, lưu đáp án, nộp bài)
+ *  - Chỉ đọc DB một lần khi khởi động để lấy giá trị ban đầu; ADMIN_DASHBOARD và
+ *    các lần đẩy METRICS chỉ đọc bộ đếm
+ *  - Admin đăng ký topic admin.dashboard (hoặc ADMIN_METRICS_SUBSCRIBE) nhận snapshot
+ *    mỗi METRICS_PUSH_INTERVAL giây qua pubsub.
+ */
+
+static long counters[METRIC_COUNT];
+
+// Số bài nộp trong ngày (theo giờ địa phương), tự về 0 khi sang ngày mới
+static long submissions_today = 0;
+static long submissions_day = 0;
+
+static int push_scheduled = 0;
+static long last_answers = 0;
+static time_t last_push = 0;
+static pthread_mutex_t metrics_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static long local_day(time_t t) {
+  struct tm tm_now;
+  localtime_r(&t, &tm_now);
+  return (long)(tm_now.tm_year + 1900) * 1000 + tm_now.tm_yday;
+}
+
+static long count_rows(const char *sql) {
+  sqlite3_stmt *stmt;
+  long value = 0;
+  if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) == SQLITE_OK) {
+    if (sqlite3_step(stmt) == SQLITE_ROW) value = sqlite3_column_int64(stmt, 0);
+    sqlite3_finalize(stmt);
+  }
+  return value;
+}
+
+/*
+ * Lấy giá trị ban đầu từ DB và phòng đã nạp. Gọi sau load_rooms_from_db()/checkpoint_restore().
+ */
+void metrics_init(void) {
+  pthread_mutex_lock(&server_data.lock);
+  long users = count_rows("SELECT COUNT(*) FROM users;");
+  long questions = count_rows("SELECT COUNT(*) FROM exam_questions;");
+  long tests = count_rows("SELECT COUNT(*) FROM results;");
+  long today = count_rows("SELECT COUNT(*) FROM results "
+                          "WHERE date(completed_at, 'localtime') = date('now', 'localtime');");
+  long online = 0, active = 0, running = 0;
+  for (int i = 0; i < server_data.user_count; i++) {
+    if (server_data.users[i].is_online == 1) online++;
+  }
+  for (int i = 0; i < server_data.room_count; i++) {
+    if (server_data.rooms[i].room_status != 2) active++;
+    if (server_data.rooms[i].room_status == 1) running++;
+  }
+  pthread_mutex_unlock(&server_data.lock);
+
+  __atomic_store_n(&counters[METRIC_REGISTERED_USERS], users, __ATOMIC_RELAXED);
+  __atomic_store_n(&counters[METRIC_ONLINE_USERS], online, __ATOMIC_RELAXED);
+  __atomic_store_n(&counters[METRIC_ACTIVE_ROOMS], active, __ATOMIC_RELAXED);
+  __atomic_store_n(&counters[METRIC_RUNNING_EXAMS], running, __ATOMIC_RELAXED);
+  __atomic_store_n(&counters[METRIC_QUESTIONS], questions, __ATOMIC_RELAXED);
+  __atomic_store_n(&counters[METRIC_TOTAL_TESTS], tests, __ATOMIC_RELAXED);
+  __atomic_store_n(&submissions_day, local_day(time(NULL)), __ATOMIC_RELAXED);
+  __atomic_store_n(&submissions_today, today, __ATOMIC_RELAXED);
+}
+
+void metrics_add(MetricId id, long delta) {
+  __atomic_add_fetch(&counters[id], delta, __ATOMIC_RELAXED);
+}
+
+long metrics_get(MetricId id) {
+  return __atomic_load_n(&counters[id], __ATOMIC_RELAXED);
+}
+
+// Sang ngày mới: một thread đổi ngày thành công thì đặt lại bộ đếm
+static void roll_day(void) {
+  long today = local_day(time(NULL));
+  long day = __atomic_load_n(&submissions_day, __ATOMIC_RELAXED);
+  if (day != today &&
+      __atomic_compare_exchange_n(&submissions_day, &day, today, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    __atomic_store_n(&submissions_today, 0, __ATOMIC_RELAXED);
+  }
+}
+
+/*
+ * Một bài vừa được lưu vào results.
+ */
+void metrics_record_submission(void) {
+  roll_day();
+  __atomic_add_fetch(&submissions_today, 1, __ATOMIC_RELAXED);
+  metrics_add(METRIC_TOTAL_TESTS, 1);
+}
+
+long metrics_submissions_today(void) {
+  roll_day();
+  return __atomic_load_n(&submissions_today, __ATOMIC_RELAXED);
+}
+
+/*
+ * ADMIN_DASHBOARD|Users:n|Rooms:n|Questions:n|TotalTests:n|OnlineUsers:n|RunningExams:n|SubmissionsToday:n
+ * (Rooms = số phòng đang hoạt động)
+ */
+void metrics_send_dashboard(int socket_fd) {
+  char response[400];
+  snprintf(response, sizeof(response),
+           "ADMIN_DASHBOARD|Users:%ld|Rooms:%ld|Questions:%ld|TotalTests:%ld|OnlineUsers:%ld|"
+           "RunningExams:%ld|SubmissionsToday:%ld\n",
+           metrics_get(METRIC_REGISTERED_USERS), metrics_get(METRIC_ACTIVE_ROOMS),
+           metrics_get(METRIC_QUESTIONS), metrics_get(METRIC_TOTAL_TESTS),
+           metrics_get(METRIC_ONLINE_USERS), metrics_get(METRIC_RUNNING_EXAMS),
+           metrics_submissions_today());
+  server_send(socket_fd, response);
+}
+
+// Snapshot cho lần đẩy; answers/giây tính từ chênh lệch METRIC_ANSWERS giữa hai lần. Caller giữ metrics_lock.
+static void render_snapshot(char *out, size_t size) {
+  time_t now = time(NULL);
+  long answers = metrics_get(METRIC_ANSWERS);
+  double rate = 0.0;
+  if (last_push > 0 && now > last_push) {
+    rate = (double)(answers - last_answers) / (double)(now - last_push);
+  }
+  last_answers = answers;
+  last_push = now;
+
+  snprintf(out, size,
+           "METRICS|%ld|Users:%ld|Online:%ld|ActiveRooms:%ld|RunningExams:%ld|"
+           "AnswersPerSec:%.1f|SubmissionsToday:%ld|TotalTests:%ld|Questions:%ld|"
+           "Shed:%ld|RateLimited:%ld\n",
+           (long)now, metrics_get(METRIC_REGISTERED_USERS), metrics_get(METRIC_ONLINE_USERS),
+           metrics_get(METRIC_ACTIVE_ROOMS), metrics_get(METRIC_RUNNING_EXAMS), rate,
+           metrics_submissions_today(), metrics_get(METRIC_TOTAL_TESTS),
+           metrics_get(METRIC_QUESTIONS), metrics_get(METRIC_SHED),
+           metrics_get(METRIC_RATE_LIMITED));
+}
+
+/*
+ * Gửi snapshot METRICS hiện tại cho một socket (ngay sau khi subscribe).
+ */
+void metrics_send_snapshot(int socket_fd) {
+  char snapshot[512];
+
+  pthread_mutex_lock(&metrics_lock);
+  render_snapshot(snapshot, sizeof(snapshot));
+  pthread_mutex_unlock(&metrics_lock);
+  server_send(socket_fd, snapshot);
+}
+
+/*
+ * Admin theo dõi số liệu: thêm socket vào topic admin.dashboard và bật nhịp đẩy.
+ * Caller đã kiểm tra quyền admin. Trả -1 nếu đã đủ METRICS_MAX_WATCHERS.
+ */
+int metrics_subscribe(int socket_fd) {
+  int rc = 0;
+
+  pthread_mutex_lock(&metrics_lock);
+  if (pubsub_subscriber_count(TOPIC_ADMIN_DASHBOARD) >= METRICS_MAX_WATCHERS ||
+      pubsub_subscribe(socket_fd, TOPIC_ADMIN_DASHBOARD) != 0) {
+    rc = -1;
+  } else if (!push_scheduled) {
+    push_scheduled = 1;
+    scheduler_add(SCHED_METRICS_PUSH, 0, 0, time(NULL) + METRICS_PUSH_INTERVAL);
+  }
+  pthread_mutex_unlock(&metrics_lock);
+
+  return rc;
+}
+
+/*
+ * Bỏ theo dõi (socket đóng thì pubsub_unsubscribe_all đã gỡ).
+ */
+void metrics_unsubscribe(int socket_fd) {
+  pubsub_unsubscribe(socket_fd, TOPIC_ADMIN_DASHBOARD);
+}
+
+/*
+ * Handler của scheduler: publish snapshot lên admin.dashboard rồi hẹn lần kế tiếp.
+ * Không còn ai theo dõi thì dừng.
+ */
+void on_metrics_push(int unused, int unused2) {
+  (void)unused;
+  (void)unused2;
+  char snapshot[512];
+
+  pthread_mutex_lock(&metrics_lock);
+  if (pubsub_subscriber_count(TOPIC_ADMIN_DASHBOARD) == 0) {
+    push_scheduled = 0;
+    pthread_mutex_unlock(&metrics_lock);
+    return;
+  }
+  render_snapshot(snapshot, sizeof(snapshot));
+  scheduler_add(SCHED_METRICS_PUSH, 0, 0, time(NULL) + METRICS_PUSH_INTERVAL);
+  pthread_mutex_unlock(&metrics_lock);
+
+  pubsub_publish(TOPIC_ADMIN_DASHBOARD, snapshot);
+}
@@ -0,0 +1,36 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "common.h"
+
+// Chu kỳ đẩy METRICS cho admin đang theo dõi (giây)
+#define METRICS_PUSH_INTERVAL 3
+// Số socket admin theo dõi tối đa
+#define METRICS_MAX_WATCHERS 8
+
+// Các bộ đếm của registry, cập nhật tại nơi phát sinh sự kiện
+typedef enum {
+  METRIC_REGISTERED_USERS = 0,
+  METRIC_ONLINE_USERS,
+  METRIC_ACTIVE_ROOMS,       // phòng đang chờ hoặc đang thi
+  METRIC_RUNNING_EXAMS,      // phòng đang thi
+  METRIC_QUESTIONS,          // số câu hỏi thi trong DB
+  METRIC_TOTAL_TESTS,        // số bài trong results
+  METRIC_ANSWERS,            // tổng số lần SAVE_ANSWER được chấp nhận (dùng tính answers/giây)
+  METRIC_SHED,               // lệnh ưu tiên thấp bị governor từ chối (BUSY)
+  METRIC_RATE_LIMITED,       // lệnh bị từ chối do hết token (BUSY)
+  METRIC_COUNT
+} MetricId;
+
+void metrics_init(void);
+void metrics_add(MetricId id, long delta);
+long metrics_get(MetricId id);
+void metrics_record_submission(void);
+long metrics_submissions_today(void);
+void metrics_send_dashboard(int socket_fd);
+void metrics_send_snapshot(int socket_fd);
+int metrics_subscribe(int socket_fd);
+void metrics_unsubscribe(int socket_fd);
+void on_metrics_push(int unused, int unused2);
+
+#endif
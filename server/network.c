@@ -8,6 +8,15 @@
 #include "admin.h"
 #include "timer.h"
 #include "practice.h"
+#include "live_stats.h"
+#include "analytics.h"
+#include "pager.h"
+#include "metrics.h"
+#include "pubsub.h"
+#include "export.h"
+#include "upload.h"
+#include "jobs.h"
+#include "admission.h"
 #include <sys/socket.h>
 #include <unistd.h>
 
@@ -25,6 +34,24 @@ ssize_t server_send(int socket_fd, const char *msg) {
   return send(socket_fd, msg, strlen(msg), 0);
 }
 
+/*
+ * Đẩy một dòng thông báo không chặn (MSG_DONTWAIT), dùng cho broadcast/pubsub:
+ *  - Buffer gửi đầy (EAGAIN) hoặc lỗi khi chưa ghi byte nào: bỏ dòng này cho socket đó, trả -1
+ *  - Chỉ ghi được một phần: không thể ghi tiếp mà không chặn hay chen vào dòng khác,
+ *    nên shutdown socket để không dòng nào bị nối sau phần dở dang; client thread
+ *    nhận EOF và dọn dẹp như khi mất kết nối. Trả -1.
+ * Trả 0 khi cả dòng đã vào buffer gửi.
+ */
+int server_push(int socket_fd, const char *msg, size_t len) {
+  ssize_t n = send(socket_fd, msg, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+  if (n == (ssize_t)len) return 0;
+  if (n > 0) {
+    fprintf(stderr, "[PUSH] fd=%d short write (%zd/%zu), closing slow client\n", socket_fd, n, len);
+    shutdown(socket_fd, SHUT_RDWR);
+  }
+  return -1;
+}
+
 /*
  * Luồng xử lý chính cho từng client TCP:
  *  - Nhận command dạng text ("CMD|arg1|arg2|...")
@@ -37,6 +64,8 @@ void *handle_client(void *arg)
   char buffer[BUFFER_SIZE];
   int user_id = -1;
   int current_room_id = -1; // Track room user đang thi
+  TokenBucket conn_bucket;   // Admission control theo kết nối
+  admission_conn_init(&conn_bucket);
 
   while (1)
   {
@@ -53,9 +82,9 @@ void *handle_client(void *arg)
         // auto_submit_on_disconnect(user_id, current_room_id); // DISABLED - allow resume
       }
       
-      // Cập nhật trạng thái offline khi disconnect
+      // Mất kết nối: giữ session (token còn hạn) để client RESUME_SESSION trên kết nối mới
       if (user_id > 0) {
-        logout_user(user_id, socket_fd);
+        detach_session(user_id, socket_fd);
       } else {
         logout_user(-1, socket_fd);  // Logout bằng socket_fd nếu chưa có user_id
       }
@@ -64,6 +93,19 @@ void *handle_client(void *arg)
 
     buffer[n] = '\0';
 
+    session_touch(socket_fd);
+
+    // UPLOAD_CHUNK mang payload nhị phân ngay sau dòng header -> xử lý trên dữ liệu thô
+    // (admission control chạy bên trong). recv đầu tiên có thể cắt ngang header,
+    // kể cả tên lệnh: đọc nốt tới '\n' rồi mới phân loại
+    if (strncmp(buffer, "UPLOAD_CHUNK|", n < 13 ? (size_t)n : 13) == 0 && !memchr(buffer, '\n', (size_t)n)) {
+      n = upload_recv_header(socket_fd, buffer, BUFFER_SIZE, n);
+    }
+    if (strncmp(buffer, "UPLOAD_CHUNK|", 13) == 0) {
+      handle_upload_chunk(socket_fd, user_id, &conn_bucket, buffer, n);
+      continue;
+    }
+
     // Log raw command received from client
     printf("[SERVER RECV fd=%d] %s\n", socket_fd, buffer);
 
@@ -77,6 +119,17 @@ void *handle_client(void *arg)
     if (cmd == NULL)
       continue;
 
+    // Hết token hoặc server quá tải (lệnh ưu tiên thấp): BUSY|retry_ms, client gửi lại sau
+    AdmitTicket ticket;
+    int retry_ms = admission_acquire(&conn_bucket, user_id, cmd, &ticket);
+    if (retry_ms > 0)
+    {
+      char busy[32];
+      snprintf(busy, sizeof(busy), "BUSY|%d\n", retry_ms);
+      server_send(socket_fd, busy);
+      continue;
+    }
+
     if (strcmp(cmd, "REGISTER") == 0)
     {
       char *username = strtok(NULL, "|");
@@ -89,6 +142,11 @@ void *handle_client(void *arg)
       char *password = strtok(NULL, "|");
       login_user(socket_fd, username, password, &user_id);
     }
+    else if (strcmp(cmd, "RESUME_SESSION") == 0)
+    {
+      // RESUME_SESSION|token: gắn lại kết nối mới vào session cũ, không cần LOGIN
+      resume_session(socket_fd, strtok(NULL, "|"), &user_id, &current_room_id);
+    }
     else if (strcmp(cmd, "LOGOUT") == 0)
     {
       logout_user(user_id, socket_fd);
@@ -99,7 +157,10 @@ void *handle_client(void *arg)
     }
     else if (strcmp(cmd, "LIST_ROOMS") == 0)
     {
-      list_test_rooms(socket_fd);
+      // LIST_ROOMS[|version]: version danh mục client đang giữ (nếu có)
+      char *version_str = strtok(NULL, "|");
+      unsigned long known_version = version_str ? strtoul(version_str, NULL, 10) : 0;
+      list_test_rooms(socket_fd, known_version);
     }
     else if (strcmp(cmd, "CREATE_ROOM") == 0)
     {
@@ -114,7 +175,7 @@ void *handle_client(void *arg)
       int medium_count = medium_str ? atoi(medium_str) : 0;
       int hard_count = hard_str ? atoi(hard_str) : 0;
       
-      create_test_room(socket_fd, user_id, room_name, 0, time_limit, easy_count, medium_count, hard_count);
+      create_test_room(socket_fd, user_id, room_name, time_limit, easy_count, medium_count, hard_count);
     }
     else if (strcmp(cmd, "JOIN_ROOM") == 0)
     {
@@ -123,7 +184,11 @@ void *handle_client(void *arg)
     }
     else if (strcmp(cmd, "LIST_MY_ROOMS") == 0)
     {
-      list_my_rooms(socket_fd, user_id);
+      // LIST_MY_ROOMS[|cursor|limit]
+      PageRequest page;
+      char *cursor_str = strtok(NULL, "|");
+      page_request_parse(&page, cursor_str, strtok(NULL, "|"));
+      list_my_rooms(socket_fd, user_id, page.cursor, page.limit);
     }
     else if (strcmp(cmd, "START_ROOM") == 0)
     {
@@ -134,12 +199,14 @@ void *handle_client(void *arg)
     {
       int room_id = atoi(strtok(NULL, "|"));
       current_room_id = room_id; // Track room
+      session_set_room(user_id, room_id);
       handle_begin_exam(socket_fd, user_id, room_id);
     }
     else if (strcmp(cmd, "RESUME_EXAM") == 0)
     {
       int room_id = atoi(strtok(NULL, "|"));
       current_room_id = room_id; // Track room
+      session_set_room(user_id, room_id);
       handle_resume_exam(socket_fd, user_id, room_id);
     }
     else if (strcmp(cmd, "CLOSE_ROOM") == 0)
@@ -157,10 +224,20 @@ void *handle_client(void *arg)
       int room_id = atoi(strtok(NULL, "|"));
       get_room_members(socket_fd, user_id, room_id);
     }
+    else if (strcmp(cmd, "GET_EXAM_STUDENTS") == 0)
+    {
+      // GET_EXAM_STUDENTS|room_id (host); cập nhật liên tục: SUBSCRIBE|proctor.<room_id>
+      char *room_id_str = strtok(NULL, "|");
+      get_exam_students_status(socket_fd, user_id, room_id_str ? atoi(room_id_str) : 0);
+    }
     else if (strcmp(cmd, "GET_ROOM_QUESTIONS") == 0)
     {
+      // GET_ROOM_QUESTIONS|room_id[|cursor|limit]
       int room_id = atoi(strtok(NULL, "|"));
-      get_room_questions(socket_fd, user_id, room_id);
+      PageRequest page;
+      char *cursor_str = strtok(NULL, "|");
+      page_request_parse(&page, cursor_str, strtok(NULL, "|"));
+      get_room_questions(socket_fd, user_id, room_id, page.cursor, page.limit);
     }
     else if (strstr(buffer, "GET_USER_ROOMS")) 
     {
@@ -190,27 +267,67 @@ void *handle_client(void *arg)
       int room_id = atoi(strtok(NULL, "|"));
       submit_test(socket_fd, user_id, room_id);
       current_room_id = -1; // Clear room sau khi submit
+      session_set_room(user_id, -1);
     }
     else if (strcmp(cmd, "LEADERBOARD") == 0)
     {
+      // LEADERBOARD[|limit[|offset]]
       int limit = 10;
+      int offset = 0;
       char *limit_str = strtok(NULL, "|");
+      char *offset_str = strtok(NULL, "|");
       if (limit_str)
         limit = atoi(limit_str);
-      get_leaderboard(socket_fd, limit);
+      if (offset_str)
+        offset = atoi(offset_str);
+      get_leaderboard(socket_fd, limit, offset);
+    }
+    else if (strcmp(cmd, "MY_RANK") == 0)
+    {
+      get_my_rank(socket_fd, user_id);
     }
     else if (strcmp(cmd, "USER_STATS") == 0)
     {
       get_user_statistics(socket_fd, user_id);
     }
+    else if (strcmp(cmd, "CATEGORY_STATS") == 0)
+    {
+      get_category_stats(socket_fd, user_id);
+    }
+    else if (strcmp(cmd, "DIFFICULTY_STATS") == 0)
+    {
+      get_difficulty_stats(socket_fd, user_id);
+    }
+    else if (strcmp(cmd, "ITEM_STATS") == 0)
+    {
+      char *room_str = strtok(NULL, "|");
+      analytics_send_item_stats(socket_fd, user_id, room_str ? atoi(room_str) : 0);
+    }
+    else if (strcmp(cmd, "EXPORT_QUESTIONS") == 0)
+    {
+      // EXPORT_QUESTIONS|room_id (0 = mọi phòng, chỉ admin)
+      char *room_str = strtok(NULL, "|");
+      handle_export_questions(socket_fd, user_id, room_str ? atoi(room_str) : -1);
+    }
+    else if (strcmp(cmd, "EXPORT_RESULTS") == 0)
+    {
+      // EXPORT_RESULTS|room_id (0 = mọi phòng, chỉ admin)
+      char *room_str = strtok(NULL, "|");
+      handle_export_results(socket_fd, user_id, room_str ? atoi(room_str) : -1);
+    }
     else if (strcmp(cmd, "TEST_HISTORY") == 0)
     {
-      get_user_test_history(socket_fd, user_id);
+      // TEST_HISTORY[|cursor|limit]
+      PageRequest page;
+      char *cursor_str = strtok(NULL, "|");
+      page_request_parse(&page, cursor_str, strtok(NULL, "|"));
+      get_user_test_history(socket_fd, user_id, page.cursor, page.limit);
     }
     else if (strcmp(cmd, "IMPORT_CSV") == 0)
     {
-      char *data = buffer + 11; // skip "IMPORT_CSV|"
-      handle_import_csv(socket_fd, data);
+      // Dạng cũ gửi nguyên file CSV qua socket không còn được nhận: file câu hỏi thi phải
+      // được upload (UPLOAD_BEGIN|exam_csv ... UPLOAD_COMMIT), nơi kiểm tra quyền admin
+      server_send(socket_fd, "ERROR|Upload the file with UPLOAD_BEGIN\n");
     }
     // Practice commands
     else if (strcmp(cmd, "CREATE_PRACTICE") == 0)
@@ -250,8 +367,12 @@ void *handle_client(void *arg)
     }
     else if (strcmp(cmd, "PRACTICE_PARTICIPANTS") == 0)
     {
+      // PRACTICE_PARTICIPANTS|practice_id[|cursor|limit]
       int practice_id = atoi(strtok(NULL, "|"));
-      get_practice_participants(socket_fd, user_id, practice_id);
+      PageRequest page;
+      char *cursor_str = strtok(NULL, "|");
+      page_request_parse(&page, cursor_str, strtok(NULL, "|"));
+      get_practice_participants(socket_fd, user_id, practice_id, page.cursor, page.limit);
     }
     else if (strcmp(cmd, "CREATE_PRACTICE_QUESTION") == 0)
     {
@@ -261,16 +382,52 @@ void *handle_client(void *arg)
     }
     else if (strcmp(cmd, "IMPORT_PRACTICE_CSV") == 0)
     {
-      int practice_id = atoi(strtok(NULL, "|"));
-      char *filename = strtok(NULL, "");  // Get rest of buffer (newline already stripped)
-      if (filename != NULL) {
-        // Trim any trailing whitespace/newline
-        size_t len = strlen(filename);
-        while (len > 0 && (filename[len-1] == '\n' || filename[len-1] == '\r' || filename[len-1] == ' ')) {
-          filename[--len] = '\0';
-        }
+      // IMPORT_PRACTICE_CSV|practice_id|filename|file_size (upload qua socket)
+      // Dạng cũ IMPORT_PRACTICE_CSV|practice_id|server_path không còn được nhận:
+      // file phải được upload (UPLOAD_BEGIN ... UPLOAD_COMMIT)
+      char *id_str = strtok(NULL, "|");
+      char *filename = strtok(NULL, "|");
+      char *size_str = strtok(NULL, "|");
+      long file_size = size_str ? atol(size_str) : 0;
+      if (id_str == NULL || filename == NULL || file_size <= 0) {
+        server_send(socket_fd, "IMPORT_PRACTICE_CSV_FAIL|Upload the file with UPLOAD_BEGIN\n");
+      } else {
+        import_practice_csv(socket_fd, user_id, atoi(id_str), NULL, file_size, NULL, 0);
       }
-      import_practice_csv(socket_fd, user_id, practice_id, filename);
+    }
+    else if (strcmp(cmd, "UPLOAD_BEGIN") == 0)
+    {
+      // UPLOAD_BEGIN|purpose|target_id|filename|size
+      char *purpose = strtok(NULL, "|");
+      char *target_str = strtok(NULL, "|");
+      char *filename = strtok(NULL, "|");
+      handle_upload_begin(socket_fd, user_id, purpose, target_str, filename, strtok(NULL, "|"));
+    }
+    else if (strcmp(cmd, "UPLOAD_RESUME") == 0)
+    {
+      char *id_str = strtok(NULL, "|");
+      handle_upload_resume(socket_fd, user_id, id_str ? atoi(id_str) : 0);
+    }
+    else if (strcmp(cmd, "UPLOAD_COMMIT") == 0)
+    {
+      // UPLOAD_COMMIT|upload_id[|progress[|async]]
+      char *id_str = strtok(NULL, "|");
+      char *progress_str = strtok(NULL, "|");
+      char *async_str = strtok(NULL, "|");
+      handle_upload_commit(socket_fd, user_id, id_str ? atoi(id_str) : 0,
+                           progress_str ? atoi(progress_str) == 1 : 0,
+                           async_str ? atoi(async_str) == 1 : 0);
+    }
+    else if (strcmp(cmd, "UPLOAD_ABORT") == 0)
+    {
+      char *id_str = strtok(NULL, "|");
+      handle_upload_abort(socket_fd, user_id, id_str ? atoi(id_str) : 0);
+    }
+    else if (strcmp(cmd, "JOB_STATUS") == 0)
+    {
+      // JOB_STATUS|job_id
+      char *id_str = strtok(NULL, "|");
+      handle_job_status(socket_fd, user_id, id_str ? atoi(id_str) : 0);
     }
     else if (strcmp(cmd, "SUBMIT_PRACTICE_ANSWER") == 0)
     {
@@ -307,8 +464,12 @@ void *handle_client(void *arg)
     }
     else if (strcmp(cmd, "GET_PRACTICE_QUESTIONS") == 0)
     {
+      // GET_PRACTICE_QUESTIONS|practice_id[|cursor|limit]
       int practice_id = atoi(strtok(NULL, "|"));
-      get_practice_questions(socket_fd, user_id, practice_id);
+      PageRequest page;
+      char *cursor_str = strtok(NULL, "|");
+      page_request_parse(&page, cursor_str, strtok(NULL, "|"));
+      get_practice_questions(socket_fd, user_id, practice_id, page.cursor, page.limit);
     }
     else if (strcmp(cmd, "UPDATE_PRACTICE_QUESTION") == 0)
     {
@@ -343,6 +504,46 @@ void *handle_client(void *arg)
       int selection_mode = atoi(strtok(NULL, "|"));
       set_room_selection_mode(socket_fd, user_id, room_id, selection_mode);
     }
+    else if (strcmp(cmd, "LIVE_SUBSCRIBE") == 0)
+    {
+      char *room_id_str = strtok(NULL, "|");
+      live_stats_subscribe(socket_fd, user_id, room_id_str ? atoi(room_id_str) : 0);
+    }
+    else if (strcmp(cmd, "LIVE_UNSUBSCRIBE") == 0)
+    {
+      char *room_id_str = strtok(NULL, "|");
+      live_stats_unsubscribe(socket_fd, room_id_str ? atoi(room_id_str) : 0);
+      server_send(socket_fd, "LIVE_UNSUBSCRIBE_OK\n");
+    }
+    else if (strcmp(cmd, "ADMIN_DASHBOARD") == 0)
+    {
+      get_admin_dashboard(socket_fd, user_id);
+    }
+    else if (strcmp(cmd, "ADMIN_METRICS_SUBSCRIBE") == 0)
+    {
+      if (!is_admin_user(user_id))
+        server_send(socket_fd, "ADMIN_METRICS_SUBSCRIBE_FAIL|Permission denied\n");
+      else if (metrics_subscribe(socket_fd) != 0)
+        server_send(socket_fd, "ADMIN_METRICS_SUBSCRIBE_FAIL|Too many subscribers\n");
+      else
+      {
+        server_send(socket_fd, "ADMIN_METRICS_SUBSCRIBE_OK\n");
+        metrics_send_snapshot(socket_fd);
+      }
+    }
+    else if (strcmp(cmd, "ADMIN_METRICS_UNSUBSCRIBE") == 0)
+    {
+      metrics_unsubscribe(socket_fd);
+      server_send(socket_fd, "ADMIN_METRICS_UNSUBSCRIBE_OK\n");
+    }
+    else if (strcmp(cmd, "SUBSCRIBE") == 0)
+    {
+      handle_subscribe(socket_fd, user_id, strtok(NULL, "|"));
+    }
+    else if (strcmp(cmd, "UNSUBSCRIBE") == 0)
+    {
+      handle_unsubscribe(socket_fd, strtok(NULL, "|"));
+    }
     else if (strcmp(cmd, "UPDATE_ROOM_DIFFICULTY") == 0)
     {
       int room_id = atoi(strtok(NULL, "|"));
@@ -351,8 +552,12 @@ void *handle_client(void *arg)
       int hard_count = atoi(strtok(NULL, "|"));
       update_room_difficulty(socket_fd, user_id, room_id, easy_count, medium_count, hard_count);
     }
+
+    admission_release(&ticket);
   }
 
+  live_stats_unsubscribe(socket_fd, 0);
+  pubsub_unsubscribe_all(socket_fd);
   close(socket_fd);
   free(arg);
   pthread_exit(NULL);
@@ -443,25 +648,45 @@ void broadcast_to_room_participants_except(int room_id, const char *message, int
 }
 
 /*
- * Thông báo tới toàn bộ user đang online rằng có phòng thi mới được tạo.
- * Hiện tại gửi broadcast cho tất cả online users, tương lai có thể thu hẹp
- * chỉ những người đang mở màn hình danh sách phòng.
+ * Gom socket của các thí sinh đang online trong phòng (và host nếu include_host).
+ * Caller giữ server_data.lock. Trả về số socket ghi vào sockets (tối đa max).
+ */
+int collect_room_sockets(const TestRoom *room, int include_host, int *sockets, int max) {
+  int count = 0;
+  for (int j = 0; j < server_data.user_count && count < max; j++) {
+    if (server_data.users[j].is_online != 1) continue;
+    int uid = server_data.users[j].user_id;
+    int interested = include_host && uid == room->creator_id;
+    for (int i = 0; i < room->participant_count && !interested; i++) {
+      if (room->participants[i] == uid) interested = 1;
+    }
+    if (interested) sockets[count++] = server_data.users[j].socket_fd;
+  }
+  return count;
+}
+
+/*
+ * Phát sự kiện thay đổi trạng thái phòng thi (ROOM_STARTED/ENDED/DELETED) tới
+ * subscriber của rooms.list và room.<id>, cùng các socket của phòng đã gom sẵn
+ * bằng collect_room_sockets. Gọi ngoài server_data.lock.
+ */
+void publish_room_event(int room_id, const int *room_sockets, int socket_count, const char *message) {
+  char room_topic[PUBSUB_TOPIC_LEN];
+  pubsub_room_topic(room_topic, sizeof(room_topic), room_id);
+  const char *topics[] = { TOPIC_ROOMS_LIST, room_topic };
+  pubsub_publish_many(topics, 2, room_sockets, socket_count, message);
+}
+
+/*
+ * Thông báo phòng thi mới được tạo cho những client đang mở màn hình
+ * danh sách phòng (subscriber của topic rooms.list).
  */
 void broadcast_room_created(int room_id, const char *room_name, int duration) {
-  pthread_mutex_lock(&server_data.lock);
-  
   char message[512];
   snprintf(message, sizeof(message), 
            "ROOM_CREATED|%d|%s|%d\n",
            room_id, room_name, duration);
   
-  // Gửi đến tất cả users online (tạm thời - sau này có thể track users đang xem list)
-  for (int i = 0; i < server_data.user_count; i++) {
-    if (server_data.users[i].is_online == 1) {
-      send(server_data.users[i].socket_fd, message, strlen(message), 0);
-    }
-  }
-  
-  pthread_mutex_unlock(&server_data.lock);
+  pubsub_publish(TOPIC_ROOMS_LIST, message);
 }
 
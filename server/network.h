@@ -7,5 +7,7 @@ void *handle_client(void *arg);
 void broadcast_to_room_participants(int room_id, const char *message);
 void broadcast_to_room_participants_except(int room_id, const char *message, int exclude_user_id);
 void broadcast_room_created(int room_id, const char *room_name, int duration);
+int collect_room_sockets(const TestRoom *room, int include_host, int *sockets, int max);
+void publish_room_event(int room_id, const int *room_sockets, int socket_count, const char *message);
 
 #endif
@@ -0,0 +1,106 @@
+#include "pager.h"
+#include <stdarg.h>
+#include <sys/socket.h>
+
+/*
+ * Phân trang + stream cho các endpoint trả danh sách:
+ *  - Request: CMD|...|cursor|limit (cả hai tuỳ chọn; thiếu limit = PAGE_DEFAULT_LIMIT dòng)
+ *  - Response vẫn là một dòng/khối như trước, nhưng được gửi theo đoạn ngay khi đọc từ SQLite,
+ *    bộ nhớ mỗi request cố định PAGE_CHUNK_SIZE thay vì buffer lớn "cho chắc"
+ *  - Mọi trang kết thúc bằng dòng riêng "NEXT|<cursor>" (NEXT|0 = trang cuối):
+ *    client gửi lại request với cursor đó cho đến khi nhận NEXT|0.
+ */
+
+void page_request_parse(PageRequest *req, const char *cursor_str, const char *limit_str) {
+  req->cursor = cursor_str ? atoi(cursor_str) : 0;
+  req->limit = limit_str ? atoi(limit_str) : 0;
+  if (req->cursor < 0) req->cursor = 0;
+  if (req->limit <= 0) req->limit = PAGE_DEFAULT_LIMIT;
+  if (req->limit > PAGE_MAX_LIMIT) req->limit = PAGE_MAX_LIMIT;
+}
+
+static void flush_chunk(PageStream *ps) {
+  size_t off = 0;
+  while (!ps->error && off < ps->len) {
+    ssize_t n = send(ps->socket_fd, ps->buf + off, ps->len - off, MSG_NOSIGNAL);
+    if (n <= 0) {
+      ps->error = 1;
+      break;
+    }
+    off += (size_t)n;
+  }
+  ps->sent += off;
+  ps->len = 0;
+}
+
+void page_stream_begin(PageStream *ps, int socket_fd) {
+  ps->socket_fd = socket_fd;
+  ps->len = 0;
+  ps->sent = 0;
+  ps->error = 0;
+}
+
+void page_stream_printf(PageStream *ps, const char *fmt, ...) {
+  if (ps->error) return;
+
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(ps->buf + ps->len, sizeof(ps->buf) - ps->len, fmt, ap);
+  va_end(ap);
+  if (n < 0) return;
+
+  if ((size_t)n < sizeof(ps->buf) - ps->len) {
+    ps->len += (size_t)n;
+    return;
+  }
+
+  // Không vừa: gửi phần đã có (bỏ dòng dở dang) rồi ghi lại từ đầu buffer
+  ps->buf[ps->len] = '\0';
+  flush_chunk(ps);
+  va_start(ap, fmt);
+  n = vsnprintf(ps->buf, sizeof(ps->buf), fmt, ap);
+  va_end(ap);
+  if (n < 0) return;
+
+  if ((size_t)n < sizeof(ps->buf)) {
+    ps->len = (size_t)n;
+    return;
+  }
+
+  // Một dòng lớn hơn cả đoạn: định dạng riêng vào heap
+  char *big = malloc((size_t)n + 1);
+  if (!big) {
+    ps->error = 1;
+    return;
+  }
+  va_start(ap, fmt);
+  vsnprintf(big, (size_t)n + 1, fmt, ap);
+  va_end(ap);
+  ps->len = 0;
+  size_t off = 0;
+  while (off < (size_t)n) {
+    ssize_t w = send(ps->socket_fd, big + off, (size_t)n - off, MSG_NOSIGNAL);
+    if (w <= 0) {
+      ps->error = 1;
+      break;
+    }
+    off += (size_t)w;
+  }
+  ps->sent += off;
+  free(big);
+}
+
+/*
+ * Dòng kết thúc trang, sau phần thân của response (0 = không còn trang sau).
+ */
+void page_stream_next(PageStream *ps, int next_cursor) {
+  page_stream_printf(ps, "NEXT|%d\n", next_cursor);
+}
+
+/*
+ * Kết thúc response: gửi phần còn lại trong buffer (caller tự ghi '\n' kết thúc).
+ */
+void page_stream_end(PageStream *ps) {
+  flush_chunk(ps);
+  printf("[SERVER SEND fd=%d] streamed %zu bytes\n", ps->socket_fd, ps->sent);
+}
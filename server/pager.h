@@ -0,0 +1,37 @@
+#ifndef PAGER_H
+#define PAGER_H
+
+#include "common.h"
+
+// Kích thước một đoạn gửi đi khi stream danh sách (bộ nhớ cố định mỗi request)
+#define PAGE_CHUNK_SIZE BUFFER_SIZE
+// Số dòng tối đa một trang khi client yêu cầu phân trang
+#define PAGE_MAX_LIMIT 500
+// Số dòng một trang khi client không gửi limit (không còn trả toàn bộ danh sách)
+#define PAGE_DEFAULT_LIMIT 100
+
+/*
+ * Ghi response dạng danh sách theo từng đoạn PAGE_CHUNK_SIZE:
+ * dòng nào không vừa phần còn lại của buffer thì gửi buffer trước rồi ghi tiếp.
+ * send() chặn nên caller không được giữ server_data.lock trong lúc stream.
+ */
+typedef struct {
+  int socket_fd;
+  size_t len;
+  size_t sent;
+  int error;
+  char buf[PAGE_CHUNK_SIZE];
+} PageStream;
+
+typedef struct {
+  int cursor;   // id (hoặc vị trí) của dòng cuối trang trước, 0 = từ đầu
+  int limit;    // số dòng tối đa, luôn trong 1..PAGE_MAX_LIMIT
+} PageRequest;
+
+void page_request_parse(PageRequest *req, const char *cursor_str, const char *limit_str);
+void page_stream_begin(PageStream *ps, int socket_fd);
+void page_stream_printf(PageStream *ps, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+void page_stream_next(PageStream *ps, int next_cursor);
+void page_stream_end(PageStream *ps);
+
+#endif
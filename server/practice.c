@@ -1,6 +1,12 @@
 #include "practice.h"
 #include "db.h"
 #include "network.h"
+#include "scheduler.h"
+#include "audit.h"
+#include "pager.h"
+#include "pubsub.h"
+#include "csv_import.h"
+#include "jobs.h"
 #include <sys/socket.h>
 #include <string.h>
 #include <stdio.h>
@@ -106,6 +112,17 @@ void init_practice_tables() {
         fprintf(stderr, "Failed to create practice_logs table: %s\n", err_msg);
         sqlite3_free(err_msg);
     }
+
+    // Index theo phòng để job xoá phòng luyện tập xoá theo lô không quét toàn bảng
+    const char *sql_indexes =
+        "CREATE INDEX IF NOT EXISTS idx_practice_sessions_room ON practice_sessions(practice_id);"
+        "CREATE INDEX IF NOT EXISTS idx_practice_logs_room ON practice_logs(practice_id);"
+        "CREATE INDEX IF NOT EXISTS idx_practice_questions_room ON practice_questions(practice_id);";
+
+    if (sqlite3_exec(db, sql_indexes, 0, 0, &err_msg) != SQLITE_OK) {
+        fprintf(stderr, "Failed to create practice indexes: %s\n", err_msg);
+        sqlite3_free(err_msg);
+    }
 }
 
 /*
@@ -850,6 +867,18 @@ void finish_practice_session(int socket_fd, int user_id, int practice_id) {
     
     printf("[DEBUG] finish_practice_session: user=%d, room=%d, score=%d/%d\n",
            user_id, practice_id, score, session->total_questions);
+
+    // Có cooldown -> hẹn giờ báo cho user khi được phép luyện lại
+    for (int i = 0; i < server_data.practice_room_count; i++) {
+        PracticeRoom *room = &server_data.practice_rooms[i];
+        if (room->practice_id == practice_id) {
+            if (room->show_answers == 0 && room->time_limit > 0) {
+                scheduler_add(SCHED_PRACTICE_COOLDOWN, practice_id, user_id,
+                              session->end_time + (time_t)room->time_limit * 60);
+            }
+            break;
+        }
+    }
     
     pthread_mutex_unlock(&server_data.lock);
 }
@@ -993,23 +1022,25 @@ void close_practice_room(int socket_fd, int user_id, int practice_id) {
     snprintf(sql, sizeof(sql), "UPDATE practice_rooms SET is_open = 0 WHERE id = %d;", practice_id);
     sqlite3_exec(db, sql, 0, 0, 0);
     
-    // Kick out all active users
+    char kick_msg[256];
+    snprintf(kick_msg, sizeof(kick_msg), 
+             "PRACTICE_CLOSED|%d|%s\n", 
+             practice_id, room->room_name);
+
+    // Kick out all active users (gom socket, gửi sau khi nhả lock)
+    int kick_sockets[MAX_CLIENTS];
+    int kick_count = 0;
     for (int i = 0; i < server_data.practice_session_count; i++) {
         if (server_data.practice_sessions[i].practice_id == practice_id &&
             server_data.practice_sessions[i].is_active == 1) {
             
             int target_user_id = server_data.practice_sessions[i].user_id;
             
-            // Find user's socket and send kick message
-            for (int j = 0; j < server_data.user_count; j++) {
+            // Find user's socket
+            for (int j = 0; j < server_data.user_count && kick_count < MAX_CLIENTS; j++) {
                 if (server_data.users[j].user_id == target_user_id && 
                     server_data.users[j].is_online == 1) {
-                    
-                    char kick_msg[256];
-                    snprintf(kick_msg, sizeof(kick_msg), 
-                             "PRACTICE_CLOSED|%d|%s\n", 
-                             practice_id, room->room_name);
-                    send(server_data.users[j].socket_fd, kick_msg, strlen(kick_msg), 0);
+                    kick_sockets[kick_count++] = server_data.users[j].socket_fd;
                     break;
                 }
             }
@@ -1023,8 +1054,13 @@ void close_practice_room(int socket_fd, int user_id, int practice_id) {
     snprintf(response, sizeof(response), "CLOSE_PRACTICE_OK|%d\n", practice_id);
     send(socket_fd, response, strlen(response), 0);
     
-    
     pthread_mutex_unlock(&server_data.lock);
+
+    // Người đang luyện tập + subscriber của practice.<id>
+    char topic[PUBSUB_TOPIC_LEN];
+    pubsub_practice_topic(topic, sizeof(topic), practice_id);
+    const char *topics[] = { topic };
+    pubsub_publish_many(topics, 1, kick_sockets, kick_count, kick_msg);
 }
 
 /*
@@ -1064,10 +1100,29 @@ void open_practice_room(int socket_fd, int user_id, int practice_id) {
     pthread_mutex_unlock(&server_data.lock);
 }
 
+// Một dòng của PRACTICE_PARTICIPANTS, chép ra trong server_data.lock
+typedef struct {
+    int user_id;
+    char username[50];
+    int score;
+    int answered;
+    int total;
+} ParticipantRow;
+
 /*
  * Lấy danh sách user đã hoặc đang tham gia một phòng luyện tập.
+ * Phân trang theo vị trí session: cursor = vị trí cuối trang trước + 1, limit = số dòng tối đa.
+ * Các dòng được chép ra trong lock vào buffer limit dòng, stream sau khi đã nhả lock,
+ * kết thúc bằng dòng NEXT|cursor (NEXT|0 = trang cuối).
  */
-void get_practice_participants(int socket_fd, int user_id, int practice_id) {
+void get_practice_participants(int socket_fd, int user_id, int practice_id, int cursor, int limit) {
+    ParticipantRow *rows = malloc(sizeof(ParticipantRow) * limit);
+    if (!rows) {
+        char response[] = "PRACTICE_PARTICIPANTS_FAIL|Server error\n";
+        send(socket_fd, response, strlen(response), 0);
+        return;
+    }
+
     pthread_mutex_lock(&server_data.lock);
     
     // Check if user is creator
@@ -1083,25 +1138,29 @@ void get_practice_participants(int socket_fd, int user_id, int practice_id) {
         char response[] = "PRACTICE_PARTICIPANTS_FAIL|Permission denied\n";
         send(socket_fd, response, strlen(response), 0);
         pthread_mutex_unlock(&server_data.lock);
+        free(rows);
         return;
     }
     
-    // Build response with active participants
-    char response[BUFFER_SIZE];
-    int offset = snprintf(response, sizeof(response), "PRACTICE_PARTICIPANTS|%d|", practice_id);
-    
+    // Chép các participant đang active
     int count = 0;
-    for (int i = 0; i < server_data.practice_session_count; i++) {
+    int next_cursor = 0;
+    for (int i = cursor; i < server_data.practice_session_count; i++) {
         if (server_data.practice_sessions[i].practice_id == practice_id &&
             server_data.practice_sessions[i].is_active == 1) {
+            if (count == limit) {
+                next_cursor = i;
+                break;
+            }
             
             PracticeSession *session = &server_data.practice_sessions[i];
+            ParticipantRow *row = &rows[count];
             
             // Get username
-            char username[50] = "Unknown";
+            strcpy(row->username, "Unknown");
             for (int j = 0; j < server_data.user_count; j++) {
                 if (server_data.users[j].user_id == session->user_id) {
-                    strncpy(username, server_data.users[j].username, sizeof(username) - 1);
+                    snprintf(row->username, sizeof(row->username), "%s", server_data.users[j].username);
                     break;
                 }
             }
@@ -1118,47 +1177,44 @@ void get_practice_participants(int socket_fd, int user_id, int practice_id) {
                 }
             }
             
-            offset += snprintf(response + offset, sizeof(response) - offset,
-                              "%d,%s,%d,%d,%d;",
-                              session->user_id, username, current_score, 
-                              answered, session->total_questions);
+            row->user_id = session->user_id;
+            row->score = current_score;
+            row->answered = answered;
+            row->total = session->total_questions;
             count++;
         }
     }
+    pthread_mutex_unlock(&server_data.lock);
     
-    if (count == 0) {
-        offset += snprintf(response + offset, sizeof(response) - offset, "NONE");
+    // Build response with active participants
+    PageStream ps;
+    page_stream_begin(&ps, socket_fd);
+    page_stream_printf(&ps, "PRACTICE_PARTICIPANTS|%d|", practice_id);
+    for (int i = 0; i < count; i++) {
+        page_stream_printf(&ps, "%d,%s,%d,%d,%d;",
+                          rows[i].user_id, rows[i].username, rows[i].score,
+                          rows[i].answered, rows[i].total);
     }
+    free(rows);
     
-    strcat(response, "\n");
-    send(socket_fd, response, strlen(response), 0);
+    if (count == 0) {
+        page_stream_printf(&ps, "NONE");
+    }
     
-    pthread_mutex_unlock(&server_data.lock);
+    page_stream_printf(&ps, "\n");
+    page_stream_next(&ps, next_cursor);
+    page_stream_end(&ps);
 }
 
 /*
  * Lưu log chi tiết cho từng lần trả lời câu hỏi trong chế độ luyện tập
  * vào bảng practice_logs để phân tích sau này.
+ * Log được đẩy vào hàng đợi audit và ghi theo lô (xem audit.c).
  */
 void save_practice_log(int user_id, int practice_id, int question_id, int answer, int is_correct) {
-    const char *sql = "INSERT INTO practice_logs (user_id, practice_id, question_id, answer, is_correct, attempt_time) VALUES (?, ?, ?, ?, ?, ?);";
-    sqlite3_stmt *stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) == SQLITE_OK) {
-        time_t now = time(NULL);
-        sqlite3_bind_int(stmt, 1, user_id);
-        sqlite3_bind_int(stmt, 2, practice_id);
-        sqlite3_bind_int(stmt, 3, question_id);
-        sqlite3_bind_int(stmt, 4, answer);
-        sqlite3_bind_int(stmt, 5, is_correct);
-        sqlite3_bind_int(stmt, 6, (int)now);
-        
-        if (sqlite3_step(stmt) == SQLITE_DONE) {
-        printf("[DEBUG] save_practice_log: user=%d, room=%d, qid=%d, ans=%d, correct=%d\n",
-                   user_id, practice_id, question_id, answer, is_correct);
-        }
-        sqlite3_finalize(stmt);
-    }
+    audit_log_practice(user_id, practice_id, question_id, answer, is_correct);
+    printf("[DEBUG] save_practice_log: user=%d, room=%d, qid=%d, ans=%d, correct=%d\n",
+           user_id, practice_id, question_id, answer, is_correct);
 }
 
 /*
@@ -1194,7 +1250,10 @@ void get_user_practice_rooms(int socket_fd, int user_id) {
 
 /*
  * Xóa hoàn toàn một phòng luyện tập khỏi DB:
- *  - Kèm theo toàn bộ câu hỏi liên quan và session/answer/log.
+ *  - Dòng practice_rooms và dữ liệu in-memory bị xoá ngay
+ *  - Câu hỏi liên quan và session/answer/log được xoá theo lô trên job nền
+ *    JOB_DELETE_PRACTICE
+ * Response: DELETE_PRACTICE_OK|practice_id|job_id
  */
 void delete_practice_room(int socket_fd, int user_id, int practice_id) {
     pthread_mutex_lock(&server_data.lock);
@@ -1213,6 +1272,7 @@ void delete_practice_room(int socket_fd, int user_id, int practice_id) {
     char response[256];
     
     if (room == NULL) {
+        snprintf(response, sizeof(response), "DELETE_PRACTICE_FAIL|Room not found\n");
         send(socket_fd, response, strlen(response), 0);
         pthread_mutex_unlock(&server_data.lock);
         return;
@@ -1225,29 +1285,10 @@ void delete_practice_room(int socket_fd, int user_id, int practice_id) {
         return;
     }
     
-    // Delete from database
+    // Delete the practice room itself; child rows are removed by the job
     char query[512];
     char *err_msg = 0;
     
-    // Delete practice sessions first (foreign key constraint)
-    snprintf(query, sizeof(query), "DELETE FROM practice_sessions WHERE practice_id=%d;", practice_id);
-    if (sqlite3_exec(db, query, 0, 0, &err_msg) != SQLITE_OK) {
-        sqlite3_free(err_msg);
-    }
-    
-    // Delete practice logs
-    snprintf(query, sizeof(query), "DELETE FROM practice_logs WHERE practice_id=%d;", practice_id);
-    if (sqlite3_exec(db, query, 0, 0, &err_msg) != SQLITE_OK) {
-        sqlite3_free(err_msg);
-    }
-    
-    // Delete practice_questions mapping
-    snprintf(query, sizeof(query), "DELETE FROM practice_questions WHERE practice_id=%d;", practice_id);
-    if (sqlite3_exec(db, query, 0, 0, &err_msg) != SQLITE_OK) {
-        sqlite3_free(err_msg);
-    }
-    
-    // Finally delete the practice room itself
     snprintf(query, sizeof(query), "DELETE FROM practice_rooms WHERE id=%d;", practice_id);
     if (sqlite3_exec(db, query, 0, 0, &err_msg) != SQLITE_OK) {
         snprintf(response, sizeof(response), "DELETE_PRACTICE_FAIL|Database error: %s\n", err_msg);
@@ -1276,17 +1317,70 @@ void delete_practice_room(int socket_fd, int user_id, int practice_id) {
         }
     }
     
+    // Hàng đợi đầy (job_id = 0): xoá dữ liệu con ngay trên thread này như trước
+    int job_id = job_submit(JOB_DELETE_PRACTICE, user_id, practice_id);
+    if (job_id < 0) job_id = 0;
+
+    snprintf(response, sizeof(response), "DELETE_PRACTICE_OK|%d|%d\n", practice_id, job_id);
     send(socket_fd, response, strlen(response), 0);
     log_activity(user_id, "DELETE_PRACTICE", "Deleted practice room");
     
     pthread_mutex_unlock(&server_data.lock);
+
+    if (job_id == 0) job_run_inline(JOB_DELETE_PRACTICE, user_id, practice_id);
+
+    char topic[PUBSUB_TOPIC_LEN];
+    pubsub_practice_topic(topic, sizeof(topic), practice_id);
+    pubsub_drop_topic(topic);
+}
+
+/*
+ * Job JOB_DELETE_PRACTICE: xoá câu hỏi, session/answer/log của phòng luyện tập
+ * đã bị xoá, theo lô. Chạy trên worker của jobs.c với connection riêng.
+ */
+int run_delete_practice_job(int job_id, int practice_id, int user_id, sqlite3 *conn,
+                            char *message, size_t message_size) {
+    (void)user_id;
+    static const struct {
+        const char *table;
+        const char *where;
+    } steps[] = {
+        {"practice_answers", "session_id IN (SELECT id FROM practice_sessions WHERE practice_id = ?)"},
+        {"practice_sessions", "practice_id = ?"},
+        {"practice_logs", "practice_id = ?"},
+        {"practice_room_questions", "practice_id = ?"},
+        {"practice_questions", "practice_id = ?"},
+    };
+    int step_count = (int)(sizeof(steps) / sizeof(steps[0]));
+
+    long total = 0;
+    for (int i = 0; i < step_count; i++) {
+        total += job_count_rows(conn, steps[i].table, steps[i].where, practice_id);
+    }
+    job_progress(job_id, 0, total);
+
+    long deleted = 0;
+    for (int i = 0; i < step_count; i++) {
+        long n = job_delete_batched(job_id, conn, steps[i].table, steps[i].where, practice_id);
+        if (n < 0) {
+            snprintf(message, message_size, "Failed to delete %s of practice room %d",
+                     steps[i].table, practice_id);
+            return -1;
+        }
+        deleted += n;
+    }
+
+    snprintf(message, message_size, "Practice room %d deleted (%ld rows)", practice_id, deleted);
+    return 0;
 }
 
 /*
  * Lấy danh sách câu hỏi thuộc một phòng luyện tập,
  * phục vụ màn hình quản trị hoặc chỉnh sửa.
+ * Phân trang theo id câu hỏi (cursor = id cuối trang trước, limit = số câu tối đa), stream theo đoạn,
+ * kết thúc bằng dòng NEXT|cursor (NEXT|0 = trang cuối).
  */
-void get_practice_questions(int socket_fd, int user_id, int practice_id) {
+void get_practice_questions(int socket_fd, int user_id, int practice_id, int cursor, int limit) {
     pthread_mutex_lock(&server_data.lock);
     
     // Find practice room and verify permission
@@ -1311,33 +1405,41 @@ void get_practice_questions(int socket_fd, int user_id, int practice_id) {
         pthread_mutex_unlock(&server_data.lock);
         return;
     }
+    pthread_mutex_unlock(&server_data.lock);
     
-    // Use dynamic allocation for large question lists
-    size_t buf_size = BUFFER_SIZE * 64;  // 512KB for 100+ questions
-    char *response = malloc(buf_size);
-    if (!response) {
-        char err[] = "GET_PRACTICE_QUESTIONS_FAIL|Memory allocation failed\n";
-        send(socket_fd, err, strlen(err), 0);
-        pthread_mutex_unlock(&server_data.lock);
+    // Đọc và stream trên read connection để không giữ server_data.lock khi send chặn
+    sqlite3 *conn = db_thread_read_connection();
+    if (!conn) {
+        char response[] = "GET_PRACTICE_QUESTIONS_FAIL|Database error\n";
+        send(socket_fd, response, strlen(response), 0);
         return;
     }
     
-    // Build response with question details from database
-    int offset = snprintf(response, buf_size, "PRACTICE_QUESTIONS_LIST|%d", practice_id);
+    // Build response with question details from database, gửi dần theo đoạn
+    PageStream ps;
+    page_stream_begin(&ps, socket_fd);
+    page_stream_printf(&ps, "PRACTICE_QUESTIONS_LIST|%d", practice_id);
     
     // Query practice questions from database
-    char query[512];
-    snprintf(query, sizeof(query),
+    const char *query =
              "SELECT id, question_text, option_a, option_b, option_c, option_d, "
              "correct_answer, difficulty, category FROM practice_questions "
-             "WHERE practice_id=%d ORDER BY id",
-             practice_id);
+             "WHERE practice_id=? AND id>? ORDER BY id LIMIT ?";
     
     sqlite3_stmt *stmt;
     int question_count = 0;
+    int last_id = 0;
+    int has_more = 0;
     
-    if (sqlite3_prepare_v2(db, query, -1, &stmt, NULL) == SQLITE_OK) {
+    if (sqlite3_prepare_v2(conn, query, -1, &stmt, NULL) == SQLITE_OK) {
+        sqlite3_bind_int(stmt, 1, practice_id);
+        sqlite3_bind_int(stmt, 2, cursor);
+        sqlite3_bind_int(stmt, 3, limit + 1);
         while (sqlite3_step(stmt) == SQLITE_ROW) {
+            if (question_count == limit) {
+                has_more = 1;
+                break;
+            }
             int q_id = sqlite3_column_int(stmt, 0);
             const char *q_text = (const char *)sqlite3_column_text(stmt, 1);
             const char *opt_a = (const char *)sqlite3_column_text(stmt, 2);
@@ -1348,25 +1450,23 @@ void get_practice_questions(int socket_fd, int user_id, int practice_id) {
             const char *difficulty = (const char *)sqlite3_column_text(stmt, 7);
             const char *category = (const char *)sqlite3_column_text(stmt, 8);
             
-            offset += snprintf(response + offset, buf_size - offset,
-                             "|%d:%s:%s:%s:%s:%s:%d:%s:%s",
+            page_stream_printf(&ps, "|%d:%s:%s:%s:%s:%s:%d:%s:%s",
                              q_id, q_text ? q_text : "",
                              opt_a ? opt_a : "", opt_b ? opt_b : "",
                              opt_c ? opt_c : "", opt_d ? opt_d : "",
                              correct, difficulty ? difficulty : "", category ? category : "");
             question_count++;
+            last_id = q_id;
         }
         sqlite3_finalize(stmt);
     }
     
-    strcat(response, "\n");
-    send(socket_fd, response, strlen(response), 0);
-    free(response);
+    page_stream_printf(&ps, "\n");
+    page_stream_next(&ps, has_more ? last_id : 0);
+    page_stream_end(&ps);
     
     printf("[DEBUG] get_practice_questions: count=%d, room=%d, user=%d\n",
            question_count, practice_id, user_id);
-    
-    pthread_mutex_unlock(&server_data.lock);
 }
 
 /*
@@ -1568,144 +1668,109 @@ void create_practice_question(int socket_fd, int user_id, int practice_id, char
 /*
  * Import các câu hỏi luyện tập từ file CSV cho một phòng luyện tập.
  */
-void import_practice_csv(int socket_fd, int user_id, int practice_id, const char *filename) {
-    pthread_mutex_lock(&server_data.lock);
-    
-    // Find practice room and verify permission
-    PracticeRoom *room = NULL;
+// Tìm phòng luyện tập in-memory (caller giữ server_data.lock)
+static PracticeRoom *find_practice_room(int practice_id) {
     for (int i = 0; i < server_data.practice_room_count; i++) {
         if (server_data.practice_rooms[i].practice_id == practice_id) {
-            room = &server_data.practice_rooms[i];
-            break;
+            return &server_data.practice_rooms[i];
         }
     }
-    
+    return NULL;
+}
+
+/*
+ * Import câu hỏi luyện tập từ CSV (parser dùng chung, xem csv_import.c):
+ *  - file_size > 0: gửi READY rồi nhận file_size byte CSV từ socket
+ *  - file_size < 0: đọc file staging đã upload xong (UPLOAD_COMMIT, xem upload.c);
+ *    đường dẫn do server cấp, client không còn chỉ định được file trên máy server
+ *  - Chèn câu hỏi + mapping thứ tự trong một transaction, ngoài server_data.lock;
+ *    chỉ lấy lock lại để nối id mới vào phòng in-memory.
+ *  - socket_fd < 0 (job nền, chỉ với file staging): không gửi gì, response chỉ ghi vào reply
+ * Trả 0 nếu thành công, -1 nếu lỗi.
+ */
+int import_practice_csv(int socket_fd, int user_id, int practice_id, const char *staged_path, long file_size,
+                        char *reply, size_t reply_size) {
     char response[256];
-    
+    const char *error = NULL;
+    int order_base = 0;
+
+    pthread_mutex_lock(&server_data.lock);
+    PracticeRoom *room = find_practice_room(practice_id);
     if (room == NULL) {
-        snprintf(response, sizeof(response), "IMPORT_PRACTICE_CSV_FAIL|Room not found\n");
-        send(socket_fd, response, strlen(response), 0);
-        pthread_mutex_unlock(&server_data.lock);
-        return;
+        error = "Room not found";
+    } else if (room->creator_id != user_id) {
+        error = "Permission denied";
+    } else {
+        order_base = room->num_questions;
     }
-    
-    if (room->creator_id != user_id) {
-        snprintf(response, sizeof(response), "IMPORT_PRACTICE_CSV_FAIL|Permission denied\n");
-        send(socket_fd, response, strlen(response), 0);
-        pthread_mutex_unlock(&server_data.lock);
-        return;
+    pthread_mutex_unlock(&server_data.lock);
+
+    if (error == NULL && (file_size == 0 || (file_size > 0 && socket_fd < 0))) error = "File size invalid";
+    if (error != NULL) {
+        snprintf(response, sizeof(response), "IMPORT_PRACTICE_CSV_FAIL|%s\n", error);
+        if (socket_fd >= 0) send(socket_fd, response, strlen(response), 0);
+        if (reply) snprintf(reply, reply_size, "%s", response);
+        return -1;
     }
-    
-    FILE *fp = fopen(filename, "r");
-    if (!fp) {
-        snprintf(response, sizeof(response), "IMPORT_PRACTICE_CSV_FAIL|Cannot open file\n");
-        send(socket_fd, response, strlen(response), 0);
-        pthread_mutex_unlock(&server_data.lock);
-        return;
+
+    CsvImportResult result;
+    int rc;
+    if (file_size > 0) {
+        server_send(socket_fd, "READY\n");
+        rc = csv_import_from_socket(socket_fd, file_size, CSV_TARGET_PRACTICE, practice_id, order_base, 0, &result);
+    } else {
+        rc = csv_import_from_file(staged_path, CSV_TARGET_PRACTICE, practice_id, order_base, -1, &result);
     }
-    
-    char line[2048];
-    int imported = 0;
-    int line_num = 0;
-    int header_skipped = 0;
-    
-    while (fgets(line, sizeof(line), fp)) {
-        line_num++;
-        
-        // Skip empty lines and comments
-        if (line[0] == '\n' || line[0] == '#' || line[0] == '\r') continue;
-        
-        // Skip header row (first non-empty, non-comment line)
-        if (!header_skipped) {
-            header_skipped = 1;
-            continue;
+
+    if (rc < 0) {
+        snprintf(response, sizeof(response), "IMPORT_PRACTICE_CSV_FAIL|%s\n", result.error);
+        if (socket_fd >= 0) send(socket_fd, response, strlen(response), 0);
+        if (reply) snprintf(reply, reply_size, "%s", response);
+        return -1;
+    }
+
+    // Update in-memory
+    pthread_mutex_lock(&server_data.lock);
+    room = find_practice_room(practice_id);
+    for (int i = 0; room != NULL && i < result.imported && room->num_questions < MAX_QUESTIONS; i++) {
+        room->question_ids[room->num_questions++] = result.question_ids[i];
+    }
+    pthread_mutex_unlock(&server_data.lock);
+    free(result.question_ids);
+
+    snprintf(response, sizeof(response), "IMPORT_PRACTICE_CSV_OK|%d|%d\n", result.imported, result.skipped);
+    if (socket_fd >= 0) send(socket_fd, response, strlen(response), 0);
+    if (reply) snprintf(reply, reply_size, "%s", response);
+
+    log_activity(user_id, "IMPORT_PRACTICE_CSV", "Imported practice questions from CSV");
+    return 0;
+}
+
+/*
+ * Handler của scheduler khi cooldown luyện tập của user hết hạn:
+ *  - Nếu user đang online và phòng vẫn mở, gửi PRACTICE_READY để client biết có thể luyện lại.
+ */
+void on_practice_cooldown_expired(int practice_id, int user_id) {
+    pthread_mutex_lock(&server_data.lock);
+
+    PracticeRoom *room = NULL;
+    for (int i = 0; i < server_data.practice_room_count; i++) {
+        if (server_data.practice_rooms[i].practice_id == practice_id) {
+            room = &server_data.practice_rooms[i];
+            break;
         }
-        
-        // Remove newline
-        line[strcspn(line, "\r\n")] = 0;
-        
-        // Parse CSV: question,optA,optB,optC,optD,correct,difficulty,category
-        char q_text[512], opt_a[256], opt_b[256], opt_c[256], opt_d[256];
-        char difficulty[32], category[128];
-        int correct;
-        
-        char *token = strtok(line, ",");
-        if (!token) continue;
-        strncpy(q_text, token, sizeof(q_text)-1);
-        q_text[sizeof(q_text)-1] = '\0';
-        
-        token = strtok(NULL, ",");
-        if (!token) continue;
-        strncpy(opt_a, token, sizeof(opt_a)-1);
-        opt_a[sizeof(opt_a)-1] = '\0';
-        
-        token = strtok(NULL, ",");
-        if (!token) continue;
-        strncpy(opt_b, token, sizeof(opt_b)-1);
-        opt_b[sizeof(opt_b)-1] = '\0';
-        
-        token = strtok(NULL, ",");
-        if (!token) continue;
-        strncpy(opt_c, token, sizeof(opt_c)-1);
-        opt_c[sizeof(opt_c)-1] = '\0';
-        
-        token = strtok(NULL, ",");
-        if (!token) continue;
-        strncpy(opt_d, token, sizeof(opt_d)-1);
-        opt_d[sizeof(opt_d)-1] = '\0';
-        
-        token = strtok(NULL, ",");
-        if (!token) continue;
-        correct = atoi(token);
-        
-        token = strtok(NULL, ",");
-        if (!token) continue;
-        strncpy(difficulty, token, sizeof(difficulty)-1);
-        difficulty[sizeof(difficulty)-1] = '\0';
-        
-        token = strtok(NULL, ",");
-        if (!token) continue;
-        strncpy(category, token, sizeof(category)-1);
-        category[sizeof(category)-1] = '\0';
-        
-        // Insert into database
-        char *query = sqlite3_mprintf(
-            "INSERT INTO practice_questions (practice_id, question_text, option_a, option_b, option_c, option_d, correct_answer, difficulty, category) "
-            "VALUES (%d, %Q, %Q, %Q, %Q, %Q, %d, %Q, %Q);",
-            practice_id, q_text, opt_a, opt_b, opt_c, opt_d, correct, difficulty, category);
-        
-        if (!query) continue;
-        
-        if (sqlite3_exec(db, query, NULL, NULL, NULL) == SQLITE_OK) {
-            int question_id = sqlite3_last_insert_rowid(db);
-            
-            // Add mapping
-            const char *sql_mapping = "INSERT INTO practice_room_questions (practice_id, question_id, question_order) VALUES (?, ?, ?);";
-            sqlite3_stmt *stmt;
-            if (sqlite3_prepare_v2(db, sql_mapping, -1, &stmt, NULL) == SQLITE_OK) {
-                sqlite3_bind_int(stmt, 1, practice_id);
-                sqlite3_bind_int(stmt, 2, question_id);
-                sqlite3_bind_int(stmt, 3, room->num_questions);
-                sqlite3_step(stmt);
-                sqlite3_finalize(stmt);
-            }
-            
-            // Update in-memory
-            if (room->num_questions < MAX_QUESTIONS) {
-                room->question_ids[room->num_questions++] = question_id;
+    }
+
+    if (room != NULL && room->is_open) {
+        for (int i = 0; i < server_data.user_count; i++) {
+            if (server_data.users[i].user_id == user_id && server_data.users[i].is_online == 1) {
+                char msg[256];
+                snprintf(msg, sizeof(msg), "PRACTICE_READY|%d|%s\n", practice_id, room->room_name);
+                server_send(server_data.users[i].socket_fd, msg);
+                break;
             }
-            
-            imported++;
         }
-        sqlite3_free(query);
     }
-    
-    fclose(fp);
-    
-    snprintf(response, sizeof(response), "IMPORT_PRACTICE_CSV_OK|%d\n", imported);
-    send(socket_fd, response, strlen(response), 0);
-    
-    log_activity(user_id, "IMPORT_PRACTICE_CSV", "Imported practice questions from CSV");
-    
+
     pthread_mutex_unlock(&server_data.lock);
 }
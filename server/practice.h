@@ -11,12 +11,15 @@ void join_practice_room(int socket_fd, int user_id, int practice_id);
 void close_practice_room(int socket_fd, int user_id, int practice_id);
 void open_practice_room(int socket_fd, int user_id, int practice_id);
 void delete_practice_room(int socket_fd, int user_id, int practice_id);
+int run_delete_practice_job(int job_id, int practice_id, int user_id, sqlite3 *conn,
+                            char *message, size_t message_size);
 void add_question_to_practice(int socket_fd, int user_id, int practice_id, int question_id);
-void get_practice_participants(int socket_fd, int user_id, int practice_id);
-void get_practice_questions(int socket_fd, int user_id, int practice_id);
+void get_practice_participants(int socket_fd, int user_id, int practice_id, int cursor, int limit);
+void get_practice_questions(int socket_fd, int user_id, int practice_id, int cursor, int limit);
 void update_practice_question(int socket_fd, int user_id, int practice_id, int question_id, char *new_data);
 void create_practice_question(int socket_fd, int user_id, int practice_id, char *question_data);
-void import_practice_csv(int socket_fd, int user_id, int practice_id, const char *filename);
+int import_practice_csv(int socket_fd, int user_id, int practice_id, const char *staged_path, long file_size,
+                        char *reply, size_t reply_size);
 void submit_practice_answer(int socket_fd, int user_id, int practice_id, int question_num, int answer);
 void finish_practice_session(int socket_fd, int user_id, int practice_id);
 void view_practice_results(int socket_fd, int user_id, int practice_id);
@@ -24,5 +27,6 @@ void restart_practice(int socket_fd, int user_id, int practice_id);
 void load_practice_rooms_from_db(void);
 void save_practice_log(int user_id, int practice_id, int question_id, int answer, int is_correct);
 void init_practice_tables(void);
+void on_practice_cooldown_expired(int practice_id, int user_id);
 
 #endif
@@ -0,0 +1,363 @@
+#include "pubsub.h"
+#include "admin.h"
+#include "metrics.h"
+#include "rooms.h"
+#include <sys/socket.h>
+
+extern ServerData server_data;
+
+/*
+ * Registry publish/subscribe cho các thông báo server đẩy xuống client:
+ *  - Mỗi topic ("rooms.list", "room.<id>", "practice.<id>", "proctor.<id>", "admin.dashboard")
+ *    giữ danh sách socket đã SUBSCRIBE, tra bằng bảng băm theo tên topic
+ *  - Publish chụp danh sách socket trong pubsub_lock rồi gửi ngoài lock
+ *    (server_push, không chặn) -> chi phí broadcast tỉ lệ với số người quan tâm,
+ *    không còn quét toàn bộ user online
+ *  - Subscriber không nhận trọn một dòng (buffer đầy) bị gỡ khỏi mọi topic: nó đã lỡ
+ *    một thông báo nên phải SUBSCRIBE lại để lấy trạng thái mới
+ *  - Topic rỗng được giải phóng ngay; socket đóng thì gỡ khỏi mọi topic.
+ * pubsub_lock là lock lá: không gọi sang module khác khi đang giữ.
+ */
+
+typedef struct Topic {
+  char name[PUBSUB_TOPIC_LEN];
+  int *fds;
+  int count;
+  int capacity;
+  struct Topic *next;
+} Topic;
+
+static Topic *buckets[PUBSUB_BUCKETS];
+static pthread_mutex_t pubsub_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned int topic_hash(const char *name) {
+  unsigned int h = 5381;
+  while (*name) h = h * 33 + (unsigned char)*name++;
+  return h % PUBSUB_BUCKETS;
+}
+
+// Gọi khi đang giữ pubsub_lock
+static Topic *find_topic(const char *name, Topic ***link_out) {
+  Topic **link = &buckets[topic_hash(name)];
+  while (*link) {
+    if (strcmp((*link)->name, name) == 0) {
+      if (link_out) *link_out = link;
+      return *link;
+    }
+    link = &(*link)->next;
+  }
+  if (link_out) *link_out = link;
+  return NULL;
+}
+
+static void free_topic(Topic **link) {
+  Topic *t = *link;
+  *link = t->next;
+  free(t->fds);
+  free(t);
+}
+
+void pubsub_room_topic(char *topic, size_t size, int room_id) {
+  snprintf(topic, size, "room.%d", room_id);
+}
+
+void pubsub_practice_topic(char *topic, size_t size, int practice_id) {
+  snprintf(topic, size, "practice.%d", practice_id);
+}
+
+// Thay đổi trạng thái thí sinh của phòng, chỉ host được subscribe (xem roster.c)
+void pubsub_proctor_topic(char *topic, size_t size, int room_id) {
+  snprintf(topic, size, "proctor.%d", room_id);
+}
+
+/*
+ * Thêm socket vào topic (idempotent). Trả 0 nếu thành công, -1 nếu hết bộ nhớ.
+ */
+int pubsub_subscribe(int socket_fd, const char *topic) {
+  if (!topic || !*topic || strlen(topic) >= PUBSUB_TOPIC_LEN) return -1;
+
+  pthread_mutex_lock(&pubsub_lock);
+  Topic **link;
+  Topic *t = find_topic(topic, &link);
+  if (!t) {
+    t = calloc(1, sizeof(Topic));
+    if (!t) {
+      pthread_mutex_unlock(&pubsub_lock);
+      return -1;
+    }
+    strcpy(t->name, topic);
+    *link = t;
+  }
+
+  for (int i = 0; i < t->count; i++) {
+    if (t->fds[i] == socket_fd) {
+      pthread_mutex_unlock(&pubsub_lock);
+      return 0;
+    }
+  }
+
+  if (t->count == t->capacity) {
+    int capacity = t->capacity ? t->capacity * 2 : 8;
+    int *grown = realloc(t->fds, capacity * sizeof(int));
+    if (!grown) {
+      if (t->count == 0) free_topic(link);
+      pthread_mutex_unlock(&pubsub_lock);
+      return -1;
+    }
+    t->fds = grown;
+    t->capacity = capacity;
+  }
+  t->fds[t->count++] = socket_fd;
+  pthread_mutex_unlock(&pubsub_lock);
+  return 0;
+}
+
+void pubsub_unsubscribe(int socket_fd, const char *topic) {
+  pthread_mutex_lock(&pubsub_lock);
+  Topic **link;
+  Topic *t = find_topic(topic, &link);
+  if (t) {
+    for (int i = 0; i < t->count; i++) {
+      if (t->fds[i] == socket_fd) {
+        t->fds[i] = t->fds[--t->count];
+        break;
+      }
+    }
+    if (t->count == 0) free_topic(link);
+  }
+  pthread_mutex_unlock(&pubsub_lock);
+}
+
+/*
+ * Gỡ socket khỏi mọi topic (gọi khi kết nối đóng, trước khi fd được tái sử dụng).
+ */
+void pubsub_unsubscribe_all(int socket_fd) {
+  pthread_mutex_lock(&pubsub_lock);
+  for (int b = 0; b < PUBSUB_BUCKETS; b++) {
+    Topic **link = &buckets[b];
+    while (*link) {
+      Topic *t = *link;
+      for (int i = 0; i < t->count; i++) {
+        if (t->fds[i] == socket_fd) {
+          t->fds[i] = t->fds[--t->count];
+          break;
+        }
+      }
+      if (t->count == 0)
+        free_topic(link);
+      else
+        link = &t->next;
+    }
+  }
+  pthread_mutex_unlock(&pubsub_lock);
+}
+
+/*
+ * Bỏ hẳn một topic (phòng thi/phòng luyện tập bị xoá).
+ */
+void pubsub_drop_topic(const char *topic) {
+  pthread_mutex_lock(&pubsub_lock);
+  Topic **link;
+  if (find_topic(topic, &link)) free_topic(link);
+  pthread_mutex_unlock(&pubsub_lock);
+}
+
+int pubsub_subscriber_count(const char *topic) {
+  pthread_mutex_lock(&pubsub_lock);
+  Topic *t = find_topic(topic, NULL);
+  int count = t ? t->count : 0;
+  pthread_mutex_unlock(&pubsub_lock);
+  return count;
+}
+
+static int compare_fd(const void *a, const void *b) {
+  int x = *(const int *)a, y = *(const int *)b;
+  return (x > y) - (x < y);
+}
+
+/*
+ * Gửi message cho hợp các subscriber của nhiều topic và các socket bổ sung
+ * (vd thí sinh của phòng), mỗi socket nhận đúng một bản.
+ * Trả về số socket đã nhận trọn message.
+ */
+int pubsub_publish_many(const char *const *topics, int topic_count,
+                        const int *extra_fds, int extra_count, const char *message) {
+  int *fds = NULL;
+  int fd_count = 0;
+
+  pthread_mutex_lock(&pubsub_lock);
+  int total = extra_count;
+  Topic *found[8];
+  int found_count = 0;
+  for (int i = 0; i < topic_count && found_count < 8; i++) {
+    Topic *t = find_topic(topics[i], NULL);
+    if (t) {
+      found[found_count++] = t;
+      total += t->count;
+    }
+  }
+  if (total > 0) fds = malloc(total * sizeof(int));
+  if (fds) {
+    for (int i = 0; i < found_count; i++) {
+      memcpy(fds + fd_count, found[i]->fds, found[i]->count * sizeof(int));
+      fd_count += found[i]->count;
+    }
+  }
+  pthread_mutex_unlock(&pubsub_lock);
+
+  if (!fds) return 0;
+  if (extra_count > 0) {
+    memcpy(fds + fd_count, extra_fds, extra_count * sizeof(int));
+    fd_count += extra_count;
+  }
+
+  // Một socket có thể nằm trong nhiều topic -> khử trùng lặp
+  qsort(fds, fd_count, sizeof(int), compare_fd);
+  size_t len = strlen(message);
+  int sent = 0;
+  for (int i = 0; i < fd_count; i++) {
+    if (i > 0 && fds[i] == fds[i - 1]) continue;
+    if (server_push(fds[i], message, len) == 0) {
+      sent++;
+    } else {
+      // Thí sinh (extra_fds) không subscribe topic nào thì chỉ lỡ dòng này
+      pubsub_unsubscribe_all(fds[i]);
+    }
+  }
+  free(fds);
+  return sent;
+}
+
+int pubsub_publish(const char *topic, const char *message) {
+  return pubsub_publish_many(&topic, 1, NULL, 0, message);
+}
+
+// Kiểm tra "<prefix><số dương>" và trả về số đó (0 nếu không khớp)
+static int parse_topic_id(const char *topic, const char *prefix) {
+  size_t plen = strlen(prefix);
+  if (strncmp(topic, prefix, plen) != 0) return 0;
+  char *end;
+  long id = strtol(topic + plen, &end, 10);
+  if (end == topic + plen || *end != '\0' || id <= 0 || id > 0x7fffffff) return 0;
+  return (int)id;
+}
+
+static int room_exists(int room_id) {
+  int found = 0;
+  pthread_mutex_lock(&server_data.lock);
+  for (int i = 0; i < server_data.room_count; i++) {
+    if (server_data.rooms[i].room_id == room_id) {
+      found = 1;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&server_data.lock);
+  return found;
+}
+
+static int room_hosted_by(int room_id, int user_id) {
+  int found = 0;
+  pthread_mutex_lock(&server_data.lock);
+  for (int i = 0; i < server_data.room_count; i++) {
+    if (server_data.rooms[i].room_id == room_id) {
+      found = server_data.rooms[i].creator_id == user_id;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&server_data.lock);
+  return found;
+}
+
+static int practice_exists(int practice_id) {
+  int found = 0;
+  pthread_mutex_lock(&server_data.lock);
+  for (int i = 0; i < server_data.practice_room_count; i++) {
+    if (server_data.practice_rooms[i].practice_id == practice_id) {
+      found = 1;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&server_data.lock);
+  return found;
+}
+
+/*
+ * SUBSCRIBE|topic
+ * Response: SUBSCRIBE_OK|topic hoặc SUBSCRIBE_FAIL|topic|reason
+ * Chỉ nhận các topic đã biết; room.<id>/practice.<id> phải là phòng đang tồn tại,
+ * admin.dashboard chỉ dành cho admin (kèm snapshot METRICS ngay sau OK),
+ * proctor.<id> chỉ dành cho host của phòng (kèm snapshot EXAM_STUDENTS_LIST).
+ */
+void handle_subscribe(int socket_fd, int user_id, const char *topic) {
+  char response[160];
+  const char *error = NULL;
+
+  if (!topic || !*topic || strlen(topic) >= PUBSUB_TOPIC_LEN) {
+    server_send(socket_fd, "SUBSCRIBE_FAIL||Invalid topic\n");
+    return;
+  }
+
+  if (strcmp(topic, TOPIC_ADMIN_DASHBOARD) == 0) {
+    if (!is_admin_user(user_id))
+      error = "Permission denied";
+    else if (metrics_subscribe(socket_fd) != 0)
+      error = "Too many subscribers";
+    else {
+      snprintf(response, sizeof(response), "SUBSCRIBE_OK|%s\n", topic);
+      server_send(socket_fd, response);
+      metrics_send_snapshot(socket_fd);
+      return;
+    }
+  } else if (parse_topic_id(topic, "proctor.") > 0) {
+    // Host nhận ngay EXAM_STUDENTS_LIST đầy đủ, sau đó từng EXAM_STUDENT_UPDATE
+    int room_id = parse_topic_id(topic, "proctor.");
+    if (!room_hosted_by(room_id, user_id))
+      error = "Permission denied";
+    else if (pubsub_subscribe(socket_fd, topic) != 0)
+      error = "Server error";
+    else {
+      snprintf(response, sizeof(response), "SUBSCRIBE_OK|%s\n", topic);
+      server_send(socket_fd, response);
+      get_exam_students_status(socket_fd, user_id, room_id);
+      return;
+    }
+  } else if (strcmp(topic, TOPIC_ROOMS_LIST) != 0) {
+    int room_id = parse_topic_id(topic, "room.");
+    int practice_id = parse_topic_id(topic, "practice.");
+    if (room_id > 0) {
+      if (!room_exists(room_id)) error = "Room not found";
+    } else if (practice_id > 0) {
+      if (!practice_exists(practice_id)) error = "Practice room not found";
+    } else {
+      error = "Unknown topic";
+    }
+  }
+
+  if (!error && pubsub_subscribe(socket_fd, topic) != 0) error = "Server error";
+
+  if (error)
+    snprintf(response, sizeof(response), "SUBSCRIBE_FAIL|%s|%s\n", topic, error);
+  else
+    snprintf(response, sizeof(response), "SUBSCRIBE_OK|%s\n", topic);
+  server_send(socket_fd, response);
+}
+
+/*
+ * UNSUBSCRIBE|topic -> UNSUBSCRIBE_OK|topic (kể cả khi chưa từng subscribe).
+ */
+void handle_unsubscribe(int socket_fd, const char *topic) {
+  char response[160];
+
+  if (!topic || !*topic || strlen(topic) >= PUBSUB_TOPIC_LEN) {
+    server_send(socket_fd, "UNSUBSCRIBE_OK|\n");
+    return;
+  }
+
+  if (strcmp(topic, TOPIC_ADMIN_DASHBOARD) == 0)
+    metrics_unsubscribe(socket_fd);
+  else
+    pubsub_unsubscribe(socket_fd, topic);
+
+  snprintf(response, sizeof(response), "UNSUBSCRIBE_OK|%s\n", topic);
+  server_send(socket_fd, response);
+}
@@ -0,0 +1,33 @@
+#ifndef PUBSUB_H
+#define PUBSUB_H
+
+#include "common.h"
+
+// Độ dài tối đa tên topic (vd "practice.12345")
+#define PUBSUB_TOPIC_LEN 48
+// Số bucket của bảng băm topic
+#define PUBSUB_BUCKETS 256
+
+// Các topic cố định; topic theo phòng dựng bằng pubsub_room_topic / pubsub_practice_topic /
+// pubsub_proctor_topic
+#define TOPIC_ROOMS_LIST "rooms.list"
+#define TOPIC_ADMIN_DASHBOARD "admin.dashboard"
+
+void pubsub_room_topic(char *topic, size_t size, int room_id);
+void pubsub_practice_topic(char *topic, size_t size, int practice_id);
+void pubsub_proctor_topic(char *topic, size_t size, int room_id);
+
+int pubsub_subscribe(int socket_fd, const char *topic);
+void pubsub_unsubscribe(int socket_fd, const char *topic);
+void pubsub_unsubscribe_all(int socket_fd);
+void pubsub_drop_topic(const char *topic);
+int pubsub_subscriber_count(const char *topic);
+
+int pubsub_publish(const char *topic, const char *message);
+int pubsub_publish_many(const char *const *topics, int topic_count,
+                        const int *extra_fds, int extra_count, const char *message);
+
+void handle_subscribe(int socket_fd, int user_id, const char *topic);
+void handle_unsubscribe(int socket_fd, const char *topic);
+
+#endif
@@ -1,5 +1,10 @@
 #include "questions.h"
 #include "db.h"
+#include "selection.h"
+#include "catalog.h"
+#include "metrics.h"
+#include "singleflight.h"
+#include "csv_import.h"
 #include <sys/socket.h>
 #include <time.h>
 #include <unistd.h>
@@ -82,6 +87,10 @@ void handle_add_question(int client_socket, char *data)
     }
     
     if (sqlite3_exec(db, query, NULL, NULL, NULL) == SQLITE_OK) {
+        metrics_add(METRIC_QUESTIONS, 1);
+        question_bank_invalidate(room_id);
+        singleflight_room_changed(room_id);
+        room_catalog_invalidate();
         send(client_socket, "QUESTION_ADDED\n", 15, 0);
     } else {
         send(client_socket, "ERROR|Failed to insert\n", 23, 0);
@@ -90,207 +99,63 @@ void handle_add_question(int client_socket, char *data)
     pthread_mutex_unlock(&server_data.lock);
 }
 
+/*
+ * Import câu hỏi thi từ file CSV trên máy server (xem csv_import.c).
+ * Trả về số câu đã import, -1 nếu lỗi.
+ */
 int import_questions_from_csv(const char *filename, int room_id)
 {
-    FILE *fp = fopen(filename, "r");
-    if (!fp) {
-        fprintf(stderr, "Cannot open file: %s\n", filename);
+    CsvImportResult result;
+    if (csv_import_from_file(filename, CSV_TARGET_EXAM_ROOM, room_id, 0, -1, &result) < 0) {
+        fprintf(stderr, "CSV import failed (%s): %s\n", filename, result.error);
         return -1;
     }
+    free(result.question_ids);
 
-    char line[2048];
-    int imported = 0;
-    
-    // Skip header
-    if (!fgets(line, sizeof(line), fp)) {
-        fclose(fp);
-        return 0;
-    }
-
-    pthread_mutex_lock(&server_data.lock);
-    
-    while (fgets(line, sizeof(line), fp)) {
-        line[strcspn(line, "\n")] = 0;
-        
-        char q_text[512], opt_a[128], opt_b[128], opt_c[128], opt_d[128];
-        char difficulty[32], category[64];
-        int correct;
-        
-        // Parse CSV: question,optA,optB,optC,optD,correct(0-3),difficulty,category
-        char *token = strtok(line, ",");
-        if (!token) continue;
-        strncpy(q_text, token, sizeof(q_text)-1);
-        q_text[sizeof(q_text)-1] = '\0';
-        
-        token = strtok(NULL, ",");
-        if (!token) continue;
-        strncpy(opt_a, token, sizeof(opt_a)-1);
-        opt_a[sizeof(opt_a)-1] = '\0';
-        
-        token = strtok(NULL, ",");
-        if (!token) continue;
-        strncpy(opt_b, token, sizeof(opt_b)-1);
-        opt_b[sizeof(opt_b)-1] = '\0';
-        
-        token = strtok(NULL, ",");
-        if (!token) continue;
-        strncpy(opt_c, token, sizeof(opt_c)-1);
-        opt_c[sizeof(opt_c)-1] = '\0';
-        
-        token = strtok(NULL, ",");
-        if (!token) continue;
-        strncpy(opt_d, token, sizeof(opt_d)-1);
-        opt_d[sizeof(opt_d)-1] = '\0';
-        
-        token = strtok(NULL, ",");
-        if (!token) continue;
-        correct = atoi(token);
-        
-        token = strtok(NULL, ",");
-        if (!token) continue;
-        strncpy(difficulty, token, sizeof(difficulty)-1);
-        difficulty[sizeof(difficulty)-1] = '\0';
-        
-        token = strtok(NULL, ",");
-        if (!token) continue;
-        strncpy(category, token, sizeof(category)-1);
-        category[sizeof(category)-1] = '\0';
-        
-        // Escape single quotes for SQL safety using sqlite3_mprintf
-        char escaped_diff[64], escaped_cat[128];
-        sqlite3_snprintf(sizeof(escaped_diff), escaped_diff, "%q", difficulty);
-        sqlite3_snprintf(sizeof(escaped_cat), escaped_cat, "%q", category);
-        
-        char *query = sqlite3_mprintf(
-            "INSERT INTO exam_questions (room_id, question_text, option_a, option_b, option_c, option_d, correct_answer, difficulty, category) "
-            "VALUES (%d, %Q, %Q, %Q, %Q, %Q, %d, '%s', '%s');",
-            room_id, q_text, opt_a, opt_b, opt_c, opt_d, correct, escaped_diff, escaped_cat);
-        
-        if (!query) continue;
-        
-        if (sqlite3_exec(db, query, NULL, NULL, NULL) == SQLITE_OK) {
-            imported++;
-        }
-        sqlite3_free(query);
+    if (result.imported > 0) {
+        metrics_add(METRIC_QUESTIONS, result.imported);
+        question_bank_invalidate(room_id);
+        singleflight_room_changed(room_id);
+        room_catalog_invalidate();
     }
-    
-    pthread_mutex_unlock(&server_data.lock);
-    fclose(fp);
-    return imported;
+    return result.imported;
 }
 
-void handle_import_csv(int client_socket, char *data)
+// Dựng kết quả import câu hỏi thi (IMPORT_OK|imported|skipped hoặc ERROR|reason)
+static void format_import_result(int room_id, int rc, CsvImportResult *result,
+                                 char *response, size_t response_size)
 {
-    // Strip newline characters first
-    data[strcspn(data, "\r\n")] = '\0';
-    
-    // Parse: room_id|filename|file_size
-    char *pipe1 = strchr(data, '|');
-    if (!pipe1) {
-        send(client_socket, "ERROR|Invalid format. Expected: room_id|filename|file_size\n", 62, 0);
-        return;
-    }
-    
-    *pipe1 = '\0';
-    char *room_id_str = data;
-    
-    char *pipe2 = strchr(pipe1 + 1, '|');
-    if (!pipe2) {
-        send(client_socket, "ERROR|Invalid format. Expected: room_id|filename|file_size\n", 62, 0);
-        return;
-    }
-    
-    *pipe2 = '\0';
-    char *filename = pipe1 + 1;
-    char *size_str = pipe2 + 1;
-    
-    if (strlen(room_id_str) == 0 || strlen(filename) == 0 || strlen(size_str) == 0) {
-        send(client_socket, "ERROR|Invalid format\n", 22, 0);
-        return;
-    }
-    
-    int room_id = atoi(room_id_str);
-    long file_size = atol(size_str);
-    
-    // Validate file size (max 5MB)
-    if (file_size <= 0 || file_size > 5 * 1024 * 1024) {
-        send(client_socket, "ERROR|File size invalid (max 5MB)\n", 36, 0);
-        return;
-    }
-    
-    // Send ACK to client to confirm ready to receive
-    char ack[] = "READY\n";
-    send(client_socket, ack, strlen(ack), 0);
-    
-    // Receive file content
-    char *file_buffer = malloc(file_size + 1);
-    if (!file_buffer) {
-        send(client_socket, "ERROR|Memory allocation failed\n", 32, 0);
-        return;
-    }
-    
-    ssize_t total_received = 0;
-    int retry_count = 0;
-    const int MAX_RETRIES = 10;
-    
-    while (total_received < file_size) {
-        ssize_t n = recv(client_socket, file_buffer + total_received, 
-                         file_size - total_received, 0);
-        if (n > 0) {
-                 total_received += n;
-            retry_count = 0; // Reset retry on success
-        } else if (n == 0) {
-            free(file_buffer);
-            send(client_socket, "ERROR|Connection closed\n", 25, 0);
-            return;
-        } else {
-            // n < 0 - error
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                // Timeout - retry
-                retry_count++;
-                if (retry_count > MAX_RETRIES) {
-                    free(file_buffer);
-                    send(client_socket, "ERROR|Upload timeout\n", 22, 0);
-                    return;
-                }
-                usleep(100000); // Sleep 100ms before retry
-                continue;
-            } else {
-                free(file_buffer);
-                send(client_socket, "ERROR|File upload failed\n", 26, 0);
-                return;
-            }
-        }
-    }
-    file_buffer[file_size] = '\0';
-    
-    // Create temp file with unique name
-    char temp_path[256];
-    snprintf(temp_path, sizeof(temp_path), "/tmp/csv_import_%d_%ld.csv", 
-             room_id, (long)time(NULL));
-    
-    FILE *fp = fopen(temp_path, "w");
-    if (!fp) {
-        free(file_buffer);
-        send(client_socket, "ERROR|Cannot create temp file\n", 32, 0);
+    if (rc < 0) {
+        snprintf(response, response_size, "ERROR|%s\n", result->error);
         return;
     }
-    
-    fwrite(file_buffer, 1, file_size, fp);
-    fclose(fp);
-    free(file_buffer);
-    
-    // Import from temp file
-    int imported = import_questions_from_csv(temp_path, room_id);
-    
-    // Delete temp file
-    unlink(temp_path);
-    
-    if (imported < 0) {
-        send(client_socket, "ERROR|Import failed\n", 21, 0);
-    } else {
-        char response[128];
-        snprintf(response, sizeof(response), "IMPORT_OK|%d\n", imported);
-        send(client_socket, response, strlen(response), 0);
+    free(result->question_ids);
+
+    if (result->imported > 0) {
+        metrics_add(METRIC_QUESTIONS, result->imported);
+        question_bank_invalidate(room_id);
+        singleflight_room_changed(room_id);
+        room_catalog_invalidate();
     }
-}
\ No newline at end of file
+
+    snprintf(response, response_size, "IMPORT_OK|%d|%d\n", result->imported, result->skipped);
+}
+
+/*
+ * Import file câu hỏi thi đã upload xong (UPLOAD_COMMIT, xem upload.c);
+ * response IMPORT_OK|imported|skipped hoặc ERROR|reason.
+ * client_socket < 0 (job nền): không gửi gì, chỉ ghi response vào reply.
+ * Trả 0 nếu thành công, -1 nếu lỗi.
+ */
+int import_csv_file(int client_socket, int room_id, const char *path, int report_progress,
+                    char *reply, size_t reply_size)
+{
+    CsvImportResult result;
+    char response[128];
+    int rc = csv_import_from_file(path, CSV_TARGET_EXAM_ROOM, room_id, 0,
+                                  report_progress && client_socket >= 0 ? client_socket : -1, &result);
+    format_import_result(room_id, rc, &result, response, sizeof(response));
+    if (client_socket >= 0) send(client_socket, response, strlen(response), 0);
+    if (reply) snprintf(reply, reply_size, "%s", response);
+    return rc < 0 ? -1 : 0;
+}
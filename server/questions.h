@@ -17,6 +17,7 @@
 void handle_get_user_rooms(int client_socket, int user_id);
 void handle_add_question(int client_socket, char *data);
 int import_questions_from_csv(const char *filename, int room_id);
-void handle_import_csv(int client_socket, char *data);
+int import_csv_file(int client_socket, int room_id, const char *path, int report_progress,
+                    char *reply, size_t reply_size);
 
 #endif
@@ -5,6 +5,19 @@
 #include "rooms.h"
 #include "practice.h"
 #include "timer.h"
+#include "auth.h"
+#include "scheduler.h"
+#include "audit.h"
+#include "journal.h"
+#include "forms.h"
+#include "leaderboard.h"
+#include "live_stats.h"
+#include "user_stats.h"
+#include "analytics.h"
+#include "metrics.h"
+#include "upload.h"
+#include "jobs.h"
+#include "credentials.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -19,21 +32,12 @@
 ServerData server_data;
 sqlite3 *db = NULL;
 
-// Timer thread function - checks room timeouts every 5 seconds
-void *timer_thread(void *arg) {
-    while (1) {
-        sleep(5);
-        check_room_timeouts();
-    }
-    return NULL;
-}
-
 int main()
 {
     int server_socket, *client_socket;
     struct sockaddr_in server_addr, client_addr;
     socklen_t client_len;
-    pthread_t thread_id, timer_tid;
+    pthread_t thread_id;
 
     // Zero initialize server data
     memset(&server_data, 0, sizeof(server_data));
@@ -53,8 +57,19 @@ int main()
     // Initialize DB and load questions
     init_database();
     load_users_from_db();  // Load users vào in-memory structure
+    credentials_load();  // Chỉ mục username -> (id, hash, role) cho LOGIN không cần SQL
+    user_stats_init();  // Rollup thống kê theo user (trigger trên results)
+    leaderboard_seed();  // Bảng xếp hạng in-memory theo tổng điểm
     load_rooms_from_db();  // Load rooms vào in-memory structure
     load_practice_rooms_from_db();  // Load practice rooms
+    audit_start();  // Batched writer cho activity_log/practice_logs
+    journal_start();  // Replay answer journal của lần chạy trước vào SQLite
+    checkpoint_restore();  // Khôi phục các phòng đang thi từ checkpoint
+    forms_start();  // Worker sinh sẵn đề riêng cho thí sinh khi phòng bắt đầu
+    analytics_start();  // Thống kê category/độ khó/câu hỏi, dựng lại từ lịch sử
+    metrics_init();  // Giá trị ban đầu cho registry số liệu dashboard admin
+    upload_init();  // Thư mục staging cho upload theo chunk, dọn file còn sót
+    scheduler_add(SCHED_CHECKPOINT, 0, 0, time(NULL) + CHECKPOINT_INTERVAL);
     // load_sample_questions();
 
     server_socket = socket(AF_INET, SOCK_STREAM, 0);
@@ -79,7 +94,8 @@ int main()
         return 1;
     }
 
-    if (listen(server_socket, 5) < 0)
+    // Backlog rộng: hàng trăm thí sinh kết nối cùng lúc trước giờ thi
+    if (listen(server_socket, SOMAXCONN) < 0)
     {
         perror("Listen failed");
         close(server_socket);
@@ -88,11 +104,33 @@ int main()
 
     printf("Server started on port %d\n", PORT);
     
-    // Start timer thread for room timeout checks
-    if (pthread_create(&timer_tid, NULL, timer_thread, NULL) != 0) {
-        perror("Failed to create timer thread");
-    } else {
-        pthread_detach(timer_tid);
+    // Start deadline scheduler (room end, participant end, practice cooldown, idle sessions)
+    scheduler_register(SCHED_ROOM_DEADLINE, on_room_deadline);
+    scheduler_register(SCHED_PARTICIPANT_DEADLINE, on_participant_deadline);
+    scheduler_register(SCHED_PRACTICE_COOLDOWN, on_practice_cooldown_expired);
+    scheduler_register(SCHED_SESSION_IDLE, on_session_idle);
+    scheduler_register(SCHED_ROOM_TICK, on_room_tick);
+    scheduler_register(SCHED_AUDIT_MAINTENANCE, on_audit_maintenance);
+    scheduler_register(SCHED_CHECKPOINT, on_checkpoint);
+    scheduler_register(SCHED_LIVE_STATS, on_live_stats_push);
+    scheduler_register(SCHED_METRICS_PUSH, on_metrics_push);
+    scheduler_register(SCHED_UPLOAD_EXPIRY, on_upload_expired);
+    scheduler_register(SCHED_ROOM_EXPIRY_RETRY, on_room_expiry_retry);
+    if (scheduler_start() != 0) {
+        fprintf(stderr, "Failed to start deadline scheduler\n");
+    }
+
+    // Background job worker for heavy admin operations (room deletes, async imports)
+    jobs_register(JOB_DELETE_ROOM, run_delete_room_job);
+    jobs_register(JOB_DELETE_PRACTICE, run_delete_practice_job);
+    jobs_register(JOB_IMPORT_UPLOAD, run_upload_import_job);
+    if (jobs_start() != 0) {
+        fprintf(stderr, "Failed to start job worker\n");
+    }
+
+    // Auth worker pool: băm mật khẩu và ghi bảng users ngoài server_data.lock
+    if (auth_pool_start() != 0) {
+        fprintf(stderr, "Failed to start auth workers, verifying credentials inline\n");
     }
 
     while (1)
@@ -1,5 +1,13 @@
 #include "results.h"
 #include "db.h"
+#include "journal.h"
+#include "forms.h"
+#include "leaderboard.h"
+#include "live_stats.h"
+#include "user_stats.h"
+#include "analytics.h"
+#include "metrics.h"
+#include "roster.h"
 #include <sys/socket.h>
 
 extern ServerData server_data;
@@ -32,54 +40,63 @@ static int find_participant_index(TestRoom *room, int user_id) {
 }
 
 /*
- * Helper: ghi toàn bộ đáp án đang lưu in-memory của một user trong room
- * xuống bảng exam_answers theo dạng batch (xóa cũ, thêm mới trong transaction).
+ * Helper: ghi toàn bộ đáp án đang lưu in-memory của một user trong room xuống
+ * exam_answers khi journal không hoạt động (caller giữ server_data.lock):
+ *  - Đọc id các câu được chọn theo thứ tự MỘT lần, bind question_id trực tiếp
+ *  - INSERT OR REPLACE bằng một prepared statement trong một transaction
+ *    (UNIQUE(user_id, room_id, question_id) nên không cần xoá trước).
  */
 static void flush_answers_to_db(int user_id, int room_id, TestRoom *room, int user_idx) {
-    // Xóa các đáp án cũ trong DB
-    char delete_query[256];
-    snprintf(delete_query, sizeof(delete_query),
-             "DELETE FROM exam_answers WHERE user_id = %d AND room_id = %d",
-             user_id, room_id);
-    sqlite3_exec(db, delete_query, NULL, NULL, NULL);
-    
-    // Insert tất cả đáp án mới (batch)
-    sqlite3_exec(db, "BEGIN TRANSACTION", NULL, NULL, NULL);
-    
-    for (int q = 0; q < MAX_QUESTIONS; q++) {
-        UserAnswer *ans = &room->answers[user_idx][q];
-        if (ans->answer >= 0 && ans->answer <= 3) {  // Có đáp án hợp lệ
-            // Lấy question_id thực tế từ DB
-            char get_qid_query[256];
-            snprintf(get_qid_query, sizeof(get_qid_query),
-                     "SELECT id FROM exam_questions WHERE room_id = %d AND is_selected = 1 LIMIT 1 OFFSET %d",
-                     room_id, q);
-            
-            sqlite3_stmt *stmt;
-            if (sqlite3_prepare_v2(db, get_qid_query, -1, &stmt, NULL) == SQLITE_OK) {
-                if (sqlite3_step(stmt) == SQLITE_ROW) {
-                    int question_id = sqlite3_column_int(stmt, 0);
-                    
-                    char insert_query[512];
-                    snprintf(insert_query, sizeof(insert_query),
-                             "INSERT INTO exam_answers (user_id, room_id, question_id, selected_answer, answered_at) "
-                             "VALUES (%d, %d, %d, %d, %ld)",
-                             user_id, room_id, question_id, ans->answer, ans->submit_time);
-                    sqlite3_exec(db, insert_query, NULL, NULL, NULL);
-                }
-                sqlite3_finalize(stmt);
-            }
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE", NULL, NULL, NULL) != SQLITE_OK) {
+        fprintf(stderr, "[RESULTS] Flush answers user=%d room=%d failed: %s\n", user_id, room_id, sqlite3_errmsg(db));
+        return;
+    }
+
+    static int question_ids[MAX_QUESTIONS];  // chỉ dùng trong server_data.lock
+    int question_count = 0;
+    sqlite3_stmt *stmt;
+    int ok = sqlite3_prepare_v2(db, "SELECT id FROM exam_questions WHERE room_id = ? AND is_selected = 1 ORDER BY id",
+                                -1, &stmt, NULL) == SQLITE_OK;
+    if (ok) {
+        sqlite3_bind_int(stmt, 1, room_id);
+        while (question_count < MAX_QUESTIONS && sqlite3_step(stmt) == SQLITE_ROW) {
+            question_ids[question_count++] = sqlite3_column_int(stmt, 0);
         }
+        sqlite3_finalize(stmt);
+    }
+
+    if (ok) {
+        ok = sqlite3_prepare_v2(db,
+                "INSERT OR REPLACE INTO exam_answers (user_id, room_id, question_id, selected_answer, answered_at) "
+                "VALUES (?, ?, ?, ?, ?)", -1, &stmt, NULL) == SQLITE_OK;
+    }
+    for (int q = 0; ok && q < question_count; q++) {
+        UserAnswer *ans = &room->answers[user_idx][q];
+        if (ans->answer < 0 || ans->answer > 3) continue;  // chưa trả lời
+        sqlite3_bind_int(stmt, 1, user_id);
+        sqlite3_bind_int(stmt, 2, room_id);
+        sqlite3_bind_int(stmt, 3, question_ids[q]);
+        sqlite3_bind_int(stmt, 4, ans->answer);
+        sqlite3_bind_int64(stmt, 5, ans->submit_time);
+        ok = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+
+    if (ok) ok = sqlite3_exec(db, "COMMIT", NULL, NULL, NULL) == SQLITE_OK;
+    if (!ok) {
+        fprintf(stderr, "[RESULTS] Flush answers user=%d room=%d failed: %s\n", user_id, room_id, sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
     }
-    
-    sqlite3_exec(db, "COMMIT", NULL, NULL, NULL);
 }
 
 /*
- * Lưu tạm thời đáp án vào bộ nhớ RAM cho một câu hỏi:
+ * Lưu đáp án cho một câu hỏi:
  *  - Validate answer và quyền tham gia phòng
- *  - Map question_id thực sang index trong mảng
- *  - Tự động flush xuống DB mỗi 5 câu hoặc khi làm xong toàn bộ.
+ *  - Map question_id thực sang index trong mảng, đổi đáp án theo đề riêng về đáp án gốc, lưu vào RAM
+ *  - Ghi vào answer journal và chỉ trả SAVE_ANSWER_OK khi bản ghi đã fsync;
+ *    journal thread tự đưa đáp án xuống exam_answers (xem journal.c).
+ *  - Nếu journal không hoạt động thì flush xuống DB mỗi 5 câu như trước.
  */
 void save_answer(int socket_fd, int user_id, int room_id, int question_id, int selected_answer)
 {
@@ -131,26 +148,43 @@ void save_answer(int socket_fd, int user_id, int room_id, int question_id, int s
         return;
     }
     
+    // Đáp án client gửi theo vị trí hiển thị trong đề riêng -> đổi về đáp án gốc
+    selected_answer = forms_unmap_answer(room_id, user_id, question_id, selected_answer);
+    
+    // Cập nhật thống kê trực tiếp cho host (so với đáp án cũ trong RAM)
+    live_stats_record_answer(room_id, user_id, question_idx,
+                             room->answers[user_idx][question_idx].answer, selected_answer);
+    roster_record_answer(room, user_idx, room->answers[user_idx][question_idx].answer, selected_answer);
+    
     // **LƯU VÀO IN-MEMORY**
+    time_t now = time(NULL);
     room->answers[user_idx][question_idx].user_id = user_id;
     room->answers[user_idx][question_idx].answer = selected_answer;
-    room->answers[user_idx][question_idx].submit_time = time(NULL);
+    room->answers[user_idx][question_idx].submit_time = now;
+    metrics_add(METRIC_ANSWERS, 1);
     
-    server_send(socket_fd, "SAVE_ANSWER_OK\n");
+    // **GHI JOURNAL** (thứ tự ghi khớp thứ tự cập nhật in-memory vì vẫn đang giữ lock)
+    uint64_t journal_seq = journal_append(user_id, room_id, question_id, selected_answer, now);
     
-    // **AUTO-SAVE mỗi 5 câu hoặc câu cuối**
-    int answered_count = 0;
-    for (int i = 0; i < MAX_QUESTIONS; i++) {
-        if (room->answers[user_idx][i].answer >= 0) {
-            answered_count++;
+    if (journal_seq == 0) {
+        // **AUTO-SAVE mỗi 5 câu hoặc câu cuối** (fallback khi không có journal)
+        int answered_count = 0;
+        for (int i = 0; i < MAX_QUESTIONS; i++) {
+            if (room->answers[user_idx][i].answer >= 0) {
+                answered_count++;
+            }
+        }
+        
+        if (answered_count % 5 == 0 || answered_count == room->num_questions) {
+            flush_answers_to_db(user_id, room_id, room, user_idx);
         }
-    }
-    
-    if (answered_count % 5 == 0 || answered_count == room->num_questions) {
-        flush_answers_to_db(user_id, room_id, room, user_idx);
     }
     
     pthread_mutex_unlock(&server_data.lock);
+    
+    // Chờ fsync ngoài lock (group commit chung với các thí sinh khác)
+    journal_wait_durable(journal_seq);
+    server_send(socket_fd, "SAVE_ANSWER_OK\n");
 }
 
 /*
@@ -188,17 +222,21 @@ void submit_answer(int socket_fd, int user_id, int room_id, int question_num, in
 
 /*
  * Người dùng nộp bài thi:
- *  - Flush toàn bộ đáp án in-memory xuống DB
+ *  - Chờ journal ghi xong mọi đáp án xuống exam_answers (ngoài lock), hoặc flush đáp án
+ *    in-memory xuống DB nếu journal không hoạt động
  *  - Kiểm tra đã bắt đầu thi, kiểm tra hết giờ
  *  - Tính điểm từ exam_answers vs exam_questions và lưu vào results
  *  - Đánh dấu has_taken_exam để không được thi lại.
  */
 void submit_test(int socket_fd, int user_id, int room_id)
 {
+  // Mọi SAVE_ANSWER của user đã được append trước lệnh này: chờ chúng vào exam_answers
+  int journal_active = journal_wait_applied() == 0;
+
   pthread_mutex_lock(&server_data.lock);
 
-  // **FLUSH tất cả đáp án từ in-memory vào DB trước khi tính điểm**
-  int room_idx = find_room_index(room_id);
+  // **FLUSH tất cả đáp án từ in-memory vào DB trước khi tính điểm** (chỉ khi không có journal)
+  int room_idx = journal_active ? -1 : find_room_index(room_id);
   if (room_idx != -1) {
       TestRoom *room = &server_data.rooms[room_idx];
       int user_idx = find_participant_index(room, user_id);
@@ -291,7 +329,13 @@ void submit_test(int socket_fd, int user_id, int room_id)
       user_id, room_id, score, total_questions, elapsed);
   
   char *err_msg = NULL;
-  sqlite3_exec(db, insert_query, NULL, NULL, &err_msg);
+  if (sqlite3_exec(db, insert_query, NULL, NULL, &err_msg) == SQLITE_OK) {
+      leaderboard_record_result(user_id, score);
+      user_stats_invalidate(user_id);
+      analytics_record_submission(room_id, user_id);
+      metrics_record_submission();
+      roster_update(room_id, user_id, PARTICIPANT_SUBMITTED);
+  }
   sqlite3_free(insert_query);
   
   if (err_msg) {
@@ -351,11 +395,16 @@ void view_results(int socket_fd, int room_id)
 /*
  * Auto-submit khi user disconnect hoặc hết thời gian (dùng trong rooms/timer):
  *  - Giả định lock đã được giữ bởi caller
+ *  - Bỏ qua nếu phòng không còn trong server_data.rooms (đã bị xoá)
  *  - Nếu chưa submit thì tính điểm từ exam_answers và lưu vào results
  *  - Đánh dấu has_taken_exam ở cả participants và room_participants.
  */
 void auto_submit_on_disconnect(int user_id, int room_id)
 {
+  // Phòng đã bị xoá: dữ liệu con đang được job nền dọn, không ghi thêm kết quả
+  if (find_room_index(room_id) == -1) {
+      return;
+  }
   
   // Kiểm tra user đã bắt đầu thi chưa
   char check_query[256];
@@ -434,7 +483,13 @@ void auto_submit_on_disconnect(int user_id, int room_id)
       user_id, room_id, score, total_questions, elapsed);
   
   char *err_msg = NULL;
-  sqlite3_exec(db, insert_query, NULL, NULL, &err_msg);
+  if (sqlite3_exec(db, insert_query, NULL, NULL, &err_msg) == SQLITE_OK) {
+      leaderboard_record_result(user_id, score);
+      user_stats_invalidate(user_id);
+      analytics_record_submission(room_id, user_id);
+      metrics_record_submission();
+      roster_update(room_id, user_id, PARTICIPANT_AUTO_SUBMITTED);
+  }
   sqlite3_free(insert_query);
   
   if (err_msg) {
@@ -463,6 +518,9 @@ void auto_submit_on_disconnect(int user_id, int room_id)
  * đáp án của một user trong một phòng xuống DB exam_answers.
  */
 void flush_user_answers(int user_id, int room_id) {
+    // Journal đã giữ mọi đáp án: chỉ cần chờ chúng vào exam_answers (RESUME đọc từ DB)
+    if (journal_wait_applied() == 0) return;
+
     pthread_mutex_lock(&server_data.lock);
     int room_idx = find_room_index(room_id);
     if (room_idx != -1) {
@@ -2,6 +2,22 @@
 #include "db.h"
 #include "results.h"
 #include "network.h"
+#include "timer.h"
+#include "scheduler.h"
+#include "journal.h"
+#include "selection.h"
+#include "forms.h"
+#include "catalog.h"
+#include "live_stats.h"
+#include "leaderboard.h"
+#include "user_stats.h"
+#include "analytics.h"
+#include "pager.h"
+#include "metrics.h"
+#include "pubsub.h"
+#include "jobs.h"
+#include "singleflight.h"
+#include "roster.h"
 #include <sys/socket.h>
 #include <unistd.h>  // for usleep
 
@@ -18,7 +34,7 @@ static void load_room_answers_internal(int room_id, int user_id);
  *  - Lưu cấu hình easy/medium/hard vào bảng rooms
  *  - Câu hỏi sẽ được chọn ngẫu nhiên theo cấu hình này khi admin START_ROOM
  */
-void create_test_room(int socket_fd, int creator_id, char *room_name, int num_q, int time_limit, int easy_count, int medium_count, int hard_count) {
+void create_test_room(int socket_fd, int creator_id, char *room_name, int time_limit, int easy_count, int medium_count, int hard_count) {
   pthread_mutex_lock(&server_data.lock);
 
   // Kiểm tra role - chỉ admin mới được tạo room
@@ -152,6 +168,7 @@ void create_test_room(int socket_fd, int creator_id, char *room_name, int num_q,
       memset(server_data.rooms[idx].answers, -1, sizeof(server_data.rooms[idx].answers));
       
       server_data.room_count++;
+      metrics_add(METRIC_ACTIVE_ROOMS, 1);
   }
 
   // ===== GỬI RESPONSE =====
@@ -170,6 +187,7 @@ void create_test_room(int socket_fd, int creator_id, char *room_name, int num_q,
            room_name, room_id, time_limit, total_questions, easy_count, medium_count, hard_count);
   log_activity(creator_id, "CREATE_ROOM", log_details);
 
+  room_catalog_invalidate();
   pthread_mutex_unlock(&server_data.lock);
   
   // ===== BROADCAST ROOM CREATED =====
@@ -178,82 +196,11 @@ void create_test_room(int socket_fd, int creator_id, char *room_name, int num_q,
 
 /*
  * Liệt kê danh sách các phòng thi đang mở:
- *  - Join với users để lấy tên host
- *  - Đếm số câu hỏi của từng phòng và trả về cho client.
+ *  - Trả từ danh mục phòng materialize trong bộ nhớ (xem catalog.c)
+ *  - known_version: version client đang giữ, nếu chưa đổi thì trả NOT_MODIFIED.
  */
-void list_test_rooms(int socket_fd) {
-  pthread_mutex_lock(&server_data.lock);
-
-  sqlite3_stmt *stmt;
-  
-  const char *sql = 
-    "SELECT "
-    "  r.id, "
-    "  r.name, "
-    "  r.duration, "
-    "  r.is_active, "
-    "  u.username, "
-    "  COUNT(q.id) as question_count "
-    "FROM rooms r "
-    "JOIN users u ON r.host_id = u.id "
-    "LEFT JOIN exam_questions q ON r.id = q.room_id "
-    "WHERE r.is_active = 1 "
-    "GROUP BY r.id "
-    "ORDER BY r.created_at DESC;";
-  
-  int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, 0);
-  
-  if (rc != SQLITE_OK) {
-    char response[] = "LIST_ROOMS_FAIL|Database error\n";
-    server_send(socket_fd, response);
-    pthread_mutex_unlock(&server_data.lock);
-    return;
-  }
-
-  char response[8192];
-  int offset = 0;
-  int room_count = 0;
-
-  // Đếm số rooms trước
-  while (sqlite3_step(stmt) == SQLITE_ROW) {
-    room_count++;
-  }
-  sqlite3_reset(stmt);
-
-  // Header với count
-  offset += snprintf(response + offset, sizeof(response) - offset, 
-                     "LIST_ROOMS_OK|%d\n", room_count);
-
-  // List từng room
-  while (sqlite3_step(stmt) == SQLITE_ROW) {
-    if (offset >= sizeof(response) - 1000) break;
-
-    int room_id = sqlite3_column_int(stmt, 0);
-    const char *room_name = (const char*)sqlite3_column_text(stmt, 1);
-    int duration = sqlite3_column_int(stmt, 2);
-    // int is_active = sqlite3_column_int(stmt, 3);  // Unused
-    const char *host = (const char*)sqlite3_column_text(stmt, 4);
-    int question_count = sqlite3_column_int(stmt, 5);
-
-    const char *status_str = "Open";
-
-    char question_info[50];
-    if (question_count == 0) {
-      strcpy(question_info, "Chưa có question");
-    } else {
-      snprintf(question_info, sizeof(question_info), "%d questions", question_count);
-    }
-
-    offset += snprintf(response + offset, sizeof(response) - offset,
-                       "ROOM|%d|%s|%d|%s|%s|%s\n",
-                       room_id, room_name, duration, status_str, question_info, host);
-  }
-
-  sqlite3_finalize(stmt);
-
-  response[offset] = '\0';
-  server_send(socket_fd, response);
-  pthread_mutex_unlock(&server_data.lock);
+void list_test_rooms(int socket_fd, unsigned long known_version) {
+  room_catalog_list(socket_fd, known_version);
 }
 
 /*
@@ -360,6 +307,14 @@ void join_test_room(int socket_fd, int user_id, int room_id) {
     return;
   }
 
+  // Hiện ngay trên màn hình giám sát của host (JOINED) nếu phòng đang trong bộ nhớ
+  for (int i = 0; i < server_data.room_count; i++) {
+    if (server_data.rooms[i].room_id == room_id) {
+      if (server_data.rooms[i].creator_id != user_id) roster_join(&server_data.rooms[i], user_id);
+      break;
+    }
+  }
+
   char response[] = "JOIN_ROOM_OK\n";
   server_send(socket_fd, response);
 
@@ -443,6 +398,8 @@ void close_room(int socket_fd, int user_id, int room_id) {
     return;
   }
 
+  room_catalog_invalidate();
+
   char response[128];
   snprintf(response, sizeof(response), "CLOSE_ROOM_OK|Room %d closed\n", room_id);
   server_send(socket_fd, response);
@@ -453,11 +410,23 @@ void close_room(int socket_fd, int user_id, int room_id) {
   pthread_mutex_unlock(&server_data.lock);
 }
 
-void list_my_rooms(int socket_fd, int user_id) {
-  pthread_mutex_lock(&server_data.lock);
+// Một dòng của LIST_MY_ROOMS, chép ra khỏi SQLite trước khi gửi
+typedef struct {
+  int room_id;
+  char room_name[100];
+  int duration;
+  const char *status;
+  int question_count;
+} MyRoomRow;
 
-  sqlite3_stmt *stmt;
-  
+/*
+ * Danh sách phòng do user tạo, mới nhất trước:
+ *  - cursor = id phòng cuối trang trước (0 = từ đầu), limit = số dòng tối đa của trang
+ *  - Đọc trên read connection của thread, không giữ server_data.lock; các dòng được chép
+ *    vào buffer cố định limit dòng để có số lượng cho header, rồi mới stream
+ *  - Kết thúc bằng dòng "NEXT|<cursor>" (NEXT|0 = trang cuối).
+ */
+void list_my_rooms(int socket_fd, int user_id, int cursor, int limit) {
   const char *sql = 
     "SELECT "
     "  r.id, "
@@ -468,80 +437,91 @@ void list_my_rooms(int socket_fd, int user_id) {
     "  COUNT(q.id) as question_count "
     "FROM rooms r "
     "LEFT JOIN exam_questions q ON r.id = q.room_id "
-    "WHERE r.host_id = ? "
+    "WHERE r.host_id = ? AND (? = 0 OR r.id < ?) "
     "GROUP BY r.id "
-    "ORDER BY r.created_at DESC;";
-  
-  int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, 0);
-  
-  if (rc != SQLITE_OK) {
+    "ORDER BY r.id DESC LIMIT ?;";
+
+  sqlite3 *conn = db_thread_read_connection();
+  sqlite3_stmt *stmt = NULL;
+  MyRoomRow *rows = malloc(sizeof(MyRoomRow) * limit);
+  if (!rows || !conn || sqlite3_prepare_v2(conn, sql, -1, &stmt, 0) != SQLITE_OK) {
     char response[] = "LIST_MY_ROOMS_FAIL|Database error\n";
     server_send(socket_fd, response);
-    pthread_mutex_unlock(&server_data.lock);
+    free(rows);
     return;
   }
 
   sqlite3_bind_int(stmt, 1, user_id);
+  sqlite3_bind_int(stmt, 2, cursor);
+  sqlite3_bind_int(stmt, 3, cursor);
+  sqlite3_bind_int(stmt, 4, limit + 1);
 
-  char response[8192];
-  int offset = 0;
   int room_count = 0;
+  int has_more = 0;
+  time_t now = time(NULL);
 
-  // Đếm số rooms trước
-  while (sqlite3_step(stmt) == SQLITE_ROW) {
-    room_count++;
-  }
-  sqlite3_reset(stmt);
-
-  // Header với count
-  offset += snprintf(response + offset, sizeof(response) - offset, 
-                     "LIST_MY_ROOMS_OK|%d\n", room_count);
-
-  // List từng room
+  // Đọc dư một dòng để biết còn trang sau
   while (sqlite3_step(stmt) == SQLITE_ROW) {
-    if (offset >= sizeof(response) - 1000) break;
+    if (room_count == limit) {
+      has_more = 1;
+      break;
+    }
 
-    int room_id = sqlite3_column_int(stmt, 0);
+    MyRoomRow *row = &rows[room_count++];
     const char *room_name = (const char*)sqlite3_column_text(stmt, 1);
-    int duration = sqlite3_column_int(stmt, 2);
     int room_status = sqlite3_column_int(stmt, 3);
     long exam_start_time = sqlite3_column_int64(stmt, 4);
-    int question_count = sqlite3_column_int(stmt, 5);
+    row->room_id = sqlite3_column_int(stmt, 0);
+    snprintf(row->room_name, sizeof(row->room_name), "%s", room_name ? room_name : "");
+    row->duration = sqlite3_column_int(stmt, 2);
+    row->question_count = sqlite3_column_int(stmt, 5);
 
-    const char *status_str;
     if (room_status == 0) {
-      status_str = "Waiting";
+      row->status = "Waiting";
     } else if (room_status == 1) {
-      time_t now = time(NULL);
-      if (now - exam_start_time > (long)duration * 60) {
-          status_str = "Ended";
+      if (now - exam_start_time > (long)row->duration * 60) {
+          row->status = "Ended";
       } else {
-          status_str = "Started";
+          row->status = "Started";
       }
     } else {
-      status_str = "Ended";
+      row->status = "Ended";
     }
+  }
 
+  sqlite3_finalize(stmt);
+
+  // Header với count
+  PageStream ps;
+  page_stream_begin(&ps, socket_fd);
+  page_stream_printf(&ps, "LIST_MY_ROOMS_OK|%d\n", room_count);
+
+  // List từng room
+  for (int i = 0; i < room_count; i++) {
     char question_info[50];
-    if (question_count == 0) {
+    if (rows[i].question_count == 0) {
       strcpy(question_info, "No questions");
     } else {
-      snprintf(question_info, sizeof(question_info), "%d questions", question_count);
+      snprintf(question_info, sizeof(question_info), "%d questions", rows[i].question_count);
     }
 
-    offset += snprintf(response + offset, sizeof(response) - offset,
-                       "ROOM|%d|%s|%d|%s|%s\n",
-                       room_id, room_name, duration, status_str, question_info);
+    page_stream_printf(&ps, "ROOM|%d|%s|%d|%s|%s\n",
+                       rows[i].room_id, rows[i].room_name, rows[i].duration,
+                       rows[i].status, question_info);
   }
 
-  sqlite3_finalize(stmt);
-
-  response[offset] = '\0';
-  server_send(socket_fd, response);
-  pthread_mutex_unlock(&server_data.lock);
+  page_stream_next(&ps, has_more ? rows[room_count - 1].room_id : 0);
+  page_stream_end(&ps);
+  free(rows);
 }
 
-// Delete a room (admin only)
+/*
+ * Xoá phòng thi (chủ phòng):
+ *  - Gỡ phòng khỏi in-memory, xoá dòng rooms và báo ROOM_DELETED ngay
+ *  - Dữ liệu con (exam_answers, participants, exam_questions, results) có thể rất lớn
+ *    nên được xoá theo lô trên job nền JOB_DELETE_ROOM
+ * Response: DELETE_ROOM_OK|job_id
+ */
 void delete_room(int socket_fd, int user_id, int room_id) {
   // Danh sách socket của các participant để broadcast sau khi nhả lock
   int participant_sockets[MAX_CLIENTS];
@@ -607,16 +587,10 @@ void delete_room(int socket_fd, int user_id, int room_id) {
 
   if (room_idx != -1) {
     TestRoom *room = &server_data.rooms[room_idx];
-    for (int i = 0; i < room->participant_count && participant_count < MAX_CLIENTS; i++) {
-      int pid = room->participants[i];
-      // Tìm socket tương ứng trong danh sách user online
-      for (int j = 0; j < server_data.user_count && participant_count < MAX_CLIENTS; j++) {
-        if (server_data.users[j].user_id == pid && server_data.users[j].is_online == 1) {
-          participant_sockets[participant_count++] = server_data.users[j].socket_fd;
-          break;
-        }
-      }
-    }
+    participant_count = collect_room_sockets(room, 0, participant_sockets, MAX_CLIENTS);
+
+    if (room->room_status != 2) metrics_add(METRIC_ACTIVE_ROOMS, -1);
+    if (room->room_status == 1) metrics_add(METRIC_RUNNING_EXAMS, -1);
 
     // Xoá room khỏi in-memory
     for (int j = room_idx; j < server_data.room_count - 1; j++) {
@@ -625,40 +599,132 @@ void delete_room(int socket_fd, int user_id, int room_id) {
     server_data.room_count--;
   }
 
+  // Chỉ xoá dòng rooms ở đây, phần còn lại do job nền xử lý
+  rc = sqlite3_prepare_v2(db, "DELETE FROM rooms WHERE id = ?;", -1, &stmt, 0);
+  if (rc == SQLITE_OK) {
+    sqlite3_bind_int(stmt, 1, room_id);
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+  }
+
+  // Hàng đợi đầy (job_id = 0): xoá dữ liệu con ngay trên thread này như trước
+  int job_id = job_submit(JOB_DELETE_ROOM, user_id, room_id);
+  if (job_id < 0) job_id = 0;
+
   pthread_mutex_unlock(&server_data.lock);
 
+  // Deadline riêng của thí sinh và nhịp TIME_UPDATE không được chạy trên phòng đã xoá
+  scheduler_cancel(SCHED_ROOM_DEADLINE, room_id, 0);
+  scheduler_cancel(SCHED_ROOM_TICK, room_id, 0);
+  scheduler_cancel(SCHED_LIVE_STATS, room_id, 0);
+  scheduler_cancel_all(SCHED_PARTICIPANT_DEADLINE, room_id);
+  room_catalog_invalidate();
+  live_stats_reset(room_id);
+
   // ===== BROADCAST RA NGOÀI LOCK =====
   char broadcast_msg[256];
   snprintf(broadcast_msg, sizeof(broadcast_msg), "ROOM_DELETED|%d\n", room_id);
-  for (int i = 0; i < participant_count; i++) {
-    server_send(participant_sockets[i], broadcast_msg);
-  }
-
-  // ===== DELETE FROM DATABASE (HARD DELETE) =====
-  // Delete associated data: exam_answers, participants, questions
-  const char *sqls[] = {
-    "DELETE FROM exam_answers WHERE room_id = ?;",
-    "DELETE FROM participants WHERE room_id = ?;",
-    "DELETE FROM exam_questions WHERE room_id = ?;",  // Permanently delete questions
-    "DELETE FROM results WHERE room_id = ?;",
-    "DELETE FROM rooms WHERE id = ?;"  // Hard delete the room
-  };
-  
-  for (int i = 0; i < 5; i++) {
-    rc = sqlite3_prepare_v2(db, sqls[i], -1, &stmt, 0);
-    if (rc == SQLITE_OK) {
-      sqlite3_bind_int(stmt, 1, room_id);
-      rc = sqlite3_step(stmt);
-      sqlite3_finalize(stmt);
+  publish_room_event(room_id, participant_sockets, participant_count, broadcast_msg);
+  char room_topic[PUBSUB_TOPIC_LEN];
+  pubsub_room_topic(room_topic, sizeof(room_topic), room_id);
+  pubsub_drop_topic(room_topic);
+
+  char response[64];
+  snprintf(response, sizeof(response), "DELETE_ROOM_OK|%d\n", job_id);
+  server_send(socket_fd, response);
+
+  if (job_id == 0) job_run_inline(JOB_DELETE_ROOM, user_id, room_id);
+}
+
+/*
+ * Xoá results của phòng theo lô JOB_BATCH_ROWS dòng. Mỗi lô là một câu DELETE ... RETURNING
+ * (nguyên tử); chỉ khi lô đã xoá xong mới trừ bảng xếp hạng, bỏ cache thống kê và giảm
+ * METRIC_TOTAL_TESTS cho đúng các dòng đó (rollup user_stats do trigger DELETE tự cập nhật).
+ * Trả về số dòng đã xoá, -1 nếu lỗi.
+ */
+static long delete_room_results(int job_id, sqlite3 *conn, int room_id) {
+  char sql[256];
+  snprintf(sql, sizeof(sql),
+           "DELETE FROM results WHERE rowid IN (SELECT rowid FROM results WHERE room_id = ? LIMIT %d) "
+           "RETURNING user_id, score",
+           JOB_BATCH_ROWS);
+  sqlite3_stmt *stmt;
+  if (sqlite3_prepare_v2(conn, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    fprintf(stderr, "[JOBS] Prepare failed (results): %s\n", sqlite3_errmsg(conn));
+    return -1;
+  }
+
+  int users[JOB_BATCH_ROWS];
+  int scores[JOB_BATCH_ROWS];
+  long deleted = 0;
+  while (1) {
+    sqlite3_bind_int(stmt, 1, room_id);
+    int count = 0;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW && count < JOB_BATCH_ROWS) {
+      users[count] = sqlite3_column_int(stmt, 0);
+      scores[count] = sqlite3_column_int(stmt, 1);
+      count++;
+    }
+    sqlite3_reset(stmt);
+    if (rc != SQLITE_DONE) {
+      fprintf(stderr, "[JOBS] Delete failed (results): %s\n", sqlite3_errmsg(conn));
+      deleted = -1;
+      break;
+    }
+
+    for (int i = 0; i < count; i++) {
+      leaderboard_remove_result(users[i], scores[i]);
+      user_stats_invalidate(users[i]);
     }
+    metrics_add(METRIC_TOTAL_TESTS, -count);
+    deleted += count;
+    job_advance(job_id, count);
+    if (count < JOB_BATCH_ROWS) break;
+    usleep(JOB_YIELD_MS * 1000);
   }
-  
-  // ===== SEND RESPONSE TO ADMIN CUỐI CÙNG =====
-  char response[] = "DELETE_ROOM_OK\n";
-  server_send(socket_fd, response);
+  sqlite3_finalize(stmt);
+  return deleted;
 }
 
-void start_test(int socket_fd, int user_id, int room_id) {
+/*
+ * Job JOB_DELETE_ROOM: xoá dữ liệu con của phòng thi đã bị xoá, theo lô.
+ * Chạy trên worker của jobs.c với connection riêng, không giữ lock nào.
+ */
+int run_delete_room_job(int job_id, int room_id, int user_id, sqlite3 *conn,
+                        char *message, size_t message_size) {
+  (void)user_id;
+  static const char *tables[] = {"exam_answers", "participants", "exam_questions", "results"};
+  long total = 0;
+  for (int i = 0; i < 4; i++) total += job_count_rows(conn, tables[i], "room_id = ?", room_id);
+  job_progress(job_id, 0, total);
+
+  long deleted = 0;
+  for (int i = 0; i < 4; i++) {
+    // tables[3] là results: bảng xếp hạng/thống kê chỉ được trừ theo lô đã xoá xong
+    long n = i == 3 ? delete_room_results(job_id, conn, room_id)
+                    : job_delete_batched(job_id, conn, tables[i], "room_id = ?", room_id);
+    if (n < 0) {
+      snprintf(message, message_size, "Failed to delete %s of room %d", tables[i], room_id);
+      return -1;
+    }
+    // tables[2] là câu hỏi của phòng
+    if (i == 2) metrics_add(METRIC_QUESTIONS, -n);
+    deleted += n;
+  }
+  question_bank_invalidate(room_id);
+  singleflight_room_changed(room_id);
+  analytics_rebuild();
+
+  snprintf(message, message_size, "Room %d deleted (%ld rows)", room_id, deleted);
+  return 0;
+}
+
+// START_ROOM chạy tuần tự: is_selected được ghi ngoài server_data.lock, không để hai lần
+// start đan xen giữa lúc chọn câu và lúc chuyển phòng sang STARTED
+static pthread_mutex_t start_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void start_test_serialized(int socket_fd, int user_id, int room_id) {
   pthread_mutex_lock(&server_data.lock);
 
   // Kiểm tra room có tồn tại trong database không
@@ -742,83 +808,41 @@ void start_test(int socket_fd, int user_id, int room_id) {
       return;
     }
 
-    // ===== VALIDATE QUESTION AVAILABILITY FOR EACH DIFFICULTY =====
-    const char *difficulties[] = {"easy", "medium", "hard"};
+    // ===== CHỌN NGẪU NHIÊN TỪ NGÂN HÀNG CÂU HỎI IN-MEMORY =====
+    // Bucket theo độ khó đã chuẩn hoá + lấy mẫu Floyd, ghi is_selected trong một transaction
     const char *difficulty_names[] = {"Easy", "Medium", "Hard"};
-    int required_counts[] = {easy_count, medium_count, hard_count};
-    
-    for (int d = 0; d < 3; d++) {
-      if (required_counts[d] > 0) {
-        // Count available questions for this difficulty
-        char count_sql[256];
-        snprintf(count_sql, sizeof(count_sql),
-                 "SELECT COUNT(*) FROM exam_questions WHERE room_id = %d AND TRIM(LOWER(difficulty)) = '%s'",
-                 room_id, difficulties[d]);
-        
-        sqlite3_stmt *count_stmt;
-        int available = 0;
-        if (sqlite3_prepare_v2(db, count_sql, -1, &count_stmt, NULL) == SQLITE_OK) {
-          if (sqlite3_step(count_stmt) == SQLITE_ROW) {
-            available = sqlite3_column_int(count_stmt, 0);
-          }
-          sqlite3_finalize(count_stmt);
-        }
-        
-        if (available < required_counts[d]) {
+    int required_counts[DIFFICULTY_LEVELS] = {easy_count, medium_count, hard_count};
+    int available_counts[DIFFICULTY_LEVELS] = {0, 0, 0};
+    int selected_counts[DIFFICULTY_LEVELS] = {0, 0, 0};
+
+    // Transaction ghi is_selected không giữ server_data.lock; start_lock giữ phòng khỏi bị start song song
+    pthread_mutex_unlock(&server_data.lock);
+    int rc = select_random_questions(room_id, required_counts, available_counts, selected_counts);
+    pthread_mutex_lock(&server_data.lock);
+    if (rc == -1) {
+      for (int d = 0; d < DIFFICULTY_LEVELS; d++) {
+        if (required_counts[d] > available_counts[d]) {
           char response[256];
           snprintf(response, sizeof(response), 
                    "START_ROOM_FAIL|Not enough %s questions: need %d but have %d\n",
-                   difficulty_names[d], required_counts[d], available);
+                   difficulty_names[d], required_counts[d], available_counts[d]);
           server_send(socket_fd, response);
-          pthread_mutex_unlock(&server_data.lock);
-          return;
+          break;
         }
       }
+      pthread_mutex_unlock(&server_data.lock);
+      return;
     }
-
-    // Reset tất cả câu hỏi của room về is_selected = 0
-    char reset_sql[256];
-    snprintf(reset_sql, sizeof(reset_sql),
-             "UPDATE exam_questions SET is_selected = 0 WHERE room_id = %d", room_id);
-    if (sqlite3_exec(db, reset_sql, 0, 0, &err_msg) != SQLITE_OK) {
-      sqlite3_free(err_msg);
-      err_msg = NULL;
-    }
-
-    // Với mỗi độ khó, nếu có cấu hình > 0 thì chọn ngẫu nhiên trong ngân hàng exam_questions của room
-    // Sử dụng TRIM(LOWER()) để normalize difficulty values và tránh whitespace issues
-    int easy_selected = 0;
-    int medium_selected = 0;
-    int hard_selected = 0;
-
-    // Helper function để chọn câu hỏi theo difficulty
-    int counts[] = {easy_count, medium_count, hard_count};
-    int *selected_counts[] = {&easy_selected, &medium_selected, &hard_selected};
-    
-    for (int d = 0; d < 3; d++) {
-      if (counts[d] > 0) {
-        char diff_query[512];
-        snprintf(diff_query, sizeof(diff_query),
-                 "SELECT id FROM exam_questions WHERE room_id = %d AND TRIM(LOWER(difficulty)) = '%s' ORDER BY RANDOM() LIMIT %d",
-                 room_id, difficulties[d], counts[d]);
-        
-        sqlite3_stmt *s;
-        if (sqlite3_prepare_v2(db, diff_query, -1, &s, NULL) == SQLITE_OK) {
-          while (sqlite3_step(s) == SQLITE_ROW) {
-            int qid = sqlite3_column_int(s, 0);
-            char mark_sql[256];
-            snprintf(mark_sql, sizeof(mark_sql),
-                     "UPDATE exam_questions SET is_selected = 1 WHERE id = %d", qid);
-            if (sqlite3_exec(db, mark_sql, NULL, NULL, NULL) == SQLITE_OK) {
-              selected_total++;
-              (*selected_counts[d])++;
-            }
-          }
-          sqlite3_finalize(s);
-        } else {
-        }
-      }
+    if (rc < 0) {
+      char response[] = "START_ROOM_FAIL|Database error while selecting questions\n";
+      server_send(socket_fd, response);
+      pthread_mutex_unlock(&server_data.lock);
+      return;
     }
+    selected_total = rc;
+    int easy_selected = selected_counts[0];
+    int medium_selected = selected_counts[1];
+    int hard_selected = selected_counts[2];
 
     // Log tổng kết số câu đã chọn theo từng difficulty
     printf("[DEBUG] start_test (RANDOM): room=%d, easy=%d/%d, medium=%d/%d, hard=%d/%d, total=%d\n",
@@ -850,14 +874,31 @@ void start_test(int socket_fd, int user_id, int room_id) {
     return;
   }
 
-  // Đồng bộ lại num_questions in-memory theo số câu thực sự chọn được
-  if (room_idx != -1) {
-    server_data.rooms[room_idx].num_questions = selected_total;
+  // Lock đã được nhả trong lúc chọn câu: phòng có thể đã bị xoá hoặc dời vị trí trong mảng
+  room_idx = -1;
+  for (int i = 0; i < server_data.room_count; i++) {
+    if (server_data.rooms[i].room_id == room_id) {
+      room_idx = i;
+      break;
+    }
+  }
+  if (room_idx == -1) {
+    char response[] = "START_ROOM_FAIL|Room not loaded in memory\n";
+    server_send(socket_fd, response);
+    pthread_mutex_unlock(&server_data.lock);
+    return;
   }
 
+  // Đồng bộ lại num_questions in-memory theo số câu thực sự chọn được
+  server_data.rooms[room_idx].num_questions = selected_total;
+
   // Update room status: WAITING -> STARTED (both in-memory and DB)
   time_t start_time = time(NULL);
+  int previous_status = server_data.rooms[room_idx].room_status;
+  if (previous_status == 2) metrics_add(METRIC_ACTIVE_ROOMS, 1);  // phòng đã kết thúc được mở thi lại
+  if (previous_status != 1) metrics_add(METRIC_RUNNING_EXAMS, 1);
   server_data.rooms[room_idx].room_status = 1;  // STARTED
+  singleflight_room_changed(room_id);  // bộ câu hỏi mới chọn, bỏ kết quả BEGIN_EXAM cũ
   server_data.rooms[room_idx].exam_start_time = start_time;
 
   // Update database status
@@ -868,6 +909,16 @@ void start_test(int socket_fd, int user_id, int room_id) {
     sqlite3_free(err_msg);
   }
 
+  // Hẹn giờ kết thúc phòng đúng deadline (thay cho quét định kỳ)
+  timer_schedule_room(room_id, start_time, server_data.rooms[room_idx].time_limit);
+  timer_schedule_room_ticks(room_id);
+  checkpoint_request();
+  room_catalog_invalidate();
+  live_stats_reset(room_id);
+
+  // Sinh sẵn đề riêng cho các thí sinh ở worker nền (không làm trễ ROOM_STARTED)
+  forms_prepare(room_id);
+
   char response[128];
   snprintf(response, sizeof(response), "START_ROOM_OK|Room %d started\n", room_id);
   server_send(socket_fd, response);
@@ -876,6 +927,10 @@ void start_test(int socket_fd, int user_id, int room_id) {
   snprintf(log_details, sizeof(log_details), "Started exam in room ID=%d", room_id);
   log_activity(user_id, "START_ROOM", log_details);
 
+  int participant_sockets[MAX_CLIENTS];
+  int participant_count = collect_room_sockets(&server_data.rooms[room_idx], 0,
+                                               participant_sockets, MAX_CLIENTS);
+
   pthread_mutex_unlock(&server_data.lock);
   
   // ===== BROADCAST ROOM STARTED =====
@@ -883,7 +938,187 @@ void start_test(int socket_fd, int user_id, int room_id) {
   snprintf(broadcast_msg, sizeof(broadcast_msg), 
            "ROOM_STARTED|%d|%ld\n", 
            room_id, start_time);
-  broadcast_to_room_participants(room_id, broadcast_msg);
+  publish_room_event(room_id, participant_sockets, participant_count, broadcast_msg);
+}
+
+void start_test(int socket_fd, int user_id, int room_id) {
+  pthread_mutex_lock(&start_lock);
+  start_test_serialized(socket_fd, user_id, room_id);
+  pthread_mutex_unlock(&start_lock);
+}
+
+/*
+ * Câu hỏi đã chọn của phòng, đọc một lần từ DB:
+ *  - stmt trả về (id, text, a, b, c, d, difficulty[, saved_answer]) theo id tăng dần
+ *  - Không có saved_answer thì bộ câu hỏi giống nhau cho mọi thí sinh -> BEGIN_EXAM
+ *    dùng chung qua singleflight (bất biến sau khi đọc xong).
+ */
+typedef struct {
+  int id;
+  char *text;
+  char *options[4];
+  char difficulty[20];
+  int saved_answer;
+} FormRow;
+
+typedef struct {
+  FormRow *rows;
+  int count;
+  size_t text_size;
+} FormRows;
+
+static void free_form_rows(void *data) {
+  FormRows *set = data;
+  if (!set) return;
+  for (int i = 0; i < set->count; i++) {
+    free(set->rows[i].text);
+    for (int o = 0; o < 4; o++) free(set->rows[i].options[o]);
+  }
+  free(set->rows);
+  free(set);
+}
+
+static FormRows *read_form_rows(sqlite3_stmt *stmt, int with_saved) {
+  FormRows *set = calloc(1, sizeof(FormRows));
+  int capacity = 64;
+  if (set) set->rows = malloc(sizeof(FormRow) * capacity);
+  if (!set || !set->rows) {
+    free(set);
+    return NULL;
+  }
+
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    if (set->count == capacity) {
+      FormRow *grown = realloc(set->rows, sizeof(FormRow) * capacity * 2);
+      if (!grown) break;
+      set->rows = grown;
+      capacity *= 2;
+    }
+    FormRow *row = &set->rows[set->count];
+    row->id = sqlite3_column_int(stmt, 0);
+    const char *q_text = (const char *)sqlite3_column_text(stmt, 1);
+    row->text = strdup(q_text ? q_text : "");
+    set->text_size += strlen(row->text);
+    for (int o = 0; o < 4; o++) {
+      const char *opt = (const char *)sqlite3_column_text(stmt, 2 + o);
+      row->options[o] = strdup(opt ? opt : "");
+      set->text_size += strlen(row->options[o]);
+    }
+    const char *difficulty = (const char *)sqlite3_column_text(stmt, 6);
+
+    // Normalize difficulty: convert to proper case (easy -> Easy, medium -> Medium, hard -> Hard)
+    strcpy(row->difficulty, "Medium");  // default
+    if (difficulty && strlen(difficulty) > 0) {
+      if (strcasecmp(difficulty, "easy") == 0) {
+        strcpy(row->difficulty, "Easy");
+      } else if (strcasecmp(difficulty, "medium") == 0) {
+        strcpy(row->difficulty, "Medium");
+      } else if (strcasecmp(difficulty, "hard") == 0) {
+        strcpy(row->difficulty, "Hard");
+      } else {
+        // Keep original but capitalize first letter
+        strncpy(row->difficulty, difficulty, sizeof(row->difficulty) - 1);
+        row->difficulty[sizeof(row->difficulty) - 1] = '\0';
+        if (row->difficulty[0] >= 'a' && row->difficulty[0] <= 'z') {
+          row->difficulty[0] -= 32;
+        }
+      }
+    }
+
+    // saved_answer có thể NULL nếu chưa trả lời
+    row->saved_answer = -1;
+    if (with_saved && sqlite3_column_type(stmt, 7) != SQLITE_NULL) {
+      row->saved_answer = sqlite3_column_int(stmt, 7);
+    }
+    set->count++;
+  }
+  return set;
+}
+
+/*
+ * Serialize câu hỏi theo đề riêng của thí sinh (xem forms.c):
+ *  - Câu hỏi được sắp theo thứ tự của đề, đáp án A-D theo hoán vị của từng câu
+ *  - saved_answer (đáp án gốc) được đổi sang vị trí hiển thị.
+ * Không sửa set (có thể đang dùng chung). Trả về chuỗi đã malloc (caller free),
+ * NULL nếu lỗi; *question_count = số câu.
+ */
+static char *render_exam_form(const FormRows *set, int room_id, int user_id,
+                              const char *header, int with_saved, int *question_count) {
+  int n = set->count;
+  const FormRow *rows = set->rows;
+  *question_count = 0;
+
+  char *response = NULL;
+  int *question_ids = malloc(sizeof(int) * (n > 0 ? n : 1));
+  uint16_t *order = malloc(sizeof(uint16_t) * (n > 0 ? n : 1));
+  uint8_t *options = malloc(n > 0 ? n : 1);
+  size_t buf_size = set->text_size + (size_t)n * 64 + 256;
+  if (question_ids && order && options) {
+    response = malloc(buf_size);
+  }
+
+  if (response) {
+    for (int i = 0; i < n; i++) {
+      question_ids[i] = rows[i].id;
+    }
+    forms_get(room_id, user_id, question_ids, n, order, options);
+
+    size_t offset = snprintf(response, buf_size, "%s", header);
+    for (int k = 0; k < n; k++) {
+      const FormRow *row = &rows[order[k]];
+      uint8_t perm = options[order[k]];
+      offset += snprintf(response + offset, buf_size - offset, "|%d:%s:%s:%s:%s:%s:%s",
+                         row->id, row->text,
+                         row->options[perm & 3], row->options[(perm >> 2) & 3],
+                         row->options[(perm >> 4) & 3], row->options[(perm >> 6) & 3],
+                         row->difficulty);
+      if (with_saved) {
+        offset += snprintf(response + offset, buf_size - offset, ":%d",
+                           forms_map_answer(room_id, user_id, row->id, row->saved_answer));
+      }
+    }
+    snprintf(response + offset, buf_size - offset, "\n");
+    *question_count = n;
+  }
+
+  free(question_ids);
+  free(order);
+  free(options);
+  return response;
+}
+
+static char *serialize_exam_form(sqlite3_stmt *stmt, int room_id, int user_id,
+                                 const char *header, int with_saved, int *question_count) {
+  FormRows *set = read_form_rows(stmt, with_saved);
+  *question_count = 0;
+  if (!set) return NULL;
+  char *response = render_exam_form(set, room_id, user_id, header, with_saved, question_count);
+  free_form_rows(set);
+  return response;
+}
+
+/*
+ * Loader singleflight của BEGIN_EXAM: đọc câu hỏi đã chọn của phòng (một lần cho
+ * cả đợt thí sinh vào thi cùng lúc). Trả NULL nếu lỗi DB.
+ */
+static void *load_exam_rows(void *ctx, size_t *size) {
+  int room_id = *(int *)ctx;
+  sqlite3_stmt *stmt;
+  FormRows *set = NULL;
+
+  pthread_mutex_lock(&server_data.lock);
+  if (sqlite3_prepare_v2(db,
+        "SELECT id, question_text, option_a, option_b, option_c, option_d, difficulty "
+        "FROM exam_questions WHERE room_id = ? AND is_selected = 1 ORDER BY id",
+        -1, &stmt, NULL) == SQLITE_OK) {
+    sqlite3_bind_int(stmt, 1, room_id);
+    set = read_form_rows(stmt, 0);
+    sqlite3_finalize(stmt);
+  }
+  pthread_mutex_unlock(&server_data.lock);
+
+  *size = set ? sizeof(*set) : 0;
+  return set;
 }
 
 // User bắt đầu làm bài thi - Load questions và kiểm tra room status
@@ -969,18 +1204,7 @@ void handle_begin_exam(int socket_fd, int user_id, int room_id)
         send(socket_fd, "EXAM_WAITING|Waiting for host to start exam\n", 45, 0);
         
         // Thêm user vào participants để sẵn sàng
-        int already_participant = 0;
-        for (int i = 0; i < room->participant_count; i++) {
-            if (room->participants[i] == user_id) {
-                already_participant = 1;
-                break;
-            }
-        }
-        
-        if (!already_participant && room->participant_count < MAX_CLIENTS) {
-          room->participants[room->participant_count] = user_id;
-          room->participant_count++;
-        }
+        roster_join(room, user_id);
         
         pthread_mutex_unlock(&server_data.lock);
         return;
@@ -1012,25 +1236,8 @@ void handle_begin_exam(int socket_fd, int user_id, int room_id)
         return;
     }
     
-    // Thêm user vào participants nếu chưa có
-    int already_participant = 0;
-    for (int i = 0; i < room->participant_count; i++) {
-        if (room->participants[i] == user_id) {
-            already_participant = 1;
-            break;
-        }
-    }
-    
-    if (!already_participant && room->participant_count < MAX_CLIENTS) {
-      room->participants[room->participant_count] = user_id;
-      room->participant_count++;
-        
-      // Init answers cho user này thành -1
-      int user_idx = room->participant_count - 1;
-      for (int q = 0; q < MAX_QUESTIONS; q++) {
-        room->answers[user_idx][q].answer = -1;
-      }
-    }
+    // Thêm user vào participants nếu chưa có (answers khởi tạo -1)
+    roster_set_state(room, roster_join(room, user_id), PARTICIPANT_STARTED);
     
     // Lưu start_time cho user này trong DB
     char update_query[512];
@@ -1039,93 +1246,47 @@ void handle_begin_exam(int socket_fd, int user_id, int room_id)
              "VALUES (%d, %d, %ld)",
              room_id, user_id, now);
     sqlite3_exec(db, update_query, NULL, NULL, NULL);
+
+    time_t exam_start_time = room->exam_start_time;
+    int time_limit = room->time_limit;
+    unsigned long version = singleflight_room_version(room_id);
+    pthread_mutex_unlock(&server_data.lock);
+
+    // Room có thể vừa được nạp lại từ DB -> đảm bảo deadline phòng đã được lên lịch
+    timer_schedule_room(room_id, exam_start_time, time_limit);
+    timer_schedule_participant(room_id, user_id, now, time_limit);
     
-    // Lấy danh sách câu hỏi (THÊM difficulty vào query)
-    char question_query[256];
-    snprintf(question_query, sizeof(question_query),
-         "SELECT id, question_text, option_a, option_b, option_c, option_d, difficulty "
-         "FROM exam_questions WHERE room_id = %d AND is_selected = 1", room_id);
-    
-    sqlite3_stmt *stmt;
-    if (sqlite3_prepare_v2(db, question_query, -1, &stmt, NULL) != SQLITE_OK) {
+    // Câu hỏi theo id tăng dần = thứ tự gốc; các BEGIN_EXAM cùng lúc (ngay sau
+    // ROOM_STARTED) dùng chung một lần đọc, mỗi thí sinh chỉ tự dựng đề riêng
+    const SfResult *shared = singleflight_do("BEGIN_EXAM", room_id, version, SF_EXAM_LINGER_MS,
+                                             load_exam_rows, free_form_rows, &room_id);
+    if (!shared) {
         send(socket_fd, "ERROR|Cannot load questions\n", 28, 0);
-        pthread_mutex_unlock(&server_data.lock);
         return;
     }
     
-    // Count questions first for dynamic allocation
-    char count_query[256];
-    snprintf(count_query, sizeof(count_query),
-             "SELECT COUNT(*) FROM exam_questions WHERE room_id = %d AND is_selected = 1", room_id);
-    int question_total = 0;
-    sqlite3_stmt *count_stmt;
-    if (sqlite3_prepare_v2(db, count_query, -1, &count_stmt, NULL) == SQLITE_OK) {
-        if (sqlite3_step(count_stmt) == SQLITE_ROW) {
-            question_total = sqlite3_column_int(count_stmt, 0);
-        }
-        sqlite3_finalize(count_stmt);
-    }
+    // Format: BEGIN_EXAM_OK|remaining_seconds|q1_id:q1_text:optA:optB:optC:optD:difficulty|q2_id:...
+    // (thứ tự câu và đáp án theo đề riêng của thí sinh)
+    char header[64];
+    snprintf(header, sizeof(header), "BEGIN_EXAM_OK|%ld", remaining);
+    
+    int question_count = 0;
+    char *response = render_exam_form(shared->data, room_id, user_id, header, 0, &question_count);
+    singleflight_release(shared);
     
-    // Dynamic allocation: 1KB per question
-    size_t buf_size = (size_t)question_total * 1024 + 4096;
-    char *response = malloc(buf_size);
     if (!response) {
-        sqlite3_finalize(stmt);
         send(socket_fd, "ERROR|Memory allocation error\n", 30, 0);
-        pthread_mutex_unlock(&server_data.lock);
         return;
     }
     
-    // Format: BEGIN_EXAM_OK|remaining_seconds|q1_id:q1_text:optA:optB:optC:optD:difficulty|q2_id:...
-    int offset = snprintf(response, buf_size, "BEGIN_EXAM_OK|%ld", remaining);
-    
-    int question_count = 0;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        int q_id = sqlite3_column_int(stmt, 0);
-        const char *q_text = (const char *)sqlite3_column_text(stmt, 1);
-        const char *opt_a = (const char *)sqlite3_column_text(stmt, 2);
-        const char *opt_b = (const char *)sqlite3_column_text(stmt, 3);
-        const char *opt_c = (const char *)sqlite3_column_text(stmt, 4);
-        const char *opt_d = (const char *)sqlite3_column_text(stmt, 5);
-        const char *difficulty = (const char *)sqlite3_column_text(stmt, 6);
-        
-        // Normalize difficulty: convert to proper case (easy -> Easy, medium -> Medium, hard -> Hard)
-        char normalized_diff[20] = "Medium";  // default
-        if (difficulty && strlen(difficulty) > 0) {
-            if (strcasecmp(difficulty, "easy") == 0) {
-                strcpy(normalized_diff, "Easy");
-            } else if (strcasecmp(difficulty, "medium") == 0) {
-                strcpy(normalized_diff, "Medium");
-            } else if (strcasecmp(difficulty, "hard") == 0) {
-                strcpy(normalized_diff, "Hard");
-            } else {
-                // Keep original but capitalize first letter
-                strncpy(normalized_diff, difficulty, sizeof(normalized_diff) - 1);
-                if (normalized_diff[0] >= 'a' && normalized_diff[0] <= 'z') {
-                    normalized_diff[0] -= 32;
-                }
-            }
-        }
-        
-        offset += snprintf(response + offset, buf_size - offset, "|%d:%s:%s:%s:%s:%s:%s",
-                 q_id, q_text, opt_a, opt_b, opt_c, opt_d, normalized_diff);
-        question_count++;
-    }
-    
-    sqlite3_finalize(stmt);
-    
     if (question_count == 0) {
         free(response);
         send(socket_fd, "ERROR|No questions in room\n", 27, 0);
-        pthread_mutex_unlock(&server_data.lock);
         return;
     }
     
-    strcat(response, "\n");
     send(socket_fd, response, strlen(response), 0);
     free(response);
-    
-    pthread_mutex_unlock(&server_data.lock);
 }
 
 void handle_resume_exam(int socket_fd, int user_id, int room_id)
@@ -1158,6 +1319,14 @@ void handle_resume_exam(int socket_fd, int user_id, int room_id)
         return;
     }
     
+    // Thí sinh có thể chưa có trong bộ nhớ (server khởi động lại không có checkpoint)
+    for (int i = 0; i < server_data.room_count; i++) {
+        if (server_data.rooms[i].room_id == room_id) {
+            roster_join(&server_data.rooms[i], user_id);
+            break;
+        }
+    }
+    
     // **LOAD đáp án từ DB vào in-memory khi RESUME** (dùng internal version, đã lock rồi)
     load_room_answers_internal(room_id, user_id);
     
@@ -1171,6 +1340,7 @@ void handle_resume_exam(int socket_fd, int user_id, int room_id)
         if (sqlite3_step(stmt) == SQLITE_ROW) {
             send(socket_fd, "RESUME_ALREADY_SUBMITTED\n", 25, 0);
             sqlite3_finalize(stmt);
+            roster_update(room_id, user_id, PARTICIPANT_SUBMITTED);
             pthread_mutex_unlock(&server_data.lock);
             return;
         }
@@ -1233,15 +1403,19 @@ void handle_resume_exam(int socket_fd, int user_id, int room_id)
       pthread_mutex_unlock(&server_data.lock);
       return;
     }
+
+    // Thí sinh resume sau khi phòng kết thúc vẫn có deadline riêng của mình
+    timer_schedule_participant(room_id, user_id, start_time, duration_minutes);
+    roster_update(room_id, user_id, PARTICIPANT_STARTED);  // ACTIVE nếu đã có đáp án
     
-    // Lấy danh sách câu hỏi và câu trả lời đã lưu (THÊM difficulty)
+    // Lấy danh sách câu hỏi và câu trả lời đã lưu (THÊM difficulty), theo id tăng dần = thứ tự gốc
     char question_query[512];
     snprintf(question_query, sizeof(question_query),
          "SELECT q.id, q.question_text, q.option_a, q.option_b, q.option_c, q.option_d, "
          "q.difficulty, ua.selected_answer FROM exam_questions q "
              "LEFT JOIN exam_answers ua ON q.id = ua.question_id "
              "AND ua.user_id = %d AND ua.room_id = %d "
-         "WHERE q.room_id = %d AND q.is_selected = 1",
+         "WHERE q.room_id = %d AND q.is_selected = 1 ORDER BY q.id",
              user_id, room_id, room_id);
     
     if (sqlite3_prepare_v2(db, question_query, -1, &stmt, NULL) != SQLITE_OK) {
@@ -1250,73 +1424,21 @@ void handle_resume_exam(int socket_fd, int user_id, int room_id)
         return;
     }
     
-    // Count questions for dynamic allocation
-    char count_query[256];
-    snprintf(count_query, sizeof(count_query),
-             "SELECT COUNT(*) FROM exam_questions WHERE room_id = %d AND is_selected = 1", room_id);
-    int question_total = 0;
-    sqlite3_stmt *count_stmt;
-    if (sqlite3_prepare_v2(db, count_query, -1, &count_stmt, NULL) == SQLITE_OK) {
-        if (sqlite3_step(count_stmt) == SQLITE_ROW) {
-            question_total = sqlite3_column_int(count_stmt, 0);
-        }
-        sqlite3_finalize(count_stmt);
-    }
+    // Format: RESUME_EXAM_OK|remaining_seconds|q1_id:q1_text:optA:optB:optC:optD:difficulty:saved_answer|...
+    // (cùng đề riêng như lúc BEGIN_EXAM, saved_answer theo vị trí hiển thị)
+    char header[64];
+    snprintf(header, sizeof(header), "RESUME_EXAM_OK|%ld", remaining);
+    
+    int question_count = 0;
+    char *response = serialize_exam_form(stmt, room_id, user_id, header, 1, &question_count);
+    sqlite3_finalize(stmt);
     
-    // Dynamic allocation: 1KB per question
-    size_t buf_size = (size_t)question_total * 1024 + 4096;
-    char *response = malloc(buf_size);
     if (!response) {
-        sqlite3_finalize(stmt);
         send(socket_fd, "ERROR|Memory allocation error\n", 30, 0);
         pthread_mutex_unlock(&server_data.lock);
         return;
     }
     
-    // Format: RESUME_EXAM_OK|remaining_seconds|q1_id:q1_text:optA:optB:optC:optD:difficulty:saved_answer|...
-    int offset = snprintf(response, buf_size, "RESUME_EXAM_OK|%ld", remaining);
-    
-    int question_count = 0;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        int q_id = sqlite3_column_int(stmt, 0);
-        const char *q_text = (const char *)sqlite3_column_text(stmt, 1);
-        const char *opt_a = (const char *)sqlite3_column_text(stmt, 2);
-        const char *opt_b = (const char *)sqlite3_column_text(stmt, 3);
-        const char *opt_c = (const char *)sqlite3_column_text(stmt, 4);
-        const char *opt_d = (const char *)sqlite3_column_text(stmt, 5);
-        const char *difficulty = (const char *)sqlite3_column_text(stmt, 6);
-        
-        // Normalize difficulty
-        char normalized_diff[20] = "Medium";
-        if (difficulty && strlen(difficulty) > 0) {
-            if (strcasecmp(difficulty, "easy") == 0) {
-                strcpy(normalized_diff, "Easy");
-            } else if (strcasecmp(difficulty, "medium") == 0) {
-                strcpy(normalized_diff, "Medium");
-            } else if (strcasecmp(difficulty, "hard") == 0) {
-                strcpy(normalized_diff, "Hard");
-            } else {
-                strncpy(normalized_diff, difficulty, sizeof(normalized_diff) - 1);
-                if (normalized_diff[0] >= 'a' && normalized_diff[0] <= 'z') {
-                    normalized_diff[0] -= 32;
-                }
-            }
-        }
-        
-        // saved_answer có thể NULL nếu chưa trả lời
-        int saved_answer = -1;
-        if (sqlite3_column_type(stmt, 7) != SQLITE_NULL) {
-            saved_answer = sqlite3_column_int(stmt, 7);
-        }
-        
-        offset += snprintf(response + offset, buf_size - offset, "|%d:%s:%s:%s:%s:%s:%s:%d",
-                 q_id, q_text, opt_a, opt_b, opt_c, opt_d, normalized_diff, saved_answer);
-        question_count++;
-    }
-    
-    sqlite3_finalize(stmt);
-    
-    strcat(response, "\n");
     send(socket_fd, response, strlen(response), 0);
     free(response);
     
@@ -1446,6 +1568,7 @@ static void load_room_answers_internal(int room_id, int user_id) {
       }
     
       sqlite3_finalize(stmt);
+      roster_recount(room, user_idx);
 }
 
 // Load đáp án của user từ DB vào in-memory (PUBLIC - có lock)
@@ -1484,8 +1607,14 @@ void handle_get_user_rooms(int socket_fd, int user_id) {
     }
 }
 
-// Get exam students status (ACTIVE, SUBMITTED, DISCONNECTED, NOT_STARTED)
+/*
+ * Trạng thái thí sinh của phòng cho host (GET_EXAM_STUDENTS|room_id, và snapshot khi
+ * SUBSCRIBE proctor.<room_id>): chỉ duyệt TestRoom.status[] (xem roster.c).
+ * Format: EXAM_STUDENTS_LIST|room_id|user_id:username:state:answered:last_seen|...
+ */
 void get_exam_students_status(int socket_fd, int user_id, int room_id) {
+    char response[BUFFER_SIZE * 2];
+    
     pthread_mutex_lock(&server_data.lock);
     
     // Find room and verify permission
@@ -1497,104 +1626,41 @@ void get_exam_students_status(int socket_fd, int user_id, int room_id) {
         }
     }
     
-    char response[BUFFER_SIZE * 2];
-    
     if (room == NULL) {
-        snprintf(response, sizeof(response), "EXAM_STUDENTS_FAIL|Room not found\n");
-        send(socket_fd, response, strlen(response), 0);
         pthread_mutex_unlock(&server_data.lock);
+        server_send(socket_fd, "EXAM_STUDENTS_FAIL|Room not found\n");
         return;
     }
     
     if (room->creator_id != user_id) {
-        snprintf(response, sizeof(response), "EXAM_STUDENTS_FAIL|Permission denied\n");
-        send(socket_fd, response, strlen(response), 0);
         pthread_mutex_unlock(&server_data.lock);
+        server_send(socket_fd, "EXAM_STUDENTS_FAIL|Permission denied\n");
         return;
     }
     
-    // Build response: EXAM_STUDENTS_LIST|room_id|user_id:username:status;...
-    int offset = snprintf(response, sizeof(response), "EXAM_STUDENTS_LIST|%d", room_id);
-    
-    // Get all participants
-    for (int i = 0; i < room->participant_count; i++) {
-        int participant_id = room->participants[i];
-        char username[50] = "Unknown";
-        char status[20] = "NOT_STARTED";
-        
-        // Get username
-        for (int j = 0; j < server_data.user_count; j++) {
-            if (server_data.users[j].user_id == participant_id) {
-                strncpy(username, server_data.users[j].username, sizeof(username) - 1);
-                break;
-            }
-        }
-        
-        // Determine status
-        // Check if user has submitted (by checking results table in DB)
-        char check_query[256];
-        snprintf(check_query, sizeof(check_query),
-                 "SELECT COUNT(*) FROM test_results WHERE user_id=%d AND room_id=%d",
-                 participant_id, room_id);
-        
-        sqlite3_stmt *check_stmt;
-        int has_submitted = 0;
-        if (sqlite3_prepare_v2(db, check_query, -1, &check_stmt, NULL) == SQLITE_OK) {
-            if (sqlite3_step(check_stmt) == SQLITE_ROW) {
-                has_submitted = sqlite3_column_int(check_stmt, 0) > 0;
-            }
-            sqlite3_finalize(check_stmt);
-        }
-        
-        if (has_submitted) {
-            strcpy(status, "SUBMITTED");
-        } else {
-            // Check if user has any answers (started but not submitted)
-            char answer_query[256];
-            snprintf(answer_query, sizeof(answer_query),
-                     "SELECT COUNT(*) FROM exam_answers WHERE user_id=%d AND room_id=%d",
-                     participant_id, room_id);
-            
-            sqlite3_stmt *ans_stmt;
-            int has_answers = 0;
-            if (sqlite3_prepare_v2(db, answer_query, -1, &ans_stmt, NULL) == SQLITE_OK) {
-                if (sqlite3_step(ans_stmt) == SQLITE_ROW) {
-                    has_answers = sqlite3_column_int(ans_stmt, 0) > 0;
-                }
-                sqlite3_finalize(ans_stmt);
-            }
-            
-            if (has_answers) {
-                // Has started, check if online
-                int is_online = 0;
-                for (int j = 0; j < server_data.user_count; j++) {
-                    if (server_data.users[j].user_id == participant_id && 
-                        server_data.users[j].is_online == 1) {
-                        is_online = 1;
-                        break;
-                    }
-                }
-                strcpy(status, is_online ? "ACTIVE" : "DISCONNECTED");
-            } else {
-                strcpy(status, "NOT_STARTED");
-            }
-        }
-        
-        offset += snprintf(response + offset, sizeof(response) - offset,
-                         "|%d:%s:%s", participant_id, username, status);
+    size_t offset = snprintf(response, sizeof(response), "EXAM_STUDENTS_LIST|%d", room_id);
+    int count = room->participant_count;
+    for (int i = 0; i < count && offset < sizeof(response) - 2; i++) {
+        const ParticipantStatus *ps = &room->status[i];
+        offset += snprintf(response + offset, sizeof(response) - 2 - offset, "|%d:%s:%s:%d:%ld",
+                           room->participants[i], ps->username[0] ? ps->username : "Unknown",
+                           roster_state_name(ps->state), ps->answered, (long)ps->last_seen);
     }
+    if (offset > sizeof(response) - 2) offset = sizeof(response) - 2;
     
-    strcat(response, "\n");
-    send(socket_fd, response, strlen(response), 0);
+    pthread_mutex_unlock(&server_data.lock);
     
-    printf("[GET_EXAM_STUDENTS] Success: Sent status of %d students in room %d to user %d\n",
-           room->participant_count, room_id, user_id);
+    strcpy(response + offset, "\n");
+    server_send(socket_fd, response);
     
-    pthread_mutex_unlock(&server_data.lock);
+    printf("[GET_EXAM_STUDENTS] Success: Sent status of %d students in room %d to user %d\n",
+           count, room_id, user_id);
 }
 
-// Get all questions in an exam room (includes is_selected status and selection_mode)
-void get_room_questions(int socket_fd, int user_id, int room_id) {
+// Get questions in an exam room (includes is_selected status and selection_mode)
+// Phân trang theo id câu hỏi: cursor = id cuối trang trước, limit = số câu tối đa; stream theo đoạn
+// trên read connection của thread, ngoài server_data.lock, kết thúc bằng dòng NEXT|cursor
+void get_room_questions(int socket_fd, int user_id, int room_id, int cursor, int limit) {
     pthread_mutex_lock(&server_data.lock);
     
     // Find room and verify permission
@@ -1606,7 +1672,7 @@ void get_room_questions(int socket_fd, int user_id, int room_id) {
         }
     }
     
-    char response[BUFFER_SIZE * 3];
+    char response[128];
     
     if (room == NULL) {
         snprintf(response, sizeof(response), "ROOM_QUESTIONS_FAIL|Room not found\n");
@@ -1621,6 +1687,15 @@ void get_room_questions(int socket_fd, int user_id, int room_id) {
         pthread_mutex_unlock(&server_data.lock);
         return;
     }
+    pthread_mutex_unlock(&server_data.lock);
+    
+    // Đọc và stream trên read connection để không giữ server_data.lock khi send chặn
+    sqlite3 *conn = db_thread_read_connection();
+    if (!conn) {
+        snprintf(response, sizeof(response), "ROOM_QUESTIONS_FAIL|Database error\n");
+        send(socket_fd, response, strlen(response), 0);
+        return;
+    }
     
     // Get selection_mode and difficulty counts from database
     int selection_mode = 0;
@@ -1629,7 +1704,7 @@ void get_room_questions(int socket_fd, int user_id, int room_id) {
     snprintf(mode_query, sizeof(mode_query), 
              "SELECT selection_mode, easy_count, medium_count, hard_count FROM rooms WHERE id=%d", room_id);
     sqlite3_stmt *mode_stmt;
-    if (sqlite3_prepare_v2(db, mode_query, -1, &mode_stmt, NULL) == SQLITE_OK) {
+    if (sqlite3_prepare_v2(conn, mode_query, -1, &mode_stmt, NULL) == SQLITE_OK) {
         if (sqlite3_step(mode_stmt) == SQLITE_ROW) {
             selection_mode = sqlite3_column_int(mode_stmt, 0);
             easy_count = sqlite3_column_int(mode_stmt, 1);
@@ -1640,20 +1715,32 @@ void get_room_questions(int socket_fd, int user_id, int room_id) {
     }
     
     // Get questions from database (now includes is_selected)
-    char query[512];
-    snprintf(query, sizeof(query),
+    const char *query =
              "SELECT id, question_text, option_a, option_b, option_c, option_d, "
-             "correct_answer, difficulty, category, is_selected FROM exam_questions WHERE room_id=%d ORDER BY id",
-             room_id);
+             "correct_answer, difficulty, category, is_selected FROM exam_questions "
+             "WHERE room_id=? AND id>? ORDER BY id LIMIT ?";
     
     sqlite3_stmt *stmt;
     // Format: ROOM_QUESTIONS_LIST|room_id|selection_mode|easy_count|medium_count|hard_count|question1|question2|...
-    int offset = snprintf(response, sizeof(response), "ROOM_QUESTIONS_LIST|%d|%d|%d|%d|%d", 
-                          room_id, selection_mode, easy_count, medium_count, hard_count);
+    //         NEXT|cursor
+    PageStream ps;
+    page_stream_begin(&ps, socket_fd);
+    page_stream_printf(&ps, "ROOM_QUESTIONS_LIST|%d|%d|%d|%d|%d", 
+                       room_id, selection_mode, easy_count, medium_count, hard_count);
     int question_count = 0;
+    int last_id = 0;
+    int has_more = 0;
     
-    if (sqlite3_prepare_v2(db, query, -1, &stmt, NULL) == SQLITE_OK) {
+    if (sqlite3_prepare_v2(conn, query, -1, &stmt, NULL) == SQLITE_OK) {
+        sqlite3_bind_int(stmt, 1, room_id);
+        sqlite3_bind_int(stmt, 2, cursor);
+        sqlite3_bind_int(stmt, 3, limit + 1);
         while (sqlite3_step(stmt) == SQLITE_ROW) {
+            if (question_count == limit) {
+                // Còn dòng sau trang này
+                has_more = 1;
+                break;
+            }
             int q_id = sqlite3_column_int(stmt, 0);
             const char *q_text = (const char *)sqlite3_column_text(stmt, 1);
             const char *opt_a = (const char *)sqlite3_column_text(stmt, 2);
@@ -1666,22 +1753,21 @@ void get_room_questions(int socket_fd, int user_id, int room_id) {
             int is_selected = sqlite3_column_int(stmt, 9);
             
             // Format: id:text:optA:optB:optC:optD:correct:difficulty:category:is_selected
-            offset += snprintf(response + offset, sizeof(response) - offset,
-                             "|%d:%s:%s:%s:%s:%s:%d:%s:%s:%d",
+            page_stream_printf(&ps, "|%d:%s:%s:%s:%s:%s:%d:%s:%s:%d",
                              q_id, q_text ? q_text : "",
                              opt_a ? opt_a : "", opt_b ? opt_b : "",
                              opt_c ? opt_c : "", opt_d ? opt_d : "",
                              correct, difficulty ? difficulty : "", category ? category : "",
                              is_selected);
             question_count++;
+            last_id = q_id;
         }
         sqlite3_finalize(stmt);
     }
     
-    strcat(response, "\n");
-    send(socket_fd, response, strlen(response), 0);
-    
-    pthread_mutex_unlock(&server_data.lock);
+    page_stream_printf(&ps, "\n");
+    page_stream_next(&ps, has_more ? last_id : 0);
+    page_stream_end(&ps);
 }
 
 // Get single question detail for editing
@@ -1803,6 +1889,9 @@ void update_exam_question(int socket_fd, int user_id, int room_id, int question_
     sqlite3_free(query);
     
     if (rc == SQLITE_OK) {
+        question_bank_invalidate(room_id);  // difficulty có thể đã đổi
+        singleflight_room_changed(room_id);
+        room_catalog_invalidate();
         send(socket_fd, "UPDATE_QUESTION_OK\n", 19, 0);
               printf("[DEBUG] update_exam_question: qid=%d, room=%d, user=%d\n",
            question_id, room_id, user_id);
@@ -1886,6 +1975,10 @@ void update_room_question(int socket_fd, int user_id, int room_id, int question_
         return;
     }
     
+    question_bank_invalidate(room_id);  // difficulty có thể đã đổi
+    singleflight_room_changed(room_id);
+    room_catalog_invalidate();
+    
     // Update in-memory
     for (int i = 0; i < server_data.question_count; i++) {
         if (server_data.questions[i].id == question_id) {
@@ -1912,25 +2005,13 @@ void update_room_question(int socket_fd, int user_id, int room_id, int question_
 }
 
 // Get room members/participants
-void get_room_members(int socket_fd, int user_id, int room_id) {
-  pthread_mutex_lock(&server_data.lock);
-  
-  // Check if user is the room creator
-  TestRoom *room = NULL;
-  for (int i = 0; i < server_data.room_count; i++) {
-    if (server_data.rooms[i].room_id == room_id) {
-      room = &server_data.rooms[i];
-      break;
-    }
-  }
-  
-  if (room == NULL || room->creator_id != user_id) {
-    char response[] = "ROOM_MEMBERS_FAIL|Permission denied\n";
-    send(socket_fd, response, strlen(response), 0);
-    pthread_mutex_unlock(&server_data.lock);
-    return;
-  }
-  
+/*
+ * Loader singleflight của GET_ROOM_MEMBERS: dựng sẵn cả dòng ROOM_MEMBERS|...
+ * (giống nhau cho mọi người xem) để các request trùng lúc gửi chung một buffer.
+ */
+static void *load_room_members(void *ctx, size_t *size) {
+  int room_id = *(int *)ctx;
+
   // Query database for room participants from participants table
   // Show all participants and their best score (if they have completed the exam)
   const char *sql = "SELECT DISTINCT u.id, u.username, "
@@ -1942,12 +2023,11 @@ void get_room_members(int socket_fd, int user_id, int room_id) {
                     "GROUP BY u.id, u.username "
                     "ORDER BY best_score DESC;";
   
+  pthread_mutex_lock(&server_data.lock);
   sqlite3_stmt *stmt;
   if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
-    char response[] = "ROOM_MEMBERS_FAIL|Database error\n";
-    send(socket_fd, response, strlen(response), 0);
     pthread_mutex_unlock(&server_data.lock);
-    return;
+    return NULL;
   }
   
   sqlite3_bind_int(stmt, 1, room_id);
@@ -1967,10 +2047,12 @@ void get_room_members(int socket_fd, int user_id, int room_id) {
   }
   
   sqlite3_finalize(stmt);
+  pthread_mutex_unlock(&server_data.lock);
   
   // Add count after room_id
-  char final_response[BUFFER_SIZE];
-  snprintf(final_response, sizeof(final_response), "ROOM_MEMBERS|%d|%d|", room_id, count);
+  char *final_response = malloc(BUFFER_SIZE);
+  if (!final_response) return NULL;
+  snprintf(final_response, BUFFER_SIZE, "ROOM_MEMBERS|%d|%d|", room_id, count);
   
   if (count == 0) {
     strcat(final_response, "NONE");
@@ -1980,9 +2062,41 @@ void get_room_members(int socket_fd, int user_id, int room_id) {
   }
   
   strcat(final_response, "\n");
-  send(socket_fd, final_response, strlen(final_response), 0);
+  *size = strlen(final_response);
+  return final_response;
+}
+
+void get_room_members(int socket_fd, int user_id, int room_id) {
+  pthread_mutex_lock(&server_data.lock);
+  
+  // Check if user is the room creator
+  TestRoom *room = NULL;
+  for (int i = 0; i < server_data.room_count; i++) {
+    if (server_data.rooms[i].room_id == room_id) {
+      room = &server_data.rooms[i];
+      break;
+    }
+  }
   
+  if (room == NULL || room->creator_id != user_id) {
+    char response[] = "ROOM_MEMBERS_FAIL|Permission denied\n";
+    send(socket_fd, response, strlen(response), 0);
+    pthread_mutex_unlock(&server_data.lock);
+    return;
+  }
+  unsigned long version = singleflight_room_version(room_id);
   pthread_mutex_unlock(&server_data.lock);
+  
+  // Không linger: danh sách đổi theo từng lượt vào thi/nộp bài, chỉ gộp các request trùng lúc
+  const SfResult *shared = singleflight_do("GET_ROOM_MEMBERS", room_id, version, 0,
+                                           load_room_members, free, &room_id);
+  if (!shared) {
+    char response[] = "ROOM_MEMBERS_FAIL|Database error\n";
+    send(socket_fd, response, strlen(response), 0);
+    return;
+  }
+  send(socket_fd, shared->data, shared->size, 0);
+  singleflight_release(shared);
 }
 
 // Set question selection status (admin toggle for manual mode)
@@ -2026,6 +2140,7 @@ void set_question_selected(int socket_fd, int user_id, int room_id, int question
   
   char *err_msg = NULL;
   if (sqlite3_exec(db, query, NULL, NULL, &err_msg) == SQLITE_OK) {
+    singleflight_room_changed(room_id);
     char response[128];
     snprintf(response, sizeof(response), "SET_QUESTION_SELECTED_OK|%d|%d|%d\n",
              room_id, question_id, is_selected);
@@ -2092,6 +2207,7 @@ void set_room_selection_mode(int socket_fd, int user_id, int room_id, int select
       snprintf(select_all_query, sizeof(select_all_query),
                "UPDATE exam_questions SET is_selected = 1 WHERE room_id = %d", room_id);
       sqlite3_exec(db, select_all_query, NULL, NULL, NULL);
+      singleflight_room_changed(room_id);
     }
     
     char response[128];
@@ -3,17 +3,19 @@
 
 #include "common.h"
 
-void create_test_room(int socket_fd, int creator_id, char *room_name, int num_q, int time_limit, int easy_count, int medium_count, int hard_count);
-void list_test_rooms(int socket_fd);
-void list_my_rooms(int socket_fd, int user_id);
+void create_test_room(int socket_fd, int creator_id, char *room_name, int time_limit, int easy_count, int medium_count, int hard_count);
+void list_test_rooms(int socket_fd, unsigned long known_version);
+void list_my_rooms(int socket_fd, int user_id, int cursor, int limit);
 void delete_room(int socket_fd, int user_id, int room_id);
+int run_delete_room_job(int job_id, int room_id, int user_id, sqlite3 *conn,
+                        char *message, size_t message_size);
 void join_test_room(int socket_fd, int user_id, int room_id);
 void start_test(int socket_fd, int user_id, int room_id);
 void handle_begin_exam(int socket_fd, int user_id, int room_id);
 void handle_resume_exam(int socket_fd, int user_id, int room_id);
 void handle_get_user_rooms(int socket_fd, int user_id);
 void get_exam_students_status(int socket_fd, int user_id, int room_id);
-void get_room_questions(int socket_fd, int user_id, int room_id);
+void get_room_questions(int socket_fd, int user_id, int room_id, int cursor, int limit);
 void get_question_detail(int socket_fd, int user_id, int room_id, int question_id);
 void update_exam_question(int socket_fd, int user_id, int room_id, int question_id, char *new_data);
 void update_room_question(int socket_fd, int user_id, int room_id, int question_id, char *new_data);
@@ -0,0 +1,158 @@
+#include "roster.h"
+#include "pubsub.h"
+
+extern ServerData server_data;
+
+/*
+ * Trạng thái từng thí sinh của phòng thi cho màn hình giám sát (GET_EXAM_STUDENTS):
+ *  - TestRoom.status[] song song với participants[]: trạng thái, số câu đã trả lời,
+ *    thời điểm sự kiện gần nhất và username (chụp lúc vào phòng)
+ *  - Cập nhật tại nơi xảy ra sự kiện (JOIN_ROOM, BEGIN_EXAM, SAVE_ANSWER, mất kết nối,
+ *    RESUME, nộp bài, auto-submit) -> xem danh sách chỉ là duyệt bộ nhớ, không query DB
+ *  - SUBMITTED/AUTO_SUBMITTED là trạng thái cuối
+ *  - Mỗi thay đổi được đẩy cho host đã SUBSCRIBE topic proctor.<room_id>:
+ *    EXAM_STUDENT_UPDATE|room_id|user_id:username:state:answered:last_seen
+ * Gửi là MSG_DONTWAIT (pubsub_lock là lock lá) nên gọi được khi giữ server_data.lock.
+ */
+
+static const char *state_names[] = {
+  "JOINED", "STARTED", "ACTIVE", "DISCONNECTED", "SUBMITTED", "AUTO_SUBMITTED"
+};
+
+const char *roster_state_name(ParticipantState state) {
+  if (state < PARTICIPANT_JOINED || state > PARTICIPANT_AUTO_SUBMITTED) return "UNKNOWN";
+  return state_names[state];
+}
+
+static int is_final(ParticipantState state) {
+  return state == PARTICIPANT_SUBMITTED || state == PARTICIPANT_AUTO_SUBMITTED;
+}
+
+static void publish_delta(const TestRoom *room, int idx) {
+  char topic[PUBSUB_TOPIC_LEN];
+  pubsub_proctor_topic(topic, sizeof(topic), room->room_id);
+
+  const ParticipantStatus *ps = &room->status[idx];
+  char message[192];
+  snprintf(message, sizeof(message), "EXAM_STUDENT_UPDATE|%d|%d:%s:%s:%d:%ld\n",
+           room->room_id, room->participants[idx], ps->username[0] ? ps->username : "Unknown",
+           roster_state_name(ps->state), ps->answered, (long)ps->last_seen);
+  pubsub_publish(topic, message);
+}
+
+static int find_index(const TestRoom *room, int user_id) {
+  for (int i = 0; i < room->participant_count; i++) {
+    if (room->participants[i] == user_id) return i;
+  }
+  return -1;
+}
+
+static void copy_username(ParticipantStatus *ps, int user_id) {
+  for (int u = 0; u < server_data.user_count; u++) {
+    if (server_data.users[u].user_id == user_id) {
+      strncpy(ps->username, server_data.users[u].username, sizeof(ps->username) - 1);
+      break;
+    }
+  }
+}
+
+/*
+ * Thêm user vào participants của phòng (JOINED, chưa có đáp án) nếu chưa có.
+ * Trả index của thí sinh, -1 nếu phòng đã đủ MAX_CLIENTS.
+ */
+int roster_join(TestRoom *room, int user_id) {
+  int idx = find_index(room, user_id);
+  if (idx >= 0) return idx;
+  if (room->participant_count >= MAX_CLIENTS) return -1;
+
+  idx = room->participant_count++;
+  room->participants[idx] = user_id;
+  for (int q = 0; q < MAX_QUESTIONS; q++) {
+    room->answers[idx][q].answer = -1;
+  }
+
+  ParticipantStatus *ps = &room->status[idx];
+  memset(ps, 0, sizeof(*ps));
+  ps->state = PARTICIPANT_JOINED;
+  ps->last_seen = time(NULL);
+  copy_username(ps, user_id);
+  publish_delta(room, idx);
+  return idx;
+}
+
+/*
+ * Chuyển trạng thái thí sinh idx:
+ *  - Không rời trạng thái cuối (nộp bài rồi thì mất kết nối/RESUME không đổi gì)
+ *  - STARTED khi đã có đáp án -> ACTIVE (RESUME giữa giờ thi)
+ *  - DISCONNECTED chỉ áp dụng khi đang thi (STARTED/ACTIVE).
+ */
+void roster_set_state(TestRoom *room, int idx, ParticipantState state) {
+  if (idx < 0 || idx >= room->participant_count) return;
+  ParticipantStatus *ps = &room->status[idx];
+
+  if (is_final(ps->state) && !is_final(state)) return;
+  if (state == PARTICIPANT_STARTED && ps->answered > 0) state = PARTICIPANT_ACTIVE;
+  if (state == PARTICIPANT_DISCONNECTED &&
+      ps->state != PARTICIPANT_STARTED && ps->state != PARTICIPANT_ACTIVE) return;
+
+  ps->last_seen = time(NULL);
+  if (ps->state == state) return;
+  ps->state = state;
+  publish_delta(room, idx);
+}
+
+/*
+ * Như roster_set_state nhưng tra theo room_id/user_id (bỏ qua nếu không có trong bộ nhớ).
+ */
+void roster_update(int room_id, int user_id, ParticipantState state) {
+  for (int r = 0; r < server_data.room_count; r++) {
+    TestRoom *room = &server_data.rooms[r];
+    if (room->room_id != room_id) continue;
+    roster_set_state(room, find_index(room, user_id), state);
+    return;
+  }
+}
+
+/*
+ * SAVE_ANSWER: cập nhật số câu đã trả lời theo đáp án cũ/mới, thí sinh thành ACTIVE.
+ */
+void roster_record_answer(TestRoom *room, int idx, int old_answer, int new_answer) {
+  if (idx < 0 || idx >= room->participant_count) return;
+  ParticipantStatus *ps = &room->status[idx];
+  int was_answered = old_answer >= 0 && old_answer <= 3;
+  int is_answered = new_answer >= 0 && new_answer <= 3;
+  ParticipantState previous = ps->state;
+  ps->answered += is_answered - was_answered;
+  ps->last_seen = time(NULL);
+
+  if (!is_final(ps->state)) ps->state = PARTICIPANT_ACTIVE;
+  // Đổi đáp án của câu đã trả lời không làm thay đổi gì host thấy được
+  if (was_answered != is_answered || ps->state != previous) publish_delta(room, idx);
+}
+
+/*
+ * Đếm lại số câu đã trả lời từ answers[] (sau khi nạp đáp án từ DB lúc RESUME/khởi động lại).
+ */
+void roster_recount(TestRoom *room, int idx) {
+  if (idx < 0 || idx >= room->participant_count) return;
+  int answered = 0;
+  for (int q = 0; q < MAX_QUESTIONS; q++) {
+    int answer = room->answers[idx][q].answer;
+    if (answer >= 0 && answer <= 3) answered++;
+  }
+  room->status[idx].answered = answered;
+}
+
+/*
+ * Phòng vừa khôi phục từ checkpoint (đáp án đã nạp lại, roster_recount): mọi thí sinh
+ * đang offline -> ai đã có đáp án là DISCONNECTED tới khi RESUME, còn lại JOINED.
+ */
+void roster_restore(TestRoom *room) {
+  time_t now = time(NULL);
+  for (int i = 0; i < room->participant_count; i++) {
+    ParticipantStatus *ps = &room->status[i];
+    ps->state = ps->answered > 0 ? PARTICIPANT_DISCONNECTED : PARTICIPANT_JOINED;
+    ps->last_seen = now;
+    if (!ps->username[0]) copy_username(ps, room->participants[i]);
+  }
+}
@@ -0,0 +1,15 @@
+#ifndef ROSTER_H
+#define ROSTER_H
+
+#include "common.h"
+
+// Tất cả hàm dưới đây: caller giữ server_data.lock
+const char *roster_state_name(ParticipantState state);
+int roster_join(TestRoom *room, int user_id);
+void roster_set_state(TestRoom *room, int idx, ParticipantState state);
+void roster_update(int room_id, int user_id, ParticipantState state);
+void roster_record_answer(TestRoom *room, int idx, int old_answer, int new_answer);
+void roster_recount(TestRoom *room, int idx);
+void roster_restore(TestRoom *room);
+
+#endif
@@ -0,0 +1,273 @@
+#include "scheduler.h"
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+
+/*
+ * Bộ lập lịch deadline dùng min-heap + timerfd:
+ *  - Mỗi sự kiện được định danh bởi (type, id, user_id); thêm lại cùng khóa sẽ dời deadline
+ *  - Sự kiện nằm cố định trong events[], heap chỉ giữ chỉ số; bảng băm theo khóa trỏ tới
+ *    sự kiện và mỗi sự kiện nhớ vị trí của mình trong heap, nên add/cancel là O(log n)
+ *  - timerfd luôn được arm đúng bằng deadline sớm nhất (TFD_TIMER_ABSTIME),
+ *    nên thread chỉ thức dậy khi thực sự có sự kiện hết hạn, không cần quét định kỳ
+ *  - Handler chạy ngoài sched_lock để handler được phép lấy server_data.lock
+ *    hoặc lên lịch lại chính nó.
+ */
+
+typedef struct {
+  time_t deadline;
+  SchedEventType type;
+  int id;
+  int user_id;
+  int pos;        // vị trí trong heap
+  int next;       // sự kiện kế trong bucket (hoặc free list), lưu chỉ số + 1, 0 = hết
+} SchedEvent;
+
+static SchedEvent events[SCHED_MAX_EVENTS];
+static int events_used = 0;          // số slot events[] đã từng cấp
+static int free_head = 0;            // slot đã giải phóng, chỉ số + 1
+static int buckets[SCHED_BUCKETS];   // đầu chain của mỗi bucket, chỉ số + 1
+static int heap[SCHED_MAX_EVENTS];   // chỉ số vào events[], min-heap theo deadline
+static int heap_size = 0;
+static SchedHandler handlers[SCHED_EVENT_TYPES];
+static pthread_mutex_t sched_lock = PTHREAD_MUTEX_INITIALIZER;
+static int timer_fd = -1;
+
+static unsigned int event_hash(SchedEventType type, int id, int user_id) {
+  unsigned int h = (unsigned int)type;
+  h = h * 31 + (unsigned int)id;
+  h = h * 2654435761U + (unsigned int)user_id;
+  return (h ^ (h >> 16)) % SCHED_BUCKETS;
+}
+
+static void heap_swap(int a, int b) {
+  int tmp = heap[a];
+  heap[a] = heap[b];
+  heap[b] = tmp;
+  events[heap[a]].pos = a;
+  events[heap[b]].pos = b;
+}
+
+static time_t deadline_at(int i) {
+  return events[heap[i]].deadline;
+}
+
+static void sift_up(int i) {
+  while (i > 0) {
+    int parent = (i - 1) / 2;
+    if (deadline_at(parent) <= deadline_at(i)) break;
+    heap_swap(i, parent);
+    i = parent;
+  }
+}
+
+static void sift_down(int i) {
+  while (1) {
+    int left = 2 * i + 1;
+    int right = left + 1;
+    int smallest = i;
+    if (left < heap_size && deadline_at(left) < deadline_at(smallest)) smallest = left;
+    if (right < heap_size && deadline_at(right) < deadline_at(smallest)) smallest = right;
+    if (smallest == i) break;
+    heap_swap(i, smallest);
+    i = smallest;
+  }
+}
+
+// Trả về chỉ số trong events[] của sự kiện (type, id, user_id), -1 nếu không có
+static int find_event(SchedEventType type, int id, int user_id) {
+  for (int e = buckets[event_hash(type, id, user_id)]; e; e = events[e - 1].next) {
+    SchedEvent *ev = &events[e - 1];
+    if (ev->type == type && ev->id == id && ev->user_id == user_id) return e - 1;
+  }
+  return -1;
+}
+
+// Cấp slot mới và gắn vào chỉ mục; -1 nếu đã đủ SCHED_MAX_EVENTS
+static int alloc_event(SchedEventType type, int id, int user_id) {
+  int e;
+  if (free_head) {
+    e = free_head - 1;
+    free_head = events[e].next;
+  } else if (events_used < SCHED_MAX_EVENTS) {
+    e = events_used++;
+  } else {
+    return -1;
+  }
+  unsigned int b = event_hash(type, id, user_id);
+  events[e].type = type;
+  events[e].id = id;
+  events[e].user_id = user_id;
+  events[e].next = buckets[b];
+  buckets[b] = e + 1;
+  return e;
+}
+
+// Gỡ slot khỏi chỉ mục và trả về free list (không đụng tới heap)
+static void release_event(int e) {
+  int *link = &buckets[event_hash(events[e].type, events[e].id, events[e].user_id)];
+  while (*link && *link != e + 1) link = &events[*link - 1].next;
+  if (*link) *link = events[e].next;
+  events[e].next = free_head;
+  free_head = e + 1;
+}
+
+static void remove_at(int i) {
+  release_event(heap[i]);
+  heap_size--;
+  if (i == heap_size) return;
+  heap[i] = heap[heap_size];
+  events[heap[i]].pos = i;
+  sift_up(i);
+  sift_down(i);
+}
+
+// Arm timerfd theo deadline sớm nhất (gọi khi đang giữ sched_lock)
+static void rearm_locked(void) {
+  if (timer_fd < 0) return;
+
+  struct itimerspec its;
+  memset(&its, 0, sizeof(its));
+  if (heap_size > 0) {
+    // Deadline đã qua vẫn được arm: timerfd sẽ báo ngay lập tức
+    its.it_value.tv_sec = deadline_at(0) > 0 ? deadline_at(0) : 1;
+  }
+  if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, NULL) < 0) {
+    perror("timerfd_settime");
+  }
+}
+
+/*
+ * Đăng ký handler cho một loại sự kiện. Gọi trước scheduler_start().
+ */
+void scheduler_register(SchedEventType type, SchedHandler handler) {
+  if (type < 0 || type >= SCHED_EVENT_TYPES) return;
+  pthread_mutex_lock(&sched_lock);
+  handlers[type] = handler;
+  pthread_mutex_unlock(&sched_lock);
+}
+
+/*
+ * Thêm hoặc dời deadline của sự kiện (type, id, user_id).
+ */
+void scheduler_add(SchedEventType type, int id, int user_id, time_t deadline) {
+  pthread_mutex_lock(&sched_lock);
+
+  int e = find_event(type, id, user_id);
+  if (e >= 0) {
+    events[e].deadline = deadline;
+    sift_up(events[e].pos);
+    sift_down(events[e].pos);
+  } else if ((e = alloc_event(type, id, user_id)) >= 0) {
+    int i = heap_size++;
+    events[e].deadline = deadline;
+    events[e].pos = i;
+    heap[i] = e;
+    sift_up(i);
+  } else {
+    fprintf(stderr, "[SCHED] Event queue full, dropping type=%d id=%d user=%d\n", type, id, user_id);
+  }
+
+  rearm_locked();
+  pthread_mutex_unlock(&sched_lock);
+}
+
+/*
+ * Hủy sự kiện nếu còn trong hàng đợi (không lỗi nếu không tồn tại).
+ */
+void scheduler_cancel(SchedEventType type, int id, int user_id) {
+  pthread_mutex_lock(&sched_lock);
+  int e = find_event(type, id, user_id);
+  if (e >= 0) {
+    remove_at(events[e].pos);
+    rearm_locked();
+  }
+  pthread_mutex_unlock(&sched_lock);
+}
+
+/*
+ * Hủy mọi sự kiện loại type của id (mọi user_id), ví dụ deadline của tất cả
+ * thí sinh trong một phòng vừa bị xoá.
+ */
+void scheduler_cancel_all(SchedEventType type, int id) {
+  pthread_mutex_lock(&sched_lock);
+  // Dồn các sự kiện còn lại rồi dựng lại heap (remove_at từng phần tử có thể
+  // đẩy phần tử chưa xét qua vị trí đã xét)
+  int kept = 0;
+  for (int i = 0; i < heap_size; i++) {
+    int e = heap[i];
+    if (events[e].type == type && events[e].id == id) {
+      release_event(e);
+      continue;
+    }
+    events[e].pos = kept;
+    heap[kept++] = e;
+  }
+  if (kept != heap_size) {
+    heap_size = kept;
+    for (int i = heap_size / 2 - 1; i >= 0; i--) sift_down(i);
+    rearm_locked();
+  }
+  pthread_mutex_unlock(&sched_lock);
+}
+
+// Thread chính: chờ timerfd, lấy ra mọi sự kiện đã đến hạn và gọi handler
+static void *scheduler_thread(void *arg) {
+  (void)arg;
+
+  while (1) {
+    uint64_t expirations;
+    ssize_t n = read(timer_fd, &expirations, sizeof(expirations));
+    if (n < 0 && errno != EINTR && errno != EAGAIN) {
+      perror("timerfd read");
+      sleep(1);
+    }
+
+    while (1) {
+      pthread_mutex_lock(&sched_lock);
+      time_t now = time(NULL);
+      if (heap_size == 0 || deadline_at(0) > now) {
+        rearm_locked();
+        pthread_mutex_unlock(&sched_lock);
+        break;
+      }
+
+      SchedEvent ev = events[heap[0]];
+      remove_at(0);
+      SchedHandler handler = handlers[ev.type];
+      pthread_mutex_unlock(&sched_lock);
+
+      if (handler) {
+        handler(ev.id, ev.user_id);
+      }
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Tạo timerfd và khởi động scheduler thread (detached).
+ * Trả về 0 nếu thành công, -1 nếu lỗi.
+ */
+int scheduler_start(void) {
+  timer_fd = timerfd_create(CLOCK_REALTIME, TFD_CLOEXEC);
+  if (timer_fd < 0) {
+    perror("timerfd_create");
+    return -1;
+  }
+
+  pthread_mutex_lock(&sched_lock);
+  rearm_locked();
+  pthread_mutex_unlock(&sched_lock);
+
+  pthread_t tid;
+  if (pthread_create(&tid, NULL, scheduler_thread, NULL) != 0) {
+    perror("Failed to create scheduler thread");
+    close(timer_fd);
+    timer_fd = -1;
+    return -1;
+  }
+  pthread_detach(tid);
+  return 0;
+}
@@ -0,0 +1,44 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "common.h"
+
+// Thời gian tối đa một session được phép im lặng trước khi bị server đóng (giây)
+// Lớn hơn thời lượng phòng thi tối đa (180 phút) để không cắt ngang bài thi
+#define SESSION_IDLE_TIMEOUT (4 * 60 * 60)
+
+// Deadline phòng thi/thí sinh trễ thêm vài giây để lệnh SUBMIT_TEST tự động
+// của client (khi đồng hồ về 0) được xử lý trước auto-submit phía server
+#define DEADLINE_GRACE_SECONDS 3
+
+// + 64 = UPLOAD_MAX_SESSIONS (một sự kiện hết hạn mỗi phiên upload)
+#define SCHED_MAX_EVENTS (MAX_ROOMS * 4 + MAX_CLIENTS * MAX_ROOMS + MAX_CLIENTS * 2 + 64 + 8)
+// Số bucket của chỉ mục (type, id, user_id) -> sự kiện
+#define SCHED_BUCKETS 4096
+
+// Các loại deadline được scheduler quản lý
+typedef enum {
+  SCHED_ROOM_DEADLINE = 0,        // id = room_id, user_id = 0
+  SCHED_PARTICIPANT_DEADLINE,     // id = room_id, user_id = participant
+  SCHED_PRACTICE_COOLDOWN,        // id = practice_id, user_id = user
+  SCHED_SESSION_IDLE,             // id = 0, user_id = user
+  SCHED_ROOM_TICK,                // id = room_id, user_id = 0 (nhịp TIME_UPDATE)
+  SCHED_AUDIT_MAINTENANCE,        // id = 0, user_id = 0 (retention/rollup log hằng ngày)
+  SCHED_CHECKPOINT,               // id = 0, user_id = 0 (chụp checkpoint phòng thi)
+  SCHED_LIVE_STATS,               // id = room_id, user_id = 0 (đẩy LIVE_STATS cho host)
+  SCHED_METRICS_PUSH,             // id = 0, user_id = 0 (đẩy METRICS cho admin)
+  SCHED_UPLOAD_EXPIRY,            // id = upload_id, user_id = 0 (dọn phiên upload bỏ dở)
+  SCHED_ROOM_EXPIRY_RETRY,        // id = room_id, user_id = số lần đã thử (ghi lại auto-submit)
+  SCHED_EVENT_TYPES
+} SchedEventType;
+
+// Handler được gọi từ scheduler thread, KHÔNG giữ server_data.lock
+typedef void (*SchedHandler)(int id, int user_id);
+
+void scheduler_register(SchedEventType type, SchedHandler handler);
+int scheduler_start(void);
+void scheduler_add(SchedEventType type, int id, int user_id, time_t deadline);
+void scheduler_cancel(SchedEventType type, int id, int user_id);
+void scheduler_cancel_all(SchedEventType type, int id);
+
+#endif
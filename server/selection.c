@@ -0,0 +1,222 @@
+#include "selection.h"
+#include "db.h"
+#include <ctype.h>
+#include <strings.h>
+
+extern sqlite3 *db;
+
+/*
+ * Bộ chọn câu hỏi ngẫu nhiên cho START_ROOM (random mode):
+ *  - Ngân hàng câu hỏi của mỗi phòng được nạp một lần vào RAM, chia bucket theo
+ *    độ khó đã chuẩn hoá (easy/medium/hard) thay vì TRIM(LOWER()) trong SQL
+ *  - Lấy mẫu k câu phân biệt từ n câu bằng thuật toán Floyd (O(k), không xáo cả mảng)
+ *  - Ghi is_selected trong MỘT transaction (BEGIN IMMEDIATE) trên connection riêng,
+ *    caller không giữ server_data.lock trong lúc ghi
+ *  - Cache bị huỷ khi câu hỏi của phòng thay đổi (question_bank_invalidate).
+ */
+
+typedef struct {
+  int room_id;
+  int valid;
+  time_t last_used;
+  int *ids[DIFFICULTY_LEVELS];
+  int count[DIFFICULTY_LEVELS];
+  int capacity[DIFFICULTY_LEVELS];
+} QuestionBank;
+
+static QuestionBank banks[MAX_ROOMS];
+static pthread_mutex_t bank_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Chuẩn hoá chuỗi độ khó (bỏ khoảng trắng, không phân biệt hoa thường).
+ * Trả về 0/1/2 cho easy/medium/hard, -1 nếu không hợp lệ.
+ */
+int normalize_difficulty(const char *difficulty) {
+  if (!difficulty) return -1;
+
+  while (isspace((unsigned char)*difficulty)) difficulty++;
+  size_t len = strlen(difficulty);
+  while (len > 0 && isspace((unsigned char)difficulty[len - 1])) len--;
+
+  if (len == 4 && strncasecmp(difficulty, "easy", 4) == 0) return 0;
+  if (len == 6 && strncasecmp(difficulty, "medium", 6) == 0) return 1;
+  if (len == 4 && strncasecmp(difficulty, "hard", 4) == 0) return 2;
+  return -1;
+}
+
+static int bank_append(QuestionBank *bank, int level, int question_id) {
+  if (bank->count[level] == bank->capacity[level]) {
+    int new_capacity = bank->capacity[level] ? bank->capacity[level] * 2 : 64;
+    int *grown = realloc(bank->ids[level], sizeof(int) * new_capacity);
+    if (!grown) return -1;
+    bank->ids[level] = grown;
+    bank->capacity[level] = new_capacity;
+  }
+  bank->ids[level][bank->count[level]++] = question_id;
+  return 0;
+}
+
+// Nạp ngân hàng câu hỏi của phòng từ DB (một lần quét theo room_id);
+// thiếu bộ nhớ thì bank vẫn invalid, không dùng ngân hàng thiếu câu
+static int bank_load(QuestionBank *bank, int room_id) {
+  bank->room_id = room_id;
+  bank->valid = 0;
+  for (int d = 0; d < DIFFICULTY_LEVELS; d++) {
+    bank->count[d] = 0;
+  }
+
+  sqlite3_stmt *stmt;
+  if (sqlite3_prepare_v2(db, "SELECT id, difficulty FROM exam_questions WHERE room_id = ?",
+                         -1, &stmt, NULL) != SQLITE_OK) {
+    return -1;
+  }
+  sqlite3_bind_int(stmt, 1, room_id);
+  int rc;
+  while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+    int level = normalize_difficulty((const char *)sqlite3_column_text(stmt, 1));
+    if (level >= 0 && bank_append(bank, level, sqlite3_column_int(stmt, 0)) != 0) {
+      break;
+    }
+  }
+  sqlite3_finalize(stmt);
+  if (rc != SQLITE_DONE) return -1;
+
+  bank->valid = 1;
+  return 0;
+}
+
+// Tìm (hoặc nạp) bank của phòng; caller giữ bank_lock
+static QuestionBank *bank_get(int room_id) {
+  QuestionBank *slot = NULL;
+  for (int i = 0; i < MAX_ROOMS; i++) {
+    if (banks[i].valid && banks[i].room_id == room_id) {
+      banks[i].last_used = time(NULL);
+      return &banks[i];
+    }
+    // Ưu tiên slot trống, nếu không thì slot ít dùng nhất
+    if (!slot || (slot->valid && (!banks[i].valid || banks[i].last_used < slot->last_used))) {
+      slot = &banks[i];
+    }
+  }
+
+  if (bank_load(slot, room_id) != 0) return NULL;
+  slot->last_used = time(NULL);
+  return slot;
+}
+
+/*
+ * Huỷ cache ngân hàng câu hỏi của phòng (room_id <= 0: huỷ tất cả).
+ * Gọi sau mọi thao tác thêm/sửa/xoá exam_questions.
+ */
+void question_bank_invalidate(int room_id) {
+  pthread_mutex_lock(&bank_lock);
+  for (int i = 0; i < MAX_ROOMS; i++) {
+    if (banks[i].valid && (room_id <= 0 || banks[i].room_id == room_id)) {
+      banks[i].valid = 0;
+    }
+  }
+  pthread_mutex_unlock(&bank_lock);
+}
+
+// Floyd: chọn k phần tử phân biệt trong ids[0..n-1], ghi vào out; -1 nếu thiếu bộ nhớ
+static int floyd_sample(const int *ids, int n, int k, int *out) {
+  unsigned char *taken = calloc(n, 1);
+  if (!taken) return -1;
+
+  int m = 0;
+  for (int j = n - k; j < n; j++) {
+    int t = rand() % (j + 1);
+    int pick = taken[t] ? j : t;
+    taken[pick] = 1;
+    out[m++] = ids[pick];
+  }
+  free(taken);
+  return 0;
+}
+
+/*
+ * Chọn ngẫu nhiên required[d] câu cho mỗi độ khó và ghi is_selected xuống DB.
+ * Trả về tổng số câu đã chọn; -1 nếu không đủ câu (available[] cho biết số câu hiện có);
+ * -2 nếu lỗi DB/thiếu bộ nhớ (khi đó is_selected không đổi).
+ */
+int select_random_questions(int room_id, const int required[DIFFICULTY_LEVELS],
+                            int available[DIFFICULTY_LEVELS], int selected[DIFFICULTY_LEVELS]) {
+  int total_required = 0;
+  for (int d = 0; d < DIFFICULTY_LEVELS; d++) {
+    total_required += required[d] > 0 ? required[d] : 0;
+    selected[d] = 0;
+  }
+
+  int *chosen = malloc(sizeof(int) * (total_required > 0 ? total_required : 1));
+  if (!chosen) return -2;
+
+  pthread_mutex_lock(&bank_lock);
+  QuestionBank *bank = bank_get(room_id);
+  if (!bank) {
+    pthread_mutex_unlock(&bank_lock);
+    free(chosen);
+    return -2;
+  }
+
+  int insufficient = 0;
+  for (int d = 0; d < DIFFICULTY_LEVELS; d++) {
+    available[d] = bank->count[d];
+    if (required[d] > available[d]) insufficient = 1;
+  }
+  if (insufficient) {
+    pthread_mutex_unlock(&bank_lock);
+    free(chosen);
+    return -1;
+  }
+
+  int chosen_count = 0;
+  for (int d = 0; d < DIFFICULTY_LEVELS; d++) {
+    if (required[d] <= 0) continue;
+    if (floyd_sample(bank->ids[d], bank->count[d], required[d], chosen + chosen_count) != 0) {
+      pthread_mutex_unlock(&bank_lock);
+      free(chosen);
+      return -2;
+    }
+    chosen_count += required[d];
+    selected[d] = required[d];
+  }
+  pthread_mutex_unlock(&bank_lock);
+
+  // Ghi lựa chọn trong một transaction trên connection riêng
+  sqlite3 *conn = db_open_worker_connection();
+  if (!conn || sqlite3_exec(conn, "BEGIN IMMEDIATE", NULL, NULL, NULL) != SQLITE_OK) {
+    sqlite3_close(conn);
+    free(chosen);
+    return -2;
+  }
+
+  int rc = 0;
+  sqlite3_stmt *stmt;
+  if (sqlite3_prepare_v2(conn, "UPDATE exam_questions SET is_selected = 0 WHERE room_id = ? AND is_selected != 0",
+                         -1, &stmt, NULL) == SQLITE_OK) {
+    sqlite3_bind_int(stmt, 1, room_id);
+    if (sqlite3_step(stmt) != SQLITE_DONE) rc = -2;
+    sqlite3_finalize(stmt);
+  } else {
+    rc = -2;
+  }
+
+  if (rc == 0 && sqlite3_prepare_v2(conn, "UPDATE exam_questions SET is_selected = 1 WHERE id = ?",
+                                    -1, &stmt, NULL) == SQLITE_OK) {
+    for (int i = 0; i < chosen_count; i++) {
+      sqlite3_bind_int(stmt, 1, chosen[i]);
+      if (sqlite3_step(stmt) != SQLITE_DONE) rc = -2;
+      sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+  } else {
+    rc = -2;
+  }
+
+  if (rc == 0 && sqlite3_exec(conn, "COMMIT", NULL, NULL, NULL) != SQLITE_OK) rc = -2;
+  if (rc != 0) sqlite3_exec(conn, "ROLLBACK", NULL, NULL, NULL);
+  sqlite3_close(conn);
+  free(chosen);
+
+  return rc == 0 ? chosen_count : rc;
+}
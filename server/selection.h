@@ -0,0 +1,13 @@
+#ifndef SELECTION_H
+#define SELECTION_H
+
+#include "common.h"
+
+#define DIFFICULTY_LEVELS 3   // 0=easy, 1=medium, 2=hard
+
+int normalize_difficulty(const char *difficulty);
+void question_bank_invalidate(int room_id);
+int select_random_questions(int room_id, const int required[DIFFICULTY_LEVELS],
+                            int available[DIFFICULTY_LEVELS], int selected[DIFFICULTY_LEVELS]);
+
+#endif
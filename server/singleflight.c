@@ -0,0 +1,195 @@
+#include "singleflight.h"
+#include <time.h>
+
+/*
+ * Gộp các request đọc giống hệt nhau đang chạy đồng thời (single-flight):
+ *  - Khoá = (command, room_id, version). Request đầu tiên (leader) chạy loader,
+ *    các request trùng khoá đến trong lúc đó chờ và dùng chung buffer kết quả
+ *  - linger_ms = 0: lượt tính xong thì gỡ khỏi bảng, request sau tính lại từ đầu;
+ *    linger_ms > 0: kết quả còn dùng được thêm chừng đó (chỉ cho dữ liệu mà mọi
+ *    thay đổi đều tăng version)
+ *  - version của phòng tăng khi nội dung phòng đổi (sửa/chọn câu hỏi, bắt đầu thi...)
+ *    để request đến sau thay đổi không dùng kết quả của lượt tính cũ
+ *  - Buffer bất biến, đếm tham chiếu; người trả cuối cùng giải phóng.
+ * Dùng cho BEGIN_EXAM ngay sau ROOM_STARTED (mọi thí sinh gửi cùng lúc) và
+ * GET_ROOM_MEMBERS. sf_lock là lock lá, loader chạy ngoài lock.
+ */
+
+typedef struct Flight {
+  SfResult result;              // phải là field đầu (singleflight_release ép kiểu ngược)
+  char command[SF_COMMAND_LEN];
+  int room_id;
+  unsigned long version;
+  int done;
+  int refs;                     // request đang dùng + 1 nếu còn nằm trong bảng
+  long expires_ms;              // hết hạn linger (chỉ có nghĩa khi done)
+  void *data;
+  SfDestroy destroy;
+  pthread_cond_t done_cond;
+  struct Flight *next;
+} Flight;
+
+static Flight *buckets[SF_BUCKETS];
+static pthread_mutex_t sf_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned long room_versions[SF_VERSION_SLOTS];
+static unsigned long global_epoch = 0;
+
+static unsigned int flight_hash(const char *command, int room_id, unsigned long version) {
+  unsigned int h = 5381;
+  while (*command) h = h * 33 + (unsigned char)*command++;
+  h = h * 33 + (unsigned int)room_id;
+  h = h * 33 + (unsigned int)version;
+  return h % SF_BUCKETS;
+}
+
+static long now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+static void flight_unlink(Flight *f) {
+  Flight **link = &buckets[flight_hash(f->command, f->room_id, f->version)];
+  while (*link && *link != f) link = &(*link)->next;
+  if (*link) *link = f->next;
+}
+
+// Gọi khi đang giữ sf_lock; trả 1 nếu caller phải giải phóng f
+static int flight_put(Flight *f) {
+  return --f->refs == 0;
+}
+
+static void flight_free(Flight *f) {
+  if (f->data && f->destroy) f->destroy(f->data);
+  pthread_cond_destroy(&f->done_cond);
+  free(f);
+}
+
+// Gỡ các kết quả hết linger (quét cả bảng, SF_BUCKETS nhỏ); trả danh sách cần free
+// (nối qua next). Gọi khi đang giữ sf_lock.
+static Flight *evict_expired(long now) {
+  Flight *dead = NULL;
+  for (int b = 0; b < SF_BUCKETS; b++) {
+    Flight **link = &buckets[b];
+    while (*link) {
+      Flight *f = *link;
+      if (f->done && now >= f->expires_ms) {
+        *link = f->next;
+        if (flight_put(f)) {
+          f->next = dead;
+          dead = f;
+        }
+      } else {
+        link = &f->next;
+      }
+    }
+  }
+  return dead;
+}
+
+static void free_list(Flight *dead) {
+  while (dead) {
+    Flight *next = dead->next;
+    flight_free(dead);
+    dead = next;
+  }
+}
+
+/*
+ * Lấy kết quả cho khoá (command, room_id, version), chạy loader nếu chưa có lượt
+ * tính nào đang chạy. Trả NULL nếu loader lỗi; ngược lại caller phải gọi
+ * singleflight_release khi dùng xong.
+ */
+const SfResult *singleflight_do(const char *command, int room_id, unsigned long version,
+                                int linger_ms, SfLoader loader, SfDestroy destroy, void *ctx) {
+  pthread_mutex_lock(&sf_lock);
+  unsigned int b = flight_hash(command, room_id, version);
+  Flight *dead = evict_expired(now_ms());
+  Flight *f = buckets[b];
+  while (f && !(f->room_id == room_id && f->version == version &&
+                strncmp(f->command, command, SF_COMMAND_LEN) == 0))
+    f = f->next;
+
+  if (f) {
+    // Đã có leader: chờ và dùng chung kết quả
+    f->refs++;
+    f->result.shared++;
+    while (!f->done) pthread_cond_wait(&f->done_cond, &sf_lock);
+  } else {
+    f = calloc(1, sizeof(Flight));
+    if (!f) {
+      pthread_mutex_unlock(&sf_lock);
+      free_list(dead);
+      return NULL;
+    }
+    snprintf(f->command, sizeof(f->command), "%s", command);
+    f->room_id = room_id;
+    f->version = version;
+    f->refs = 2;                // leader + bảng
+    f->result.shared = 1;
+    f->destroy = destroy;
+    pthread_cond_init(&f->done_cond, NULL);
+    f->next = buckets[b];
+    buckets[b] = f;
+    pthread_mutex_unlock(&sf_lock);
+
+    size_t size = 0;
+    void *data = loader(ctx, &size);
+
+    pthread_mutex_lock(&sf_lock);
+    f->data = data;
+    f->result.data = data;
+    f->result.size = data ? size : 0;
+    f->done = 1;
+    f->expires_ms = now_ms() + linger_ms;
+    if (linger_ms <= 0 || !data) {
+      flight_unlink(f);
+      flight_put(f);            // leader vẫn giữ một tham chiếu
+    }
+    pthread_cond_broadcast(&f->done_cond);
+    if (f->result.shared > 1) {
+      printf("[SINGLEFLIGHT] %s room=%d shared by %d requests\n", command, room_id, f->result.shared);
+    }
+  }
+
+  const SfResult *result = &f->result;
+  int last = 0;
+  if (!f->data) {
+    last = flight_put(f);
+    result = NULL;
+  }
+  pthread_mutex_unlock(&sf_lock);
+  if (last) flight_free(f);
+  free_list(dead);
+  return result;
+}
+
+void singleflight_release(const SfResult *result) {
+  if (!result) return;
+  Flight *f = (Flight *)result;
+  pthread_mutex_lock(&sf_lock);
+  int last = flight_put(f);
+  pthread_mutex_unlock(&sf_lock);
+  if (last) flight_free(f);
+}
+
+/*
+ * Version nội dung của phòng (room_id <= 0: chỉ epoch toàn cục).
+ */
+unsigned long singleflight_room_version(int room_id) {
+  unsigned long epoch = __atomic_load_n(&global_epoch, __ATOMIC_ACQUIRE);
+  if (room_id <= 0) return epoch;
+  return epoch + __atomic_load_n(&room_versions[room_id % SF_VERSION_SLOTS], __ATOMIC_ACQUIRE);
+}
+
+/*
+ * Báo nội dung phòng đã đổi. room_id <= 0: không biết phòng nào (vd xoá câu hỏi theo id)
+ * -> đổi version của mọi phòng.
+ */
+void singleflight_room_changed(int room_id) {
+  if (room_id <= 0)
+    __atomic_add_fetch(&global_epoch, 1, __ATOMIC_RELEASE);
+  else
+    __atomic_add_fetch(&room_versions[room_id % SF_VERSION_SLOTS], 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,34 @@
+#ifndef SINGLEFLIGHT_H
+#define SINGLEFLIGHT_H
+
+#include "common.h"
+
+// Số bucket của bảng lượt tính đang chạy
+#define SF_BUCKETS 64
+// Số slot version theo phòng (room_id trùng slot chỉ làm version tăng thừa, vẫn đúng)
+#define SF_VERSION_SLOTS 1024
+#define SF_COMMAND_LEN 32
+// Thời gian giữ lại kết quả của BEGIN_EXAM sau khi tính xong (ms): thí sinh gửi trễ
+// vài trăm ms sau ROOM_STARTED vẫn dùng chung, an toàn vì version nằm trong khoá
+#define SF_EXAM_LINGER_MS 2000
+
+// Kết quả bất biến dùng chung giữa các request trùng nhau
+typedef struct {
+  const void *data;
+  size_t size;
+  int shared;           // số request đã dùng chung lượt tính này (kể cả leader)
+} SfResult;
+
+// Tính kết quả (chạy trên thread của leader, không giữ lock của singleflight).
+// Trả buffer đã malloc, NULL nếu lỗi; destroy giải phóng buffer khi không còn ai dùng.
+typedef void *(*SfLoader)(void *ctx, size_t *size);
+typedef void (*SfDestroy)(void *data);
+
+const SfResult *singleflight_do(const char *command, int room_id, unsigned long version,
+                                int linger_ms, SfLoader loader, SfDestroy destroy, void *ctx);
+void singleflight_release(const SfResult *result);
+
+unsigned long singleflight_room_version(int room_id);
+void singleflight_room_changed(int room_id);
+
+#endif
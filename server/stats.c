@@ -1,5 +1,10 @@
 #include "stats.h"
 #include "db.h"
+#include "leaderboard.h"
+#include "user_stats.h"
+#include "analytics.h"
+#include "pager.h"
+#include "network.h"
 #include <sys/socket.h>
 
 extern ServerData server_data;
@@ -7,216 +12,122 @@ extern sqlite3 *db;
 
 /*
  * Lấy bảng xếp hạng theo tổng điểm của tất cả user (trừ admin):
- *  - Gom SUM(score) và COUNT(tests) từ bảng results
- *  - Trả về top N theo tham số limit.
+ *  - Đọc từ bảng xếp hạng in-memory (xem leaderboard.c), không truy vấn SQLite
+ *  - Trả về limit dòng bắt đầu từ vị trí offset (phân trang).
  */
-void get_leaderboard(int socket_fd, int limit)
+void get_leaderboard(int socket_fd, int limit, int offset)
 {
-  char query[500];
-  sqlite3_stmt *stmt;
+  if (limit <= 0 || limit > LEADERBOARD_MAX_PAGE)
+    limit = LEADERBOARD_MAX_PAGE;
 
-  snprintf(query, sizeof(query),
-           "SELECT u.id, u.username, COALESCE(SUM(r.score), 0) as total_score, COUNT(r.id) as tests_completed "
-           "FROM users u LEFT JOIN results r ON u.id = r.user_id "
-           "WHERE u.role != 'admin' "
-           "GROUP BY u.id ORDER BY total_score DESC LIMIT %d;",
-           limit);
+  LeaderboardRow rows[LEADERBOARD_MAX_PAGE];
+  int count = leaderboard_window(offset, limit, rows, NULL);
 
-  pthread_mutex_lock(&server_data.lock);
+  size_t size = 32 + (size_t)count * (sizeof(rows[0].username) + 48);
+  char *response = malloc(size);
+  if (!response)
+  {
+    server_send(socket_fd, "LEADERBOARD|\n");
+    return;
+  }
 
-  if (sqlite3_prepare_v2(db, query, -1, &stmt, 0) == SQLITE_OK)
+  size_t len = snprintf(response, size, "LEADERBOARD|");
+  for (int i = 0; i < count; i++)
   {
-    char response[4096];
-    strcpy(response, "LEADERBOARD|");
-
-    int rank = 1;
-    while (sqlite3_step(stmt) == SQLITE_ROW)
-    {
-      const char *username = (const char *)sqlite3_column_text(stmt, 1);
-      int total_score = sqlite3_column_int(stmt, 2);
-      int tests_completed = sqlite3_column_int(stmt, 3);
-
-      char entry[300];
-      snprintf(entry, sizeof(entry), "#%d|%s|Score:%d|Tests:%d|",
-               rank, username, total_score, tests_completed);
-      strcat(response, entry);
-      rank++;
-    }
-
-    strcat(response, "\n");
-    send(socket_fd, response, strlen(response), 0);
+    len += snprintf(response + len, size - len, "#%d|%s|Score:%d|Tests:%d|",
+                    rows[i].rank, rows[i].username, rows[i].total_score, rows[i].tests_completed);
   }
+  snprintf(response + len, size - len, "\n");
 
-  sqlite3_finalize(stmt);
-  pthread_mutex_unlock(&server_data.lock);
+  send(socket_fd, response, strlen(response), 0);
+  free(response);
+}
+
+/*
+ * Hạng hiện tại của user trên bảng xếp hạng:
+ *  MY_RANK|rank|total_players|Score:X|Tests:Y (rank = 0 nếu không có trong bảng, vd admin).
+ */
+void get_my_rank(int socket_fd, int user_id)
+{
+  LeaderboardRow row;
+  memset(&row, 0, sizeof(row));
+  int total = 0;
+  int rank = leaderboard_rank(user_id, &row, &total);
+
+  char response[128];
+  snprintf(response, sizeof(response), "MY_RANK|%d|%d|Score:%d|Tests:%d\n",
+           rank, total, row.total_score, row.tests_completed);
+  send(socket_fd, response, strlen(response), 0);
 }
 
 /*
  * Thống kê tổng quan kết quả thi của một user:
- *  - Tổng số bài thi, điểm trung bình, điểm cao nhất, tổng điểm.
+ *  - Tổng số bài thi, điểm trung bình, điểm cao nhất, tổng điểm
+ *  - Đọc từ rollup user_stats (xem user_stats.c), không quét bảng results.
  */
 void get_user_statistics(int socket_fd, int user_id)
 {
-  char query[500];
-  sqlite3_stmt *stmt;
-
-  snprintf(query, sizeof(query),
-           "SELECT COUNT(id) as total_tests, AVG(CAST(score AS FLOAT)/total_questions) as avg_score, "
-           "MAX(score) as max_score, SUM(score) as total_score "
-           "FROM results WHERE user_id = %d;",
-           user_id);
-
-  pthread_mutex_lock(&server_data.lock);
-
-  if (sqlite3_prepare_v2(db, query, -1, &stmt, 0) == SQLITE_OK)
+  UserStatsSummary summary;
+  if (user_stats_get(user_id, &summary) != 0)
   {
-    if (sqlite3_step(stmt) == SQLITE_ROW)
-    {
-      int total_tests = sqlite3_column_int(stmt, 0);
-      double avg_score = sqlite3_column_double(stmt, 1);
-      int max_score = sqlite3_column_int(stmt, 2);
-      int total_score = sqlite3_column_int(stmt, 3);
-
-      char response[300];
-      snprintf(response, sizeof(response),
-               "USER_STATS|Tests:%d|AvgScore:%.2f%%|MaxScore:%d|TotalScore:%d\n",
-               total_tests, avg_score * 100, max_score, total_score);
-      send(socket_fd, response, strlen(response), 0);
-    }
+    char response[] = "ERROR|Failed to load statistics\n";
+    send(socket_fd, response, strlen(response), 0);
+    return;
   }
 
-  sqlite3_finalize(stmt);
-  pthread_mutex_unlock(&server_data.lock);
+  char response[300];
+  snprintf(response, sizeof(response),
+           "USER_STATS|Tests:%d|AvgScore:%.2f%%|MaxScore:%d|TotalScore:%d\n",
+           summary.tests, summary.avg_ratio * 100, summary.max_score, summary.total_score);
+  send(socket_fd, response, strlen(response), 0);
 }
 
 /*
- * Thống kê theo category (hiện tại là All Categories):
- *  - Số bài thi và số bài đạt (điểm >= 50%) của user.
+ * Thống kê theo category của user:
+ *  - Số câu đúng / số câu đã làm theo category của từng câu hỏi
+ *  - Đọc từ bộ đếm in-memory (xem analytics.c).
  */
 void get_category_stats(int socket_fd, int user_id)
 {
-  char query[800];
-  sqlite3_stmt *stmt;
-
-  snprintf(query, sizeof(query),
-           "SELECT 'All Categories' as category, COUNT(DISTINCT r.id) as tests, "
-           "SUM(CASE WHEN CAST(r.score AS FLOAT)/r.total_questions >= 0.5 THEN 1 ELSE 0 END) as passed "
-           "FROM results r "
-           "WHERE r.user_id = %d;",
-           user_id);
-
-  pthread_mutex_lock(&server_data.lock);
-
-  if (sqlite3_prepare_v2(db, query, -1, &stmt, 0) == SQLITE_OK)
-  {
-    char response[2048];
-    strcpy(response, "CATEGORY_STATS|");
-
-    while (sqlite3_step(stmt) == SQLITE_ROW)
-    {
-      const char *category = (const char *)sqlite3_column_text(stmt, 0);
-      int tests = sqlite3_column_int(stmt, 1);
-      int passed = sqlite3_column_int(stmt, 2);
-
-      char entry[200];
-      snprintf(entry, sizeof(entry), "%s:%d/%d|", category, passed, tests);
-      strcat(response, entry);
-    }
-
-    strcat(response, "\n");
-    send(socket_fd, response, strlen(response), 0);
-  }
-
-  sqlite3_finalize(stmt);
-  pthread_mutex_unlock(&server_data.lock);
+  analytics_send_category_stats(socket_fd, user_id);
 }
 
 /*
- * Thống kê theo độ khó (hiện tại All Difficulties):
- *  - Số bài thi và tỉ lệ điểm trung bình (pass_rate) của user.
+ * Thống kê theo độ khó (Easy/Medium/Hard) của user:
+ *  - Số câu đã làm và tỉ lệ đúng ở mỗi mức
+ *  - Đọc từ bộ đếm in-memory (xem analytics.c).
  */
 void get_difficulty_stats(int socket_fd, int user_id)
 {
-  char query[800];
-  sqlite3_stmt *stmt;
-
-  snprintf(query, sizeof(query),
-           "SELECT 'All Difficulties' as difficulty, COUNT(DISTINCT r.id) as tests, "
-           "AVG(CAST(r.score AS FLOAT)/r.total_questions) as pass_rate "
-           "FROM results r "
-           "WHERE r.user_id = %d;",
-           user_id);
-
-  pthread_mutex_lock(&server_data.lock);
-
-  if (sqlite3_prepare_v2(db, query, -1, &stmt, 0) == SQLITE_OK)
-  {
-    char response[2048];
-    strcpy(response, "DIFFICULTY_STATS|");
-
-    while (sqlite3_step(stmt) == SQLITE_ROW)
-    {
-      const char *difficulty = (const char *)sqlite3_column_text(stmt, 0);
-      int tests = sqlite3_column_int(stmt, 1);
-      double pass_rate = sqlite3_column_double(stmt, 2);
-
-      char entry[200];
-      snprintf(entry, sizeof(entry), "%s:%d:%.1f%%|", difficulty, tests, pass_rate * 100);
-      strcat(response, entry);
-    }
-
-    strcat(response, "\n");
-    send(socket_fd, response, strlen(response), 0);
-  }
-
-  sqlite3_finalize(stmt);
-  pthread_mutex_unlock(&server_data.lock);
+  analytics_send_difficulty_stats(socket_fd, user_id);
 }
 
 /*
- * Lấy lịch sử tối đa 20 bài thi gần nhất của user:
- *  - Kèm tên phòng, điểm, tổng số câu, thời gian làm và thời điểm hoàn thành.
+ * Lấy lịch sử bài thi của user theo trang (mới nhất trước):
+ *  - Kèm tên phòng, điểm, tổng số câu, thời gian làm và thời điểm hoàn thành
+ *  - cursor = result id cuối của trang trước (0 = trang đầu), tối đa USER_STATS_PAGE_MAX dòng
+ *  - Kết thúc bằng dòng "NEXT|<cursor>" (NEXT|0 = trang cuối).
  */
-void get_user_test_history(int socket_fd, int user_id)
+void get_user_test_history(int socket_fd, int user_id, int cursor, int limit)
 {
-  char query[800];
-  sqlite3_stmt *stmt;
+  UserHistoryRow rows[USER_STATS_PAGE_MAX];
+  int has_more = 0;
+  int count = user_stats_history(user_id, cursor, limit, rows, &has_more);
+  if (count < 0)
+    count = 0;
 
-  snprintf(query, sizeof(query),
-           "SELECT r.id, rm.name, r.score, r.total_questions, "
-           "r.time_taken, datetime(r.completed_at, 'localtime') "
-           "FROM results r "
-           "JOIN rooms rm ON r.room_id = rm.id "
-           "WHERE r.user_id = %d "
-           "ORDER BY r.completed_at DESC LIMIT 20;",
-           user_id);
+  PageStream ps;
+  page_stream_begin(&ps, socket_fd);
+  page_stream_printf(&ps, "TEST_HISTORY|");
 
-  pthread_mutex_lock(&server_data.lock);
-
-  if (sqlite3_prepare_v2(db, query, -1, &stmt, 0) == SQLITE_OK)
+  for (int i = 0; i < count; i++)
   {
-    char response[8192];
-    strcpy(response, "TEST_HISTORY|");
-
-    while (sqlite3_step(stmt) == SQLITE_ROW)
-    {
-      int result_id = sqlite3_column_int(stmt, 0);
-      const char *room_name = (const char *)sqlite3_column_text(stmt, 1);
-      int score = sqlite3_column_int(stmt, 2);
-      int total = sqlite3_column_int(stmt, 3);
-      int time_taken = sqlite3_column_int(stmt, 4);
-      const char *completed = (const char *)sqlite3_column_text(stmt, 5);
-
-      char entry[400];
-      snprintf(entry, sizeof(entry), "%d|%s|%d|%d|%d|%s|",
-               result_id, room_name, score, total, time_taken, completed ? completed : "N/A");
-      strcat(response, entry);
-    }
-
-    strcat(response, "\n");
-    send(socket_fd, response, strlen(response), 0);
+    page_stream_printf(&ps, "%d|%s|%d|%d|%d|%s|",
+                       rows[i].result_id, rows[i].room_name, rows[i].score,
+                       rows[i].total, rows[i].time_taken, rows[i].completed);
   }
 
-  sqlite3_finalize(stmt);
-  pthread_mutex_unlock(&server_data.lock);
+  page_stream_printf(&ps, "\n");
+  page_stream_next(&ps, has_more && count > 0 ? rows[count - 1].result_id : 0);
+  page_stream_end(&ps);
 }
@@ -3,10 +3,11 @@
 
 #include "include/common.h"
 
-void get_leaderboard(int socket_fd, int limit);
+void get_leaderboard(int socket_fd, int limit, int offset);
+void get_my_rank(int socket_fd, int user_id);
 void get_user_statistics(int socket_fd, int user_id);
 void get_category_stats(int socket_fd, int user_id);
 void get_difficulty_stats(int socket_fd, int user_id);
-void get_user_test_history(int socket_fd, int user_id);
+void get_user_test_history(int socket_fd, int user_id, int cursor, int limit);
 
 #endif
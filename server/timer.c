@@ -1,5 +1,14 @@
 #include "timer.h"
 #include "db.h"
+#include "results.h"
+#include "scheduler.h"
+#include "catalog.h"
+#include "leaderboard.h"
+#include "user_stats.h"
+#include "analytics.h"
+#include "metrics.h"
+#include "network.h"
+#include "roster.h"
 #include <time.h>
 #include <pthread.h>
 
@@ -7,169 +16,500 @@ extern ServerData server_data;
 extern sqlite3 *db;
 
 /*
- * Gửi thông tin thời gian còn lại của một phòng thi tới tất cả
- * thí sinh trong phòng (hiện tại mới xây dựng message, chưa gửi ra client).
- * NOTE: This function is called from check_room_timeouts which already holds the mutex
+ * Gửi TIME_UPDATE (thời gian còn lại theo đồng hồ server) tới tất cả
+ * thí sinh online trong phòng:
+ *  - Message được format MỘT lần vào buffer chung cho cả phòng
+ *  - Danh sách socket được chụp lại trong lock, việc gửi diễn ra ngoài lock
+ *    và không chặn (server_push) để client chậm không làm trễ các phòng khác;
+ *    client có buffer đầy chỉ lỡ một TIME_UPDATE, lần sau sẽ bù.
  */
-void broadcast_time_update(int room_idx, int time_remaining)
+void broadcast_time_update(int room_id, int time_remaining)
 {
-  // NOTE: No mutex lock here - caller (check_room_timeouts) already holds the lock
-  
-  TestRoom *room = &server_data.rooms[room_idx];
+  int sockets[MAX_CLIENTS];
+  int socket_count = 0;
 
-  // Send time update to all participants
-  char update[100];
-  snprintf(update, sizeof(update), "TIME_UPDATE|%d|%d\n", room->room_id, time_remaining);
+  pthread_mutex_lock(&server_data.lock);
+  for (int r = 0; r < server_data.room_count; r++)
+  {
+    TestRoom *room = &server_data.rooms[r];
+    if (room->room_id != room_id)
+      continue;
+
+    for (int i = 0; i < room->participant_count; i++)
+    {
+      for (int u = 0; u < server_data.user_count; u++)
+      {
+        if (server_data.users[u].user_id == room->participants[i] &&
+            server_data.users[u].is_online == 1 &&
+            socket_count < MAX_CLIENTS)
+        {
+          sockets[socket_count++] = server_data.users[u].socket_fd;
+          break;
+        }
+      }
+    }
+    break;
+  }
+  pthread_mutex_unlock(&server_data.lock);
 
-  for (int i = 0; i < room->participant_count; i++)
+  char update[64];
+  int len = snprintf(update, sizeof(update), "TIME_UPDATE|%d|%d\n", room_id, time_remaining);
+  for (int i = 0; i < socket_count; i++)
   {
-    // In a real app, we'd need to track client sockets for each participant
-    // Currently, this function only updates server-side timer state.
+    server_push(sockets[i], update, (size_t)len);
   }
 }
 
+static int find_room_index_by_id(int room_id)
+{
+  for (int i = 0; i < server_data.room_count; i++)
+  {
+    if (server_data.rooms[i].room_id == room_id)
+      return i;
+  }
+  return -1;
+}
+
 /*
- * Quét toàn bộ phòng thi đang STARTED để kiểm tra hết giờ:
- *  - Gửi TIME_UPDATE định kỳ (thông qua broadcast_time_update)
- *  - Khi hết thời gian, auto-submit cho các user đang online và
- *    ghi kết quả vào bảng results.
+ * Lên lịch deadline kết thúc phòng thi (gọi lại khi host START_ROOM lần nữa sẽ dời deadline).
  */
-void check_room_timeouts(void)
+void timer_schedule_room(int room_id, time_t start_time, int time_limit)
 {
-  pthread_mutex_lock(&server_data.lock);
+  scheduler_add(SCHED_ROOM_DEADLINE, room_id, 0,
+                start_time + (time_t)time_limit * 60 + DEADLINE_GRACE_SECONDS);
+}
 
-  time_t now = time(NULL);
+/*
+ * Lên lịch nhịp TIME_UPDATE đầu tiên cho phòng vừa START.
+ */
+void timer_schedule_room_ticks(int room_id)
+{
+  scheduler_add(SCHED_ROOM_TICK, room_id, 0, time(NULL) + TIME_UPDATE_INTERVAL);
+}
 
-  for (int i = 0; i < server_data.room_count; i++)
+/*
+ * Lên lịch deadline riêng của một thí sinh (tính từ start_time của thí sinh đó,
+ * dùng cho trường hợp resume sau khi phòng đã kết thúc).
+ */
+void timer_schedule_participant(int room_id, int user_id, time_t start_time, int time_limit)
+{
+  scheduler_add(SCHED_PARTICIPANT_DEADLINE, room_id, user_id,
+                start_time + (time_t)time_limit * 60 + DEADLINE_GRACE_SECONDS);
+}
+
+// Đáp án in-memory của thí sinh online, chụp lại lúc phòng hết giờ
+typedef struct
+{
+  int user_id;
+  int question_idx;
+  int answer;
+  time_t submit_time;
+} ExpiredAnswer;
+
+// Connection riêng của scheduler thread: transaction auto-submit không trộn với connection chính
+static sqlite3 *expiry_db = NULL;
+
+// Ảnh chụp lúc phòng hết giờ, giữ lại tới khi ghi xuống DB thành công
+typedef struct PendingExpiry
+{
+  int room_id;
+  int time_limit;
+  int *online_ids;
+  int online_count;
+  ExpiredAnswer *answers;
+  int answer_count;
+  struct PendingExpiry *next;
+} PendingExpiry;
+
+// Các lần auto-submit đang chờ thử lại (chỉ scheduler thread truy cập)
+static PendingExpiry *pending_expiries = NULL;
+
+/*
+ * Ghi kết quả auto-submit cho phòng vừa hết giờ (chạy NGOÀI server_data.lock):
+ *  - Ghi các đáp án in-memory đã chụp vào exam_answers (id câu hỏi theo thứ tự được đọc
+ *    một lần rồi bind trực tiếp, không OFFSET theo từng đáp án)
+ *  - Một câu INSERT ... SELECT duy nhất cho tất cả thí sinh online đã bắt đầu thi
+ *    và chưa có kết quả (NOT EXISTS -> chạy lại không tạo bản ghi trùng)
+ *  - Tất cả trong một transaction. Trả -1 nếu không mở được connection, không lấy được
+ *    khoá ghi hoặc có lệnh lỗi (đã rollback): caller giữ ảnh chụp và thử lại sau.
+ */
+static int persist_room_expiry(const PendingExpiry *e)
+{
+  if (!expiry_db)
+    expiry_db = db_open_worker_connection();
+  if (!expiry_db)
+    return -1;
+  sqlite3 *conn = expiry_db;
+  int room_id = e->room_id;
+
+  if (sqlite3_exec(conn, "BEGIN IMMEDIATE", NULL, NULL, NULL) != SQLITE_OK)
   {
-    TestRoom *room = &server_data.rooms[i];
+    fprintf(stderr, "[TIMER] Auto-submit room %d deferred: %s\n", room_id, sqlite3_errmsg(conn));
+    return -1;
+  }
+
+  int *scored = NULL;  // cặp (user_id, score) của các bài vừa auto-submit
+  int scored_count = 0;
 
-    if (room->room_status == 1)  // STARTED
-    { // Ongoing
-      int elapsed = (int)(now - room->exam_start_time);
-      int remaining = (room->time_limit * 60) - elapsed;  // time_limit is in minutes, convert to seconds
+  char update_status_sql[128];
+  snprintf(update_status_sql, sizeof(update_status_sql),
+           "UPDATE rooms SET room_status = 2 WHERE id = %d", room_id);
+  int ok = sqlite3_exec(conn, update_status_sql, NULL, NULL, NULL) == SQLITE_OK;
+
+  // Đáp án chưa kịp flush (save_answer chỉ flush mỗi 5 câu)
+  sqlite3_stmt *stmt;
+  int question_ids[MAX_QUESTIONS];
+  int question_count = 0;
+  if (ok && e->answer_count > 0)
+  {
+    ok = sqlite3_prepare_v2(conn, "SELECT id FROM exam_questions WHERE room_id = ? AND is_selected = 1 ORDER BY id",
+                            -1, &stmt, NULL) == SQLITE_OK;
+    if (ok)
+    {
+      int rc;
+      sqlite3_bind_int(stmt, 1, room_id);
+      while (question_count < MAX_QUESTIONS && (rc = sqlite3_step(stmt)) == SQLITE_ROW)
+        question_ids[question_count++] = sqlite3_column_int(stmt, 0);
+      ok = question_count == MAX_QUESTIONS || rc == SQLITE_DONE;
+      sqlite3_finalize(stmt);
+    }
+  }
 
-      if (remaining > 0)
+  const char *answer_sql =
+    "INSERT OR REPLACE INTO exam_answers (user_id, room_id, question_id, selected_answer, answered_at) "
+    "VALUES (?, ?, ?, ?, ?)";
+  if (ok && question_count > 0)
+  {
+    ok = sqlite3_prepare_v2(conn, answer_sql, -1, &stmt, NULL) == SQLITE_OK;
+    for (int i = 0; ok && i < e->answer_count; i++)
+    {
+      const ExpiredAnswer *ans = &e->answers[i];
+      if (ans->question_idx >= question_count)
+        continue;
+      sqlite3_bind_int(stmt, 1, ans->user_id);
+      sqlite3_bind_int(stmt, 2, room_id);
+      sqlite3_bind_int(stmt, 3, question_ids[ans->question_idx]);
+      sqlite3_bind_int(stmt, 4, ans->answer);
+      sqlite3_bind_int64(stmt, 5, ans->submit_time);
+      ok = sqlite3_step(stmt) == SQLITE_DONE;
+      sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+  }
+
+  if (ok && e->online_count > 0)
+  {
+    // Danh sách user online dạng "1,5,7" (chỉ chứa số nguyên)
+    size_t list_size = (size_t)e->online_count * 12 + 1;
+    char *id_list = malloc(list_size);
+    scored = malloc(sizeof(int) * 2 * e->online_count);
+    char *insert_sql = NULL;
+    ok = id_list && scored;
+    if (ok)
+    {
+      size_t offset = 0;
+      id_list[0] = '\0';
+      for (int i = 0; i < e->online_count; i++)
       {
-        broadcast_time_update(i, remaining);
+        offset += snprintf(id_list + offset, list_size - offset, "%s%d", i ? "," : "", e->online_ids[i]);
       }
-      else if (room->room_status == 1)
+
+      insert_sql = sqlite3_mprintf(
+        "INSERT INTO results (user_id, room_id, score, total_questions, time_taken) "
+        "SELECT p.user_id, p.room_id, "
+        "  (SELECT COUNT(*) FROM exam_answers ua JOIN exam_questions q ON ua.question_id = q.id "
+        "   WHERE ua.user_id = p.user_id AND ua.room_id = p.room_id "
+        "   AND ua.selected_answer = q.correct_answer), "
+        "  (SELECT COUNT(*) FROM exam_questions WHERE room_id = p.room_id AND is_selected = 1), "
+        "  %d "
+        "FROM participants p "
+        "WHERE p.room_id = %d AND p.start_time > 0 AND p.user_id IN (%s) "
+        "AND NOT EXISTS (SELECT 1 FROM results r WHERE r.room_id = p.room_id AND r.user_id = p.user_id) "
+        "RETURNING user_id, score",
+        e->time_limit * 60, room_id, id_list);
+    }
+
+    // RETURNING: điểm từng thí sinh vừa được chấm để cập nhật bảng xếp hạng sau COMMIT
+    sqlite3_stmt *insert_stmt;
+    if (ok)
+      ok = insert_sql && sqlite3_prepare_v2(conn, insert_sql, -1, &insert_stmt, NULL) == SQLITE_OK;
+    if (ok)
+    {
+      int rc;
+      while ((rc = sqlite3_step(insert_stmt)) == SQLITE_ROW && scored_count < e->online_count)
       {
-        // Time's up - auto-submit CHỈ users đang ONLINE
-        room->room_status = 2; // Set status TO ENDED
-
-        // ===== PERSIST ENDED STATUS TO DATABASE =====
-        char update_status_sql[256];
-        snprintf(update_status_sql, sizeof(update_status_sql),
-                 "UPDATE rooms SET room_status = 2 WHERE id = %d", room->room_id);
-        char *update_err = NULL;
-        sqlite3_exec(db, update_status_sql, NULL, NULL, &update_err);
-        if (update_err) {
-          sqlite3_free(update_err);
-        } else {
-        }
+        scored[scored_count * 2] = sqlite3_column_int(insert_stmt, 0);
+        scored[scored_count * 2 + 1] = sqlite3_column_int(insert_stmt, 1);
+        scored_count++;
+      }
+      ok = rc == SQLITE_DONE || rc == SQLITE_ROW;
+      sqlite3_finalize(insert_stmt);
+    }
+    sqlite3_free(insert_sql);
+    free(id_list);
+  }
 
-        // ===== BROADCAST ROOM_ENDED TO ALL ONLINE USERS =====
-        char end_broadcast[128];
-        snprintf(end_broadcast, sizeof(end_broadcast), "ROOM_ENDED|%d\n", room->room_id);
-        for (int u = 0; u < server_data.user_count; u++) {
-          if (server_data.users[u].is_online == 1) {
-            send(server_data.users[u].socket_fd, end_broadcast, strlen(end_broadcast), 0);
-          }
-        }
+  if (ok)
+    ok = sqlite3_exec(conn, "COMMIT", NULL, NULL, NULL) == SQLITE_OK;
+  if (!ok)
+  {
+    fprintf(stderr, "[TIMER] Auto-submit room %d failed: %s\n", room_id, sqlite3_errmsg(conn));
+    sqlite3_exec(conn, "ROLLBACK", NULL, NULL, NULL);
+    free(scored);
+    return -1;
+  }
 
-        // Query danh sách participants từ DB để lấy users đã bắt đầu thi
-        char participant_query[512];
-        snprintf(participant_query, sizeof(participant_query),
-                 "SELECT DISTINCT p.user_id FROM participants p "
-                 "WHERE p.room_id = %d AND p.start_time > 0",
-                 room->room_id);
-
-        sqlite3_stmt *stmt;
-        if (sqlite3_prepare_v2(db, participant_query, -1, &stmt, NULL) == SQLITE_OK) {
-          while (sqlite3_step(stmt) == SQLITE_ROW) {
-            int user_id = sqlite3_column_int(stmt, 0);
-
-            // Kiểm tra user có đang online không
-            int is_online = 0;
-            for (int u = 0; u < server_data.user_count; u++) {
-              if (server_data.users[u].user_id == user_id) {
-                is_online = server_data.users[u].is_online;
-                break;
-              }
-            }
-
-            // CHỈ auto-submit user đang online
-            // User offline sẽ được giữ lại để có thể RESUME sau
-            if (is_online) {
-              // Query để check đã submit chưa
-              char check_result[256];
-              snprintf(check_result, sizeof(check_result),
-                       "SELECT id FROM results WHERE room_id = %d AND user_id = %d",
-                       room->room_id, user_id);
-
-              sqlite3_stmt *check_stmt;
-              int already_submitted = 0;
-              if (sqlite3_prepare_v2(db, check_result, -1, &check_stmt, NULL) == SQLITE_OK) {
-                if (sqlite3_step(check_stmt) == SQLITE_ROW) {
-                  already_submitted = 1;
-                }
-                sqlite3_finalize(check_stmt);
-              }
-
-              if (!already_submitted) {
-                // Tính điểm từ exam_answers
-                char score_query[512];
-                snprintf(score_query, sizeof(score_query),
-                         "SELECT COUNT(*) FROM exam_answers ua "
-                         "JOIN exam_questions q ON ua.question_id = q.id "
-                         "WHERE ua.user_id = %d AND ua.room_id = %d "
-                         "AND ua.selected_answer = q.correct_answer",
-                         user_id, room->room_id);
-
-                int score = 0;
-                sqlite3_stmt *score_stmt;
-                if (sqlite3_prepare_v2(db, score_query, -1, &score_stmt, NULL) == SQLITE_OK) {
-                  if (sqlite3_step(score_stmt) == SQLITE_ROW) {
-                    score = sqlite3_column_int(score_stmt, 0);
-                  }
-                  sqlite3_finalize(score_stmt);
-                }
-
-                // Đếm tổng số câu hỏi đã được chọn (is_selected = 1)
-                char count_query[256];
-                snprintf(count_query, sizeof(count_query),
-                         "SELECT COUNT(*) FROM exam_questions WHERE room_id = %d AND is_selected = 1", room->room_id);
-
-                int total_questions = 0;
-                sqlite3_stmt *count_stmt;
-                if (sqlite3_prepare_v2(db, count_query, -1, &count_stmt, NULL) == SQLITE_OK) {
-                  if (sqlite3_step(count_stmt) == SQLITE_ROW) {
-                    total_questions = sqlite3_column_int(count_stmt, 0);
-                  }
-                  sqlite3_finalize(count_stmt);
-                }
-
-                // Insert into results
-                char insert_query[512];
-                snprintf(insert_query, sizeof(insert_query),
-                         "INSERT INTO results (user_id, room_id, score, total_questions, time_taken) "
-                         "VALUES (%d, %d, %d, %d, %d)",
-                         user_id, room->room_id, score, total_questions, room->time_limit * 60);
-
-                char *err_msg = NULL;
-                sqlite3_exec(db, insert_query, NULL, NULL, &err_msg);
-                if (err_msg) {
-                  sqlite3_free(err_msg);
-                }
-              }
-            }
-          }
-          sqlite3_finalize(stmt);
-        }
+  printf("[TIMER] Room %d ended, auto-submitted %d user(s)\n", room_id, scored_count);
+  for (int i = 0; i < scored_count; i++)
+  {
+    leaderboard_record_result(scored[i * 2], scored[i * 2 + 1]);
+    user_stats_invalidate(scored[i * 2]);
+    analytics_record_submission(room_id, scored[i * 2]);
+    metrics_record_submission();
+  }
+
+  pthread_mutex_lock(&server_data.lock);
+  for (int i = 0; i < scored_count; i++)
+  {
+    roster_update(room_id, scored[i * 2], PARTICIPANT_AUTO_SUBMITTED);
+  }
+  pthread_mutex_unlock(&server_data.lock);
+  free(scored);
+  return 0;
+}
+
+static void free_pending_expiry(PendingExpiry *e)
+{
+  free(e->online_ids);
+  free(e->answers);
+  free(e);
+}
+
+// Giữ ảnh chụp và lên lịch thử lại sau 1, 2, 4, ... giây (tối đa EXPIRY_RETRY_MAX_SECONDS)
+static void schedule_expiry_retry(PendingExpiry *e, int attempt)
+{
+  int delay = attempt < 6 ? 1 << attempt : EXPIRY_RETRY_MAX_SECONDS;
+  if (delay > EXPIRY_RETRY_MAX_SECONDS)
+    delay = EXPIRY_RETRY_MAX_SECONDS;
+  scheduler_add(SCHED_ROOM_EXPIRY_RETRY, e->room_id, attempt + 1, time(NULL) + delay);
+}
+
+/*
+ * Handler thử lại auto-submit (id = room_id, user_id = số lần đã thử).
+ * Phòng đã bị xoá hoặc được start lại thì bỏ ảnh chụp cũ.
+ */
+void on_room_expiry_retry(int room_id, int attempt)
+{
+  PendingExpiry **link = &pending_expiries;
+  while (*link && (*link)->room_id != room_id)
+    link = &(*link)->next;
+  PendingExpiry *e = *link;
+  if (!e)
+    return;
+
+  pthread_mutex_lock(&server_data.lock);
+  int i = find_room_index_by_id(room_id);
+  int still_ended = i != -1 && server_data.rooms[i].room_status == 2;
+  pthread_mutex_unlock(&server_data.lock);
+
+  if (still_ended && persist_room_expiry(e) < 0)
+  {
+    schedule_expiry_retry(e, attempt);
+    return;
+  }
+  if (!still_ended)
+    fprintf(stderr, "[TIMER] Room %d changed before auto-submit was stored, dropping it\n", room_id);
+  *link = e->next;
+  free_pending_expiry(e);
+}
+
+/*
+ * Handler của scheduler khi một phòng thi hết giờ:
+ *  - Bỏ qua nếu phòng đã bị xoá/kết thúc hoặc đã được start lại (deadline cũ)
+ *  - Trong lock: đánh dấu ENDED, chụp lại user online + đáp án in-memory của họ
+ *  - Ngoài lock: phát ROOM_ENDED (host, thí sinh, subscriber rooms.list/room.<id>)
+ *    và ghi kết quả theo kiểu set-based.
+ *  User offline được giữ lại để có thể RESUME sau (như trước).
+ */
+void on_room_deadline(int room_id, int unused)
+{
+  (void)unused;
+  pthread_mutex_lock(&server_data.lock);
+
+  int i = find_room_index_by_id(room_id);
+  if (i == -1 || server_data.rooms[i].room_status != 1)  // STARTED
+  {
+    pthread_mutex_unlock(&server_data.lock);
+    return;
+  }
+
+  TestRoom *room = &server_data.rooms[i];
+  time_t deadline = room->exam_start_time + (time_t)room->time_limit * 60;
+  if (time(NULL) < deadline)
+  {
+    // Deadline cũ của lần start trước - lần start mới đã tự lên lịch
+    pthread_mutex_unlock(&server_data.lock);
+    return;
+  }
+
+  if (room->room_status == 1) metrics_add(METRIC_RUNNING_EXAMS, -1);
+  if (room->room_status != 2) metrics_add(METRIC_ACTIVE_ROOMS, -1);
+  room->room_status = 2; // Set status TO ENDED
+  int time_limit = room->time_limit;
+  room_catalog_invalidate();
+
+  // Socket của host/thí sinh để báo ROOM_ENDED, và id user online cho auto-submit
+  int sockets[MAX_CLIENTS];
+  int socket_count = collect_room_sockets(room, 1, sockets, MAX_CLIENTS);
+  int online_ids[MAX_CLIENTS];
+  int online_count = 0;
+  for (int u = 0; u < server_data.user_count && online_count < MAX_CLIENTS; u++)
+  {
+    if (server_data.users[u].is_online == 1)
+      online_ids[online_count++] = server_data.users[u].user_id;
+  }
+
+  // Chụp đáp án in-memory của các participant đang online
+  ExpiredAnswer *answers = NULL;
+  int answer_count = 0;
+  int answer_capacity = 0;
+  for (int p = 0; p < room->participant_count; p++)
+  {
+    int is_online = 0;
+    for (int k = 0; k < online_count; k++)
+    {
+      if (online_ids[k] == room->participants[p])
+      {
+        is_online = 1;
+        break;
+      }
+    }
+    if (!is_online)
+      continue;
+
+    for (int q = 0; q < room->num_questions && q < MAX_QUESTIONS; q++)
+    {
+      UserAnswer *ans = &room->answers[p][q];
+      if (ans->answer < 0 || ans->answer > 3)
+        continue;
+      if (answer_count == answer_capacity)
+      {
+        answer_capacity = answer_capacity ? answer_capacity * 2 : 64;
+        ExpiredAnswer *grown = realloc(answers, answer_capacity * sizeof(ExpiredAnswer));
+        if (!grown)
+          break;
+        answers = grown;
       }
+      answers[answer_count].user_id = room->participants[p];
+      answers[answer_count].question_idx = q;
+      answers[answer_count].answer = ans->answer;
+      answers[answer_count].submit_time = ans->submit_time;
+      answer_count++;
+    }
+  }
+
+  pthread_mutex_unlock(&server_data.lock);
+
+  // ===== BROADCAST ROOM_ENDED =====
+  char end_broadcast[128];
+  snprintf(end_broadcast, sizeof(end_broadcast), "ROOM_ENDED|%d\n", room_id);
+  publish_room_event(room_id, sockets, socket_count, end_broadcast);
+
+  PendingExpiry snapshot = { room_id, time_limit, online_ids, online_count, answers, answer_count, NULL };
+  if (persist_room_expiry(&snapshot) == 0)
+  {
+    free(answers);
+    return;
+  }
+
+  // DB bận/lỗi: phòng đã ENDED trong bộ nhớ nên phải giữ ảnh chụp và thử lại tới khi ghi được
+  PendingExpiry *e = calloc(1, sizeof(PendingExpiry));
+  int *ids = online_count > 0 ? malloc(sizeof(int) * online_count) : NULL;
+  if (!e || (online_count > 0 && !ids))
+  {
+    fprintf(stderr, "[TIMER] Auto-submit room %d lost: out of memory\n", room_id);
+    free(e);
+    free(ids);
+    free(answers);
+    return;
+  }
+  if (online_count > 0)
+    memcpy(ids, online_ids, sizeof(int) * online_count);
+  *e = snapshot;
+  e->online_ids = ids;
+  e->next = pending_expiries;
+  pending_expiries = e;
+  schedule_expiry_retry(e, 0);
+}
+
+/*
+ * Handler của scheduler cho nhịp TIME_UPDATE của một phòng:
+ *  - Tính thời gian còn lại theo exam_start_time phía server
+ *  - Fan-out một message chung rồi tự lên lịch nhịp kế tiếp cho tới khi hết giờ.
+ */
+void on_room_tick(int room_id, int unused)
+{
+  (void)unused;
+  pthread_mutex_lock(&server_data.lock);
+
+  int i = find_room_index_by_id(room_id);
+  if (i == -1 || server_data.rooms[i].room_status != 1)
+  {
+    pthread_mutex_unlock(&server_data.lock);
+    return;
+  }
+
+  TestRoom *room = &server_data.rooms[i];
+  time_t now = time(NULL);
+  int remaining = (int)(room->exam_start_time + (time_t)room->time_limit * 60 - now);
+  pthread_mutex_unlock(&server_data.lock);
+
+  if (remaining <= 0)
+    return;  // SCHED_ROOM_DEADLINE sẽ kết thúc phòng
+
+  broadcast_time_update(room_id, remaining);
+
+  if (remaining > TIME_UPDATE_INTERVAL)
+  {
+    scheduler_add(SCHED_ROOM_TICK, room_id, 0, now + TIME_UPDATE_INTERVAL);
+  }
+}
+
+/*
+ * Handler của scheduler khi deadline riêng của một thí sinh đến:
+ *  - Thí sinh online mà chưa nộp bài -> auto-submit
+ *  - Thí sinh offline được giữ nguyên để RESUME xử lý như trước
+ *  - Phòng đã bị xoá thì bỏ qua.
+ */
+void on_participant_deadline(int room_id, int user_id)
+{
+  pthread_mutex_lock(&server_data.lock);
+
+  // Phòng đã bị xoá (deadline còn sót lại): không tạo kết quả cho phòng không còn tồn tại
+  int room_exists = 0;
+  for (int r = 0; r < server_data.room_count; r++) {
+    if (server_data.rooms[r].room_id == room_id) {
+      room_exists = 1;
+      break;
     }
   }
+  if (!room_exists) {
+    pthread_mutex_unlock(&server_data.lock);
+    return;
+  }
+
+  int is_online = 0;
+  for (int u = 0; u < server_data.user_count; u++) {
+    if (server_data.users[u].user_id == user_id) {
+      is_online = server_data.users[u].is_online;
+      break;
+    }
+  }
+
+  if (is_online) {
+    // auto_submit_on_disconnect tự kiểm tra đã có kết quả chưa (idempotent)
+    auto_submit_on_disconnect(user_id, room_id);
+  }
 
   pthread_mutex_unlock(&server_data.lock);
 }
@@ -4,7 +4,22 @@
 #include "include/common.h"
 #include <sys/socket.h>
 
+// Chu kỳ server đẩy TIME_UPDATE cho thí sinh (giây), có thể override bằng -DTIME_UPDATE_INTERVAL=...
+#ifndef TIME_UPDATE_INTERVAL
+#define TIME_UPDATE_INTERVAL 10
+#endif
+
+// Auto-submit lúc hết giờ ghi DB lỗi (SQLITE_BUSY...) -> thử lại qua scheduler, khoảng chờ
+// tăng gấp đôi tới tối đa số giây này
+#define EXPIRY_RETRY_MAX_SECONDS 60
+
 void broadcast_time_update(int room_id, int time_remaining);
-void check_room_timeouts(void);
+void timer_schedule_room(int room_id, time_t start_time, int time_limit);
+void timer_schedule_room_ticks(int room_id);
+void timer_schedule_participant(int room_id, int user_id, time_t start_time, int time_limit);
+void on_room_deadline(int room_id, int unused);
+void on_room_expiry_retry(int room_id, int attempt);
+void on_room_tick(int room_id, int unused);
+void on_participant_deadline(int room_id, int user_id);
 
 #endif
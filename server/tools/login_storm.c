@@ -0,0 +1,174 @@
+/*
+ * login_storm: đo độ trễ LOGIN khi nhiều thí sinh đăng nhập cùng lúc (vd 8:59 trước giờ thi).
+ *
+ *   make login_storm
+ *   ./login_storm [-h host] [-p port] [-u users] [-r rounds] [-n prefix]
+ *
+ *  - Đăng ký sẵn `users` tài khoản <prefix>_<i> (bỏ qua nếu đã tồn tại)
+ *  - Mỗi vòng: mọi thread cùng qua barrier rồi connect + LOGIN, đo thời gian tới
+ *    LOGIN_OK/LOGIN_FAIL, sau đó LOGOUT và đóng kết nối
+ *  - In p50/p90/p99/max và số lượt đăng nhập mỗi giây.
+ * Server giữ tối đa MAX_CLIENTS (100) user in-memory nên mặc định 80 user x 5 vòng = 400 lượt.
+ */
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char *host = "127.0.0.1";
+static int port = 8888;
+static int user_count = 80;
+static int rounds = 5;
+static const char *prefix = "storm";
+// Quá thời gian này tính là lỗi (vd kết nối kẹt vì backlog listen đầy)
+#define STORM_REPLY_TIMEOUT_SEC 30
+
+static pthread_barrier_t start_barrier;
+static double *latencies_ms;     // [round * user_count + user], < 0 = lỗi
+static int login_failures = 0;
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static double now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static int connect_server(void) {
+  struct addrinfo hints = {0}, *res;
+  char port_str[16];
+  snprintf(port_str, sizeof(port_str), "%d", port);
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(host, port_str, &hints, &res) != 0) return -1;
+  int fd = socket(res->ai_family, res->ai_socktype, 0);
+  struct timeval tv = {STORM_REPLY_TIMEOUT_SEC, 0};
+  if (fd >= 0) setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  if (fd >= 0 && connect(fd, res->ai_addr, res->ai_addrlen) != 0) {
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(res);
+  return fd;
+}
+
+// Gửi một lệnh và đọc một dòng trả lời; trả độ dài, -1 nếu lỗi
+static int request(int fd, const char *msg, char *reply, size_t size) {
+  size_t len = strlen(msg);
+  if (send(fd, msg, len, MSG_NOSIGNAL) != (ssize_t)len) return -1;
+  size_t got = 0;
+  while (got < size - 1) {
+    ssize_t n = recv(fd, reply + got, size - 1 - got, 0);
+    if (n <= 0) return -1;
+    got += n;
+    if (memchr(reply, '\n', got)) break;
+  }
+  reply[got] = '\0';
+  return (int)got;
+}
+
+static void *storm_thread(void *arg) {
+  int index = (int)(long)arg;
+  char msg[128], reply[512];
+
+  // Chuẩn bị tài khoản
+  int fd = connect_server();
+  if (fd >= 0) {
+    snprintf(msg, sizeof(msg), "REGISTER|%s_%d|pw_%d\n", prefix, index, index);
+    request(fd, msg, reply, sizeof(reply));
+    close(fd);
+  }
+
+  for (int r = 0; r < rounds; r++) {
+    pthread_barrier_wait(&start_barrier);
+
+    double started = now_ms();
+    double elapsed = -1;
+    fd = connect_server();
+    if (fd >= 0) {
+      snprintf(msg, sizeof(msg), "LOGIN|%s_%d|pw_%d\n", prefix, index, index);
+      if (request(fd, msg, reply, sizeof(reply)) > 0) {
+        elapsed = now_ms() - started;
+        if (strncmp(reply, "LOGIN_OK|", 9) == 0) {
+          request(fd, "LOGOUT\n", reply, sizeof(reply));
+        } else {
+          pthread_mutex_lock(&stats_lock);
+          if (login_failures++ < 5) fprintf(stderr, "user %d: %s", index, reply);
+          pthread_mutex_unlock(&stats_lock);
+        }
+      }
+      close(fd);
+    }
+    latencies_ms[r * user_count + index] = elapsed;
+  }
+  return NULL;
+}
+
+static int compare_double(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, int count, double p) {
+  int idx = (int)(p / 100.0 * count + 0.5) - 1;
+  if (idx < 0) idx = 0;
+  if (idx >= count) idx = count - 1;
+  return sorted[idx];
+}
+
+int main(int argc, char **argv) {
+  int opt;
+  while ((opt = getopt(argc, argv, "h:p:u:r:n:")) != -1) {
+    switch (opt) {
+    case 'h': host = optarg; break;
+    case 'p': port = atoi(optarg); break;
+    case 'u': user_count = atoi(optarg); break;
+    case 'r': rounds = atoi(optarg); break;
+    case 'n': prefix = optarg; break;
+    default:
+      fprintf(stderr, "Usage: %s [-h host] [-p port] [-u users] [-r rounds] [-n prefix]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (user_count < 1 || rounds < 1) return 1;
+
+  latencies_ms = calloc((size_t)user_count * rounds, sizeof(double));
+  pthread_t *threads = calloc(user_count, sizeof(pthread_t));
+  if (!latencies_ms || !threads) return 1;
+
+  pthread_barrier_init(&start_barrier, NULL, user_count);
+  double started = now_ms();
+  for (int i = 0; i < user_count; i++) {
+    pthread_create(&threads[i], NULL, storm_thread, (void *)(long)i);
+  }
+  for (int i = 0; i < user_count; i++) pthread_join(threads[i], NULL);
+  double total_ms = now_ms() - started;
+
+  int total = user_count * rounds;
+  int ok = 0;
+  for (int i = 0; i < total; i++) {
+    if (latencies_ms[i] >= 0) latencies_ms[ok++] = latencies_ms[i];
+  }
+  if (ok == 0) {
+    fprintf(stderr, "No login completed (is the server running on %s:%d?)\n", host, port);
+    return 1;
+  }
+  qsort(latencies_ms, ok, sizeof(double), compare_double);
+
+  printf("logins: %d answered / %d sent, %d rejected, %d users x %d rounds\n",
+         ok, total, login_failures, user_count, rounds);
+  printf("latency ms: p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n",
+         percentile(latencies_ms, ok, 50), percentile(latencies_ms, ok, 90),
+         percentile(latencies_ms, ok, 99), latencies_ms[ok - 1]);
+  printf("throughput: %.0f logins/s (wall %.0f ms incl. setup)\n", ok * 1000.0 / total_ms, total_ms);
+
+  free(threads);
+  free(latencies_ms);
+  return 0;
+}
@@ -0,0 +1,530 @@
+#include "upload.h"
+#include "admin.h"
+#include "jobs.h"
+#include "journal.h"
+#include "practice.h"
+#include "questions.h"
+#include "scheduler.h"
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+extern ServerData server_data;
+
+/*
+ * Upload file theo chunk, tiếp tục được sau khi mất kết nối:
+ *   UPLOAD_BEGIN|purpose|target_id|filename|size   -> UPLOAD_READY|id|offset|max_chunk
+ *   UPLOAD_RESUME|id                                -> UPLOAD_READY|id|offset|max_chunk
+ *   UPLOAD_CHUNK|id|offset|len|crc32\n<len byte>   -> UPLOAD_ACK|id|offset mới
+ *                                                     hoặc UPLOAD_NACK|id|offset|reason
+ *   UPLOAD_COMMIT|id[|progress]                     -> response của lệnh import tương ứng
+ *   UPLOAD_COMMIT|id|0|1                            -> UPLOAD_QUEUED|id|job_id (import chạy
+ *                                                     trên job nền, kết quả qua JOB_DONE)
+ *   UPLOAD_ABORT|id                                 -> UPLOAD_ABORTED|id
+ *  - Dữ liệu ghi vào file staging uploads/<id>.part; offset chỉ tăng sau khi chunk
+ *    đã kiểm CRC32 và ghi xong, client gửi lại từ offset được ACK cuối cùng
+ *  - Chunk trùng (client gửi lại vì mất ACK) được ACK lại, không ghi hai lần
+ *  - Phiên gắn với user chứ không với socket: đăng nhập lại trên kết nối mới
+ *    rồi UPLOAD_RESUME để tiếp tục; phiên bỏ dở bị scheduler dọn sau UPLOAD_IDLE_TIMEOUT.
+ * Client phải chờ ACK/NACK của một chunk rồi mới gửi lệnh tiếp theo.
+ * Chunk đi qua admission control như mọi lệnh khác: bị từ chối thì payload vẫn được
+ * đọc bỏ rồi trả BUSY|retry_ms, client gửi lại chunk đó sau retry_ms.
+ */
+
+typedef struct {
+  int upload_id;            // 0 = slot trống
+  int user_id;
+  UploadPurpose purpose;
+  int target_id;
+  char filename[128];
+  long size;
+  long acked;               // số byte đầu file đã nhận và ghi xong
+  int busy;                 // đang nhận chunk hoặc đang import
+  int fd;                   // file staging
+  time_t last_activity;
+} UploadSession;
+
+static UploadSession sessions[UPLOAD_MAX_SESSIONS];
+static int next_upload_id = 1;
+static pthread_mutex_t upload_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void staging_path(char *path, size_t size, int upload_id) {
+  snprintf(path, size, UPLOAD_DIR "/%d.part", upload_id);
+}
+
+// Gọi khi đang giữ upload_lock
+static UploadSession *find_session(int upload_id) {
+  if (upload_id <= 0) return NULL;
+  for (int i = 0; i < UPLOAD_MAX_SESSIONS; i++) {
+    if (sessions[i].upload_id == upload_id) return &sessions[i];
+  }
+  return NULL;
+}
+
+// Gọi khi đang giữ upload_lock: đóng và xoá file staging, giải phóng slot
+static void release_session(UploadSession *s) {
+  char path[64];
+  staging_path(path, sizeof(path), s->upload_id);
+  if (s->fd >= 0) close(s->fd);
+  unlink(path);
+  printf("[UPLOAD] Released upload %d (%s, %ld/%ld bytes)\n", s->upload_id, s->filename, s->acked, s->size);
+  memset(s, 0, sizeof(*s));
+  s->fd = -1;
+}
+
+/*
+ * Tạo thư mục staging và xoá file còn sót từ lần chạy trước
+ * (phiên chỉ nằm trong bộ nhớ nên không thể tiếp tục sau khi restart).
+ */
+void upload_init(void) {
+  for (int i = 0; i < UPLOAD_MAX_SESSIONS; i++) sessions[i].fd = -1;
+
+  if (mkdir(UPLOAD_DIR, 0700) != 0 && errno != EEXIST) {
+    perror("[UPLOAD] Cannot create staging directory");
+    return;
+  }
+  DIR *dir = opendir(UPLOAD_DIR);
+  if (!dir) return;
+  struct dirent *entry;
+  char path[512];
+  while ((entry = readdir(dir)) != NULL) {
+    size_t len = strlen(entry->d_name);
+    if (len > 5 && strcmp(entry->d_name + len - 5, ".part") == 0) {
+      snprintf(path, sizeof(path), UPLOAD_DIR "/%s", entry->d_name);
+      unlink(path);
+    }
+  }
+  closedir(dir);
+}
+
+/*
+ * Handler của scheduler: huỷ phiên im lặng quá UPLOAD_IDLE_TIMEOUT,
+ * ngược lại hẹn kiểm tra lại theo lần hoạt động cuối.
+ */
+void on_upload_expired(int upload_id, int user_id) {
+  (void)user_id;
+  time_t now = time(NULL);
+  pthread_mutex_lock(&upload_lock);
+  UploadSession *s = find_session(upload_id);
+  if (s) {
+    time_t deadline = s->last_activity + UPLOAD_IDLE_TIMEOUT;
+    if (s->busy || deadline > now) {
+      scheduler_add(SCHED_UPLOAD_EXPIRY, upload_id, 0, s->busy ? now + UPLOAD_IDLE_TIMEOUT : deadline);
+    } else {
+      release_session(s);
+    }
+  }
+  pthread_mutex_unlock(&upload_lock);
+}
+
+static void send_ready(int socket_fd, int upload_id, long offset) {
+  char response[96];
+  snprintf(response, sizeof(response), "UPLOAD_READY|%d|%ld|%d\n", upload_id, offset, UPLOAD_MAX_CHUNK);
+  server_send(socket_fd, response);
+}
+
+static void send_fail(int socket_fd, int upload_id, const char *reason) {
+  char response[160];
+  snprintf(response, sizeof(response), "UPLOAD_FAIL|%d|%s\n", upload_id, reason);
+  server_send(socket_fd, response);
+}
+
+// Kiểm tra quyền ghi vào đích của upload; trả NULL nếu được phép
+static const char *check_target(int user_id, UploadPurpose purpose, int target_id) {
+  const char *error = "Room not found";
+  pthread_mutex_lock(&server_data.lock);
+  if (purpose == UPLOAD_EXAM_CSV) {
+    for (int i = 0; i < server_data.room_count; i++) {
+      if (server_data.rooms[i].room_id == target_id) {
+        error = NULL;
+        break;
+      }
+    }
+  } else {
+    for (int i = 0; i < server_data.practice_room_count; i++) {
+      if (server_data.practice_rooms[i].practice_id == target_id) {
+        error = server_data.practice_rooms[i].creator_id == user_id ? NULL : "Permission denied";
+        break;
+      }
+    }
+  }
+  pthread_mutex_unlock(&server_data.lock);
+
+  // Câu hỏi thi chỉ admin được thêm (giống ADD_QUESTION)
+  if (!error && purpose == UPLOAD_EXAM_CSV && !is_admin_user(user_id)) error = "Permission denied";
+  return error;
+}
+
+/*
+ * UPLOAD_BEGIN|purpose|target_id|filename|size
+ * purpose: exam_csv (target = room_id) hoặc practice_csv (target = practice_id).
+ */
+void handle_upload_begin(int socket_fd, int user_id, const char *purpose, const char *target_str,
+                         const char *filename, const char *size_str) {
+  if (user_id <= 0) {
+    send_fail(socket_fd, 0, "Not logged in");
+    return;
+  }
+  if (!purpose || !target_str || !filename || !size_str) {
+    send_fail(socket_fd, 0, "Invalid format. Expected: purpose|target_id|filename|size");
+    return;
+  }
+
+  UploadPurpose kind;
+  if (strcmp(purpose, "exam_csv") == 0)
+    kind = UPLOAD_EXAM_CSV;
+  else if (strcmp(purpose, "practice_csv") == 0)
+    kind = UPLOAD_PRACTICE_CSV;
+  else {
+    send_fail(socket_fd, 0, "Unknown purpose");
+    return;
+  }
+
+  int target_id = atoi(target_str);
+  long size = atol(size_str);
+  if (size <= 0 || size > UPLOAD_MAX_SIZE) {
+    send_fail(socket_fd, 0, "File size invalid");
+    return;
+  }
+
+  const char *error = check_target(user_id, kind, target_id);
+  if (error) {
+    send_fail(socket_fd, 0, error);
+    return;
+  }
+
+  pthread_mutex_lock(&upload_lock);
+  UploadSession *slot = NULL;
+  int owned = 0;
+  for (int i = 0; i < UPLOAD_MAX_SESSIONS; i++) {
+    if (sessions[i].upload_id == 0) {
+      if (!slot) slot = &sessions[i];
+    } else if (sessions[i].user_id == user_id) {
+      owned++;
+    }
+  }
+  if (!slot || owned >= UPLOAD_MAX_PER_USER) {
+    pthread_mutex_unlock(&upload_lock);
+    send_fail(socket_fd, 0, slot ? "Too many uploads in progress" : "Server busy");
+    return;
+  }
+
+  int upload_id = next_upload_id++;
+  char path[64];
+  staging_path(path, sizeof(path), upload_id);
+  int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (fd < 0) {
+    pthread_mutex_unlock(&upload_lock);
+    perror("[UPLOAD] Cannot create staging file");
+    send_fail(socket_fd, 0, "Server error");
+    return;
+  }
+
+  slot->upload_id = upload_id;
+  slot->user_id = user_id;
+  slot->purpose = kind;
+  slot->target_id = target_id;
+  snprintf(slot->filename, sizeof(slot->filename), "%s", filename);
+  slot->size = size;
+  slot->acked = 0;
+  slot->busy = 0;
+  slot->fd = fd;
+  slot->last_activity = time(NULL);
+  pthread_mutex_unlock(&upload_lock);
+
+  scheduler_add(SCHED_UPLOAD_EXPIRY, upload_id, 0, time(NULL) + UPLOAD_IDLE_TIMEOUT);
+  printf("[UPLOAD] User %d began upload %d: %s (%ld bytes) -> %s %d\n",
+         user_id, upload_id, filename, size, purpose, target_id);
+  send_ready(socket_fd, upload_id, 0);
+}
+
+/*
+ * UPLOAD_RESUME|id -> offset đã ACK để client gửi tiếp (sau khi kết nối lại).
+ */
+void handle_upload_resume(int socket_fd, int user_id, int upload_id) {
+  pthread_mutex_lock(&upload_lock);
+  UploadSession *s = find_session(upload_id);
+  if (!s || s->user_id != user_id) {
+    pthread_mutex_unlock(&upload_lock);
+    send_fail(socket_fd, upload_id, "Upload not found");
+    return;
+  }
+  long offset = s->acked;
+  s->last_activity = time(NULL);
+  pthread_mutex_unlock(&upload_lock);
+  send_ready(socket_fd, upload_id, offset);
+}
+
+// Đọc đúng len byte (chờ tối đa UPLOAD_CHUNK_TIMEOUT_MS mỗi lần); trả 0, -1 nếu mất kết nối/timeout
+static int recv_exact(int socket_fd, char *data, size_t len) {
+  size_t got = 0;
+  while (got < len) {
+    struct pollfd pfd = { .fd = socket_fd, .events = POLLIN };
+    int ready = poll(&pfd, 1, UPLOAD_CHUNK_TIMEOUT_MS);
+    if (ready < 0 && errno == EINTR) continue;
+    if (ready <= 0) return -1;
+    ssize_t n = recv(socket_fd, data + got, len - got, 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return -1;
+    got += (size_t)n;
+  }
+  return 0;
+}
+
+// Đọc bỏ len byte payload của chunk bị từ chối để giữ đồng bộ protocol
+static int discard_exact(int socket_fd, size_t len) {
+  char scratch[4096];
+  while (len > 0) {
+    size_t part = len < sizeof(scratch) ? len : sizeof(scratch);
+    if (recv_exact(socket_fd, scratch, part) != 0) return -1;
+    len -= part;
+  }
+  return 0;
+}
+
+
+static void send_nack(int socket_fd, int upload_id, long offset, const char *reason) {
+  char response[160];
+  snprintf(response, sizeof(response), "UPLOAD_NACK|%d|%ld|%s\n", upload_id, offset, reason);
+  server_send(socket_fd, response);
+}
+
+// Phần còn lại của UPLOAD_CHUNK sau khi đã qua admission: nhận nốt payload, kiểm tra và ghi
+static void upload_apply_chunk(int socket_fd, int user_id, int upload_id, long offset, long len,
+                               uint32_t crc, const char *start, size_t have) {
+  char *data = malloc((size_t)len);
+  if (!data) {
+    send_nack(socket_fd, upload_id, -1, "Out of memory");
+    return;
+  }
+  memcpy(data, start, have);
+  if (recv_exact(socket_fd, data + have, (size_t)len - have) != 0) {
+    // Mất kết nối giữa chunk: phiên giữ nguyên offset cũ để UPLOAD_RESUME
+    free(data);
+    send_nack(socket_fd, upload_id, -1, "Incomplete chunk");
+    return;
+  }
+
+  const char *error = NULL;
+  long acked = -1;
+  pthread_mutex_lock(&upload_lock);
+  UploadSession *s = find_session(upload_id);
+  if (!s || s->user_id != user_id) {
+    error = "Upload not found";
+  } else if (s->busy) {
+    error = "Upload busy";
+    acked = s->acked;
+  } else {
+    acked = s->acked;
+    s->last_activity = time(NULL);
+    if (offset + len <= s->acked) {
+      // Chunk đã nhận (client gửi lại vì mất ACK) -> ACK lại
+      offset = -1;
+    } else if (offset != s->acked) {
+      error = "Unexpected offset";
+    } else if (offset + len > s->size) {
+      error = "Chunk exceeds file size";
+    } else if (crc32_compute(data, (size_t)len) != crc) {
+      error = "Checksum mismatch";
+    } else {
+      s->busy = 1;
+    }
+  }
+  int fd = s ? s->fd : -1;
+  pthread_mutex_unlock(&upload_lock);
+
+  if (error) {
+    free(data);
+    send_nack(socket_fd, upload_id, acked, error);
+    return;
+  }
+
+  if (offset >= 0) {
+    // Ghi ngoài lock; busy chặn chunk/commit khác của cùng phiên
+    ssize_t written = pwrite(fd, data, (size_t)len, offset);
+    pthread_mutex_lock(&upload_lock);
+    s->busy = 0;
+    if (written == len) s->acked = offset + len;
+    acked = s->acked;
+    pthread_mutex_unlock(&upload_lock);
+    if (written != len) {
+      free(data);
+      perror("[UPLOAD] Staging write failed");
+      send_nack(socket_fd, upload_id, acked, "Server write failed");
+      return;
+    }
+  }
+  free(data);
+
+  char response[64];
+  snprintf(response, sizeof(response), "UPLOAD_ACK|%d|%ld\n", upload_id, acked);
+  server_send(socket_fd, response);
+}
+
+/*
+ * recv() đầu tiên có thể chỉ chứa một phần dòng header UPLOAD_CHUNK: đọc tiếp vào buffer
+ * (đang có n byte) tới khi gặp '\n', tối đa UPLOAD_HEADER_MAX byte header.
+ * Trả tổng số byte trong buffer; header vẫn không trọn (quá dài, mất kết nối, timeout)
+ * thì handle_upload_chunk sẽ NACK.
+ */
+int upload_recv_header(int socket_fd, char *buffer, size_t size, int n) {
+  while (!memchr(buffer, '\n', (size_t)n) && n < UPLOAD_HEADER_MAX && (size_t)n < size - 1) {
+    struct pollfd pfd = { .fd = socket_fd, .events = POLLIN };
+    int ready = poll(&pfd, 1, UPLOAD_CHUNK_TIMEOUT_MS);
+    if (ready < 0 && errno == EINTR) continue;
+    if (ready <= 0) break;
+    ssize_t got = recv(socket_fd, buffer + n, size - 1 - (size_t)n, 0);
+    if (got < 0 && errno == EINTR) continue;
+    if (got <= 0) break;
+    n += (int)got;
+  }
+  buffer[n] = '\0';
+  return n;
+}
+
+/*
+ * UPLOAD_CHUNK|id|offset|len|crc32\n<len byte>
+ * buffer/n là dữ liệu đã nhận, chứa trọn dòng header (xem upload_recv_header):
+ * phần sau header là đầu payload.
+ * Luôn đọc hết payload (nếu len hợp lệ) để giữ đồng bộ protocol.
+ */
+void handle_upload_chunk(int socket_fd, int user_id, TokenBucket *conn_bucket, const char *buffer, int n) {
+  const char *newline = memchr(buffer, '\n', (size_t)n);
+  int upload_id = 0;
+  long offset = -1;
+  long len = 0;
+  unsigned long crc = 0;
+  if (!newline || sscanf(buffer, "UPLOAD_CHUNK|%d|%ld|%ld|%lu", &upload_id, &offset, &len, &crc) != 4 ||
+      len <= 0 || len > UPLOAD_MAX_CHUNK || offset < 0) {
+    send_nack(socket_fd, upload_id, -1, "Invalid chunk header");
+    return;
+  }
+
+  size_t have = (size_t)(buffer + n - (newline + 1));
+  if (have > (size_t)len) have = (size_t)len;   // dữ liệu thừa sau payload bị bỏ
+
+  AdmitTicket ticket;
+  int retry_ms = admission_acquire(conn_bucket, user_id, "UPLOAD_CHUNK", &ticket);
+  if (retry_ms > 0) {
+    if (discard_exact(socket_fd, (size_t)len - have) != 0) return;
+    char busy[32];
+    snprintf(busy, sizeof(busy), "BUSY|%d\n", retry_ms);
+    server_send(socket_fd, busy);
+    return;
+  }
+  upload_apply_chunk(socket_fd, user_id, upload_id, offset, len, (uint32_t)crc, newline + 1, have);
+  admission_release(&ticket);
+}
+
+/*
+ * Chạy import theo purpose của phiên đã được đánh dấu busy, rồi xoá phiên và file
+ * staging. socket_fd < 0 khi chạy từ job nền (response chỉ ghi vào reply).
+ */
+static int run_upload_import(int socket_fd, int user_id, int upload_id, int report_progress,
+                             char *reply, size_t reply_size) {
+  char path[64];
+  pthread_mutex_lock(&upload_lock);
+  UploadSession *s = find_session(upload_id);
+  if (!s) {
+    pthread_mutex_unlock(&upload_lock);
+    snprintf(reply, reply_size, "Upload not found");
+    return -1;
+  }
+  UploadPurpose purpose = s->purpose;
+  int target_id = s->target_id;
+  staging_path(path, sizeof(path), upload_id);
+  pthread_mutex_unlock(&upload_lock);
+
+  int rc;
+  if (purpose == UPLOAD_EXAM_CSV)
+    rc = import_csv_file(socket_fd, target_id, path, report_progress, reply, reply_size);
+  else
+    rc = import_practice_csv(socket_fd, user_id, target_id, path, -1, reply, reply_size);
+
+  scheduler_cancel(SCHED_UPLOAD_EXPIRY, upload_id, 0);
+  pthread_mutex_lock(&upload_lock);
+  s = find_session(upload_id);
+  if (s) release_session(s);
+  pthread_mutex_unlock(&upload_lock);
+  return rc;
+}
+
+/*
+ * Job JOB_IMPORT_UPLOAD (target = upload_id): import file đã upload xong.
+ * message = response import (không kèm '\n'), được đẩy về qua JOB_DONE.
+ */
+int run_upload_import_job(int job_id, int upload_id, int user_id, sqlite3 *conn,
+                          char *message, size_t message_size) {
+  (void)job_id;
+  (void)conn;  // csv_import_from_file tự mở connection ghi riêng
+  int rc = run_upload_import(-1, user_id, upload_id, 0, message, message_size);
+  message[strcspn(message, "\n")] = '\0';
+  return rc;
+}
+
+/*
+ * UPLOAD_COMMIT|id[|progress[|async]]: file phải đủ size byte; chạy import theo purpose
+ * (response giống IMPORT_CSV / IMPORT_PRACTICE_CSV) rồi xoá phiên và file staging.
+ * async = 1: trả UPLOAD_QUEUED|id|job_id ngay, import chạy trên job nền.
+ */
+void handle_upload_commit(int socket_fd, int user_id, int upload_id, int report_progress, int async) {
+  char reason[256];
+  pthread_mutex_lock(&upload_lock);
+  UploadSession *s = find_session(upload_id);
+  if (!s || s->user_id != user_id) {
+    pthread_mutex_unlock(&upload_lock);
+    send_fail(socket_fd, upload_id, "Upload not found");
+    return;
+  }
+  if (s->busy || s->acked != s->size) {
+    if (s->busy)
+      snprintf(reason, sizeof(reason), "Upload busy");
+    else
+      snprintf(reason, sizeof(reason), "Incomplete upload (%ld/%ld bytes)", s->acked, s->size);
+    pthread_mutex_unlock(&upload_lock);
+    send_fail(socket_fd, upload_id, reason);
+    return;
+  }
+  s->busy = 1;
+  pthread_mutex_unlock(&upload_lock);
+
+  if (async) {
+    int job_id = job_submit(JOB_IMPORT_UPLOAD, user_id, upload_id);
+    if (job_id < 0) {
+      pthread_mutex_lock(&upload_lock);
+      s = find_session(upload_id);
+      if (s) s->busy = 0;
+      pthread_mutex_unlock(&upload_lock);
+      send_fail(socket_fd, upload_id, "Server busy, try again later");
+      return;
+    }
+    char response[64];
+    snprintf(response, sizeof(response), "UPLOAD_QUEUED|%d|%d\n", upload_id, job_id);
+    server_send(socket_fd, response);
+    return;
+  }
+
+  // reason nhận lại response import đã gửi cho client (không dùng tới)
+  run_upload_import(socket_fd, user_id, upload_id, report_progress, reason, sizeof(reason));
+}
+
+void handle_upload_abort(int socket_fd, int user_id, int upload_id) {
+  pthread_mutex_lock(&upload_lock);
+  UploadSession *s = find_session(upload_id);
+  if (!s || s->user_id != user_id || s->busy) {
+    pthread_mutex_unlock(&upload_lock);
+    send_fail(socket_fd, upload_id, s && s->user_id == user_id ? "Upload busy" : "Upload not found");
+    return;
+  }
+  release_session(s);
+  pthread_mutex_unlock(&upload_lock);
+  scheduler_cancel(SCHED_UPLOAD_EXPIRY, upload_id, 0);
+
+  char response[64];
+  snprintf(response, sizeof(response), "UPLOAD_ABORTED|%d\n", upload_id);
+  server_send(socket_fd, response);
+}
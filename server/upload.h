@@ -0,0 +1,41 @@
+#ifndef UPLOAD_H
+#define UPLOAD_H
+
+#include "common.h"
+#include "admission.h"
+
+// Thư mục chứa file staging (tương đối với thư mục chạy server)
+#define UPLOAD_DIR "uploads"
+// Số phiên upload đồng thời tối đa (toàn server / mỗi user)
+#define UPLOAD_MAX_SESSIONS 64
+#define UPLOAD_MAX_PER_USER 4
+// Kích thước file và chunk tối đa
+#define UPLOAD_MAX_SIZE (256L * 1024 * 1024)
+#define UPLOAD_MAX_CHUNK (1024 * 1024)
+// Phiên không có hoạt động quá thời gian này bị huỷ cùng file staging (giây)
+#define UPLOAD_IDLE_TIMEOUT (60 * 60)
+// Thời gian chờ tối đa phần dữ liệu còn lại của một chunk (ms)
+#define UPLOAD_CHUNK_TIMEOUT_MS 30000
+// Độ dài tối đa dòng header UPLOAD_CHUNK|id|offset|len|crc32
+#define UPLOAD_HEADER_MAX 128
+
+// Mục đích của file upload, quyết định việc gì chạy khi UPLOAD_COMMIT
+typedef enum {
+  UPLOAD_EXAM_CSV = 0,       // câu hỏi thi -> exam_questions của phòng target_id
+  UPLOAD_PRACTICE_CSV        // câu hỏi luyện tập -> phòng luyện tập target_id
+} UploadPurpose;
+
+void upload_init(void);
+void on_upload_expired(int upload_id, int user_id);
+
+void handle_upload_begin(int socket_fd, int user_id, const char *purpose, const char *target_str,
+                         const char *filename, const char *size_str);
+void handle_upload_resume(int socket_fd, int user_id, int upload_id);
+int upload_recv_header(int socket_fd, char *buffer, size_t size, int n);
+void handle_upload_chunk(int socket_fd, int user_id, TokenBucket *conn_bucket, const char *buffer, int n);
+void handle_upload_commit(int socket_fd, int user_id, int upload_id, int report_progress, int async);
+int run_upload_import_job(int job_id, int upload_id, int user_id, sqlite3 *conn,
+                          char *message, size_t message_size);
+void handle_upload_abort(int socket_fd, int user_id, int upload_id);
+
+#endif
@@ -0,0 +1,253 @@
+#include "user_stats.h"
+
+extern ServerData server_data;
+extern sqlite3 *db;
+
+/*
+ * Thống kê cá nhân (USER_STATS) và lịch sử thi (TEST_HISTORY):
+ *  - Bảng user_stats (số bài, tổng điểm, điểm cao nhất, tổng tỉ lệ đúng, số bài đạt)
+ *    được trigger cập nhật trong cùng transaction với mỗi INSERT/DELETE trên results
+ *  - Cache in-memory theo user: tổng hợp + USER_STATS_RECENT bài gần nhất,
+ *    nạp bằng hai truy vấn theo khoá, bị huỷ khi user có kết quả mới
+ *  - Lịch sử phân trang theo cursor (result id giảm dần) trên index (user_id, id).
+ */
+
+typedef struct {
+  int user_id;
+  int valid;
+  time_t last_used;
+  int tests;
+  int total_score;
+  int max_score;
+  double ratio_sum;
+  int passed;
+  int recent_count;
+  UserHistoryRow recent[USER_STATS_RECENT];
+} UserStatsEntry;
+
+static UserStatsEntry cache[USER_STATS_CACHE_SIZE];
+// Tăng mỗi lần invalidate: entry nạp trước một lần invalidate không được đưa vào cache
+static unsigned long cache_generation = 0;
+static pthread_mutex_t user_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Tạo bảng rollup + trigger và backfill từ results nếu bảng còn rỗng.
+ * Gọi một lần khi khởi động, sau init_database().
+ */
+void user_stats_init(void) {
+  const char *sql_schema =
+    "CREATE TABLE IF NOT EXISTS user_stats("
+    "user_id INTEGER PRIMARY KEY,"
+    "tests INTEGER DEFAULT 0,"
+    "total_score INTEGER DEFAULT 0,"
+    "max_score INTEGER DEFAULT 0,"
+    "ratio_sum REAL DEFAULT 0,"
+    "passed INTEGER DEFAULT 0);"
+    "CREATE INDEX IF NOT EXISTS idx_results_user ON results(user_id, id);"
+    "CREATE TRIGGER IF NOT EXISTS trg_results_stats_insert AFTER INSERT ON results BEGIN "
+    "  INSERT INTO user_stats (user_id, tests, total_score, max_score, ratio_sum, passed) "
+    "  VALUES (NEW.user_id, 1, NEW.score, NEW.score, "
+    "    CASE WHEN NEW.total_questions > 0 THEN CAST(NEW.score AS REAL) / NEW.total_questions ELSE 0 END, "
+    "    CASE WHEN NEW.total_questions > 0 AND NEW.score * 2 >= NEW.total_questions THEN 1 ELSE 0 END) "
+    "  ON CONFLICT(user_id) DO UPDATE SET "
+    "    tests = tests + 1, total_score = total_score + excluded.total_score, "
+    "    max_score = MAX(max_score, excluded.max_score), "
+    "    ratio_sum = ratio_sum + excluded.ratio_sum, passed = passed + excluded.passed; "
+    "END;"
+    "CREATE TRIGGER IF NOT EXISTS trg_results_stats_delete AFTER DELETE ON results BEGIN "
+    "  UPDATE user_stats SET "
+    "    tests = tests - 1, total_score = total_score - OLD.score, "
+    "    ratio_sum = ratio_sum - CASE WHEN OLD.total_questions > 0 "
+    "      THEN CAST(OLD.score AS REAL) / OLD.total_questions ELSE 0 END, "
+    "    passed = passed - CASE WHEN OLD.total_questions > 0 AND OLD.score * 2 >= OLD.total_questions "
+    "      THEN 1 ELSE 0 END, "
+    "    max_score = (SELECT COALESCE(MAX(score), 0) FROM results WHERE user_id = OLD.user_id) "
+    "  WHERE user_id = OLD.user_id; "
+    "END;";
+
+  char *err_msg = NULL;
+  if (sqlite3_exec(db, sql_schema, NULL, NULL, &err_msg) != SQLITE_OK) {
+    fprintf(stderr, "[USER_STATS] Failed to create rollup: %s\n", err_msg ? err_msg : "");
+    sqlite3_free(err_msg);
+    return;
+  }
+
+  // DB cũ đã có results nhưng chưa có rollup: dựng lại một lần từ lịch sử
+  const char *sql_backfill =
+    "INSERT INTO user_stats (user_id, tests, total_score, max_score, ratio_sum, passed) "
+    "SELECT user_id, COUNT(*), SUM(score), MAX(score), "
+    "  SUM(CASE WHEN total_questions > 0 THEN CAST(score AS REAL) / total_questions ELSE 0 END), "
+    "  SUM(CASE WHEN total_questions > 0 AND score * 2 >= total_questions THEN 1 ELSE 0 END) "
+    "FROM results WHERE NOT EXISTS (SELECT 1 FROM user_stats) GROUP BY user_id;";
+  if (sqlite3_exec(db, sql_backfill, NULL, NULL, &err_msg) != SQLITE_OK) {
+    fprintf(stderr, "[USER_STATS] Backfill failed: %s\n", err_msg ? err_msg : "");
+    sqlite3_free(err_msg);
+  }
+}
+
+/*
+ * User vừa có kết quả mới / bị xoá kết quả: bỏ cache của user (user_id <= 0: bỏ tất cả).
+ */
+void user_stats_invalidate(int user_id) {
+  pthread_mutex_lock(&user_stats_lock);
+  cache_generation++;
+  for (int i = 0; i < USER_STATS_CACHE_SIZE; i++) {
+    if (cache[i].valid && (user_id <= 0 || cache[i].user_id == user_id)) {
+      cache[i].valid = 0;
+    }
+  }
+  pthread_mutex_unlock(&user_stats_lock);
+}
+
+// Đọc tối đa limit bài thi của user có id < cursor (0 = mới nhất), mới nhất trước.
+// Caller giữ server_data.lock (dùng connection chính).
+static int load_history(int user_id, int cursor, int limit, UserHistoryRow *out) {
+  const char *sql =
+    "SELECT r.id, rm.name, r.score, r.total_questions, r.time_taken, "
+    "datetime(r.completed_at, 'localtime') "
+    "FROM results r JOIN rooms rm ON r.room_id = rm.id "
+    "WHERE r.user_id = ? AND (? = 0 OR r.id < ?) "
+    "ORDER BY r.id DESC LIMIT ?;";
+
+  sqlite3_stmt *stmt;
+  if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    return -1;
+  }
+  sqlite3_bind_int(stmt, 1, user_id);
+  sqlite3_bind_int(stmt, 2, cursor);
+  sqlite3_bind_int(stmt, 3, cursor);
+  sqlite3_bind_int(stmt, 4, limit);
+
+  int count = 0;
+  while (count < limit && sqlite3_step(stmt) == SQLITE_ROW) {
+    UserHistoryRow *r = &out[count++];
+    memset(r, 0, sizeof(*r));
+    r->result_id = sqlite3_column_int(stmt, 0);
+    const char *room_name = (const char *)sqlite3_column_text(stmt, 1);
+    const char *completed = (const char *)sqlite3_column_text(stmt, 5);
+    strncpy(r->room_name, room_name ? room_name : "", sizeof(r->room_name) - 1);
+    strncpy(r->completed, completed ? completed : "N/A", sizeof(r->completed) - 1);
+    r->score = sqlite3_column_int(stmt, 2);
+    r->total = sqlite3_column_int(stmt, 3);
+    r->time_taken = sqlite3_column_int(stmt, 4);
+  }
+  sqlite3_finalize(stmt);
+  return count;
+}
+
+// Nạp rollup + các bài gần nhất của user. Caller giữ server_data.lock.
+static int load_entry(UserStatsEntry *entry, int user_id) {
+  memset(entry, 0, sizeof(*entry));
+  entry->user_id = user_id;
+
+  sqlite3_stmt *stmt;
+  if (sqlite3_prepare_v2(db, "SELECT tests, total_score, max_score, ratio_sum, passed "
+                             "FROM user_stats WHERE user_id = ?;",
+                         -1, &stmt, NULL) != SQLITE_OK) {
+    return -1;
+  }
+  sqlite3_bind_int(stmt, 1, user_id);
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    entry->tests = sqlite3_column_int(stmt, 0);
+    entry->total_score = sqlite3_column_int(stmt, 1);
+    entry->max_score = sqlite3_column_int(stmt, 2);
+    entry->ratio_sum = sqlite3_column_double(stmt, 3);
+    entry->passed = sqlite3_column_int(stmt, 4);
+  }
+  sqlite3_finalize(stmt);
+
+  int count = load_history(user_id, 0, USER_STATS_RECENT, entry->recent);
+  if (count < 0) return -1;
+  entry->recent_count = count;
+  entry->valid = 1;
+  return 0;
+}
+
+// Lấy bản sao entry của user từ cache, nạp từ DB nếu chưa có
+static int get_entry(int user_id, UserStatsEntry *out) {
+  pthread_mutex_lock(&user_stats_lock);
+  for (int i = 0; i < USER_STATS_CACHE_SIZE; i++) {
+    if (cache[i].valid && cache[i].user_id == user_id) {
+      cache[i].last_used = time(NULL);
+      *out = cache[i];
+      pthread_mutex_unlock(&user_stats_lock);
+      return 0;
+    }
+  }
+  unsigned long generation = cache_generation;
+  pthread_mutex_unlock(&user_stats_lock);
+
+  // Cache miss: đọc DB không giữ user_stats_lock (thứ tự lock: server_data.lock -> user_stats_lock)
+  pthread_mutex_lock(&server_data.lock);
+  int rc = load_entry(out, user_id);
+  pthread_mutex_unlock(&server_data.lock);
+  if (rc != 0) return -1;
+
+  pthread_mutex_lock(&user_stats_lock);
+  if (generation == cache_generation) {
+    // Thay slot trống hoặc slot lâu không dùng nhất
+    UserStatsEntry *slot = &cache[0];
+    for (int i = 0; i < USER_STATS_CACHE_SIZE && slot->valid; i++) {
+      if (!cache[i].valid || cache[i].last_used < slot->last_used) {
+        slot = &cache[i];
+      }
+    }
+    out->last_used = time(NULL);
+    *slot = *out;
+  }
+  pthread_mutex_unlock(&user_stats_lock);
+  return 0;
+}
+
+/*
+ * Tổng hợp kết quả thi của user (từ cache/rollup, không quét bảng results).
+ * Trả về 0 nếu thành công, -1 nếu lỗi DB.
+ */
+int user_stats_get(int user_id, UserStatsSummary *out) {
+  UserStatsEntry entry;
+  memset(out, 0, sizeof(*out));
+  if (get_entry(user_id, &entry) != 0) return -1;
+
+  out->tests = entry.tests;
+  out->total_score = entry.total_score;
+  out->max_score = entry.max_score;
+  out->avg_ratio = entry.tests > 0 ? entry.ratio_sum / entry.tests : 0.0;
+  out->passed = entry.passed;
+  return 0;
+}
+
+/*
+ * Một trang lịch sử thi của user, mới nhất trước:
+ *  - cursor = result id cuối của trang trước (0 = trang đầu, lấy từ cache)
+ *  - *has_more = 1 nếu còn trang sau.
+ * Trả về số dòng ghi vào rows (tối đa limit), -1 nếu lỗi DB.
+ */
+int user_stats_history(int user_id, int cursor, int limit, UserHistoryRow *rows, int *has_more) {
+  if (limit <= 0) limit = USER_STATS_RECENT;
+  if (limit > USER_STATS_PAGE_MAX) limit = USER_STATS_PAGE_MAX;
+  if (cursor < 0) cursor = 0;
+  *has_more = 0;
+
+  if (cursor == 0 && limit <= USER_STATS_RECENT) {
+    UserStatsEntry entry;
+    if (get_entry(user_id, &entry) != 0) return -1;
+    int count = entry.recent_count < limit ? entry.recent_count : limit;
+    memcpy(rows, entry.recent, sizeof(UserHistoryRow) * count);
+    *has_more = entry.tests > count;
+    return count;
+  }
+
+  // Đọc dư một dòng để biết còn trang sau hay không
+  UserHistoryRow page[USER_STATS_PAGE_MAX + 1];
+  pthread_mutex_lock(&server_data.lock);
+  int count = load_history(user_id, cursor, limit + 1, page);
+  pthread_mutex_unlock(&server_data.lock);
+  if (count < 0) return -1;
+
+  if (count > limit) {
+    *has_more = 1;
+    count = limit;
+  }
+  memcpy(rows, page, sizeof(UserHistoryRow) * count);
+  return count;
+}
@@ -0,0 +1,35 @@
+#ifndef USER_STATS_H
+#define USER_STATS_H
+
+#include "common.h"
+
+// Số bài thi gần nhất giữ sẵn trong cache (= trang lịch sử mặc định)
+#define USER_STATS_RECENT 20
+// Số user được cache thống kê cùng lúc
+#define USER_STATS_CACHE_SIZE 256
+// Số dòng tối đa mỗi trang TEST_HISTORY
+#define USER_STATS_PAGE_MAX 50
+
+typedef struct {
+  int tests;
+  int total_score;
+  int max_score;
+  double avg_ratio;   // trung bình score/total_questions (0..1)
+  int passed;         // số bài đạt >= 50%
+} UserStatsSummary;
+
+typedef struct {
+  int result_id;
+  char room_name[100];
+  int score;
+  int total;
+  int time_taken;
+  char completed[32];
+} UserHistoryRow;
+
+void user_stats_init(void);
+void user_stats_invalidate(int user_id);
+int user_stats_get(int user_id, UserStatsSummary *out);
+int user_stats_history(int user_id, int cursor, int limit, UserHistoryRow *rows, int *has_more);
+
+#endif